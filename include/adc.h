@@ -0,0 +1,22 @@
+#ifndef ADC_H
+#define ADC_H
+
+#include <inttypes.h>
+#include "struct.h"
+
+/******************************************************************************
+* Internal ADC
+* Calibrated (eFuse) conversion of raw values to mV and burst sampling of
+* several ADC1 channels at once through I2S DMA.
+******************************************************************************/
+namespace Adc
+{
+	RetResult init();
+
+	RetResult read_burst(const uint8_t pins[], int count, int mv_out[]);
+
+	int raw_to_mv(uint8_t pin, int raw);
+	int mv_to_raw(uint8_t pin, int mv);
+}
+
+#endif
@@ -28,17 +28,68 @@ extern const int TB_PORT;
  * used only for debugging. Wifi debug console uses the much larger ESP http
  * library because ArduinoHttpClient doesn't support SSL.
  */
+#ifndef WIFI_DEBUG_CONSOLE
 #define WIFI_DEBUG_CONSOLE false
+#endif
 
 /**
  * Enable data submission through Wifi instead of GSM
  * For debugging purposes
  */
+#ifndef WIFI_DATA_SUBMISSION
 #define WIFI_DATA_SUBMISSION false
+#endif
+
+/******************************************************************************
+ * Features
+ * Subsystems built into the firmware. Defaults can be overridden per board
+ * (include/boards) or per build env (-D in platformio.ini). FLAGS are constexpr
+ * so code of disabled features is removed by the compiler/linker, run the
+ * size_report target to see the resulting flash/RAM usage.
+ *****************************************************************************/
+#ifndef FEATURE_WATER_QUALITY_SENSOR
+#define FEATURE_WATER_QUALITY_SENSOR true
+#endif
+
+#ifndef FEATURE_WATER_LEVEL_SENSOR
+#define FEATURE_WATER_LEVEL_SENSOR true
+#endif
+
+#ifndef FEATURE_WATER_PRESENCE_SENSOR
+#define FEATURE_WATER_PRESENCE_SENSOR false
+#endif
+
+#ifndef FEATURE_ATMOS41
+#define FEATURE_ATMOS41 false
+#endif
+
+#ifndef FEATURE_SOIL_MOISTURE_SENSOR
+#define FEATURE_SOIL_MOISTURE_SENSOR false
+#endif
+
+#ifndef FEATURE_LIGHTNING_SENSOR
+#define FEATURE_LIGHTNING_SENSOR false
+#endif
+
+#ifndef FEATURE_BATTERY_GAUGE
+#define FEATURE_BATTERY_GAUGE false
+#endif
+
+#ifndef FEATURE_SOLAR_CURRENT_MONITOR
+#define FEATURE_SOLAR_CURRENT_MONITOR false
+#endif
+
+#ifndef FEATURE_ENERGY_MONITOR
+#define FEATURE_ENERGY_MONITOR true
+#endif
+
+#ifndef FEATURE_IPFS
+#define FEATURE_IPFS false
+#endif
 
 // Main switches
 
-volatile const FLAGS_T FLAGS
+constexpr FLAGS_T FLAGS
 {
     /** Debug mode enabled - set by build env*/
     #ifdef DEBUG
@@ -58,10 +109,10 @@ volatile const FLAGS_T FLAGS
     WIFI_DATA_SUBMISSION_ENABLED: WIFI_DATA_SUBMISSION,
 
     /** Enable Battery Gauge. */
-    BATTERY_GAUGE_ENABLED: false,
+    BATTERY_GAUGE_ENABLED: FEATURE_BATTERY_GAUGE,
 
     /** Enable solar panel current monitor */
-    SOLAR_CURRENT_MONITOR_ENABLED: false,
+    SOLAR_CURRENT_MONITOR_ENABLED: FEATURE_SOLAR_CURRENT_MONITOR,
 
     /** Enable NBIoT mode. If false GSM is used */
     NBIOT_MODE: false,
@@ -74,19 +125,19 @@ volatile const FLAGS_T FLAGS
     BATTERY_FORCE_NORMAL_MODE: false,
 
     /** Take measurements from water quality sensor */
-    WATER_QUALITY_SENSOR_ENABLED: true,
+    WATER_QUALITY_SENSOR_ENABLED: FEATURE_WATER_QUALITY_SENSOR,
     
     /** Take measurements from water level sensor */
-    WATER_LEVEL_SENSOR_ENABLED: true,
+    WATER_LEVEL_SENSOR_ENABLED: FEATURE_WATER_LEVEL_SENSOR,
 
     /** Take measurements from water presence sensor */
-    WATER_PRESENCE_SENSOR_ENABLED: false,
+    WATER_PRESENCE_SENSOR_ENABLED: FEATURE_WATER_PRESENCE_SENSOR,
 
     /** Take measurements from Atmos41 weather station */
-    ATMOS41_ENABLED: false,
+    ATMOS41_ENABLED: FEATURE_ATMOS41,
 
     /** Take measurements from soil moisture sensor */
-    SOIL_MOISTURE_SENSOR_ENABLED: false,
+    SOIL_MOISTURE_SENSOR_ENABLED: FEATURE_SOIL_MOISTURE_SENSOR,
 
     /** Return dummy values when measuring water quality */
     MEASURE_DUMMY_WATER_QUALITY: false,
@@ -97,7 +148,7 @@ volatile const FLAGS_T FLAGS
     /** Return dummy values when measuring weather data */
     MEASURE_DUMMY_WEATHER: false,
 
-    LIGHTNING_SENSOR_ENABLED: false,
+    LIGHTNING_SENSOR_ENABLED: FEATURE_LIGHTNING_SENSOR,
 
     /** Sync RTC automatically on preset intervals */
     RTC_AUTO_SYNC: false,
@@ -106,8 +157,35 @@ volatile const FLAGS_T FLAGS
     EXTERNAL_RTC_ENABLED: true,
 
     /** Submit data to IPFS */
-    IPFS: false
-}; 
+    IPFS: FEATURE_IPFS,
+
+    /** Sample water sensors at a higher rate and call home early when water level
+     * changes fast */
+    WATER_LEVEL_BURST_ENABLED: true,
+
+    /** Store every raw frame received by the FO sniffer for replay. For debugging
+     * only, wears flash */
+    FO_SNIFFER_CAPTURE_ENABLED: false,
+
+    /** Keep the RF module receiving while sleeping and wake up on its packet INT
+     * instead of waking up for every expected packet. RF module RX current is drawn
+     * during the whole sleep. Not used when lightning sensor is enabled (shares INT
+     * wake up source) */
+    FO_SNIFFER_RADIO_WAKEUP_ENABLED: false,
+
+    /** Keep sniffing FO stations in a background task while calling home */
+    FO_SNIFFER_CALL_HOME_TASK_ENABLED: true,
+
+    /** Sample battery/solar voltage with the ULP while sleeping and wake up when
+     * battery crosses the sleep charge thresholds */
+    ENERGY_MONITOR_ENABLED: FEATURE_ENERGY_MONITOR,
+
+    /** Light sleep while waiting for SDI12 measurements, sensor power held high */
+    SENSOR_WAIT_LIGHT_SLEEP_ENABLED: true,
+
+    /** Read sensors on independent buses concurrently, powered on once per wake up */
+    SENSOR_TASKS_ENABLED: true
+};
 
 /** Print serial comms between the MCU and the GSM module (used by tinyGSM) */
 #define PRINT_GSM_AT_COMMS false
@@ -132,15 +210,30 @@ const int RTC_AUTOSYNC_INTERVAL_MIN = 240;
 const WaterLevelChannel WATER_LEVEL_INPUT_CHANNEL = WATER_LEVEL_CHANNEL_MAXBOTIX_PWM;
 // const WaterLevelChannel WATER_LEVEL_INPUT_CHANNEL = WATER_LEVEL_CHANNEL_MAXBOTIX_SERIAL;
 
-const AquatrollModel AQUATROLL_MODEL = AQUATROLL_MODEL_400;
-// const AquatrollModel AQUATROLL_MODEL = AQUATROLL_MODEL_500;
-// const AquatrollModel AQUATROLL_MODEL = AQUATROLL_MODEL_600;
+/**
+ * How pulses are captured when using the Water Level PWM channel. RMT times pulses
+ * in hardware while the CPU is blocked, pulseIn busy-waits on the pin.
+ */
+const WaterLevelPwmCapture WATER_LEVEL_PWM_CAPTURE = WATER_LEVEL_PWM_CAPTURE_RMT;
+// const WaterLevelPwmCapture WATER_LEVEL_PWM_CAPTURE = WATER_LEVEL_PWM_CAPTURE_PULSEIN;
+
+constexpr AquatrollModel AQUATROLL_MODEL = AQUATROLL_MODEL_400;
+// constexpr AquatrollModel AQUATROLL_MODEL = AQUATROLL_MODEL_500;
+// constexpr AquatrollModel AQUATROLL_MODEL = AQUATROLL_MODEL_600;
 
 /**
  * FineOffset weather station source: sniffer/uart
  */
-const FineOffsetSource FO_SOURCE = FO_SOURCE_SNIFFER;
-// const FineOffsetSource FO_SOURCE = FO_SOURCE_UART;
+constexpr FineOffsetSource FO_SOURCE = FO_SOURCE_SNIFFER;
+// constexpr FineOffsetSource FO_SOURCE = FO_SOURCE_UART;
+
+/**
+ * Optional FineOffset aggregate outputs submitted as telemetry. Values are always
+ * calculated and stored. FO_OUTPUT_HOURLY also submits hourly aggregates.
+ */
+const int FO_AGGREGATE_OUTPUTS = FO_OUTPUT_TEMP_MIN_MAX | FO_OUTPUT_WIND_GUST_MAX |
+                                 FO_OUTPUT_WIND_SPEED_STD_DEV | FO_OUTPUT_WIND_DIR_STD_DEV |
+                                 FO_OUTPUT_RAIN_INTENSITY | FO_OUTPUT_HOURLY;
 
 /**
  * Lightning sensor module to use
@@ -210,11 +303,25 @@ const SleepScheduler::WakeupScheduleEntry WAKEUP_SCHEDULE_BATT_LOW[WAKEUP_SCHEDU
     {SleepScheduler::WakeupReason::REASON_READ_SOIL_MOISTURE_SENSOR, 60}
 };
 
+/**
+ * Water sensors wake up interval (minutes) used while water level burst sampling
+ * is active. Overrides water sensors interval of current schedule if shorter.
+ * Must be one of WAKEUP_SCHEDULE_VALID_VALUES.
+ */
+const int WATER_LEVEL_BURST_WAKEUP_INT = 2;
+
 /******************************************************************************
  * FineOffset sniffer\
  *****************************************************************************/
 const float FO_SNIFFER_FREQ = 868.35;
 
+/**
+ * Max number of weather stations sniffed at the same time. Each station has its
+ * own sync state and aggregation buffer. With more than one station hardware
+ * address filtering is disabled and packets are filtered by address in software.
+ */
+const int FO_SNIFFER_MAX_STATIONS = 3;
+
 /******************************************************************************
  * Lightning sensor
  *****************************************************************************/
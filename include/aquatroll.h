@@ -9,10 +9,6 @@ namespace Aquatroll
 
     RetResult measure(WaterSensorData::Entry *data);
 
-    RetResult measure_aquatroll400(WaterSensorData::Entry *data);
-    RetResult measure_aquatroll500(WaterSensorData::Entry *data);
-    RetResult measure_aquatroll600(WaterSensorData::Entry *data);
-
     RetResult measure_dummy(WaterSensorData::Entry *data);
 }
 
@@ -2,6 +2,7 @@
 #define ATMOS41_H
 
 #include "atmos41_data.h"
+#include "sensor_driver.h"
 
 namespace Atmos41
 {
@@ -12,6 +13,8 @@ namespace Atmos41
     RetResult measure(Atmos41Data::Entry *data);
 	RetResult measure_dummy(Atmos41Data::Entry *data);
 	RetResult measure_log();
+
+	extern const SensorDriver DRIVER;
 }
 
 #endif
\ No newline at end of file
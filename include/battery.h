@@ -14,6 +14,7 @@ namespace Battery
     void sleep_charge();
     void print_mode();
     RetResult read_solar_mv(uint16_t *voltage);
+    uint16_t pct_to_mv(uint8_t pct);
 }
 
 #endif
\ No newline at end of file
@@ -2,6 +2,10 @@
 #define CALL_HOME_H
 
 #include "struct.h"
+#include "const.h"
+#include "utils.h"
+#include "common.h"
+#include "data_store_reader.h"
 
 namespace CallHome
 {
@@ -14,6 +18,146 @@ namespace CallHome
     RetResult handle_logs();
     RetResult handle_telemetry();
     RetResult submit_ipfs();
+
+    // Used by sensor drivers to submit their data
+    RetResult submit_tb_telemetry(const char *data, int data_size);
+
+    template <typename TStore, typename TBuilder, typename TEntry>
+    RetResult submit_stored_telemetry(TStore *store, DataStoreSubmitStats *stats);
+
+    /******************************************************************************
+     * Read all data from a DataStore, build JSON and submit as telemetry
+     *****************************************************************************/
+    template <typename TStore, typename TBuilder, typename TEntry>
+    RetResult submit_stored_telemetry(TStore *store, DataStoreSubmitStats *stats)
+    {
+
+        // Entries in current request packet
+        int cur_req_entries = 0;
+        // Keep count of failed CRCs for log
+        int crc_failures = 0;
+        // Total sensor data entries
+        int total_entries = 0;
+        // Total entries submitted (valid entries)
+        int submitted_entries = 0;
+        // Total successfull entries
+        int successfull_entries = 0;
+        // Total number of requests 
+        int total_requests = 0;
+        // Number of successfull requests
+        int successfull_requests = 0;
+
+        TBuilder json_builder;
+
+        // Output buffer for resulting JSON
+        char json_buff[TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE] = {0};
+        
+        DataStoreReader<TEntry> reader(store);
+        const TEntry *entry = NULL;
+
+        json_builder.reset();
+
+        //
+        // Iterate all data and submit. Each file in flash will fit in a single request.
+        // If request succeeds, file is deleted, if not it is left to be retried next time.
+        //
+        
+        // Submission errors occurred
+        bool submission_failed = false;
+
+        while(reader.next_file())
+        {
+            cur_req_entries = 0;
+
+            // Iterate all file entries in file, check CRC and add to JSON
+            while((entry = reader.next_entry()))
+            {
+                total_entries++;
+                if(!reader.entry_crc_valid())
+                {
+                    crc_failures++;
+                    continue;
+                }
+                
+                cur_req_entries++;
+                submitted_entries++;
+
+                json_builder.add(entry);
+            }
+
+            // Send only if there are valid entries to be sent
+            if(cur_req_entries > 0)
+            {
+                json_builder.build(json_buff, sizeof(json_buff), false);
+
+                total_requests++;
+
+                if(submit_tb_telemetry(json_buff, strlen(json_buff)) == RET_OK)
+                {
+                    // Request success, file can be deleted
+                    reader.delete_file();
+
+                    Utils::serial_style(STYLE_BLUE);
+                    debug_println(F("Deleting file, all complete"));
+                    Utils::serial_style(STYLE_RESET);
+
+                    successfull_entries += cur_req_entries;
+                    successfull_requests++;
+                }
+                else
+                {
+                    Utils::serial_style(STYLE_RED);
+                    debug_println(F("Sending telemetry data failed. File remains to be retried next time."));
+                    Utils::serial_style(STYLE_RESET);
+
+                    // Max error threshold reached, abort
+                    if(total_requests - successfull_entries >= FAILED_TELEMETRY_REQ_THRESHOLD)
+                    {
+                        submission_failed = true;
+                        break;
+                    }
+                }
+            }
+            else
+            {
+                // All entries failed CRC in this file so it is useless, delete it
+                reader.delete_file();
+
+                Utils::serial_style(STYLE_BLUE);
+                debug_println(F("Deleting file, BAD CRC"));
+                Utils::serial_style(STYLE_RESET);
+            }
+
+            // Empty packet and prepare for next
+            json_builder.reset();
+        }
+
+        // Print report
+        int failed_requests = total_requests - successfull_requests;
+
+        debug_print(F("Total entries: "));
+        debug_println(total_entries, DEC);
+        debug_print(F("Submitted entries: "));
+        debug_println(submitted_entries, DEC);
+        debug_print(F("Successful entries: "));
+        debug_println(successfull_entries, DEC);
+        debug_print(F("Entries failed CRC32: "));
+        debug_println(crc_failures, DEC);
+        debug_println();
+
+        // Output operation stats (add to provided)
+        if(stats != nullptr)
+        {
+            stats->total_entries += total_entries;
+            stats->submitted_entries += submitted_entries;
+            stats->successful_entries += successfull_entries;
+            stats->crc_failed_entries += crc_failures;
+            stats->total_requests += total_requests;
+            stats->failed_requests += failed_requests;
+        }
+
+        return submission_failed ? RET_ERROR : RET_OK;
+    }
 }
 
 #endif
\ No newline at end of file
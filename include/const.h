@@ -48,8 +48,37 @@ const unsigned long FAIL_CHECK_TIMESTAMP_END = 2072091600;
 /** Samples configuration for analog */
 const int ADC_CYCLES = 128;
 
-/** Samples to average when reading battery voltage with internal ADC */
-const int ADC_BATTERY_LEVEL_SAMPLES = 20;
+/** Default Vref (mV) used for ADC calibration when not burned in eFuse */
+const int ADC_DEFAULT_VREF_MV = 1100;
+
+// Burst sampling of ADC1 channels (battery, solar) with I2S DMA
+/** I2S port used for ADC DMA */
+#define ADC_BURST_I2S_PORT I2S_NUM_0
+
+/** Max channels sampled in a single burst */
+const int ADC_BURST_MAX_CHANNELS = 4;
+
+/** ADC conversions per second, shared by all channels of the burst */
+const int ADC_BURST_SAMPLE_RATE = 20000;
+
+/** Samples kept per channel. Max STATS_MAX_SAMPLES */
+const int ADC_BURST_SAMPLES = 32;
+
+/** Samples dropped at the start of a burst */
+const int ADC_BURST_DISCARD_SAMPLES = 64;
+
+/** Length of each DMA buffer (samples) */
+const int ADC_BURST_DMA_BUFF_LEN = 128;
+
+/** Max time to wait for a burst to complete */
+const int ADC_BURST_TIMEOUT_MS = 100;
+
+/** Times to repeat a burst when samples are too noisy */
+const int ADC_BURST_TRIES = 3;
+
+/** Solar voltage is sampled along with battery voltage. A burst this recent is
+ * reused instead of sampling again */
+const int ADC_BURST_MAX_AGE_MS = 2000;
 
 /** Time user has to hold button to enter config mode */
 const int CONFIG_MODE_BTN_HOLD_TIME_MS = 2000;
@@ -73,6 +102,25 @@ const int WIFI_SERIAL_BUFFER_SIZE = 512;
 /** Timeout when trying to connect to network */
 const int WIFI_CONNECT_TIMEOUT_SEC = 10;
 
+/******************************************************************************
+ * Statistics (sensor sample filtering)
+ *****************************************************************************/
+/** Max samples filtered at once (size of work array on stack) */
+const int STATS_MAX_SAMPLES = 64;
+
+/** Hampel filter threshold, in std devs estimated from MAD (Q8, 3.0) */
+const int STATS_HAMPEL_K_Q8 = 3 * 256;
+
+/** MAD to std dev of a normal distribution (Q8, 1.4826) */
+const int STATS_MAD_SCALE_Q8 = 380;
+
+/** Min MAD used by the Hampel filter. Keeps values one step away from the median
+ * when most samples are equal */
+const int STATS_MAD_MIN = 1;
+
+/** Percentage of lowest and highest values dropped by trimmed mean */
+const int STATS_TRIM_PCT = 20;
+
 /******************************************************************************
  * Data stores
  *****************************************************************************/
@@ -90,6 +138,22 @@ const int STORE_CLEANUP_FILE_COUNT = 500;
  * is triggered */
 const int STORE_MAX_FILE_COUNT = 1000;
 
+/** Marks files of stores with an entry format, blocks of delta encoded entries */
+const uint32_t ENTRY_CODEC_BLOCK_FILE_MAGIC = 0x32434E45;
+
+/** Marks files of fixed size records, written by older firmware */
+const uint32_t ENTRY_CODEC_RECORD_FILE_MAGIC = 0x31434E45;
+
+/** Max fields of an entry format */
+const int ENTRY_CODEC_MAX_FIELDS = 24;
+
+/** Max size of a fixed size record */
+const int ENTRY_CODEC_MAX_SIZE = 64;
+
+/** Max size of block data, a new block is started when full. Blocks are read
+ * in memory to be decoded and rewritten */
+const int ENTRY_CODEC_BLOCK_MAX_SIZE = 256;
+
 /******************************************************************************
  * Telemetry data
  *****************************************************************************/
@@ -350,15 +414,61 @@ const int HTTL_CLIENT_REPONSE_TIMEOUT = 15000;
 /** UART to use for SDI12 comms */
 const int SDI12_UART_NUM = 2;
 
-/** Time to wait after sending a command and before reading back the response */
-const int SDI12_COMMAND_WAIT_TIME_MS = 50;
+/** Response latency histogram bucket width and number of buckets. Last bucket
+ * counts all longer latencies */
+const int SDI12_LATENCY_BUCKET_MS = 25;
+const int SDI12_LATENCY_BUCKETS = 16;
+
+/** Max values of a sensor measurement (table driven sensor profiles) */
+const int SDI12_PROFILE_MAX_VALUES = 20;
 
-/** Receive buffer size. Must be large enough to fit a single response */ 
-const int SDI12_RECV_BUFF_SIZE = 48;
+/** Max data batches of a measurement (aD0! - aD9!) */
+const int SDI12_MAX_DATA_BATCHES = 10;
+
+/** Max sensors on the virtual SDI12 bus */
+const int SDI12_SIM_MAX_SENSORS = 4;
+
+/** Virtual bus timing: break and marking, one char at 1200 baud (10 bits),
+ * time driver waits for a response that never comes */
+const int SDI12_SIM_BREAK_US = 21000;
+const int SDI12_SIM_CHAR_US = 8333;
+const int SDI12_SIM_NO_RESPONSE_US = 1000000;
+
+/** Receive buffer size. Must be large enough to fit a single response: address,
+ * up to 75 value chars (concurrent measurement), 3 CRC chars, <CR><LF> and null */ 
+const int SDI12_RECV_BUFF_SIZE = 82;
 
 /** Number of extra seconds to wait for measurement on top of what the sensors says */
 const int SDI12_MEASURE_EXTRA_WAIT_SECS = 1;
 
+/** Time for a service request (a<CR><LF>) to be transmitted after its first
+ * edge wakes up the device */
+const int SDI12_SERVICE_REQUEST_TIME_MS = 30;
+
+/** Max number of sensors measured concurrently (aCC!) */
+const int SDI12_BUS_MAX_SENSORS = 4;
+
+/** Max time to wait for concurrent measurements. Sensors that report longer
+ * times are ignored and measured on their own later */
+const int SDI12_BUS_MEASURE_WAIT_SEC_MAX = 30;
+
+/******************************************************************************
+ * Sensor tasks
+ * Sensors on independent buses are read concurrently, one task per bus.
+ *****************************************************************************/
+/** Max jobs queued for a single run */
+const int SENSOR_TASKS_MAX_JOBS = 8;
+
+/** Max acquisition jobs (buses) of a sensor driver */
+const int SENSOR_DRIVER_MAX_JOBS = 2;
+
+const int SENSOR_TASKS_CORE = 0;
+const int SENSOR_TASKS_STACK_SIZE = 8192;
+const int SENSOR_TASKS_PRIORITY = 1;
+
+/** Interval to poll bus tasks for completion (ms) */
+const int SENSOR_TASKS_POLL_MS = 10;
+
 /******************************************************************************
  * Weather Station
  *****************************************************************************/
@@ -371,12 +481,29 @@ const int WEATHER_STATION_MEASURE_WAIT_SEC_MAX = 10;
 /** Number of measurement values expected from the sensor */
 const int WEATHER_STATION_NUMBER_OF_MEASUREMENTS = 9;
 
+/** SDI12 address. Sensors sharing the bus must have unique addresses to be
+ * measured concurrently */
+const char WEATHER_STATION_SDI12_ADDRESS = '0';
+
 /******************************************************************************
  * Aquatroll
  *****************************************************************************/
 /** Time to wait for water sensors to boot after powering them up */
 const int WATER_SENSORS_POWER_ON_DELAY_MS = 2000;
 
+/** Sensor waits shorter than this are not worth a light sleep */
+const int WATER_SENSORS_MIN_SLEEP_MS = 100;
+
+/******************************************************************************
+ * Power rails
+ *****************************************************************************/
+/** Time for peripherals to boot after their rail is switched on */
+const int POWER_RAIL_SENSORS_WARM_UP_MS = WATER_SENSORS_POWER_ON_DELAY_MS + 200;
+const int POWER_RAIL_BOOST_WARM_UP_MS = 0;
+
+/** Time for a rail to discharge after being switched off */
+const int POWER_RAIL_OFF_DELAY_MS = 100;
+
 /** Max time to wait for sensor to prepare measurements after a 
  * measure command. Used in case sensor returns garbage values, to prevent
  * waiting for long amounts of time. Value must be adapted to water quality
@@ -392,6 +519,10 @@ const int AQUATROLL500_NUMBER_OF_MEASUREMENTS = 8;
 /** Number of measurement values expected for Aquatroll 600 */
 const int AQUATROLL600_NUMBER_OF_MEASUREMENTS = 7;
 
+/** SDI12 address. Sensors sharing the bus must have unique addresses to be
+ * measured concurrently */
+const char AQUATROLL_SDI12_ADDRESS = '0';
+
 /** Number of mS to wait before retrying after an error */
 const int WATER_QUALITY_RETRY_WAIT_MS = 1000;
 
@@ -429,6 +560,22 @@ const int WATER_LEVEL_PWM_MAX_VAL_TOL = 30;
  **/
 const int WATER_LEVEL_PWM_FAILED_MEAS_LIMIT = 15;
 
+/** RMT channel used to capture PWM pulses */
+const int WATER_LEVEL_PWM_RMT_CHANNEL = 4;
+
+/** RMT tick is 1uS (80MHz APB clock / 80), equal to 1mm of PWM pulse width */
+const int WATER_LEVEL_PWM_RMT_CLK_DIV = 80;
+
+/** Line idle for this long (uS) ends a pulse capture. Longer than max pulse
+ * width, shorter than the time between pulses */
+const int WATER_LEVEL_PWM_RMT_IDLE_US = 15000;
+
+/** Pulses shorter than this many APB clock cycles are ignored as glitches */
+const int WATER_LEVEL_PWM_RMT_FILTER_TICKS = 250;
+
+/** Size of RMT driver ring buffer holding captured pulses (bytes) */
+const int WATER_LEVEL_PWM_RMT_BUFF_SIZE = 1024;
+
 // Analog channel only
 /** Millivolts per cm */
 const float WATER_LEVEL_MV_PER_MM = (float)3300 / WATER_LEVEL_MAX_RANGE_MM;
@@ -437,6 +584,25 @@ const float WATER_LEVEL_MV_PER_MM = (float)3300 / WATER_LEVEL_MAX_RANGE_MM;
  * failed */
 const int WATER_LEVEL_US_TIMEOUT_MS = 6000;
 
+// Rate of change / burst sampling
+/** Number of readings kept in history for rate of change estimation */
+const int WATER_LEVEL_TREND_HISTORY_LEN = 8;
+
+/** Readings older than this (from the latest one) are not used when estimating rate */
+const int WATER_LEVEL_TREND_WINDOW_SEC = 1200;
+
+/** Min time span between oldest and latest reading used for a valid rate estimation */
+const int WATER_LEVEL_TREND_MIN_SPAN_SEC = 90;
+
+/** Rate of change (absolute, cm/min) above which burst sampling starts */
+const float WATER_LEVEL_BURST_ENTER_RATE_CM_MIN = 0.5;
+
+/** Rate of change (absolute, cm/min) under which level is considered stable in burst mode */
+const float WATER_LEVEL_BURST_EXIT_RATE_CM_MIN = 0.2;
+
+/** Consecutive stable readings required to fall back from burst to normal sampling */
+const int WATER_LEVEL_BURST_STABLE_COUNT = 5;
+
 /******************************************************************************
  * Teros12 sensor
  *****************************************************************************/
@@ -450,17 +616,24 @@ const int TEROS12_MEASURE_WAIT_SEC_MAX = 10;
 /** Number of measurement values expected from the sensor */
 const int TEROS12_NUMBER_OF_MEASUREMENTS = 3;
 
+/** SDI12 address. Sensors sharing the bus must have unique addresses to be
+ * measured concurrently */
+const char TEROS12_SDI12_ADDRESS = '0';
+
 /******************************************************************************
  * FineOffset weather station data
  *****************************************************************************/
 /** Data store path */
 const char* const FO_DATA_STORE_PATH = "/fo";
 
+/** Hourly aggregates data store path */
+const char* const FO_DATA_HOURLY_STORE_PATH = "/foh";
+
 /** FO entries to group into a single json packet for submission */
 const int FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ = 5;
 
 /** Arduino JSON doc size */
-const int FO_DATA_JSON_DOC_SIZE = 1024;
+const int FO_DATA_JSON_DOC_SIZE = 2048;
 
 // Telemetry key names
 const char FO_DATA_KEY_TIMESTAMP[] = "ts";
@@ -476,6 +649,34 @@ const char FO_DATA_KEY_UV[] = "fo_uv";
 const char FO_DATA_KEY_UV_INDEX[] = "fo_uv_index";
 const char FO_DATA_KEY_LIGHT[] = "fo_light";
 const char FO_DATA_KEY_SOLAR_RADIATION[] = "fo_sol_rad";
+const char FO_DATA_KEY_TEMP_MIN[] = "fo_temp_min";
+const char FO_DATA_KEY_TEMP_MAX[] = "fo_temp_max";
+const char FO_DATA_KEY_WIND_GUST_MAX[] = "fo_w_gust_max";
+const char FO_DATA_KEY_WIND_SPEED_STD_DEV[] = "fo_w_speed_sd";
+const char FO_DATA_KEY_WIND_DIR_STD_DEV[] = "fo_w_dir_sd";
+const char FO_DATA_KEY_RAIN_INTENSITY[] = "fo_rain_int";
+const char FO_DATA_KEY_STATION_ID[] = "fo_station";
+
+// Telemetry key names of hourly aggregates
+const char FO_DATA_HOURLY_KEY_PACKETS[] = "fo_h_packets";
+const char FO_DATA_HOURLY_KEY_TEMP[] = "fo_h_temp";
+const char FO_DATA_HOURLY_KEY_HUMIDITY[] = "fo_h_hum";
+const char FO_DATA_HOURLY_KEY_RAIN[] = "fo_h_rain";
+const char FO_DATA_HOURLY_KEY_RAIN_RATE_HR[] = "fo_h_rain_hr";
+const char FO_DATA_HOURLY_KEY_WIND_DIR[] = "fo_h_w_dir";
+const char FO_DATA_HOURLY_KEY_WIND_SPEED[] = "fo_h_w_speed";
+const char FO_DATA_HOURLY_KEY_WIND_GUST[] = "fo_h_w_gust";
+const char FO_DATA_HOURLY_KEY_UV[] = "fo_h_uv";
+const char FO_DATA_HOURLY_KEY_UV_INDEX[] = "fo_h_uv_index";
+const char FO_DATA_HOURLY_KEY_LIGHT[] = "fo_h_light";
+const char FO_DATA_HOURLY_KEY_SOLAR_RADIATION[] = "fo_h_sol_rad";
+const char FO_DATA_HOURLY_KEY_TEMP_MIN[] = "fo_h_temp_min";
+const char FO_DATA_HOURLY_KEY_TEMP_MAX[] = "fo_h_temp_max";
+const char FO_DATA_HOURLY_KEY_WIND_GUST_MAX[] = "fo_h_w_gust_max";
+const char FO_DATA_HOURLY_KEY_WIND_SPEED_STD_DEV[] = "fo_h_w_speed_sd";
+const char FO_DATA_HOURLY_KEY_WIND_DIR_STD_DEV[] = "fo_h_w_dir_sd";
+const char FO_DATA_HOURLY_KEY_RAIN_INTENSITY[] = "fo_h_rain_int";
+const char FO_DATA_HOURLY_KEY_STATION_ID[] = "fo_h_station";
 
 /** Wind speed coefficient in sniffed packet */
 const float FO_WIND_SPEED_COEFF = 0.0644;
@@ -494,13 +695,24 @@ const float FO_SNIFFER_LUX_TO_SOLAR_RADIATION_COEFF = 0.0079;
  * seconds (approx.) */
 const int FO_AGGREGATE_INTERVAL_SEC = 600;
 
+/** Hourly aggregate time window. Every packet is also added to an hourly aggregate.
+ * Windows are aligned to clock time so default window entries nest in hourly ones.
+ * Must be a multiple of FO_AGGREGATE_INTERVAL_SEC */
+const int FO_AGGREGATE_HOURLY_INTERVAL_SEC = 3600;
+
+/** Dir of raw frame capture store */
+const char* const FO_CAPTURE_STORE_PATH = "/foc";
+
+/** Captured frames per store file */
+const int FO_CAPTURE_ENTRIES_PER_FILE = 20;
+
+/** Bytes of rx buffer stored per captured frame (more than a frame, in case the
+ * radio reads past it) */
+const int FO_CAPTURE_FRAME_LEN = 32;
+
 /** FO is disabled after X successive failed RX (both sniff and uart) to prevent battery drainage*/
 const uint8_t FO_FAILED_RX_THRESHOLD = 20;
 
-/******************************************************************************
- * FineOffset Buffer
- *****************************************************************************/
-const int FO_BUFFER_SIZE = 200;
 
 /******************************************************************************
  * FineOffset weather station sniffer
@@ -514,6 +726,25 @@ const uint8_t FO_SNIFFER_SYNC_WORD[] = {0x2D, 0xD4};
 /** FineOffset weather station family code */
 const uint8_t FO_SNIFFER_FAMILY_CODE = 0x24;
 
+/** Length of a FineOffset frame including family code, CRC and checksum */
+const int FO_SNIFFER_FRAME_LEN = 17;
+
+/** CRC8 of the first 15 bytes of a frame, polynomial 0x31, no reflection */
+const uint8_t FO_SNIFFER_CRC_INIT = 0;
+
+/** Bytes of a frame covered by CRC and checksum respectively */
+const int FO_SNIFFER_CRC_LEN = 15;
+const int FO_SNIFFER_CHECKSUM_LEN = 16;
+
+/** Max raw values of frame fields (0x7FF temp, 0x1FF wind dir and 0xFF humidity
+ * are the invalid markers sent by the station), used to reject noise before CRC */
+const uint16_t FO_SNIFFER_TEMP_RAW_MAX = 1000;
+const uint16_t FO_SNIFFER_TEMP_RAW_INVALID = 0x7FF;
+const uint16_t FO_SNIFFER_WIND_DIR_MAX = 359;
+const uint16_t FO_SNIFFER_WIND_DIR_INVALID = 0x1FF;
+const uint8_t FO_SNIFFER_HUM_MAX = 100;
+const uint8_t FO_SNIFFER_HUM_INVALID = 0xFF;
+
 /** Interval at which the weather station sends packets */
 const int FO_SNIFFER_PACKET_INTERVAL_SEC = 16;
 
@@ -524,13 +755,70 @@ const int FO_SNIFFER_PACKET_INTERVAL_SEC = 16;
 const int FO_SNIFFER_SYNC_WAIT_TIME_MS = 20000;
 
 /** Ms to wake up before the expected time of packet arrival
- * (threshold to make sure we catch the packet) */
+ * (threshold to make sure we catch the packet). Used until the tx slot of the
+ * station is tracked */
 const int FO_SNIFFER_WAIT_PACKET_EARLY_WAKEUP_SEC = 3;
 
 /**
- * Time to wait for a packet to arrive during sniffing.
+ * Tx slot tracking
+ * Listen window around the predicted packet arrival. Starts wide, narrows as
+ * packets arrive where predicted and doubles after every missed packet.
+ */
+const int FO_SNIFFER_SLOT_WINDOW_INIT_MS = 4000;
+const int FO_SNIFFER_SLOT_WINDOW_MIN_MS = 300;
+const int FO_SNIFFER_SLOT_WINDOW_MAX_MS = 8000;
+
+/** Window widening (ms) for every tx slot skipped since the last packet */
+const int FO_SNIFFER_SLOT_DRIFT_MS = 20;
+
+/** Gain of phase, period and jitter estimate corrections (0 - 1). Period gain is
+ * kept low so packet jitter does not leak into the period estimate */
+const float FO_SNIFFER_SLOT_PHASE_GAIN = 0.5;
+const float FO_SNIFFER_SLOT_PERIOD_GAIN = 0.05;
+const float FO_SNIFFER_SLOT_JITTER_GAIN = 0.25;
+
+/** Window is kept at least this many times the jitter estimate (plus min window) */
+const int FO_SNIFFER_SLOT_JITTER_MULT = 4;
+
+/** Max deviation of the estimated period from the nominal tx interval (ppm) */
+const int FO_SNIFFER_SLOT_MAX_DRIFT_PPM = 2000;
+
+/** Successive missed windows after which station is considered out of sync */
+const int FO_SNIFFER_SLOT_MAX_MISSES = 3;
+
+/** Secs to wake up before the window opens. Radio is kept off until then */
+const int FO_SNIFFER_SLOT_EARLY_WAKEUP_SEC = 1;
+
+/** Slots since last packet after which predictions are not trusted anymore (1h) */
+const int FO_SNIFFER_SLOT_MAX_TRACK_SLOTS = 225;
+
+/**
+ * When sniffing multiple stations, stations whose packets are expected within this
+ * many seconds after the first one are received in the same wakeup
+ */
+const int FO_SNIFFER_STATION_GROUP_SEC = 4;
+
+/**
+ * With radio wake up enabled, stations not heard for this long are sniffed on
+ * schedule again (synced, rx failures counted)
  */
-const int FO_SNIFFER_PACKET_WAIT_TIME_MS = 4000;
+const int FO_SNIFFER_RADIO_WAKEUP_TIMEOUT_SEC = 120;
+
+/**
+ * Background sniffing task (runs while calling home)
+ * Task runs on the core not used by the Arduino loop. Received packets are
+ * queued and aggregated by the main task when buffers are commited.
+ */
+const int FO_SNIFFER_TASK_CORE = 0;
+const int FO_SNIFFER_TASK_STACK_SIZE = 8192;
+const int FO_SNIFFER_TASK_PRIORITY = 1;
+const int FO_SNIFFER_TASK_QUEUE_LEN = 64;
+
+/** Interval to poll RF module INT pin while listening from the task (ms) */
+const int FO_SNIFFER_TASK_POLL_MS = 2;
+
+/** Time to wait for the task to finish when stopping it before warning (ms) */
+const int FO_SNIFFER_TASK_STOP_TIMEOUT_MS = 1000;
 
 /* Time to scan for weather stations when scanning for new id */
 const int FO_SNIFFER_SCAN_TIME_MS = 25000;
@@ -602,6 +890,24 @@ const uint8_t IP5306_BOOST_FLAGS = 0x37;  // 0x37 = 0b110111 TCALL example
  [1]      Key off EN: (0)                 [EXM note: could not detect difference]
   */
 
+/******************************************************************************
+ * Energy monitor (ULP battery/solar sampling while sleeping)
+ *****************************************************************************/
+/** Interval between ULP program runs */
+const int ENERGY_MONITOR_PERIOD_MS = 10000;
+
+/** Offset (words) of ULP variables in RTC slow memory. ULP program is loaded at
+ * 0 and must fit before it. Program and variables must fit in the memory reserved
+ * for the ULP (CONFIG_ULP_COPROC_RESERVE_MEM, 512 bytes) */
+const int ENERGY_MONITOR_ULP_DATA_OFFSET = 100;
+
+/** Battery must be this far past a threshold (mV) for the ULP to wake up the
+ * device, so it is not woken up repeatedly around the threshold */
+const int ENERGY_MONITOR_WAKE_HYST_MV = 20;
+
+/** Time to let a running ULP program finish after stopping its timer */
+const int ENERGY_MONITOR_STOP_WAIT_MS = 5;
+
 /******************************************************************************
  * Things board timeseries/attribute keys
  *****************************************************************************/
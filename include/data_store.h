@@ -6,6 +6,7 @@
 #include "app_config.h"
 #include "struct.h"
 #include "const.h"
+#include "entry_codec.h"
 
 template <typename TStruct>
 class DataStore
@@ -25,7 +26,7 @@ public:
         TStruct data;
     }__attribute__((packed));
 
-    DataStore(const char *dir_path, int max_entries_per_file);
+    DataStore(const char *dir_path, int max_entries_per_file, const EntryCodec::Format *format = NULL);
 
     RetResult add(TStruct *data);
 
@@ -41,6 +42,8 @@ public:
 
 	const char* get_dir_path() const;
 
+    const EntryCodec::Format* get_format() const;
+
     RetResult cleanup(bool force);
 protected:
 	// Default constructor private
@@ -52,7 +55,13 @@ private:
     // Methods
     //
 
-    RetResult update_current_data_file_path();
+    RetResult update_current_data_file_path(bool force_new = false);
+
+    RetResult commit_blocks();
+
+    int append_blocks(int first, int count);
+
+    int scan_block_file(File &f, int *last_block_pos);
 
     File open_file();
 
@@ -76,6 +85,9 @@ private:
     /** When writing data to flash, break it into x elements per file.
   	 *	A file is removed only when all of its data is marked as deleted. */
     int _max_entries_per_file = 0;
+
+    /** Compact encoding of entries in files, NULL to store entries as they are */
+    const EntryCodec::Format *_format = NULL;
 };
 
 #endif
\ No newline at end of file
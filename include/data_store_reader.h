@@ -4,6 +4,8 @@
  * DataStore. The process is transparent, the class returns elements
  * from the buffer one by one and when the end is reached, it switches to the
  * flash memory until all data is iterated.
+ * Files of stores with an entry format are decoded block by block, files
+ * written before the format was used are read as they are.
  ******************************************************************************/
 
 #ifndef DATA_STORE_READER
@@ -33,6 +35,10 @@ private:
 
     RetResult reset_data_state();
 
+    void read_file_header();
+
+    bool read_block_entry();
+
     /** Data store to traverse */
     const DataStore<TStruct> *_store = NULL;
 
@@ -45,6 +51,23 @@ private:
     /** Buffer to which entries are read and their data field  returned */
     typename DataStore<TStruct>::Entry _cur_entry = {0};
 
+    /** Encoded entry (CRC + data) when current file is a record file */
+    uint8_t _cur_record[sizeof(uint32_t) + ENTRY_CODEC_MAX_SIZE] = {0};
+
+    /** Kind of current file */
+    uint8_t _cur_file_type = FILE_RAW;
+
+    /** Record files only, entries are encoded against it */
+    uint32_t _base_timestamp = 0;
+
+    /** Block files only, current block and entry decoding state */
+    EntryCodec::BlockHeader _cur_block_header = {0};
+    uint8_t _cur_block[ENTRY_CODEC_BLOCK_MAX_SIZE] = {0};
+    int _cur_block_pos = 0;
+    int _cur_block_entry = 0;
+    bool _cur_block_valid = false;
+    EntryCodec::BlockState _block_state;
+
     /** Current state of file reader */
     uint8_t _state_files = STATE_PREPARE;
 
@@ -58,6 +81,17 @@ private:
         STATE_READING,
         STATE_READING_FINISHED
     };
+
+    /** File types */
+    enum FILE_TYPE
+    {
+        // Entries as they are
+        FILE_RAW = 1,
+        // Fixed size encoded entries
+        FILE_RECORDS,
+        // Blocks of delta encoded entries
+        FILE_BLOCKS
+    };
 };
 
 #endif
\ No newline at end of file
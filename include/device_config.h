@@ -43,6 +43,10 @@ namespace DeviceConfig
 
         /** FO weather enabled */
         bool fo_enabled;
+
+        /** IDs of additional weather stations to sniff (0 when not set). Station 0 is
+         * fo_sniffer_id */
+        uint8_t fo_sniffer_extra_ids[FO_SNIFFER_MAX_STATIONS - 1];
     }__attribute__((packed));
 
     RetResult init();
@@ -68,8 +72,8 @@ namespace DeviceConfig
     const char* get_cellular_apn();
     RetResult set_cellular_apn(char *apn);
     
-    const uint8_t get_fo_sniffer_id();
-    RetResult set_fo_sniffer_id(uint8_t id);
+    const uint8_t get_fo_sniffer_id(int station = 0);
+    RetResult set_fo_sniffer_id(uint8_t id, int station = 0);
 
     const bool get_fo_enabled();
     RetResult set_fo_enabled(bool enabled);
@@ -0,0 +1,31 @@
+#ifndef ENERGY_MONITOR_H
+#define ENERGY_MONITOR_H
+
+#include <inttypes.h>
+#include "struct.h"
+
+/******************************************************************************
+* Battery/solar voltage sampling with the ULP coprocessor while sleeping
+* Min/max/sum of samples are accumulated in RTC memory until drained to the log.
+******************************************************************************/
+namespace EnergyMonitor
+{
+	/** Battery threshold that wakes up the device */
+	enum WakeMode
+	{
+		WAKE_NONE,
+		// Battery under sleep charge level
+		WAKE_BATTERY_LOW,
+		// Battery over sleep charge recharged level
+		WAKE_BATTERY_RECHARGED
+	};
+
+	RetResult init();
+
+	RetResult arm(WakeMode mode);
+	bool check_wakeup();
+
+	RetResult drain();
+}
+
+#endif
@@ -0,0 +1,138 @@
+/******************************************************************************
+ * Entry codec
+ * Compact on-flash encoding of data store entries. Each entry type describes
+ * its fields once in a descriptor table, values are quantized to scaled
+ * integers.
+ *
+ * Files are a file header followed by blocks. A block header holds the base
+ * timestamp, entry count and a CRC of the block's data. Entries in a block are
+ * encoded as zigzag varints: delta-of-delta of the timestamp and delta of each
+ * value from the previous entry, so slowly changing values take 1-2 bytes.
+ *
+ * Files of the first version (fixed size records, timestamp delta against the
+ * file's base timestamp) are still decoded.
+ ******************************************************************************/
+
+#ifndef ENTRY_CODEC_H
+#define ENTRY_CODEC_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "FS.h"
+#include "struct.h"
+#include "const.h"
+
+/** Descriptor table helpers */
+#define ENTRY_FIELD_TIMESTAMP(type, member, size) \
+    {EntryCodec::FIELD_TIMESTAMP, offsetof(type, member), size, 1}
+
+#define ENTRY_FIELD_TIMESTAMP_MS(type, member) \
+    {EntryCodec::FIELD_TIMESTAMP_MS, offsetof(type, member), 8, 1}
+
+#define ENTRY_FIELD_FLOAT(type, member, size, scale) \
+    {EntryCodec::FIELD_FLOAT, offsetof(type, member), size, scale}
+
+// Unsigned integer or bool, type picked from member size
+#define ENTRY_FIELD_UINT(type, member, size) \
+    {sizeof(((type*)0)->member) == 1 ? EntryCodec::FIELD_UINT8 : \
+        sizeof(((type*)0)->member) == 2 ? EntryCodec::FIELD_UINT16 : EntryCodec::FIELD_UINT32, \
+        offsetof(type, member), size, 1}
+
+namespace EntryCodec
+{
+    /**
+     * Type of field in the entry struct
+     */
+    enum FieldType
+    {
+        // uint32_t, seconds
+        FIELD_TIMESTAMP,
+        // uint64_t, milliseconds
+        FIELD_TIMESTAMP_MS,
+        // float, quantized to signed round(value * scale). Lowest value marks NAN.
+        FIELD_FLOAT,
+        // Unsigned integers (and bool), saturated to the field size
+        FIELD_UINT8,
+        FIELD_UINT16,
+        FIELD_UINT32
+    };
+
+    /**
+     * Field descriptor
+     */
+    struct Field
+    {
+        FieldType type;
+
+        // Offset of field in entry struct
+        uint16_t offset;
+
+        // Quantized value range in bytes (1-4), encoded size in record files
+        uint8_t size;
+
+        // Float fields only, 1/resolution
+        float scale;
+    };
+
+    /**
+     * Entry format, defined once per entry type
+     */
+    struct Format
+    {
+        // Stored in file headers, files of other versions are not decoded
+        uint8_t version;
+
+        const Field *fields;
+        int field_count;
+    };
+
+    /**
+     * Header at the start of every file of a store with a format
+     */
+    struct FileHeader
+    {
+        // Block or record file
+        uint32_t magic;
+        uint8_t version;
+        // Record files only
+        uint32_t base_timestamp;
+    }__attribute__((packed));
+
+    /**
+     * Header of a block of entries
+     */
+    struct BlockHeader
+    {
+        uint8_t count;
+        // Size of data following the header
+        uint16_t size;
+        // Seconds, timestamps of entries are deltas from it
+        uint32_t base_timestamp;
+        // CRC32 of data
+        uint32_t crc32;
+    }__attribute__((packed));
+
+    /**
+     * Previous entry of a block, entries are encoded as deltas from it
+     */
+    struct BlockState
+    {
+        int64_t timestamp;
+        int64_t timestamp_delta;
+        int64_t values[ENTRY_CODEC_MAX_FIELDS];
+    };
+
+    uint32_t get_base_timestamp(const Format *format, const void *entry);
+
+    void block_begin(const Format *format, uint32_t base_timestamp, BlockState *state);
+    int block_encode(const Format *format, BlockState *state, const void *entry, uint8_t *out, int out_size);
+    int block_decode(const Format *format, BlockState *state, const uint8_t *in, int in_size, void *entry);
+
+    int record_size(const Format *format);
+    void record_decode(const Format *format, const uint8_t *in, uint32_t base_timestamp, void *entry);
+
+    RetResult read_header(File &f, FileHeader *header);
+    RetResult write_header(File &f, const Format *format);
+}
+
+#endif
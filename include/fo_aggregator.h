@@ -0,0 +1,81 @@
+#ifndef FO_AGGREGATOR_H
+#define FO_AGGREGATOR_H
+
+#include <inttypes.h>
+#include "struct.h"
+#include "fo_data.h"
+
+/******************************************************************************
+* FO packet streaming aggregator
+* Aggregates decoded packets as they arrive in constant memory, instead of
+* buffering them until commit. Totals are accumulated in arrival order so
+* averages are identical to averaging a buffer of the same packets.
+******************************************************************************/
+class FoAggregator
+{
+public:
+    /**
+     * Running statistics of a single value
+     * Mean/variance with Welford's algorithm, min/max and plain total
+     */
+    struct Stat
+    {
+        float total;
+        float mean;
+        float m2;
+        float min;
+        float max;
+
+        void add(float val, int count);
+        float variance(int count) const;
+    };
+
+    void clear();
+    void add(const FoDecodedPacket *packet, uint32_t tstamp);
+
+    RetResult fill_entry(FoData::StoreEntry *entry) const;
+
+    int get_count() const;
+    float get_first_rain() const;
+    float get_last_rain() const;
+    float get_rain_intensity() const;
+    float get_wind_dir_std_dev() const;
+
+    const Stat* get_temp() const;
+    const Stat* get_wind_speed() const;
+    const Stat* get_wind_gust() const;
+
+private:
+    /** Packets aggregated so far */
+    uint16_t _count = 0;
+
+    Stat _temp = {0};
+    Stat _wind_speed = {0};
+    Stat _wind_gust = {0};
+
+    float _hum_total = 0;
+    float _solar_radiation_total = 0;
+    uint32_t _uv_total = 0;
+    uint32_t _uv_index_total = 0;
+    uint32_t _light_total = 0;
+
+    /** Total of sin/cos of wind dir, used to calculate mean angle */
+    float _wind_dir_sin_total = 0;
+    float _wind_dir_cos_total = 0;
+
+    /** Rain counter of first and last packet */
+    float _first_rain = 0;
+    float _last_rain = 0;
+
+    /** Timestamp of first packet, rain slope times are relative to it */
+    uint32_t _first_tstamp = 0;
+
+    /** Least squares sums of rain counter (relative to first, mm) over time
+     * (relative to first packet, min) */
+    float _rain_t_total = 0;
+    float _rain_r_total = 0;
+    float _rain_tt_total = 0;
+    float _rain_tr_total = 0;
+};
+
+#endif
@@ -3,36 +3,48 @@
 
 #include <inttypes.h>
 #include "app_config.h"
-#include "fo_buffer.h"
+#include "fo_aggregator.h"
 
 /******************************************************************************
 * FO Decoded Packet buffer
-* Stores decoded packets which can then be aggregated and commited into a 
-* single FoData store entry
+* Aggregates decoded packets as they are added, into nested aggregation windows
+* (default and hourly). Each window is commited into a single FoData store
+* entry of its store.
 ******************************************************************************/
 class FoBuffer
 {
 public:
     RetResult commit_buffer();
     RetResult add_packet(FoDecodedPacket *packet);
+    RetResult add_packet(FoDecodedPacket *packet, uint32_t tstamp);
     void clear();
+    void set_station(uint8_t station, uint8_t station_id);
 
     static void print_packet(FoDecodedPacket *packet);
 private:
-    /** Buffer */
-    FoDecodedPacket _buffer[FO_BUFFER_SIZE];
+    /** State of a single aggregation window */
+    struct Window
+    {
+        /** Aggregates of packets added since last commit */
+        FoAggregator aggregator;
 
-    /** Count of packets in buffer */
-    int _packet_count = 0;
+        /** Timestamp of first added packet */
+        uint32_t first_packet_tstamp = 0;
 
-    /** Timestamp of first added packet */
-    uint32_t _first_packet_tstamp = 0;
+        /** Timestamp of last added packet */
+        uint32_t last_packet_tstamp = 0;
+    };
 
-    /** Timestamp of last added packet */
-    uint32_t _last_packet_tstamp = 0;
+    RetResult commit_window(FoData::Window window);
+
+    Window _windows[FoData::WINDOW_COUNT];
 
     /** Rain count from previously commited packet. Used to calculate hr rate */
     float _prev_rain = -1;
+
+    /** Station packets come from, entries are tagged with it */
+    uint8_t _station = 0;
+    uint8_t _station_id = 0;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef FO_CAPTURE_H
+#define FO_CAPTURE_H
+
+#include "app_config.h"
+#include "struct.h"
+#include "data_store.h"
+#include "fo_buffer.h"
+
+/******************************************************************************
+* Raw FO frame capture
+* Frames received by the sniffer are stored as-is so they can be replayed later
+* through the decoder and aggregation, without a weather station in range.
+******************************************************************************/
+namespace FoCapture
+{
+    /**
+     * A single captured frame
+     * NOTE: Must be aligned to 4 byte boundary to avoid padding (CRC32)
+     */
+    struct Entry
+    {
+        uint32_t timestamp;
+
+        // Start of rx buffer (family code, address, payload, CRC, checksum and
+        // whatever the radio read after the frame)
+        uint8_t frame[FO_CAPTURE_FRAME_LEN];
+    } __attribute__((packed));
+
+    /**
+     * Results of a replay
+     */
+    struct ReplayStats
+    {
+        // Frames read from store
+        int frames;
+
+        // Rejected by pre-filter
+        int filtered;
+
+        // Failed integrity check
+        int corrupt;
+
+        // Decoded and added to buffer
+        int decoded;
+
+        // Time spent in decode/aggregate pipeline
+        uint32_t elapsed_us;
+    };
+
+    RetResult add(uint32_t tstamp, uint8_t const buff[]);
+    RetResult commit_buffer();
+    DataStore<Entry>* get_store();
+
+    RetResult replay(const DataStore<Entry> *store, FoBuffer *buffer, ReplayStats *stats);
+
+    void print(const Entry *data);
+} // namespace FoCapture
+
+#endif
@@ -69,16 +69,49 @@ namespace FoData
 		// Solar radiation - Derived from light, W/M^2
 		// Range: ?
 		uint32_t solar_radiation;
+
+		// Min/max temperature in window, Celsius
+		float temp_min;
+		float temp_max;
+
+		// Max wind gust in window, m/s
+		float wind_gust_max;
+
+		// Wind speed standard deviation, m/s
+		float wind_speed_std_dev;
+
+		// Wind direction standard deviation, deg
+		uint16_t wind_dir_std_dev;
+
+		// Rain intensity from rain counter slope (mm/h)
+		float rain_intensity;
+
+		// Index of station in sniffer's station table
+		uint8_t station;
+
+		// Weather station address
+		uint8_t station_id;
 	}__attribute__((packed));
 
+	/**
+	 * Aggregation windows. Each window is committed to its own store.
+	 */
+	enum Window
+	{
+		WINDOW_DEFAULT,
+		WINDOW_HOURLY,
+		WINDOW_COUNT
+	};
+
     RetResult init();
-    RetResult add(StoreEntry *data);
+    RetResult add(StoreEntry *data, Window window = WINDOW_DEFAULT);
 
     RetResult commit_buffer();
-    DataStore<StoreEntry>* get_store();
+    DataStore<StoreEntry>* get_store(Window window = WINDOW_DEFAULT);
+    void set_store(Window window, DataStore<StoreEntry> *target);
 
 	void inc_wakeup_count();
-    void print(FoData::StoreEntry *packet);
+    void print(const FoData::StoreEntry *data);
 };
 
 #endif
\ No newline at end of file
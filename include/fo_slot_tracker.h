@@ -0,0 +1,49 @@
+#ifndef FO_SLOT_TRACKER_H
+#define FO_SLOT_TRACKER_H
+
+#include <inttypes.h>
+#include "struct.h"
+#include "const.h"
+
+/******************************************************************************
+* FO station tx slot tracker
+* Estimates the true tx period (nominal period plus crystal drift) and phase of
+* a weather station from packet arrival times (ms) and predicts the listen
+* window of its next packet. Window narrows as arrival times match predictions
+* and widens after missed packets.
+******************************************************************************/
+class FoSlotTracker
+{
+public:
+    void reset();
+    void add(uint32_t rx_ms);
+    void miss();
+
+    void get_next_window(uint32_t now_ms, uint32_t *open_ms, uint32_t *len_ms) const;
+
+    bool is_anchored() const;
+    float get_period_ms() const;
+    uint32_t get_window_ms() const;
+    uint8_t get_misses() const;
+
+    void print() const;
+
+private:
+    /** Arrival time of last packet (ms), predictions start from it */
+    uint32_t _anchor_ms = 0;
+    bool _anchored = false;
+
+    /** Estimated tx period (ms) */
+    float _period_ms = FO_SNIFFER_PACKET_INTERVAL_SEC * 1000;
+
+    /** Smoothed absolute error of predicted arrival times (ms) */
+    float _jitter_ms = 0;
+
+    /** Listen window length for the slot after the anchor (ms) */
+    uint32_t _window_ms = FO_SNIFFER_SLOT_WINDOW_INIT_MS;
+
+    /** Successive missed windows */
+    uint8_t _misses = 0;
+};
+
+#endif
@@ -18,9 +18,21 @@ namespace FoSniffer
 
 	int calc_secs_to_next_sniff();
 	RetResult handle_sniff_event();
+
+	bool radio_wakeup_enabled();
+	RetResult arm_radio_wakeup();
+	bool check_radio_wakeup();
+
+	RetResult start_task();
+	void stop_task();
 	RetResult commit_buffer();
 	void print_packet(FoDecodedPacket *packet);
 	FoDecodedPacket* get_last_packet();
+
+	bool prefilter_frame(uint8_t const buff[]);
+	RetResult decode_packet(uint8_t const buff[], FoDecodedPacket *decoded);
+	uint8_t calc_crc(uint8_t const buff[], int len, uint8_t init = FO_SNIFFER_CRC_INIT);
+	uint8_t calc_checksum(uint8_t const buff[]);
 }
 
 #endif
\ No newline at end of file
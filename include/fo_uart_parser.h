@@ -0,0 +1,71 @@
+#ifndef FO_UART_PARSER_H
+#define FO_UART_PARSER_H
+
+#include <inttypes.h>
+#include "struct.h"
+#include "const.h"
+
+/******************************************************************************
+* FO UART response parser
+* Incremental state machine fed with bytes as they arrive from the UART. Lines
+* of "Name = Value" are matched against FO_UART_RESPONSE_PARAM_NAMES and values
+* are decoded char by char, without buffering lines. Parsing is done as soon as
+* every param has been seen once.
+******************************************************************************/
+class FoUartParser
+{
+public:
+    enum Result
+    {
+        PARSE_INCOMPLETE,
+        PARSE_DONE,
+        PARSE_ERROR
+    };
+
+    void reset();
+    Result feed(char c);
+    Result feed(const char *data, int len);
+
+    Result get_result() const;
+    int get_found_param_count() const;
+    float get_value(FoUartParam param) const;
+
+    void fill_packet(FoDecodedPacket *packet) const;
+
+private:
+    enum State
+    {
+        STATE_NAME,
+        STATE_SEPARATOR,
+        STATE_VALUE,
+        STATE_SKIP_LINE
+    };
+
+    void end_name();
+    void end_value();
+
+    State _state = STATE_NAME;
+    Result _result = PARSE_INCOMPLETE;
+
+    /** Params whose name still matches chars received so far (bitmask) */
+    uint16_t _candidates = 0;
+
+    /** Index of next name char */
+    uint8_t _name_index = 0;
+
+    /** Param of current line */
+    int8_t _param = -1;
+
+    /** Value being decoded */
+    bool _negative = false;
+    bool _fraction = false;
+    bool _has_digits = false;
+    float _value = 0;
+    float _fraction_div = 1;
+
+    /** Params seen so far (bitmask) and their values */
+    uint16_t _found = 0;
+    float _values[FO_UART_PARAM_COUNT] = {0};
+};
+
+#endif
@@ -22,6 +22,8 @@ namespace Log
         int meta2;
     }__attribute__((packed));
 
+    extern const EntryCodec::Format FORMAT;
+
     bool log(Log::Code code, uint32_t meta1 = 0, uint32_t meta2 = 0);
     
     RetResult commit();
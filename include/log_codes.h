@@ -346,11 +346,12 @@ namespace Log
         // FO Scan for new device started
         FO_SNIFFER_SCANNING = 83,
 
-        // FO Scan finished
+        // FO station found (scan or sync)
         // Meta1: Found FO node id
         FO_SNIFFER_SCAN_RESULT = 84,
 
         // FO Scan finished
+        // Meta1: Stations found
         FO_SNIFFER_SCAN_FINISHED = 85,
 
         // FO enabled status
@@ -358,17 +359,22 @@ namespace Log
         // Meta2: New status
         FO_ENABLED_STATUS = 86,
 
-        // FO disabled because RX failures reached threshold
+        // FO station disabled because RX failures reached threshold. FO is disabled
+        // when all stations are disabled
         // Meta1: Successive tries after which it was disabled
+        // Meta2: Station id
         FO_DISABLED_RX_FAILED = 87,
 
         // FO waited to sniff packet but packet not received
+        // Meta1: Station id
         FO_SNIFFER_SNIFF_FAILED = 88,
 
         // FO not in sync
+        // Meta1: Station id
         FO_SNIFFER_NOT_IN_SYNC = 89,
 
         // FO could not sync
+        // Meta1: Station id
         FO_SNIFFER_SYNC_FAILED = 90,
 
         // Time elapsed during data submission
@@ -527,7 +533,59 @@ namespace Log
         * Could not calc wake up time
         * Meta1: 
         */
-        SLEEP_COULD_NOT_CALC_WAKEUP_TIME = 214
+        SLEEP_COULD_NOT_CALC_WAKEUP_TIME = 214,
+
+        //
+        // Sensor acquisition codes
+        // All 3XX codes
+
+        //
+        // Water level changing fast, burst sampling started
+        // Meta1: Rate of change (cm/min * 100)
+        // Meta2: Water level (cm)
+        WATER_LEVEL_BURST_START = 300,
+
+        //
+        // Water level stable, burst sampling ended
+        // Meta1: Rate of change (cm/min * 100)
+        // Meta2: Water level (cm)
+        WATER_LEVEL_BURST_END = 301,
+
+        //
+        // FO sniffer radio on time since last commit
+        // Meta1: Radio on time (ms)
+        // Meta2: Duty cycle (per mille)
+        FO_SNIFFER_RADIO_DUTY_CYCLE = 302,
+
+        //
+        // FO background sniffing task stopped
+        // Meta1: Packets received by the task
+        // Meta2: Packets dropped (queue full)
+        FO_SNIFFER_TASK_STATS = 303,
+
+        //
+        // Battery voltage sampled by the ULP while sleeping, since last report
+        // Meta1: Min mV (high 16 bits), max mV (low 16 bits)
+        // Meta2: Avg mV (high 16 bits), samples (low 16 bits)
+        ENERGY_MONITOR_BATTERY = 304,
+
+        //
+        // Solar panel voltage sampled by the ULP while sleeping, since last report
+        // Meta1: Min mV (high 16 bits), max mV (low 16 bits)
+        // Meta2: Avg mV (high 16 bits), samples (low 16 bits)
+        ENERGY_MONITOR_SOLAR = 305,
+
+        //
+        // SDI12 sensors measured concurrently
+        // Meta1: Number of sensors started
+        // Meta2: Seconds waited for the slowest sensor
+        SDI12_CONCURRENT_MEASUREMENT = 306,
+
+        //
+        // Sensors read concurrently by bus tasks
+        // Meta1: Total time (ms)
+        // Meta2: Sum of all jobs' time, time if run one after the other (ms)
+        SENSOR_TASKS_DONE = 307
     };
 }
 
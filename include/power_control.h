@@ -3,9 +3,34 @@
 
 #include "struct.h"
 
+/******************************************************************************
+* Power rails shared by several peripherals
+* Rails are reference counted, a rail is switched on by its first user and off
+* by its last one. Users powering a rail up together share its warm-up time.
+******************************************************************************/
 namespace PowerControl
 {
-    RetResult switch_12v(bool on);    
+    enum Rail
+    {
+        RAIL_NONE = -1,
+        // TCall IP5306 boost and 4V4 regulator (GSM, 12V step up)
+        RAIL_BOOST,
+        // Water sensors, weather station and soil moisture sensor
+        RAIL_SENSORS,
+        RAIL_COUNT
+    };
+
+    RetResult init();
+
+    RetResult acquire(Rail rail);
+    RetResult release(Rail rail);
+    RetResult cycle(Rail rail);
+
+    bool is_on(Rail rail);
+    bool is_ready(Rail rail);
+    uint32_t get_cycle_count(Rail rail);
+
+    void hold(Rail rail, bool enable);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -2,8 +2,22 @@
 #define SDI12_H
 
 #include <Arduino.h>
-#include <HardwareSerial.h>
+#include <driver/uart.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "const.h"
+#include "struct.h"
 
+/******************************************************************************
+* SDI12 line driver
+* The UART driver is installed by the first instance on a UART and deleted
+* with the last one, so the UART is free for other users (FO UART) between
+* sessions.
+* The data pin is switched between UART TX and RX through the GPIO matrix,
+* the break is timed with an esp_timer and responses are received through
+* the UART event queue.
+******************************************************************************/
 class Sdi12
 {
 public:
@@ -13,41 +27,102 @@ public:
         STATE_TX
     };
 
-    Sdi12(int uart_num, gpio_num_t data_pin);
+    /** Transaction types, latency is tracked separately for each */
+    enum CommandType
+    {
+        CMD_MEASURE,
+        CMD_DATA,
+        CMD_OTHER,
+        CMD_TYPES_COUNT
+    };
+
+    /** Response latency histogram, from end of command to terminator */
+    struct LatencyHistogram
+    {
+        uint32_t buckets[SDI12_LATENCY_BUCKETS];
+        uint32_t timeouts;
+    };
 
-    size_t write_command(char *cmd);
+    /** Handles transactions instead of the UART (bus simulator) */
+    typedef size_t (*Transport)(const char *cmd, char *response, size_t length);
 
-    int available(void);
-    int read();
-    size_t readBytesUntil(char terminator, char *buffer, size_t length);
+    Sdi12(int uart_num, gpio_num_t data_pin);
+    ~Sdi12();
+
+    size_t transaction(const char *cmd, char *response, size_t length);
 
     static bool check_crc(const char *buff);
+    static void calc_crc(const char *data, size_t length, char crc_out[4]);
+
+    static void set_transport(Transport transport);
+
+    static const LatencyHistogram* get_latency_histogram(CommandType type);
+    static void clear_latency_histograms();
+    static void print_latency_histograms();
 private:
-    /** Default constructor privade, useΟr must initialize serial on construct */
+    /** Default constructor privade, user must initialize serial on construct */
     Sdi12();
 
+    /** Not copyable, instances are counted */
+    Sdi12(const Sdi12&);
+
     /** UART number to use */
     int _uart_num = 0;
 
     /** Data pin for TX/RX */
     gpio_num_t _data_pin;
 
-    /** HW serial instance, must be initiated and provided by externally */
-    HardwareSerial _serial;
-
     /** Current state */
     State _state;
 
     void switch_to_tx();
     void switch_to_rx();
 
+    RetResult send_break(bool full_break);
+    size_t receive(char *response, size_t length);
+
+    static void break_timer_cb(void *arg);
+    static CommandType command_type(const char *cmd);
+
+    /** Event queue of each UART, driver is shared by instances */
+    static QueueHandle_t _uart_queues[UART_NUM_MAX];
+
+    /** Instances on each UART, driver is deleted with the last one */
+    static int _instances[UART_NUM_MAX];
+
+    /** Break timing */
+    static esp_timer_handle_t _break_timer;
+    static SemaphoreHandle_t _break_done;
+    static volatile int _break_stage;
+    static gpio_num_t _break_pin;
+
+    /** Bus activity, to skip break when addressing the same sensor again */
+    static uint32_t _last_activity_ms;
+    static char _last_address;
+
+    static LatencyHistogram _latency[CMD_TYPES_COUNT];
+
+    /** Transport replacing the UART, nullptr for none */
+    static Transport _transport;
+
     //
     // Constants
     //
     /** SDI12 standard baud rade */
     const int BAUD_RATE = 1200;
 
-    const int UART_TIMEOUT_MS = 3000;
+    /** Break (spacing) and marking after break, with some margin over
+     * the standard's 12ms and 8.33ms */
+    static const int BREAK_US = 12500;
+    static const int MARKING_US = 8500;
+
+    /** Sensors go back to standby after 87ms of marking, a break is needed */
+    const int BREAK_SKIP_MS = 87;
+
+    const int UART_TIMEOUT_MS = 1000;
+
+    const int UART_RX_BUFF_SIZE = 256;
+    const int UART_QUEUE_LEN = 10;
 };
 
-#endif
\ No newline at end of file
+#endif
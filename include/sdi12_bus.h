@@ -0,0 +1,22 @@
+#ifndef SDI12_BUS_H
+#define SDI12_BUS_H
+
+#include <inttypes.h>
+#include "struct.h"
+
+/******************************************************************************
+* SDI12 bus scheduler
+* Starts concurrent measurements (aCC!) on all sensors of the bus and waits
+* once for the slowest one, instead of measuring sensors one after the other.
+* Drivers collect the results through Sdi12Sensor::measure() as usual.
+******************************************************************************/
+namespace Sdi12Bus
+{
+	RetResult start(const char addresses[], int count);
+	void end();
+
+	bool is_active();
+	bool take_measurement(char address, uint8_t *measurement_vals);
+}
+
+#endif
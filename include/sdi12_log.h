@@ -14,7 +14,7 @@ namespace SDI12Log
 		char response[64];
 	};
 
-	RetResult add(char *data);
+	RetResult add(const char *data);
 
     DataStore<Entry>* get_store();
 
@@ -0,0 +1,83 @@
+#ifndef SDI12_PROFILE_H
+#define SDI12_PROFILE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include "struct.h"
+#include "log_codes.h"
+
+/******************************************************************************
+* Table driven SDI12 sensor measurement
+* A profile describes a sensor's measurement (expected values, retries,
+* where each value is stored in the output structure and its valid range).
+* A single engine runs the measurement for any profile.
+******************************************************************************/
+namespace Sdi12Profile
+{
+	/** Type of an output structure field */
+	enum FieldType
+	{
+		// Value is not stored
+		FIELD_NONE,
+		FIELD_FLOAT,
+		FIELD_INT16
+	};
+
+	/**
+	 * Mapping of a measured value (in response order) to the output structure
+	 */
+	struct Field
+	{
+		FieldType type;
+
+		// Offset in output structure
+		uint16_t offset;
+
+		// Value is multiplied by scale before stored (unit conversion)
+		float scale;
+
+		// Valid range of the value as returned by the sensor, not checked when
+		// min >= max. Batches with values out of range are requested again.
+		float min;
+		float max;
+	};
+
+	struct Profile
+	{
+		// Name, for debugging
+		const char *name;
+
+		// SDI12 address
+		char address;
+
+		// Number of values the sensor is configured to measure, one Field each
+		uint8_t values;
+		const Field *fields;
+
+		// Output structure size, zeroed before measuring
+		size_t out_size;
+
+		// Max seconds to wait for a measurement. Longer times mean a garbage
+		// response or a misconfigured sensor.
+		uint16_t wait_sec_max;
+
+		// Tries of each data request (aDx!) and delay between them
+		uint8_t tries;
+		uint16_t retry_delay_ms;
+
+		// Measurement fails when all values are 0, even if CRC is ok
+		bool reject_zero_vals;
+
+		// Log codes
+		Log::Code invalid_response_code;
+		Log::Code data_req_failed_code;
+		Log::Code zero_vals_code;
+
+		// Calculates derived fields after all values are stored, optional
+		void (*post_process)(void *out);
+	};
+
+	RetResult measure(const Profile *profile, void *out);
+}
+
+#endif
@@ -15,19 +15,22 @@ public:
 		ERROR_CRC_FAIL
 	};
 
-	Sdi12Sensor(gpio_num_t data_pin);
+	Sdi12Sensor(gpio_num_t data_pin, char address = '0');
 
-    size_t read_response();
-    size_t write_command(char *cmd);
+    size_t transaction(const char *cmd);
 
 	RetResult measure(uint16_t *secs_to_wait, uint8_t *measurement_vals);
-	RetResult read_measurement_data(uint8_t batch, float *o1, float *o2, float *o3);
+	RetResult start_concurrent(uint16_t *secs_to_wait, uint8_t *measurement_vals);
+	void wait_measurement(uint16_t secs_to_wait);
+	RetResult read_data(uint8_t batch, float vals[], int max_vals, int *count);
 
     bool check_crc();
 
 	ErrorCode get_last_error();
 
 	const char *get_buffer();
+
+	char get_address();
 private:
     /** Default constructor is private, user must provide extra data for init */
     Sdi12Sensor();
@@ -35,6 +38,17 @@ private:
     /** SDI12 object used for comms */
     Sdi12 _sdi12;
 
+	/** Data pin, high level is the start of a service request */
+	gpio_num_t _data_pin;
+
+	/** SDI12 address of the sensor */
+	char _address;
+
+	/** Measurement was started by Sdi12Bus and is already complete */
+	bool _prestarted = false;
+
+	RetResult start_measurement(const char *cmd, uint16_t *secs_to_wait, uint8_t *measurement_vals);
+
 	void set_last_error(ErrorCode error);
 	ErrorCode _last_error = ERROR_NONE;
 
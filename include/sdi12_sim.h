@@ -0,0 +1,49 @@
+#ifndef SDI12_SIM_H
+#define SDI12_SIM_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/******************************************************************************
+* Virtual SDI12 bus
+* Scripted sensors answer commands in place of the UART (plugged in as the Sdi12
+* transport), so drivers can be tested and timed without sensors. Bus time is
+* not waited, it is accumulated from the standard's timing (break, 1200 baud
+* chars) and each sensor's response delay.
+******************************************************************************/
+namespace Sdi12Sim
+{
+	/** Scripted sensor */
+	struct Sensor
+	{
+		char address;
+
+		// Seconds until measurement is ready, returned to aM!/aC!
+		uint16_t measure_secs;
+
+		// Measured values and max values in each aDn! response
+		const float *values;
+		uint8_t values_count;
+		uint8_t values_per_batch;
+
+		// Time from end of command to start of response
+		uint16_t response_delay_ms;
+
+		// Number of next data responses sent with a wrong CRC
+		uint8_t crc_errors;
+
+		// Number of next responses (any command) replaced with garbage
+		uint8_t garbage;
+	};
+
+	void attach(Sensor sensors[], int count);
+	void detach();
+
+	size_t transaction(const char *cmd, char *response, size_t length);
+
+	uint32_t get_bus_time_ms();
+	uint32_t get_transactions();
+	void reset_stats();
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef SENSOR_DRIVER_H
+#define SENSOR_DRIVER_H
+
+#include "struct.h"
+#include "const.h"
+#include "sleep_scheduler.h"
+#include "power_control.h"
+#include "sensor_tasks.h"
+
+/******************************************************************************
+* Sensor driver interface
+* Each sensor module describes itself with a SensorDriver, drivers are listed
+* in the SensorRegistry which is iterated by setup, the main loop and call home.
+* Acquisition and storing are split so sensors can be read concurrently while
+* data is stored from the main task.
+******************************************************************************/
+struct SensorDriver
+{
+	/**
+	 * Reads sensor(s) on a bus into the driver's memory, runs in the bus' task
+	 */
+	struct AcquireJob
+	{
+		SensorTasks::Bus bus;
+		RetResult (*acquire)();
+	};
+
+	const char *name;
+
+	/** Wake up reason the sensor is read on */
+	SleepScheduler::WakeupReason reason;
+
+	/** Rail powering the sensor, held while all due sensors are read */
+	PowerControl::Rail rail;
+
+	bool (*is_enabled)();
+
+	/** SDI12 address to start a concurrent measurement on, 0 for none. Null if not an SDI12 sensor */
+	char (*sdi12_address)();
+
+	RetResult (*init)();
+
+	/** Acquisition jobs, unused have a null acquire */
+	AcquireJob jobs[SENSOR_DRIVER_MAX_JOBS];
+
+	/** Store acquired data, runs in the main task after all jobs finished */
+	RetResult (*store)();
+
+	/** Build JSON from stored data and submit it when calling home */
+	RetResult (*submit)(DataStoreSubmitStats *stats);
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <inttypes.h>
+#include "struct.h"
+#include "sensor_driver.h"
+
+/******************************************************************************
+* Sensor registry
+* All sensor drivers of the node. Reads due sensors with the sensor task runner
+* and keeps timing and failure counters of each driver.
+******************************************************************************/
+namespace SensorRegistry
+{
+	/** Driver counters, since boot */
+	struct Stats
+	{
+		uint32_t runs;
+		uint32_t failures;
+		// Acquisition time (all jobs)
+		uint32_t last_ms;
+		uint32_t max_ms;
+		uint32_t total_ms;
+	};
+
+	int count();
+	const SensorDriver* get(int index);
+	const Stats* get_stats(int index);
+
+	RetResult init();
+
+	RetResult log_due();
+	RetResult log_all();
+
+	void print_stats();
+}
+
+#endif
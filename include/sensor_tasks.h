@@ -0,0 +1,33 @@
+#ifndef SENSOR_TASKS_H
+#define SENSOR_TASKS_H
+
+#include <inttypes.h>
+#include "struct.h"
+
+/******************************************************************************
+* Sensor task runner
+* Jobs are queued per bus and run() reads all buses concurrently, one FreeRTOS
+* task per bus. Jobs on the same bus run one after the other, in the order
+* they were added. When sensor tasks are disabled (FLAGS) buses are read one
+* after the other in the calling task. Power is handled by the caller.
+******************************************************************************/
+namespace SensorTasks
+{
+	/** Independent buses */
+	enum Bus
+	{
+		BUS_SDI12,
+		// Ultrasonic water level (PWM/serial)
+		BUS_WATER_LEVEL,
+		BUS_COUNT
+	};
+
+	typedef RetResult (*Job)(void *arg);
+
+	RetResult add(Bus bus, const char *name, Job job, void *arg = nullptr);
+	RetResult run();
+
+	bool is_concurrent();
+}
+
+#endif
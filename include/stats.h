@@ -0,0 +1,108 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <inttypes.h>
+#include "const.h"
+
+/******************************************************************************
+* Robust statistics on integer sensor samples (raw ADC counts, mm, etc.)
+* All calculations are integer, results are rounded to the samples' unit.
+* Functions taking a non-const array reorder it.
+******************************************************************************/
+namespace Stats
+{
+    int select(int vals[], int count, int k);
+
+    int median(int vals[], int count);
+
+    int mad(const int vals[], int count, int med, int scratch[]);
+
+    int mean(const int vals[], int count);
+
+    int trimmed_mean(int vals[], int count, int trim_pct = STATS_TRIM_PCT);
+
+    int hampel_filter(int vals[], int count, int k_q8 = STATS_HAMPEL_K_Q8);
+
+    /**************************************************************************
+    * Window of the last N samples (ring buffer)
+    * Once full, every new sample replaces the oldest one.
+    **************************************************************************/
+    template<int N>
+    class Window
+    {
+    public:
+        void clear()
+        {
+            _head = 0;
+            _count = 0;
+        }
+
+        void push(int val)
+        {
+            _vals[_head] = val;
+            _head = (_head + 1) % N;
+
+            if(_count < N)
+                _count++;
+        }
+
+        int get_count() const
+        {
+            return _count;
+        }
+
+        int median() const
+        {
+            int tmp[N];
+            copy(tmp);
+
+            return Stats::median(tmp, _count);
+        }
+
+        int mean() const
+        {
+            return Stats::mean(_vals, _count);
+        }
+
+        int trimmed_mean(int trim_pct = STATS_TRIM_PCT) const
+        {
+            int tmp[N];
+            copy(tmp);
+
+            return Stats::trimmed_mean(tmp, _count, trim_pct);
+        }
+
+        /**
+         * Mean of samples left after Hampel filtering
+         * @param valid_out Outputs number of samples used
+         */
+        int hampel_mean(int *valid_out = nullptr) const
+        {
+            int tmp[N];
+            copy(tmp);
+
+            int valid = Stats::hampel_filter(tmp, _count);
+            if(valid < 0)
+                valid = 0;
+
+            if(valid_out != nullptr)
+                *valid_out = valid;
+
+            return Stats::mean(tmp, valid);
+        }
+
+    private:
+        void copy(int out[]) const
+        {
+            // Oldest samples are overwritten first, order does not matter
+            for(int i = 0; i < _count; i++)
+                out[i] = _vals[i];
+        }
+
+        int _vals[N];
+        int _head = 0;
+        int _count = 0;
+    };
+}
+
+#endif
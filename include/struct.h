@@ -79,6 +79,15 @@ enum WaterLevelChannel
     WATER_LEVEL_CHANNEL_DFROBOT_ULTRASONIC_SERIAL
 };
 
+/**
+ * Water Level PWM channel capture method
+ */
+enum WaterLevelPwmCapture
+{
+    WATER_LEVEL_PWM_CAPTURE_PULSEIN = 1,
+    WATER_LEVEL_PWM_CAPTURE_RMT
+};
+
 /**
  * Aquatroll model
  */
@@ -98,6 +107,20 @@ enum FineOffsetSource
     FO_SOURCE_UART
 };
 
+/**
+ * Optional FineOffset aggregate outputs (bitmask)
+ */
+enum FoAggregateOutput
+{
+    FO_OUTPUT_NONE = 0,
+    FO_OUTPUT_TEMP_MIN_MAX = 1,
+    FO_OUTPUT_WIND_GUST_MAX = 1 << 1,
+    FO_OUTPUT_WIND_SPEED_STD_DEV = 1 << 2,
+    FO_OUTPUT_WIND_DIR_STD_DEV = 1 << 3,
+    FO_OUTPUT_RAIN_INTENSITY = 1 << 4,
+    FO_OUTPUT_HOURLY = 1 << 5
+};
+
 /**
  * FineOffset UART response field
  */
@@ -233,6 +256,20 @@ struct FLAGS_T
     bool EXTERNAL_RTC_ENABLED : 1;
 
     bool IPFS: 1;
+
+    bool WATER_LEVEL_BURST_ENABLED : 1;
+
+    bool FO_SNIFFER_CAPTURE_ENABLED : 1;
+
+    bool FO_SNIFFER_RADIO_WAKEUP_ENABLED : 1;
+
+    bool FO_SNIFFER_CALL_HOME_TASK_ENABLED : 1;
+
+    bool ENERGY_MONITOR_ENABLED : 1;
+
+    bool SENSOR_WAIT_LIGHT_SLEEP_ENABLED : 1;
+
+    bool SENSOR_TASKS_ENABLED : 1;
 };
 
 #endif
\ No newline at end of file
@@ -15,8 +15,44 @@
 ******************************************************************************/
 class TbFoDataJsonBuilder : public JsonBuilderBase<FoData::StoreEntry, FO_DATA_JSON_DOC_SIZE>
 {
+public:
+	/** Telemetry key names used for each entry field */
+	struct Keys
+	{
+		const char *packets;
+		const char *temp;
+		const char *hum;
+		const char *rain;
+		const char *rain_hourly;
+		const char *wind_dir;
+		const char *wind_speed;
+		const char *wind_gust;
+		const char *uv;
+		const char *uv_index;
+		const char *light;
+		const char *solar_radiation;
+		const char *temp_min;
+		const char *temp_max;
+		const char *wind_gust_max;
+		const char *wind_speed_std_dev;
+		const char *wind_dir_std_dev;
+		const char *rain_intensity;
+		const char *station_id;
+	};
+
+	RetResult add(const FoData::StoreEntry *entry);
+
+protected:
+	RetResult add(const FoData::StoreEntry *entry, const Keys *keys);
+};
+
+/******************************************************************************
+* Helper class to build Thingsboard telemetry JSON from FO hourly aggregates
+******************************************************************************/
+class TbFoHourlyDataJsonBuilder : public TbFoDataJsonBuilder
+{
 public:
 	RetResult add(const FoData::StoreEntry *entry);
 };
 
-#endif
\ No newline at end of file
+#endif
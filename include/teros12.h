@@ -2,6 +2,7 @@
 #define TEROS12_H
 
 #include "soil_moisture_data.h"
+#include "sensor_driver.h"
 
 namespace Teros12
 {
@@ -10,6 +11,8 @@ namespace Teros12
     RetResult measure(SoilMoistureData::Entry *data);
 
     RetResult log();
+
+    extern const SensorDriver DRIVER;
 }
 
 #endif
\ No newline at end of file
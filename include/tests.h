@@ -11,7 +11,19 @@ namespace Tests
 		RTC_FROM_GSM,
 		DATA_STORE,
 		WAKEUP_TIMES,
-		DEVICE_CONFIG
+		DEVICE_CONFIG,
+		WATER_LEVEL_BURST,
+		FO_AGGREGATOR,
+		FO_SNIFFER_FRAMES,
+		FO_CAPTURE_REPLAY,
+		FO_SLOT_TRACKER,
+		FO_UART_PARSER,
+		WATER_LEVEL_PWM_CAPTURE,
+		STATS,
+		ADC_BURST,
+		SDI12_SIM,
+		ENTRY_CODEC,
+		SENSOR_POWER_CYCLE
 	};
 
 	RetResult rtc_from_gsm();
@@ -24,6 +36,30 @@ namespace Tests
 
 	RetResult device_config();
 
+	RetResult water_level_burst();
+
+	RetResult fo_aggregator();
+
+	RetResult fo_sniffer_frames();
+
+	RetResult fo_capture_replay();
+
+	RetResult fo_slot_tracker();
+
+	RetResult fo_uart_parser();
+
+	RetResult water_level_pwm_capture();
+
+	RetResult stats();
+
+	RetResult adc_burst();
+
+	RetResult sdi12_sim();
+
+	RetResult entry_codec();
+
+	RetResult sensor_power_cycle();
+
 	void run(TestId tests[], int count);
 
 	void run_all();
@@ -52,8 +52,6 @@ namespace Utils
 
     void build_ipfs_file_json(String hash, uint32_t timestamp, char *buff, int buff_size);
 
-    int filter_outliers(int vals[], int count, float *avg_out = nullptr);
-
     void print_vals(const int vals[], int count);
 
     void cleanup_stores();
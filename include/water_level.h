@@ -20,6 +20,8 @@ namespace WaterLevel
 
 	RetResult measure_dummy(WaterSensorData::Entry *data);
 
+	RetResult capture_pwm(WaterLevelPwmCapture method, int samples[], int count);
+
 	ErrorCode get_last_error();
 }
 
@@ -0,0 +1,70 @@
+#ifndef WATER_LEVEL_TREND_H
+#define WATER_LEVEL_TREND_H
+#include "struct.h"
+#include "const.h"
+
+/******************************************************************************
+ * Water level rate of change estimation and flood burst sampling.
+ * Keeps a short history of level readings, estimates their rate of change and
+ * switches between normal and burst (high rate) water sampling.
+ *****************************************************************************/
+namespace WaterLevelTrend
+{
+	enum Mode
+	{
+		MODE_NORMAL,
+		MODE_BURST
+	};
+
+	/** Mode change caused by a new sample */
+	enum Transition
+	{
+		TRANSITION_NONE,
+		TRANSITION_BURST_START,
+		TRANSITION_BURST_END
+	};
+
+	struct Sample
+	{
+		uint32_t timestamp;
+		float level;
+	}__attribute__((packed));
+
+	/** Estimator/state machine state. Kept in RTC memory by the module, tests use their own. */
+	struct State
+	{
+		/** Ring buffer of last readings */
+		Sample history[WATER_LEVEL_TREND_HISTORY_LEN];
+		/** Index where next sample will be written */
+		uint8_t head;
+		/** Number of valid samples in history */
+		uint8_t count;
+		Mode mode;
+		/** Consecutive readings with rate under exit threshold while in burst mode */
+		uint8_t stable_count;
+		/** Last calculated rate (cm/min) */
+		float rate;
+	}__attribute__((packed));
+
+	RetResult add(uint32_t tstamp, float level);
+
+	bool burst_active();
+
+	bool take_call_home_request();
+
+	void reset();
+
+	//
+	// State functions, independent from module state so they can be tested with
+	// recorded series
+	//
+	void reset(State *state);
+
+	Transition update(State *state, uint32_t tstamp, float level);
+
+	float calc_rate(const State *state);
+
+	void print(const State *state);
+}
+
+#endif
@@ -47,10 +47,13 @@ namespace WaterSensorData
         // Capacitive water presence sensor
         bool presence;
 
-        // Range: 50 - 999cm
+        // Range: 50 - 999cm, raw mV (0 - ~3300) for analog pressure sensors
         float water_level;
     }__attribute__((packed));
 
+    /** Compact on-flash encoding of entries */
+    extern const EntryCodec::Format FORMAT;
+
     RetResult add(Entry *data);
 
     DataStore<Entry>* get_store();
@@ -2,15 +2,17 @@
 #define WATER_SENSORS_H
 
 #include "struct.h"
+#include "sensor_driver.h"
 
 namespace WaterSensors
 {
     RetResult on();
     RetResult off();
-
-    RetResult log();
+    bool sleep(uint32_t ms, int wake_pin = -1);
 
     RetResult init();
+
+    extern const SensorDriver DRIVER;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,75 @@
+"""
+Flash/RAM usage report of the firmware image
+
+Usage: pio run -e <env> -t size_report
+
+Custom targets need PlatformIO Core 5 or newer, older Core (the pinned
+espressif32 platform still builds with 4.x) gets a plain SCons alias instead.
+
+Usage is compared with the previous report of the same env, eg. build and
+report once, change FEATURE_* flags (app_config.h, board or env build_flags)
+and report again to see the savings.
+"""
+Import("env")
+
+import json
+import os
+import subprocess
+
+# Sections stored in flash (code, constants and initial values of data)
+FLASH_SECTIONS = (".iram0.vectors", ".iram0.text", ".flash.text", ".flash.rodata",
+                  ".dram0.data", ".rtc.text", ".rtc.data")
+# Statically allocated RAM
+DRAM_SECTIONS = (".dram0.data", ".dram0.bss")
+IRAM_SECTIONS = (".iram0.vectors", ".iram0.text")
+
+
+def read_sections(elf):
+    out = subprocess.check_output([env.subst("$SIZETOOL"), "-A", elf]).decode()
+    sections = {}
+
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith(".") and parts[1].isdigit():
+            sections[parts[0]] = int(parts[1])
+
+    return sections
+
+
+def size_report(target, source, env):
+    sections = read_sections(str(source[0]))
+
+    usage = {
+        "flash": sum(sections.get(s, 0) for s in FLASH_SECTIONS),
+        "dram": sum(sections.get(s, 0) for s in DRAM_SECTIONS),
+        "iram": sum(sections.get(s, 0) for s in IRAM_SECTIONS)
+    }
+
+    path = os.path.join(env.subst("$PROJECT_BUILD_DIR"), "size_report_%s.json" % env["PIOENV"])
+
+    previous = None
+    if os.path.isfile(path):
+        with open(path) as f:
+            previous = json.load(f)
+
+    print("Size report (%s)" % env["PIOENV"])
+    for key in ("flash", "dram", "iram"):
+        line = "  %-6s %8d bytes" % (key.upper(), usage[key])
+        if previous is not None and key in previous:
+            line += "  (%+d since last report)" % (usage[key] - previous[key])
+        print(line)
+
+    with open(path, "w") as f:
+        json.dump(usage, f)
+
+
+if hasattr(env, "AddCustomTarget"):
+    env.AddCustomTarget(
+        name="size_report",
+        dependencies="$BUILD_DIR/${PROGNAME}.elf",
+        actions=size_report,
+        title="Size report",
+        description="Flash/RAM usage compared to the previous report"
+    )
+else:
+    env.AlwaysBuild(env.Alias("size_report", "$BUILD_DIR/${PROGNAME}.elf", size_report))
@@ -0,0 +1,261 @@
+#include <Arduino.h>
+#include <driver/i2s.h>
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#include <soc/syscon_struct.h>
+#include <soc/sens_reg.h>
+#include "adc.h"
+#include "const.h"
+#include "stats.h"
+#include "common.h"
+
+namespace Adc
+{
+	//
+	// Private functions
+	//
+	RetResult capture(const int channels[], int count, int samples[][ADC_BURST_SAMPLES]);
+
+	//
+	// Private members
+	//
+	esp_adc_cal_characteristics_t _adc1_chars;
+	esp_adc_cal_characteristics_t _adc2_chars;
+	bool _initialized = false;
+
+	/******************************************************************************
+	 * Characterize ADCs from eFuse calibration values. Values match analogRead
+	 * defaults (11dB attenuation, 12 bit).
+	 *****************************************************************************/
+	RetResult init()
+	{
+		esp_adc_cal_value_t cal_type = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12,
+			ADC_DEFAULT_VREF_MV, &_adc1_chars);
+		esp_adc_cal_characterize(ADC_UNIT_2, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, ADC_DEFAULT_VREF_MV, &_adc2_chars);
+
+		debug_print(F("ADC calibration: "));
+		if(cal_type == ESP_ADC_CAL_VAL_EFUSE_TP)
+		{
+			debug_println(F("eFuse two point"));
+		}
+		else if(cal_type == ESP_ADC_CAL_VAL_EFUSE_VREF)
+		{
+			debug_println(F("eFuse Vref"));
+		}
+		else
+		{
+			debug_println(F("default Vref"));
+		}
+
+		_initialized = true;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Sample ADC1 pins in a single DMA burst. Samples of each pin are Hampel
+	 * filtered, averaged and converted to mV. Burst is repeated when more than
+	 * half of a pin's samples are outliers.
+	 * @param pins		ADC1 pins, max ADC_BURST_MAX_CHANNELS
+	 * @param count		Number of pins
+	 * @param mv_out	Output, mV of each pin
+	 *****************************************************************************/
+	RetResult read_burst(const uint8_t pins[], int count, int mv_out[])
+	{
+		if(count < 1 || count > ADC_BURST_MAX_CHANNELS)
+			return RET_ERROR;
+
+		if(!_initialized)
+			init();
+
+		int channels[ADC_BURST_MAX_CHANNELS];
+		for(int i = 0; i < count; i++)
+		{
+			channels[i] = digitalPinToAnalogChannel(pins[i]);
+
+			// ADC2 cannot be sampled with DMA
+			if(channels[i] < 0 || channels[i] >= ADC1_CHANNEL_MAX)
+			{
+				debug_print_e(F("Pin not on ADC1: "));
+				debug_println(pins[i], DEC);
+				return RET_ERROR;
+			}
+		}
+
+		int tries = ADC_BURST_TRIES;
+
+		while(tries--)
+		{
+			int samples[ADC_BURST_MAX_CHANNELS][ADC_BURST_SAMPLES];
+
+			if(capture(channels, count, samples) != RET_OK)
+				return RET_ERROR;
+
+			bool noisy = false;
+			for(int i = 0; i < count; i++)
+			{
+				int valid = Stats::hampel_filter(samples[i], ADC_BURST_SAMPLES);
+				if(valid <= ADC_BURST_SAMPLES / 2)
+					noisy = true;
+
+				mv_out[i] = raw_to_mv(pins[i], Stats::mean(samples[i], valid));
+			}
+
+			// Data is ok, done
+			if(!noisy)
+				break;
+
+			debug_println_w(F("Too much noise, retrying"));
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Convert raw ADC value to mV using eFuse calibration
+	 * @param pin	Pin value was read from
+	 * @param raw	Raw 12 bit value
+	 *****************************************************************************/
+	int raw_to_mv(uint8_t pin, int raw)
+	{
+		if(!_initialized)
+			init();
+
+		int channel = digitalPinToAnalogChannel(pin);
+		const esp_adc_cal_characteristics_t *chars = (channel >= 0 && channel < ADC1_CHANNEL_MAX) ? &_adc1_chars : &_adc2_chars;
+
+		return esp_adc_cal_raw_to_voltage(raw, chars);
+	}
+
+	/******************************************************************************
+	 * Convert mV to the lowest raw ADC value that reads at least mV (inverse of
+	 * raw_to_mv, binary search)
+	 * @param pin	Pin value will be read from
+	 * @param mv	Voltage
+	 *****************************************************************************/
+	int mv_to_raw(uint8_t pin, int mv)
+	{
+		int low = 0;
+		int high = 4095;
+
+		while(low < high)
+		{
+			int mid = (low + high) / 2;
+
+			if(raw_to_mv(pin, mid) < mv)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+
+		return low;
+	}
+
+	/******************************************************************************
+	 * Capture ADC_BURST_SAMPLES raw samples of each channel with I2S DMA.
+	 * SAR ADC1 pattern table is extended so each conversion moves to the next
+	 * channel. Samples are tagged with their channel.
+	 * @param channels	ADC1 channels
+	 * @param count		Number of channels
+	 * @param samples	Output, raw samples of each channel
+	 *****************************************************************************/
+	RetResult capture(const int channels[], int count, int samples[][ADC_BURST_SAMPLES])
+	{
+		i2s_config_t config = {};
+		config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+		config.sample_rate = ADC_BURST_SAMPLE_RATE;
+		config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+		config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+		config.communication_format = I2S_COMM_FORMAT_I2S_MSB;
+		config.intr_alloc_flags = 0;
+		config.dma_buf_count = 2;
+		config.dma_buf_len = ADC_BURST_DMA_BUFF_LEN;
+		config.use_apll = false;
+
+		if(i2s_driver_install(ADC_BURST_I2S_PORT, &config, 0, NULL) != ESP_OK)
+		{
+			debug_println_e(F("Could not init I2S ADC."));
+			return RET_ERROR;
+		}
+
+		for(int i = 0; i < count; i++)
+			adc1_config_channel_atten((adc1_channel_t)channels[i], ADC_ATTEN_DB_11);
+
+		// Sets up ADC1 for I2S with a single channel pattern
+		i2s_set_adc_mode(ADC_UNIT_1, (adc1_channel_t)channels[0]);
+
+		// Pattern table entry: channel (4 bits), bit width (2 bits), attenuation (2 bits),
+		// 4 entries per register, first entry in MSB
+		uint32_t patt_tab[4] = {0};
+		for(int i = 0; i < count; i++)
+		{
+			uint32_t entry = (channels[i] << 4) | (ADC_WIDTH_BIT_12 << 2) | ADC_ATTEN_DB_11;
+			patt_tab[i / 4] |= entry << (24 - 8 * (i % 4));
+		}
+
+		for(int i = 0; i < 4; i++)
+			SYSCON.saradc_sar1_patt_tab[i] = patt_tab[i];
+		SYSCON.saradc_ctrl.sar1_patt_len = count - 1;
+
+		i2s_adc_enable(ADC_BURST_I2S_PORT);
+
+		int samples_count[ADC_BURST_MAX_CHANNELS] = {0};
+		int discard = ADC_BURST_DISCARD_SAMPLES;
+		int done = 0;
+		RetResult ret = RET_OK;
+
+		uint32_t start_ms = millis();
+
+		while(done < count)
+		{
+			if(millis() - start_ms > ADC_BURST_TIMEOUT_MS)
+			{
+				debug_println_e(F("ADC burst timeout."));
+				ret = RET_ERROR;
+				break;
+			}
+
+			uint16_t buff[ADC_BURST_DMA_BUFF_LEN];
+			size_t read_bytes = 0;
+
+			i2s_read(ADC_BURST_I2S_PORT, buff, sizeof(buff), &read_bytes, pdMS_TO_TICKS(ADC_BURST_TIMEOUT_MS));
+
+			int read_samples = read_bytes / sizeof(buff[0]);
+			for(int i = 0; i < read_samples; i++)
+			{
+				// First conversions after enabling are unreliable
+				if(discard > 0)
+				{
+					discard--;
+					continue;
+				}
+
+				int channel = buff[i] >> 12;
+				int value = buff[i] & 0xFFF;
+
+				for(int c = 0; c < count; c++)
+				{
+					if(channels[c] != channel || samples_count[c] >= ADC_BURST_SAMPLES)
+						continue;
+
+					samples[c][samples_count[c]++] = value;
+
+					if(samples_count[c] == ADC_BURST_SAMPLES)
+						done++;
+				}
+			}
+		}
+
+		i2s_adc_disable(ADC_BURST_I2S_PORT);
+		i2s_driver_uninstall(ADC_BURST_I2S_PORT);
+
+		// Give ADC1 back to the RTC controller (as set by analogRead init), I2S
+		// mode left it to the digital controller
+		CLEAR_PERI_REG_MASK(SENS_SAR_READ_CTRL_REG, SENS_SAR1_DIG_FORCE);
+		SET_PERI_REG_MASK(SENS_SAR_READ_CTRL_REG, SENS_SAR1_DATA_INV);
+		SET_PERI_REG_MASK(SENS_SAR_MEAS_START1_REG, SENS_MEAS1_START_FORCE_M);
+		SET_PERI_REG_MASK(SENS_SAR_MEAS_START1_REG, SENS_SAR1_EN_PAD_FORCE_M);
+
+		return ret;
+	}
+}
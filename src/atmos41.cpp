@@ -3,12 +3,88 @@
 #include "utils.h"
 #include "rtc.h"
 #include "log.h"
-#include "sdi12_sensor.h"
+#include <stddef.h>
+#include "sdi12_profile.h"
+#include "power_control.h"
 #include "atmos41_data.h"
+#include "call_home.h"
+#include "tb_atmos41_data_json_builder.h"
 #include "common.h"
 
 namespace Atmos41
 {
+    using Sdi12Profile::FIELD_FLOAT;
+    using Sdi12Profile::FIELD_INT16;
+
+    /******************************************************************************
+    * Private functions
+    ******************************************************************************/
+    void calc_derived(void *out);
+    RetResult acquire();
+    RetResult store();
+    RetResult submit(DataStoreSubmitStats *stats);
+    bool is_enabled();
+    char sdi12_address();
+
+    /******************************************************************************
+    * Private members
+    ******************************************************************************/
+    /** Last acquired data, until stored */
+    Atmos41Data::Entry _data;
+    RetResult _data_ret = RET_ERROR;
+
+    /******************************************************************************
+     * Atmos41 returns the following measurements (in this order):
+     * Solar radiation - W/m^2
+     * Precipitation - mm
+     * Lightning strikes
+     * Wind speed - m/s
+     * Wind direction - deg
+     * Wind gust speed - m/s
+     * Air temperature - C
+     * Vapor pressure - kPa
+     * Atmospheric pressure - kPa, stored as hPa
+     ******************************************************************************/
+    const Sdi12Profile::Field ATMOS41_FIELDS[WEATHER_STATION_NUMBER_OF_MEASUREMENTS] = {
+        {FIELD_INT16, offsetof(Atmos41Data::Entry, solar), 1, 0, 1750},
+        {FIELD_FLOAT, offsetof(Atmos41Data::Entry, precipitation), 1, 0, 400},
+        {FIELD_INT16, offsetof(Atmos41Data::Entry, strikes), 1, 0, 65535},
+        {FIELD_FLOAT, offsetof(Atmos41Data::Entry, wind_speed), 1, 0, 30},
+        {FIELD_INT16, offsetof(Atmos41Data::Entry, wind_dir), 1, 0, 360},
+        {FIELD_FLOAT, offsetof(Atmos41Data::Entry, wind_gust_speed), 1, 0, 30},
+        {FIELD_FLOAT, offsetof(Atmos41Data::Entry, air_temp), 1, -50, 60},
+        {FIELD_FLOAT, offsetof(Atmos41Data::Entry, vapor_pressure), 1, 0, 47},
+        {FIELD_FLOAT, offsetof(Atmos41Data::Entry, atm_pressure), 10, 0, 0}
+    };
+
+    const Sdi12Profile::Profile ATMOS41_PROFILE = {
+        "Atmos41",
+        WEATHER_STATION_SDI12_ADDRESS,
+        WEATHER_STATION_NUMBER_OF_MEASUREMENTS,
+        ATMOS41_FIELDS,
+        sizeof(Atmos41Data::Entry),
+        WEATHER_STATION_MEASURE_WAIT_SEC_MAX,
+        3,
+        500,
+        false,
+        Log::WEATHER_STATION_INVALID_RESPONSE,
+        Log::WEATHER_STATION_MEASUREMENT_DATA_REQ_FAILED,
+        Log::WEATHER_STATION_MEASUREMENT_FAILED,
+        calc_derived
+    };
+
+    const SensorDriver DRIVER = {
+        "weather station",
+        SleepScheduler::REASON_READ_WEATHER_STATION,
+        PowerControl::RAIL_SENSORS,
+        is_enabled,
+        sdi12_address,
+        init,
+        {{SensorTasks::BUS_SDI12, acquire}},
+        store,
+        submit
+    };
+
 	/******************************************************************************
      * Initialization
      ******************************************************************************/
@@ -19,42 +95,20 @@ namespace Atmos41
 
     /******************************************************************************
      * Turn weather station ON
-     * TODO: Same power source as the water sensors, so turning on/off affects them
-     * as well. To be moved to own power source and switch.
+     * Same power rail as the water sensors, power stays on while any of them
+     * uses it. Must be matched by an off().
      ******************************************************************************/
 	RetResult on()
 	{
-		debug_println(F("Atmos41 ON."));
-
-		#ifdef TCALL_H
-			// Turn IP5306 power boost OFF to reduce idle current
-			Utils::ip5306_set_power_boost_state(true);
-		#endif
-
-		digitalWrite(PIN_WATER_SENSORS_PWR, 1);
-		delay(WATER_SENSORS_POWER_ON_DELAY_MS);
-
-        return RET_OK;
+		return PowerControl::acquire(PowerControl::RAIL_SENSORS);
 	}
 
     /******************************************************************************
      * Turn weather station OFF
-     * TODO: Same power source as the water sensors, so turning on/off affects them
-     * as well. To be moved to own power source and switch.
      *****************************************************************************/
 	RetResult off()
 	{
-		debug_println(F("Atmos41 OFF."));
-
-		digitalWrite(PIN_WATER_SENSORS_PWR, 0);
-		delay(100);
-
-		#ifdef TCALL_H
-			// Turn IP5306 power boost OFF to reduce idle current
-			Utils::ip5306_set_power_boost_state(false);
-		#endif
-
-        return RET_OK;
+		return PowerControl::release(PowerControl::RAIL_SENSORS);
 	}
 
     /******************************************************************************
@@ -71,226 +125,33 @@ namespace Atmos41
             return measure_dummy(data);
         }
 
-        // Zero structure
-        memset(data, 0, sizeof(Atmos41Data::Entry));
-
-        Sdi12Sensor sensor(PIN_SDI12_DATA);
-
-        // Output variables
-        // Seconds to wait
-        uint16_t secs_to_wait = 0;
-        // Vals to be measured
-        uint8_t measured_values = 0;
-
-        if(sensor.measure(&secs_to_wait, &measured_values) != RET_OK)
-        {
-            Sdi12Sensor::ErrorCode error = sensor.get_last_error();
-            if(error == Sdi12Sensor::ERROR_INVALID_RESPONSE)
-            {
-                Log::log(Log::WEATHER_STATION_INVALID_RESPONSE, strlen(sensor.get_buffer()), 0);
-
-                return RET_ERROR;
-            }
+        RetResult ret = Sdi12Profile::measure(&ATMOS41_PROFILE, data);
 
-            return RET_ERROR;
-        }
-
-        // Check if seconds within range. Range values are chosen empirically.
-        // If values not within range, something is wrong with the response or with the
-        // configuration of sensor
-        if(secs_to_wait > WEATHER_STATION_MEASURE_WAIT_SEC_MAX)
-        {
-            debug_println(F("Invalid number of seconds to wait for measurements."));
-            return RET_ERROR;
-        }
-        // The exact number of measured values is constant
-        if(measured_values != WEATHER_STATION_NUMBER_OF_MEASUREMENTS)
-        {
-            debug_print(F("Invalid number of measured values. Expected: "));
-            debug_println(WEATHER_STATION_NUMBER_OF_MEASUREMENTS, DEC);
-            return RET_ERROR;
-        }
-
-
-        // TODO: 
-        // When sleeping, pins go low and sensor is disabled.
-        // Use RTC GPIO so power pin  can stay high and ESP32 can sleep instead of waiting
-        debug_print(F("Waiting (sec): "));
-        debug_println(secs_to_wait + SDI12_MEASURE_EXTRA_WAIT_SECS);
-        delay((secs_to_wait + SDI12_MEASURE_EXTRA_WAIT_SECS) * 1000);
-
-        //
-        // Request measurement data
-        // 
-        Atmos41Data::Entry weather_data;
-
-        // Vars to receive all the measurement data
-        // Data will be copied to output structure only after successfull measurement
-        float d1 = 0, d2 = 0, d3 = 0;
-
-        // Tries requesting data before aborting
-        int tries = 3;
-
-        //
-        // Batch 0
-        //
-        tries = 3;
-        uint8_t batch = 0;
-        RetResult ret = RET_ERROR;
-        while(tries--)
-        {
-            if(sensor.read_measurement_data(batch, &d1, &d2, &d3) != RET_OK)
-            {
-                debug_print(F("Could not get measurement results for batch: "));
-                debug_println(batch, DEC);
-
-                Log::log(Log::WEATHER_STATION_MEASUREMENT_DATA_REQ_FAILED, batch);
-
-                if(tries > 0)
-                {
-                    debug_println(F("Retrying"));
-                }
-                else
-                {
-                    ret = RET_ERROR;
-                }
-
-                delay(500);
-            }
-            else
-            {
-                ret = RET_OK;
-                break;
-            }
-        }
-
-        if(ret != RET_OK)
-        {
-
-            debug_println(F("Aborting"));
-            return RET_ERROR;
-        }
-
-		weather_data.solar = d1;
-		weather_data.precipitation = d2;
-		weather_data.strikes = d3;
-
-        //
-        // Batch 1
-        //
-        tries = 3;
-        ret = RET_ERROR;
-        batch = 1;
-
-        while(tries--)
-        {
-            if(sensor.read_measurement_data(batch, &d1, &d2, &d3) != RET_OK)
-            {
-                debug_print(F("Could not get measurement results for batch: "));
-                debug_println(batch, DEC);
-
-                Log::log(Log::WEATHER_STATION_MEASUREMENT_DATA_REQ_FAILED, batch);
-
-                if(tries > 0)
-                {
-                    debug_println(F("Retrying"));
-                }
-                else
-                {
-                    ret = RET_ERROR;
-                }
-
-                delay(500);
-            }
-            else
-            {
-                ret = RET_OK;
-                break;
-            }
-        }
-
-        if(ret != RET_OK)
-        {
+        if(ret == RET_OK)
+            Atmos41Data::print(data);
 
-            debug_println(F("Aborting"));
-            return RET_ERROR;
-        }
-
-    	weather_data.wind_speed = d1;
-		weather_data.wind_dir = d2;
-		weather_data.wind_gust_speed = d3;
-
-		//
-        // Batch 2
-        //
-        tries = 3;
-        ret = RET_ERROR;
-        batch = 2;
-
-        while(tries--)
-        {
-            if(sensor.read_measurement_data(batch, &d1, &d2, &d3) != RET_OK)
-            {
-                debug_print(F("Could not get measurement results for batch: "));
-                debug_println(batch, DEC);
-
-                Log::log(Log::WEATHER_STATION_MEASUREMENT_DATA_REQ_FAILED, batch);
-
-                if(tries > 0)
-                {
-                    debug_println(F("Retrying"));
-                }
-                else
-                {
-                    ret = RET_ERROR;
-                }
-
-                delay(500);
-            }
-            else
-            {
-                ret = RET_OK;
-                break;
-            }
-        }
-
-        if(ret != RET_OK)
-        {
-
-            debug_println(F("Aborting"));
-            return RET_ERROR;
-        }
-
-		weather_data.air_temp = d1;
-		weather_data.vapor_pressure = d2;
-		weather_data.atm_pressure = d3;
+        return ret;
+    }
 
-        // Convert pressure to hPa from kPa
-        weather_data.atm_pressure *= 10;
+    /******************************************************************************
+     * Calculate relative humidity and dew point from air temp and vapor pressure
+     ******************************************************************************/
+    void calc_derived(void *out)
+    {
+        Atmos41Data::Entry *weather_data = (Atmos41Data::Entry*)out;
 
         //
         // Calculate relative humidity from air temp and vapor pressure
         //
-        weather_data.rel_humidity = 100 * (weather_data.vapor_pressure / (0.611 * exp((17.502 * weather_data.air_temp) / (240.97 + weather_data.air_temp))));
+        weather_data->rel_humidity = 100 * (weather_data->vapor_pressure / (0.611 * exp((17.502 * weather_data->air_temp) / (240.97 + weather_data->air_temp))));
        
         //
         // Calculate dew point
         //
         const float a = 17.625;
         const float b = 243.04;
-        weather_data.dew_point = (b * (log(weather_data.rel_humidity / 100) + (a * weather_data.air_temp) / (b + weather_data.air_temp))) /
-                                 (a - log(weather_data.rel_humidity / 100) - (a * weather_data.air_temp) / (b + weather_data.air_temp));
-
-        // Copy structure to output
-        memcpy(data, &weather_data, sizeof(weather_data));
-
-        Utils::serial_style(STYLE_GREEN);
-        debug_println(F("All Weather data is received successfully."));
-        Utils::serial_style(STYLE_RESET);
-
-        Atmos41Data::print(data);
-
-        return RET_OK;
+        weather_data->dew_point = (b * (log(weather_data->rel_humidity / 100) + (a * weather_data->air_temp) / (b + weather_data->air_temp))) /
+                                 (a - log(weather_data->rel_humidity / 100) - (a * weather_data->air_temp) / (b + weather_data->air_temp));
     }
 
     /******************************************************************************
@@ -298,37 +159,81 @@ namespace Atmos41
 	******************************************************************************/
 	RetResult measure_log()
 	{
-        Atmos41Data::Entry data;
+        acquire();
+
+        return store();
+    }
+
+    /******************************************************************************
+	* Read weather station, data kept until store()
+	******************************************************************************/
+    RetResult acquire()
+    {
+        memset(&_data, 0, sizeof(_data));
+        _data_ret = RET_ERROR;
 
         Log::log(Log::WEATHER_STATION_MEASUREMENT_LOG);
 
         if(Atmos41::on() != RET_OK)
         {
             debug_println(F("Could not turn weather station ON."));
-            Atmos41::off();
             return RET_ERROR;
         }
 
-        RetResult ret = Atmos41::measure(&data);
+        _data_ret = Atmos41::measure(&_data);
 
         Atmos41::off();
 
-        if(ret == RET_ERROR)
+        if(_data_ret == RET_ERROR)
         {
             debug_println(F("Could not measure weather station."));
             Log::log(Log::WEATHER_STATION_MEASUREMENT_FAILED);
-            return RET_ERROR;
         }
 
-        data.timestamp = RTC::get_timestamp();
+        return _data_ret;
+    }
+
+    /******************************************************************************
+	* Set timestamp and save acquired data
+	******************************************************************************/
+    RetResult store()
+    {
+        if(_data_ret != RET_OK)
+            return RET_ERROR;
+
+        _data.timestamp = RTC::get_timestamp();
 
         debug_println(F("Weather data:"));
-		Atmos41Data::print(&data);
+		Atmos41Data::print(&_data);
 
-		Atmos41Data::add(&data);
+		Atmos41Data::add(&_data);
 		Atmos41Data::get_store()->commit();
 
-        return ret;
+        _data_ret = RET_ERROR;
+
+        return RET_OK;
+    }
+
+    /******************************************************************************
+     * Submit stored data when calling home
+     ******************************************************************************/
+    RetResult submit(DataStoreSubmitStats *stats)
+    {
+        return CallHome::submit_stored_telemetry<DataStore<Atmos41Data::Entry>, TbAtmos41DataJsonBuilder, Atmos41Data::Entry>(Atmos41Data::get_store(), stats);
+    }
+
+    /******************************************************************************
+     * Driver config
+     ******************************************************************************/
+    bool is_enabled()
+    {
+        return FLAGS.ATMOS41_ENABLED;
+    }
+
+    char sdi12_address()
+    {
+        // Dummy measurements do not use the bus
+        return FLAGS.MEASURE_DUMMY_WEATHER ? 0 : WEATHER_STATION_SDI12_ADDRESS;
     }
 
     /******************************************************************************
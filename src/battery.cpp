@@ -2,10 +2,12 @@
 #include "const.h"
 #include "log.h"
 #include "utils.h"
+#include "adc.h"
 #include "gsm.h"
 #include "app_config.h"
 #include "common.h"
 #include "lightning.h"
+#include "energy_monitor.h"
 
 namespace Battery
 {
@@ -14,10 +16,17 @@ namespace Battery
     //
     BATTERY_MODE _last_battery_mode = BATTERY_MODE::BATTERY_MODE_NORMAL;
 
+    /** Last battery/solar burst */
+    uint16_t _bat_mv = 0;
+    uint16_t _solar_mv = 0;
+    uint32_t _burst_ms = 0;
+    bool _burst_valid = false;
+
     //
     // Private functions
     //
     uint8_t mv_to_pct(uint16_t mv);
+    RetResult read_burst();
 
     /******************************************************************************
      * Init fuel
@@ -30,49 +39,49 @@ namespace Battery
         pinMode(PIN_ADC_BAT, ANALOG);
         pinMode(PIN_ADC_SOLAR, ANALOG);
 
-        return RET_OK;
+        return Adc::init();
     }
 
     /******************************************************************************
-     * Read battery mV with ADC (TCALL)
-     * @param
+     * Sample battery and solar voltage together
+     * Falls back to sampling each pin separately when burst sampling fails
      *****************************************************************************/
-    RetResult read_adc(uint16_t *voltage, uint16_t *pct)
+    RetResult read_burst()
     {
-        int tries = 3;
-        float avg_level = 0;
+        const uint8_t pins[] = {PIN_ADC_BAT, PIN_ADC_SOLAR};
+        int mv[2] = {0};
 
-        while(tries--)
+        if(Adc::read_burst(pins, 2, mv) != RET_OK)
         {
-            int battery_vals[ADC_BATTERY_LEVEL_SAMPLES];
-            for (int i = 0; i < ADC_BATTERY_LEVEL_SAMPLES; i++)
-            {
-                battery_vals[i] = (uint32_t)analogRead(PIN_ADC_BAT);
-                delay(5);
-            }
+            debug_println_w(F("ADC burst failed, sampling pins separately."));
 
-            // Serial.println(F("Values read: "));
-            // print_vals(battery_vals, ADC_BATTERY_LEVEL_SAMPLES);
+            mv[0] = Utils::read_adc_mv(PIN_ADC_BAT, ADC_BURST_SAMPLES, 0);
+            mv[1] = Utils::read_adc_mv(PIN_ADC_SOLAR, ADC_BURST_SAMPLES, 0);
 
-            int outliers = Utils::filter_outliers(battery_vals, ADC_BATTERY_LEVEL_SAMPLES, &avg_level);
-            
-            // Data is ok, done
-            if(outliers < ADC_BATTERY_LEVEL_SAMPLES / 2)
-                break;
-
-            // debug_println_e(F("Too much noise, retrying"));
-            // debug_print_e(F("Vals: "));
-            // debug_println(avg_level, DEC);
+            if(mv[0] < 0 || mv[1] < 0)
+                return RET_ERROR;
+        }
 
-            // print_vals(battery_vals, ADC_BATTERY_LEVEL_SAMPLES);
+        // Compensate for 1/2 dividers
+        _bat_mv = mv[0] * 2;
+        _solar_mv = mv[1] * 2;
+        _burst_ms = millis();
+        _burst_valid = true;
 
-            debug_println("\n----------------------------------");
-        }
+        return RET_OK;
+    }
 
-        uint16_t bat_mv = ((float)avg_level / 4096) * 3600 * 2;
+    /******************************************************************************
+     * Read battery mV with ADC (TCALL)
+     * @param
+     *****************************************************************************/
+    RetResult read_adc(uint16_t *voltage, uint16_t *pct)
+    {
+        if(read_burst() != RET_OK)
+            return RET_ERROR;
 
-        *voltage = bat_mv;
-        *pct = mv_to_pct(bat_mv);
+        *voltage = _bat_mv;
+        *pct = mv_to_pct(_bat_mv);
                
         return RET_OK;
     }
@@ -169,6 +178,22 @@ namespace Battery
         return pct_out;
     }
 
+    /******************************************************************************
+     * Convert battery pct to voltage (lowest mV of the pct in the look up table)
+     *****************************************************************************/
+    uint16_t pct_to_mv(uint8_t pct)
+    {
+        const uint8_t array_size = sizeof(BATTERY_PCT_LUT) / sizeof(BATTERY_PCT_LUT[0]);
+
+        for(int i = 0; i < array_size; i++)
+        {
+            if(BATTERY_PCT_LUT[i].pct >= pct)
+                return BATTERY_PCT_LUT[i].mv;
+        }
+
+        return BATTERY_PCT_LUT[array_size - 1].mv;
+    }
+
     /******************************************************************************
      * Get battery mode depending on level
      *****************************************************************************/
@@ -262,7 +287,17 @@ namespace Battery
         {
             debug_printf("Sleeping for (sec): %llu \n", time_to_sleep_ms / 1000);
             Serial.flush();
+
+            // Wake up as soon as battery is recharged instead of on next check
+            if(FLAGS.ENERGY_MONITOR_ENABLED)
+                EnergyMonitor::arm(EnergyMonitor::WAKE_BATTERY_RECHARGED);
+
             esp_light_sleep_start();
+
+            if(EnergyMonitor::check_wakeup())
+            {
+                debug_println(F("Woke up on battery recharged."));
+            }
             debug_println(F("Wake up"));
 
             wakeup_count++;
@@ -299,13 +334,14 @@ namespace Battery
 	******************************************************************************/
 	RetResult read_solar_mv(uint16_t *voltage)
 	{
-        int mv = Utils::read_adc_mv(PIN_ADC_SOLAR, 10, 10);
-        
-        if(mv < 0)
-            return RET_ERROR;
+        // Solar is sampled along with battery, reuse a recent burst
+        if(!_burst_valid || millis() - _burst_ms > ADC_BURST_MAX_AGE_MS)
+        {
+            if(read_burst() != RET_OK)
+                return RET_ERROR;
+        }
 
-        // Compensate for1/2 divider
-        *voltage = mv * 2;
+        *voltage = _solar_mv;
 
         return RET_OK;
 	}
@@ -4,17 +4,13 @@
 #include "common.h"
 #include "log.h"
 #include "data_store_reader.h"
-#include "water_sensor_data.h"
-#include "soil_moisture_data.h"
 #include "sdi12_log.h"
 #include "rtc.h"
-#include "tb_water_sensor_data_json_builder.h"
-#include "tb_atmos41_data_json_builder.h"
-#include "tb_soil_moisture_data_json_builder.h"
 #include "tb_sdi12_log_json_builder.h"
 #include "tb_fo_data_json_builder.h"
 #include "tb_lightning_data_json_builder.h"
 #include "tb_log_json_builder.h"
+#include "sensor_registry.h"
 #include "test_utils.h"
 #include "utils.h"
 #include "gsm.h"
@@ -26,12 +22,12 @@
 #include "http_request.h"
 #include "log.h"
 #include "globals.h"
-#include "atmos41_data.h"
 #include "fo_sniffer.h"
 #include "fo_uart.h"
 #include "fo_buffer.h"
 #include "battery_gauge.h"
 #include "solar_monitor.h"
+#include "energy_monitor.h"
 #include "rtc.h"
 #include "credentials.h"
 #include <HTTPClient.h>
@@ -42,9 +38,6 @@ namespace CallHome
 	//
 	// Private functions
 	//
-	template <typename TStore, typename TBuilder, typename TEntry>
-	RetResult submit_stored_telemetry(TStore *store, DataStoreSubmitStats *stats);
-	RetResult submit_tb_telemetry(const char *data, int data_size);
 	uint32_t build_flags_bitmask();
 	RetResult end();
 
@@ -75,12 +68,17 @@ namespace CallHome
 		Log::log(Log::SCHEDULE_SOIL_MOISTURE_INT, DeviceConfig::get_wakeup_schedule_reason_int(SleepScheduler::WakeupReason::REASON_READ_SOIL_MOISTURE_SENSOR));
 		//
 
+		EnergyMonitor::drain();
 		Battery::log_adc();
 		Battery::log_solar_adc();
 		Log::log(Log::BATTERY_MDDE, Battery::get_last_mode());
 
 		Log::log(Log::Code::FS_SPACE, SPIFFS.usedBytes(), SPIFFS.totalBytes() - SPIFFS.usedBytes());
 
+		// Keep receiving FO packets while calling home, FO sniff events are not
+		// handled until it finishes
+		FoSniffer::start_task();
+
 		GSM::on();
 		if(GSM::connect_persist() != RET_OK)
 		{
@@ -187,6 +185,8 @@ namespace CallHome
 	 *****************************************************************************/
 	RetResult end()
 	{
+		FoSniffer::stop_task();
+
 		GSM::off();
 		
 		Utils::serial_style(STYLE_BLUE);
@@ -211,54 +211,10 @@ namespace CallHome
 		DataStoreSubmitStats telemetry_stats = {0};
 
 		//
-		// Array of lambdas each submitting telemetry for a single sensor/store
+		// Array of lambdas each submitting telemetry for a single store, sensor
+		// drivers' data is submitted first
 		//
 		RetResult (* tasks[])(DataStoreSubmitStats*) = {
-            [](DataStoreSubmitStats *telemetry_stats) mutable -> RetResult
-			{ 
-				//
-				// Submit water sensor data
-				//
-				Utils::serial_style(STYLE_BLUE);
-				Utils::print_separator(F("Submitting water sensor data."));
-				Utils::serial_style(STYLE_RESET);
-
-				submit_stored_telemetry<DataStore<WaterSensorData::Entry>, TbWaterSensorDataJsonBuilder, WaterSensorData::Entry>(WaterSensorData::get_store(), telemetry_stats);
-
-				Utils::serial_style(STYLE_BLUE);
-				debug_print_i(F("Water sensor data submission complete"));
-				Utils::serial_style(STYLE_RESET);
-			},
-            [](DataStoreSubmitStats *telemetry_stats) mutable -> RetResult
-			{ 
-				//
-				// Submit weather data
-				//
-				Utils::serial_style(STYLE_BLUE);
-				Utils::print_separator(F("Submitting weather data."));
-				Utils::serial_style(STYLE_RESET);
-
-				submit_stored_telemetry<DataStore<Atmos41Data::Entry>, TbAtmos41DataJsonBuilder, Atmos41Data::Entry>(Atmos41Data::get_store(), telemetry_stats);
-
-				Utils::serial_style(STYLE_BLUE);
-				Utils::print_separator(F("Atmos41 data submission complete"));
-				Utils::serial_style(STYLE_RESET);
-			},
-            [](DataStoreSubmitStats *telemetry_stats) mutable -> RetResult
-			{ 
-				//
-				// Submit soil moisture sensor data
-				//
-				Utils::serial_style(STYLE_BLUE);
-				Utils::print_separator(F("Submitting soil moisture data."));
-				Utils::serial_style(STYLE_RESET);
-
-				submit_stored_telemetry<DataStore<SoilMoistureData::Entry>, TbSoilMoistureDataJsonBuilder, SoilMoistureData::Entry>(SoilMoistureData::get_store(), telemetry_stats);
-
-				Utils::serial_style(STYLE_BLUE);
-				Utils::print_separator(F("Soil moisture data submission complete"));
-				Utils::serial_style(STYLE_RESET);
-			},
             [](DataStoreSubmitStats *telemetry_stats) mutable -> RetResult
 			{ 
 				//
@@ -270,6 +226,11 @@ namespace CallHome
 
 				submit_stored_telemetry<DataStore<FoData::StoreEntry>, TbFoDataJsonBuilder, FoData::StoreEntry>(FoData::get_store(), telemetry_stats);
 
+				if(FO_AGGREGATE_OUTPUTS & FO_OUTPUT_HOURLY)
+				{
+					submit_stored_telemetry<DataStore<FoData::StoreEntry>, TbFoHourlyDataJsonBuilder, FoData::StoreEntry>(FoData::get_store(FoData::WINDOW_HOURLY), telemetry_stats);
+				}
+
 				Utils::serial_style(STYLE_BLUE);
 				Utils::print_separator(F("FineOffset weather data submission complete"));
 				Utils::serial_style(STYLE_RESET);
@@ -333,7 +294,25 @@ namespace CallHome
 		// Keep track of time elapsed
 		uint32_t telemetry_start_millis = millis();
 
-		for(int i = 0; i < sizeof(tasks) / sizeof(tasks[0]); i++)
+		for(int i = 0; i < SensorRegistry::count(); i++)
+		{
+			const SensorDriver *driver = SensorRegistry::get(i);
+
+			Utils::serial_style(STYLE_BLUE);
+			debug_printf("Submitting %s data.\n", driver->name);
+			Utils::serial_style(STYLE_RESET);
+
+			driver->submit(&telemetry_stats);
+
+			if(telemetry_stats.failed_requests >= FAILED_TELEMETRY_REQ_THRESHOLD)
+			{
+				debug_println_e(F("Request error threshold reached, aborting telemetry submission"));
+				submission_aborted = true;
+				break;
+			}
+		}
+
+		for(int i = 0; i < sizeof(tasks) / sizeof(tasks[0]) && !submission_aborted; i++)
 		{
 			tasks[i](&telemetry_stats);
 
@@ -402,140 +381,6 @@ namespace CallHome
 		return submission_aborted ? RET_ERROR : RET_OK;
 	}
 
-	/******************************************************************************
-	 * Read all data from a DataStore, build JSON and submit as telemetry
-	 *****************************************************************************/
-	template <typename TStore, typename TBuilder, typename TEntry>
-	RetResult submit_stored_telemetry(TStore *store, DataStoreSubmitStats *stats)
-	{
-
-		// Entries in current request packet
-		int cur_req_entries = 0;
-		// Keep count of failed CRCs for log
-		int crc_failures = 0;
-		// Total sensor data entries
-		int total_entries = 0;
-		// Total entries submitted (valid entries)
-		int submitted_entries = 0;
-		// Total successfull entries
-		int successfull_entries = 0;
-		// Total number of requests 
-		int total_requests = 0;
-		// Number of successfull requests
-		int successfull_requests = 0;
-
-		TBuilder json_builder;
-
-		// Output buffer for resulting JSON
-		char json_buff[TELEMETRY_DATA_JSON_OUTPUT_BUFF_SIZE] = {0};
-		
-		DataStoreReader<TEntry> reader(store);
-		const TEntry *entry = NULL;
-
-		json_builder.reset();
-
-		//
-		// Iterate all data and submit. Each file in flash will fit in a single request.
-		// If request succeeds, file is deleted, if not it is left to be retried next time.
-		//
-		
-		// Submission errors occurred
-		bool submission_failed = false;
-
-		while(reader.next_file())
-		{
-			cur_req_entries = 0;
-
-			// Iterate all file entries in file, check CRC and add to JSON
-			while((entry = reader.next_entry()))
-			{
-				total_entries++;
-				if(!reader.entry_crc_valid())
-				{
-					crc_failures++;
-					continue;
-				}
-				
-				cur_req_entries++;
-				submitted_entries++;
-
-				json_builder.add(entry);
-			}
-
-			// Send only if there are valid entries to be sent
-			if(cur_req_entries > 0)
-			{
-				json_builder.build(json_buff, sizeof(json_buff), false);
-
-				total_requests++;
-
-				if(submit_tb_telemetry(json_buff, strlen(json_buff)) == RET_OK)
-				{
-					// Request success, file can be deleted
-					reader.delete_file();
-
-					Utils::serial_style(STYLE_BLUE);
-					debug_println(F("Deleting file, all complete"));
-					Utils::serial_style(STYLE_RESET);
-
-					successfull_entries += cur_req_entries;
-					successfull_requests++;
-				}
-				else
-				{
-					Utils::serial_style(STYLE_RED);
-					debug_println(F("Sending telemetry data failed. File remains to be retried next time."));
-					Utils::serial_style(STYLE_RESET);
-
-					// Max error threshold reached, abort
-					if(total_requests - successfull_entries >= FAILED_TELEMETRY_REQ_THRESHOLD)
-					{
-						submission_failed = true;
-						break;
-					}
-				}
-			}
-			else
-			{
-				// All entries failed CRC in this file so it is useless, delete it
-				reader.delete_file();
-
-				Utils::serial_style(STYLE_BLUE);
-				debug_println(F("Deleting file, BAD CRC"));
-				Utils::serial_style(STYLE_RESET);
-			}
-
-			// Empty packet and prepare for next
-			json_builder.reset();
-		}
-
-		// Print report
-		int failed_requests = total_requests - successfull_requests;
-
-		debug_print(F("Total entries: "));
-		debug_println(total_entries, DEC);
-		debug_print(F("Submitted entries: "));
-		debug_println(submitted_entries, DEC);
-		debug_print(F("Successful entries: "));
-		debug_println(successfull_entries, DEC);
-		debug_print(F("Entries failed CRC32: "));
-		debug_println(crc_failures, DEC);
-		debug_println();
-
-		// Output operation stats (add to provided)
-		if(stats != nullptr)
-		{
-			stats->total_entries += total_entries;
-			stats->submitted_entries += submitted_entries;
-			stats->successful_entries += successfull_entries;
-			stats->crc_failed_entries += crc_failures;
-			stats->total_requests += total_requests;
-			stats->failed_requests += failed_requests;
-		}
-
-		return submission_failed ? RET_ERROR : RET_OK;
-	}
-
 	/******************************************************************************
 	 * Submit all logs
 	 * @param data Buffer with json for TB
@@ -768,9 +613,14 @@ namespace CallHome
 		// FO Enabled
 		json_doc[TB_ATTR_CUR_FO_EN] = DeviceConfig::get_fo_enabled();
 
-		// FO id
-		char fo_id[5] = "";
+		// FO ids, comma separated when sniffing multiple stations
+		char fo_id[FO_SNIFFER_MAX_STATIONS * 3 + 1] = "";
 		snprintf(fo_id, sizeof(fo_id), "%02x", DeviceConfig::get_fo_sniffer_id());
+		for(int i = 1; i < FO_SNIFFER_MAX_STATIONS; i++)
+		{
+			if(DeviceConfig::get_fo_sniffer_id(i) != 0)
+				snprintf(fo_id + strlen(fo_id), sizeof(fo_id) - strlen(fo_id), ",%02x", DeviceConfig::get_fo_sniffer_id(i));
+		}
 		json_doc[TB_ATTR_CUR_FO_ID] = fo_id;
 
 		// Include aquatroll model if water quality sensor is enabled
@@ -4,6 +4,7 @@
 #include "lightning_data.h"
 #include "atmos41_data.h"
 #include "fo_data.h"
+#include "fo_capture.h"
 #include "sdi12_log.h"
 #include "log.h"
 #include "utils.h"
@@ -18,18 +19,23 @@
  * A file has a max size. When max size is reached, a new file is created and 
  * subsequent structures are written there.
  * Data in a DataStore can be traversed with a DataStoreReader class.
+ * Stores with an entry format write entries compactly encoded (EntryCodec) in
+ * blocks. A block is extended in place on every commit until it is full, so
+ * entries logged one at a time still share a block header.
  ******************************************************************************/
 
 /******************************************************************************
  * Constructor
  * @param dir Dir in SPIFFS Where data will be stored
  * @param elements_per_file Max entries to store in a file before creating a new one
+ * @param format Entry format for compact encoding, NULL to store entries as they are
  ******************************************************************************/
 template <class TStruct>
-DataStore<TStruct>::DataStore(const char *dir_path, int max_entries_per_file)
+DataStore<TStruct>::DataStore(const char *dir_path, int max_entries_per_file, const EntryCodec::Format *format)
 {
 	_dir_path = dir_path;
 	_max_entries_per_file = max_entries_per_file;
+	_format = format;
 }
 
 /******************************************************************************
@@ -98,6 +104,10 @@ RetResult DataStore<TStruct>::commit()
 	if (Flash::mount() != RET_OK)
 		return RET_ERROR;
 
+	// Compact encoded stores are written in blocks
+	if(_format != NULL)
+		return commit_blocks();
+
 	// If current data file not set yet, get one
 	if(strlen(_current_data_file_path) < 1)
 	{
@@ -277,13 +287,283 @@ const char* DataStore<TStruct>::get_dir_path() const
 	return _dir_path;
 }
 
+/******************************************************************************
+ * Get entry format
+ ******************************************************************************/
+template <class TStruct>
+const EntryCodec::Format* DataStore<TStruct>::get_format() const
+{
+	return _format;
+}
+
+/******************************************************************************
+ * Commit buffer of a store with a format
+ * Entries are written oldest first so deltas between them stay small. Entries
+ * that could not be written are kept in the buffer.
+ ******************************************************************************/
+template <class TStruct>
+RetResult DataStore<TStruct>::commit_blocks()
+{
+	if(_format->field_count > ENTRY_CODEC_MAX_FIELDS)
+	{
+		debug_println_e(F("Too many fields in entry format."));
+		return RET_ERROR;
+	}
+
+	// If current data file not set yet or it was removed (eg. submitted), get one
+	if(strlen(_current_data_file_path) < 1 || !SPIFFS.exists(_current_data_file_path))
+	{
+		if(update_current_data_file_path() != RET_OK)
+		{
+			debug_println(F("Could not get data file to write to."));
+			return RET_ERROR;
+		}
+	}
+
+	int count = get_buffer_element_count();
+	int written = 0;
+	bool new_file = false;
+	RetResult ret = RET_OK;
+
+	while(written < count)
+	{
+		int written_now = append_blocks(written, count - written);
+
+		if(written_now < 0 || (written_now == 0 && new_file))
+		{
+			debug_print(F("Writing failed, aborting. Entries left in buffer: "));
+			debug_println(count - written);
+			ret = RET_ERROR;
+			break;
+		}
+
+		written += written_now;
+
+		// File full or not appendable, continue in a new one
+		if(written < count)
+		{
+			if(update_current_data_file_path(true) != RET_OK)
+			{
+				debug_println(F("Could not get data file to write to."));
+				ret = RET_ERROR;
+				break;
+			}
+
+			new_file = true;
+		}
+	}
+
+	// Keep entries not written
+	if(written > 0)
+	{
+		memmove(&_buffer[0], &_buffer[written], (count - written) * sizeof(Entry));
+		_buffer_element_count = count - written;
+	}
+
+	return ret;
+}
+
+/******************************************************************************
+ * Append entries to the last block of the current file, starting new blocks
+ * as they fill up. Block header is rewritten after every entry so a reset
+ * loses at most the entry being written.
+ * @param first Index of first buffer entry to write
+ * @param count Number of entries to write
+ * @return Entries written (0 if file is full or can't be appended to),
+ * -1 on write error
+ ******************************************************************************/
+template <class TStruct>
+int DataStore<TStruct>::append_blocks(int first, int count)
+{
+	File f = SPIFFS.open(_current_data_file_path, "r+");
+	if(!f)
+	{
+		debug_println(F("Could not open data file for append."));
+		return -1;
+	}
+
+	int file_size = f.size();
+	int file_entries = 0;
+	int block_pos = -1;
+
+	EntryCodec::BlockHeader header = {0};
+	EntryCodec::BlockState state;
+	uint8_t data[ENTRY_CODEC_BLOCK_MAX_SIZE];
+
+	if(file_size == 0)
+	{
+		if(EntryCodec::write_header(f, _format) != RET_OK)
+		{
+			debug_println(F("Could not write file header."));
+			f.close();
+			return -1;
+		}
+
+		file_size = sizeof(EntryCodec::FileHeader);
+	}
+	else
+	{
+		file_entries = scan_block_file(f, &block_pos);
+		if(file_entries < 0)
+		{
+			f.close();
+			return 0;
+		}
+
+		// Continue last block, unless it is damaged. Decoding it restores the
+		// previous entry deltas are encoded against.
+		if(block_pos >= 0)
+		{
+			f.seek(block_pos);
+			f.read((uint8_t*)&header, sizeof(header));
+
+			bool valid = header.size <= sizeof(data) &&
+				f.read(data, header.size) == header.size &&
+				Utils::crc32(data, header.size) == header.crc32;
+
+			EntryCodec::block_begin(_format, header.base_timestamp, &state);
+
+			TStruct decoded;
+			int pos = 0;
+
+			for(int i = 0; valid && i < header.count; i++)
+			{
+				int read = EntryCodec::block_decode(_format, &state, data + pos, header.size - pos, &decoded);
+				if(read < 0)
+					valid = false;
+				else
+					pos += read;
+			}
+
+			if(!valid)
+				block_pos = -1;
+		}
+	}
+
+	int written = 0;
+
+	while(written < count && file_entries < _max_entries_per_file)
+	{
+		const Entry *buff_entry = get_buffer_element(first + written);
+		if(buff_entry == NULL)
+			break;
+
+		// Start a new block at the end of file
+		if(block_pos < 0 || header.count == UINT8_MAX)
+		{
+			block_pos = file_size;
+
+			memset(&header, 0, sizeof(header));
+			header.base_timestamp = EntryCodec::get_base_timestamp(_format, &buff_entry->data);
+			header.crc32 = Utils::crc32(data, 0);
+
+			EntryCodec::block_begin(_format, header.base_timestamp, &state);
+
+			f.seek(block_pos);
+			if(f.write((uint8_t*)&header, sizeof(header)) != sizeof(header))
+			{
+				debug_println(F("Could not write block header."));
+				f.close();
+				return -1;
+			}
+
+			file_size += sizeof(header);
+		}
+
+		int size = EntryCodec::block_encode(_format, &state, &buff_entry->data, data + header.size, sizeof(data) - header.size);
+
+		if(size < 0)
+		{
+			// Block full
+			if(header.count > 0)
+			{
+				block_pos = -1;
+				continue;
+			}
+
+			debug_println_e(F("Entry does not fit in a block."));
+			f.close();
+			return -1;
+		}
+
+		// Entry data first, then header with the new count and CRC
+		f.seek(block_pos + sizeof(header) + header.size);
+		int written_bytes = f.write(data + header.size, size);
+
+		header.count++;
+		header.size += size;
+		header.crc32 = Utils::crc32(data, header.size);
+
+		f.seek(block_pos);
+		if(written_bytes != size || f.write((uint8_t*)&header, sizeof(header)) != sizeof(header))
+		{
+			debug_println(F("Could not write entry."));
+			f.close();
+			return -1;
+		}
+		f.flush();
+
+		file_size += size;
+		file_entries++;
+		written++;
+	}
+
+	f.close();
+
+	return written;
+}
+
+/******************************************************************************
+ * Walk block headers of a file
+ * @param f File to scan
+ * @param last_block_pos Position of last block, -1 if file has no blocks
+ * @return Number of entries in file, -1 if it is not a block file of the store's
+ * format version or is damaged
+ ******************************************************************************/
+template <class TStruct>
+int DataStore<TStruct>::scan_block_file(File &f, int *last_block_pos)
+{
+	EntryCodec::FileHeader file_header = {0};
+
+	*last_block_pos = -1;
+
+	if(EntryCodec::read_header(f, &file_header) != RET_OK ||
+		file_header.magic != ENTRY_CODEC_BLOCK_FILE_MAGIC || file_header.version != _format->version)
+	{
+		return -1;
+	}
+
+	int file_size = f.size();
+	int pos = sizeof(file_header);
+	int entries = 0;
+
+	while(pos < file_size)
+	{
+		EntryCodec::BlockHeader header = {0};
+
+		f.seek(pos);
+		if(f.read((uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+			pos + (int)sizeof(header) + header.size > file_size)
+		{
+			return -1;
+		}
+
+		entries += header.count;
+		*last_block_pos = pos;
+		pos += sizeof(header) + header.size;
+	}
+
+	return entries;
+}
+
 /******************************************************************************
  * Update path of file where the next write operation will take
  * First try to find a  file that has still space left (didn't reach max 
  * element per file limit). If failed, create a new file.
+ * @param force_new Create a new file without looking for one with space left
  ******************************************************************************/
 template <class TStruct>
-RetResult DataStore<TStruct>::update_current_data_file_path()
+RetResult DataStore<TStruct>::update_current_data_file_path(bool force_new)
 {
 	File dir = SPIFFS.open(_dir_path);
 	if(!dir)
@@ -298,11 +578,27 @@ RetResult DataStore<TStruct>::update_current_data_file_path()
 	char smallest_file_path[FILE_PATH_BUFFER_SIZE] = {0};
 	File cur_file;
 
-	while(cur_file = dir.openNextFile())
+	while(!force_new && (cur_file = dir.openNextFile()))
 	{
-		if(cur_file.size() < smallest_size || smallest_size < 0)
+		int size = cur_file.size();
+
+		// Block files are filled by entry count. Files of other formats (eg. written
+		// before formats were used) or damaged are only read
+		if(_format != NULL && size > 0)
+		{
+			int last_block_pos = 0;
+			size = scan_block_file(cur_file, &last_block_pos);
+
+			if(size < 0)
+			{
+				cur_file.close();
+				continue;
+			}
+		}
+
+		if(size < smallest_size || smallest_size < 0)
 		{
-			smallest_size = cur_file.size();
+			smallest_size = size;
 			strncpy(smallest_file_path, cur_file.name(), sizeof(smallest_file_path));
 		}
 
@@ -316,7 +612,10 @@ RetResult DataStore<TStruct>::update_current_data_file_path()
 
 	// Smallest file found, check if there is space in it for at least one entry
 	// else create a new file
-	if(smallest_size >= 0 && smallest_size + sizeof(Entry) <= _max_entries_per_file * sizeof(Entry))
+	bool has_space = _format != NULL ? smallest_size < _max_entries_per_file :
+		smallest_size + sizeof(Entry) <= _max_entries_per_file * sizeof(Entry);
+
+	if(smallest_size >= 0 && has_space)
 	{
 		// debug_print(F("Use existing: "));
 		// debug_println(smallest_file_path);
@@ -495,4 +794,5 @@ template class DataStore<SoilMoistureData::Entry>;
 template class DataStore<Log::Entry>;
 template class DataStore<SDI12Log::Entry>;
 template class DataStore<FoData::StoreEntry>;
+template class DataStore<FoCapture::Entry>;
 template class DataStore<LightningData::Entry>;
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "water_sensor_data.h"
 #include "soil_moisture_data.h"
 #include "fo_data.h"
+#include "fo_capture.h"
 #include "sdi12_log.h"
 #include "atmos41_data.h"
 #include "log.h"
@@ -103,6 +104,8 @@ bool DataStoreReader<TStruct>::next_file()
 
 			// New file to read, let entry reader know
 			reset_data_state();
+
+			read_file_header();
 		}
 	}
 
@@ -138,10 +141,33 @@ TStruct* DataStoreReader<TStruct>::next_entry()
 
 	if(_state_data == STATE_READING)
 	{
-		int bytes_read = _cur_file.readBytes((char*)&_cur_entry, sizeof(_cur_entry));
+		bool read = false;
+
+		if(_cur_file_type == FILE_BLOCKS)
+		{
+			read = read_block_entry();
+		}
+		else if(_cur_file_type == FILE_RECORDS)
+		{
+			const EntryCodec::Format *format = _store->get_format();
+			int record_size = sizeof(uint32_t) + EntryCodec::record_size(format);
+
+			if(_cur_file.readBytes((char*)_cur_record, record_size) == record_size)
+			{
+				memcpy(&_cur_entry.crc32, _cur_record, sizeof(uint32_t));
+				memset(&_cur_entry.data, 0, sizeof(_cur_entry.data));
+				EntryCodec::record_decode(format, _cur_record + sizeof(uint32_t), _base_timestamp, &_cur_entry.data);
+
+				read = true;
+			}
+		}
+		else
+		{
+			read = _cur_file.readBytes((char*)&_cur_entry, sizeof(_cur_entry)) == sizeof(_cur_entry);
+		}
 
 		// No more data, reading of data finished
-		if(bytes_read != sizeof(_cur_entry))
+		if(!read)
 		{
 			_state_data = STATE_READING_FINISHED;
 		}
@@ -174,6 +200,13 @@ bool DataStoreReader<TStruct>::entry_crc_valid()
 	if(_state_data != STATE_READING)
 		return false;
 
+	// Entries of a block share its CRC
+	if(_cur_file_type == FILE_BLOCKS)
+		return _cur_block_valid;
+
+	if(_cur_file_type == FILE_RECORDS)
+		return Utils::crc32(_cur_record + sizeof(uint32_t), EntryCodec::record_size(_store->get_format())) == _cur_entry.crc32;
+
 	return Utils::crc32( (uint8_t*)&_cur_entry.data, sizeof(_cur_entry.data) ) == _cur_entry.crc32;
 }
 
@@ -204,6 +237,102 @@ RetResult DataStoreReader<TStruct>::delete_file()
 	}
 }
 
+/******************************************************************************
+ * Check header of file just opened. Files of the store's format are decoded,
+ * files without a header are read as they are and files of other format
+ * versions can't be read.
+ ******************************************************************************/
+template <class TStruct>
+void DataStoreReader<TStruct>::read_file_header()
+{
+	_cur_file_type = FILE_RAW;
+	_base_timestamp = 0;
+	_cur_block_header.count = 0;
+	_cur_block_entry = 0;
+
+	const EntryCodec::Format *format = _store->get_format();
+	if(format == NULL)
+		return;
+
+	EntryCodec::FileHeader header = {0};
+
+	if(EntryCodec::read_header(_cur_file, &header) != RET_OK)
+	{
+		// Written before format was used
+		_cur_file.seek(0);
+	}
+	else if(header.version != format->version)
+	{
+		debug_print_w(F("Unknown entry format version, file skipped: "));
+		debug_println(header.version);
+
+		_state_data = STATE_READING_FINISHED;
+	}
+	else if(header.magic == ENTRY_CODEC_BLOCK_FILE_MAGIC)
+	{
+		_cur_file_type = FILE_BLOCKS;
+	}
+	else
+	{
+		_cur_file_type = FILE_RECORDS;
+		_base_timestamp = header.base_timestamp;
+	}
+}
+
+/******************************************************************************
+ * Decode next entry of a block file, reading the next block when the current
+ * one is done
+ * @return False when there are no more entries or the rest of the file is
+ * damaged
+ ******************************************************************************/
+template <class TStruct>
+bool DataStoreReader<TStruct>::read_block_entry()
+{
+	const EntryCodec::Format *format = _store->get_format();
+
+	while(true)
+	{
+		if(_cur_block_entry >= _cur_block_header.count)
+		{
+			if(_cur_file.read((uint8_t*)&_cur_block_header, sizeof(_cur_block_header)) != sizeof(_cur_block_header))
+				return false;
+
+			int size = _cur_block_header.size;
+
+			if(size > (int)sizeof(_cur_block) || _cur_file.read(_cur_block, size) != size)
+			{
+				debug_println_w(F("Block truncated, rest of file skipped."));
+				return false;
+			}
+
+			_cur_block_valid = Utils::crc32(_cur_block, size) == _cur_block_header.crc32;
+			_cur_block_pos = 0;
+			_cur_block_entry = 0;
+
+			EntryCodec::block_begin(format, _cur_block_header.base_timestamp, &_block_state);
+
+			continue;
+		}
+
+		memset(&_cur_entry.data, 0, sizeof(_cur_entry.data));
+
+		int read = EntryCodec::block_decode(format, &_block_state, _cur_block + _cur_block_pos,
+			_cur_block_header.size - _cur_block_pos, &_cur_entry.data);
+
+		// Damaged block, skip rest of its entries
+		if(read < 0)
+		{
+			_cur_block_entry = _cur_block_header.count;
+			continue;
+		}
+
+		_cur_block_pos += read;
+		_cur_block_entry++;
+
+		return true;
+	}
+}
+
 /******************************************************************************
  * Reset reader to enable re-iteration
  ******************************************************************************/
@@ -236,5 +365,6 @@ template class DataStoreReader<Atmos41Data::Entry>;
 template class DataStoreReader<SoilMoistureData::Entry>;
 template class DataStoreReader<Log::Entry>;
 template class DataStoreReader<FoData::StoreEntry>;
+template class DataStoreReader<FoCapture::Entry>;
 template class DataStoreReader<LightningData::Entry>;
 template class DataStoreReader<SDI12Log::Entry>;
\ No newline at end of file
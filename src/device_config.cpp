@@ -1,4 +1,5 @@
 #include "device_config.h"
+#include <stddef.h>
 #include "common.h"
 #include "app_config.h"
 
@@ -35,10 +36,16 @@ namespace DeviceConfig
 
 		fo_enabled: false,
 
+		fo_sniffer_extra_ids: {0},
+
 		/** Last received/
 		last_remote_control_data: RemoteControl::Data(0, 0, 0, 0) */
 	};
 	
+	/** Size of config saved by FW versions before multiple FO stations were
+	 * supported. Such config is loaded with defaults for the fields added since. */
+	const int DEVICE_CONFIG_LEGACY_SIZE = offsetof(Data, fo_sniffer_extra_ids);
+
 	/** Currently loaded config. Struct is kept up to date every time new config is set */
 	Data _current_config = DEVICE_CONFIG_DEFAULT;
 
@@ -170,14 +177,24 @@ namespace DeviceConfig
 		int read_bytes = _prefs.getBytes(DEVICE_CONFIG_NVS_NAMESPACE_NAME, &loaded_config, sizeof(loaded_config));
 
 		// Read successful
-		if(read_bytes == sizeof(loaded_config))
+		if(read_bytes == sizeof(loaded_config) || read_bytes == DEVICE_CONFIG_LEGACY_SIZE)
 		{
 			// Check crc. CRC is checked with the CRC field = 0, so set to 0 but keep backup first
 			uint32_t crc32_bkp = loaded_config.crc32;
 			loaded_config.crc32 = 0;
 
+			// Legacy config, fill fields it doesn't have with defaults
+			if(read_bytes == DEVICE_CONFIG_LEGACY_SIZE)
+			{
+				debug_println(F("Legacy config, using defaults for new fields."));
+
+				memcpy((uint8_t*)&loaded_config + DEVICE_CONFIG_LEGACY_SIZE,
+					(uint8_t*)&DEVICE_CONFIG_DEFAULT + DEVICE_CONFIG_LEGACY_SIZE,
+					sizeof(loaded_config) - DEVICE_CONFIG_LEGACY_SIZE);
+			}
+
 			// CRC check failed. Log event and abort.
-			if(crc32_bkp != Utils::crc32((uint8_t*)&loaded_config, sizeof(loaded_config)))
+			if(crc32_bkp != Utils::crc32((uint8_t*)&loaded_config, read_bytes))
 			{
 				debug_println(F("Config failed CRC32 check. Loading aborted."));
 
@@ -274,6 +291,11 @@ namespace DeviceConfig
 		debug_print(F("FO Sniffer ID: "));
 		debug_println(data->fo_sniffer_id, HEX);
 
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS - 1; i++)
+		{
+			debug_printf("FO Sniffer ID (station %d): %x\n", i + 1, data->fo_sniffer_extra_ids[i]);
+		}
+
 
 		Utils::print_separator(NULL);
 	}
@@ -409,19 +431,40 @@ namespace DeviceConfig
 	}
 
 	/******************************************************************************
-	* Set FO sniffer weather station ID
+	* Get FO sniffer weather station ID
+	* @param station Station index (0 to FO_SNIFFER_MAX_STATIONS - 1)
+	* @return ID, 0 when not set
 	******************************************************************************/
-	const uint8_t get_fo_sniffer_id()
+	const uint8_t get_fo_sniffer_id(int station)
 	{
-		return _current_config.fo_sniffer_id;
+		if(station == 0)
+			return _current_config.fo_sniffer_id;
+
+		if(station < 0 || station >= FO_SNIFFER_MAX_STATIONS)
+			return 0;
+
+		return _current_config.fo_sniffer_extra_ids[station - 1];
 	}
 
 	/******************************************************************************
-	* Get FO sniffer weather station ID
+	* Set FO sniffer weather station ID
+	* @param id			ID, 0 to clear
+	* @param station	Station index (0 to FO_SNIFFER_MAX_STATIONS - 1)
 	******************************************************************************/
-	RetResult set_fo_sniffer_id(uint8_t id)
+	RetResult set_fo_sniffer_id(uint8_t id, int station)
 	{
-		_current_config.fo_sniffer_id = id;
+		if(station == 0)
+		{
+			_current_config.fo_sniffer_id = id;
+			return RET_OK;
+		}
+
+		if(station < 0 || station >= FO_SNIFFER_MAX_STATIONS)
+			return RET_ERROR;
+
+		_current_config.fo_sniffer_extra_ids[station - 1] = id;
+
+		return RET_OK;
 	}
 
 	/******************************************************************************
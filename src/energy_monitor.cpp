@@ -0,0 +1,324 @@
+#include <Arduino.h>
+#include <esp_sleep.h>
+#include <esp32/ulp.h>
+#include <driver/adc.h>
+#include <soc/rtc_cntl_reg.h>
+#include <soc/sens_reg.h>
+#include "energy_monitor.h"
+#include "app_config.h"
+#include "const.h"
+#include "adc.h"
+#include "battery.h"
+#include "log.h"
+#include "log_codes.h"
+#include "common.h"
+
+/**
+ * ULP instructions that sample an ADC1 pad (average of 4) and update its
+ * aggregates. R3 holds the address of the variables. Uses labels label to
+ * label + 5.
+ */
+#define ULP_SAMPLE_CHANNEL(pad, var, label)	\
+	I_MOVI(R1, 0),							\
+	I_ADC(R0, 0, pad),						\
+	I_ADDR(R1, R1, R0),						\
+	I_ADC(R0, 0, pad),						\
+	I_ADDR(R1, R1, R0),						\
+	I_ADC(R0, 0, pad),						\
+	I_ADDR(R1, R1, R0),						\
+	I_ADC(R0, 0, pad),						\
+	I_ADDR(R1, R1, R0),						\
+	I_RSHI(R0, R1, 2),						\
+	I_ST(R0, R3, var + CH_LAST),			\
+	/* Min (sub overflows when lower) */	\
+	I_LD(R1, R3, var + CH_MIN),				\
+	I_SUBR(R2, R0, R1),						\
+	M_BXF(label),							\
+	M_BX(label + 1),						\
+	M_LABEL(label),							\
+	I_ST(R0, R3, var + CH_MIN),				\
+	M_LABEL(label + 1),						\
+	/* Max */								\
+	I_LD(R1, R3, var + CH_MAX),				\
+	I_SUBR(R2, R1, R0),						\
+	M_BXF(label + 2),						\
+	M_BX(label + 3),						\
+	M_LABEL(label + 2),						\
+	I_ST(R0, R3, var + CH_MAX),				\
+	M_LABEL(label + 3),						\
+	/* 32 bit sum, carry to high word */	\
+	I_LD(R1, R3, var + CH_SUM_LO),			\
+	I_ADDR(R1, R1, R0),						\
+	I_ST(R1, R3, var + CH_SUM_LO),			\
+	M_BXF(label + 4),						\
+	M_BX(label + 5),						\
+	M_LABEL(label + 4),						\
+	I_LD(R1, R3, var + CH_SUM_HI),			\
+	I_ADDI(R1, R1, 1),						\
+	I_ST(R1, R3, var + CH_SUM_HI),			\
+	M_LABEL(label + 5)
+
+namespace EnergyMonitor
+{
+	/**
+	 * Aggregates of a channel, offsets from the channel's first variable
+	 */
+	enum ChannelVar
+	{
+		CH_LAST,
+		CH_MIN,
+		CH_MAX,
+		CH_SUM_LO,
+		CH_SUM_HI,
+		CH_LEN
+	};
+
+	/**
+	 * Variables shared with the ULP, word offsets from ENERGY_MONITOR_ULP_DATA_OFFSET.
+	 * ULP only uses the lower 16 bits of each word.
+	 */
+	enum UlpVar
+	{
+		VAR_BAT = 0,
+		VAR_SOLAR = VAR_BAT + CH_LEN,
+		VAR_COUNT = VAR_SOLAR + CH_LEN,
+		VAR_WAKE_BELOW,
+		VAR_WAKE_ABOVE,
+		VAR_WAKE_FLAG,
+		VAR_LEN
+	};
+
+	enum UlpLabel
+	{
+		LABEL_BAT = 0,
+		LABEL_SOLAR = 6,
+		LABEL_WAKE = 12,
+		LABEL_HALT
+	};
+
+	//
+	// Private functions
+	//
+	uint32_t get_var(int var);
+	void set_var(int var, uint32_t val);
+	void reset_aggregates();
+	void log_channel(Log::Code code, uint8_t pin, int var, uint32_t count);
+
+	//
+	// Private members
+	//
+	bool _initialized = false;
+	bool _armed = false;
+
+	/******************************************************************************
+	 * Load ULP program and reset aggregates
+	 *****************************************************************************/
+	RetResult init()
+	{
+		if(!FLAGS.ENERGY_MONITOR_ENABLED)
+			return RET_OK;
+
+		int bat_pad = digitalPinToAnalogChannel(PIN_ADC_BAT);
+		int solar_pad = digitalPinToAnalogChannel(PIN_ADC_SOLAR);
+
+		// ULP can only read ADC1
+		if(bat_pad < 0 || bat_pad >= ADC1_CHANNEL_MAX || solar_pad < 0 || solar_pad >= ADC1_CHANNEL_MAX)
+		{
+			debug_println_e(F("Energy monitor pins not on ADC1."));
+			return RET_ERROR;
+		}
+
+		const ulp_insn_t program[] = {
+			I_MOVI(R3, ENERGY_MONITOR_ULP_DATA_OFFSET),
+
+			ULP_SAMPLE_CHANNEL(bat_pad, VAR_BAT, LABEL_BAT),
+			ULP_SAMPLE_CHANNEL(solar_pad, VAR_SOLAR, LABEL_SOLAR),
+
+			I_LD(R1, R3, VAR_COUNT),
+			I_ADDI(R1, R1, 1),
+			I_ST(R1, R3, VAR_COUNT),
+
+			// Wake up when battery crosses a threshold, once per arming
+			I_LD(R0, R3, VAR_BAT + CH_LAST),
+			I_LD(R1, R3, VAR_WAKE_BELOW),
+			I_SUBR(R2, R0, R1),
+			M_BXF(LABEL_WAKE),
+			I_LD(R1, R3, VAR_WAKE_ABOVE),
+			I_SUBR(R2, R1, R0),
+			M_BXF(LABEL_WAKE),
+			I_HALT(),
+
+			M_LABEL(LABEL_WAKE),
+			I_LD(R0, R3, VAR_WAKE_FLAG),
+			M_BGE(LABEL_HALT, 1),
+			I_MOVI(R0, 1),
+			I_ST(R0, R3, VAR_WAKE_FLAG),
+			I_WAKE(),
+
+			M_LABEL(LABEL_HALT),
+			I_HALT()
+		};
+
+		size_t size = sizeof(program) / sizeof(ulp_insn_t);
+
+		if(ulp_process_macros_and_load(0, program, &size) != ESP_OK || size > ENERGY_MONITOR_ULP_DATA_OFFSET)
+		{
+			debug_println_e(F("Could not load energy monitor ULP program."));
+			return RET_ERROR;
+		}
+
+		reset_aggregates();
+
+		_initialized = true;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Start sampling, before going to sleep
+	 * @param mode Battery threshold that wakes up the device
+	 *****************************************************************************/
+	RetResult arm(WakeMode mode)
+	{
+		if(!_initialized)
+			return RET_ERROR;
+
+		uint32_t wake_below = 0;
+		uint32_t wake_above = 0xFFFF;
+
+		// Battery pin is behind a 1/2 divider
+		if(mode == WAKE_BATTERY_LOW && !FLAGS.BATTERY_FORCE_NORMAL_MODE)
+		{
+			int mv = Battery::pct_to_mv(BATTERY_LEVEL_SLEEP_CHARGE) - ENERGY_MONITOR_WAKE_HYST_MV;
+			wake_below = Adc::mv_to_raw(PIN_ADC_BAT, mv / 2);
+		}
+		else if(mode == WAKE_BATTERY_RECHARGED)
+		{
+			int mv = Battery::pct_to_mv(BATTERY_LEVEL_SLEEP_RECHARGED) + ENERGY_MONITOR_WAKE_HYST_MV;
+			wake_above = Adc::mv_to_raw(PIN_ADC_BAT, mv / 2);
+		}
+
+		set_var(VAR_WAKE_BELOW, wake_below);
+		set_var(VAR_WAKE_ABOVE, wake_above);
+		set_var(VAR_WAKE_FLAG, 0);
+
+		// Hand ADC1 over to the ULP
+		adc1_config_width(ADC_WIDTH_BIT_12);
+		adc1_config_channel_atten((adc1_channel_t)digitalPinToAnalogChannel(PIN_ADC_BAT), ADC_ATTEN_DB_11);
+		adc1_config_channel_atten((adc1_channel_t)digitalPinToAnalogChannel(PIN_ADC_SOLAR), ADC_ATTEN_DB_11);
+		adc1_ulp_enable();
+
+		ulp_set_wakeup_period(0, (uint32_t)ENERGY_MONITOR_PERIOD_MS * 1000);
+
+		if(mode != WAKE_NONE)
+			esp_sleep_enable_ulp_wakeup();
+
+		if(ulp_run(0) != ESP_OK)
+		{
+			debug_println_e(F("Could not start energy monitor ULP program."));
+			return RET_ERROR;
+		}
+
+		_armed = true;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Stop sampling after waking up
+	 * @return True if woken up by the ULP (battery crossed threshold)
+	 *****************************************************************************/
+	bool check_wakeup()
+	{
+		if(!_armed)
+			return false;
+
+		_armed = false;
+
+		// Stop ULP timer and let a running program finish
+		CLEAR_PERI_REG_MASK(RTC_CNTL_STATE0_REG, RTC_CNTL_ULP_CP_SLP_TIMER_EN);
+		delay(ENERGY_MONITOR_STOP_WAIT_MS);
+
+		esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ULP);
+
+		// Give ADC1 back to software control (as set by analogRead init)
+		SET_PERI_REG_MASK(SENS_SAR_READ_CTRL_REG, SENS_SAR1_DATA_INV);
+		SET_PERI_REG_MASK(SENS_SAR_MEAS_START1_REG, SENS_MEAS1_START_FORCE_M);
+		SET_PERI_REG_MASK(SENS_SAR_MEAS_START1_REG, SENS_SAR1_EN_PAD_FORCE_M);
+
+		return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_ULP;
+	}
+
+	/******************************************************************************
+	 * Log aggregates accumulated since last drain and reset them
+	 *****************************************************************************/
+	RetResult drain()
+	{
+		if(!_initialized || _armed)
+			return RET_ERROR;
+
+		uint32_t count = get_var(VAR_COUNT);
+		if(count == 0)
+			return RET_OK;
+
+		log_channel(Log::ENERGY_MONITOR_BATTERY, PIN_ADC_BAT, VAR_BAT, count);
+		log_channel(Log::ENERGY_MONITOR_SOLAR, PIN_ADC_SOLAR, VAR_SOLAR, count);
+
+		reset_aggregates();
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Log aggregates of a channel
+	 * @param code	Log code
+	 * @param pin	Channel pin
+	 * @param var	Channel's first variable
+	 * @param count	Number of samples
+	 *****************************************************************************/
+	void log_channel(Log::Code code, uint8_t pin, int var, uint32_t count)
+	{
+		uint32_t sum = (get_var(var + CH_SUM_HI) << 16) | get_var(var + CH_SUM_LO);
+
+		// 1/2 dividers
+		uint32_t min_mv = Adc::raw_to_mv(pin, get_var(var + CH_MIN)) * 2;
+		uint32_t max_mv = Adc::raw_to_mv(pin, get_var(var + CH_MAX)) * 2;
+		uint32_t avg_mv = Adc::raw_to_mv(pin, sum / count) * 2;
+
+		debug_printf("Energy monitor (%d samples): min %umV, max %umV, avg %umV\n", count, min_mv, max_mv, avg_mv);
+
+		Log::log(code, (min_mv << 16) | max_mv, (avg_mv << 16) | count);
+	}
+
+	/******************************************************************************
+	 * Reset aggregates of all channels
+	 *****************************************************************************/
+	void reset_aggregates()
+	{
+		const int channels[] = {VAR_BAT, VAR_SOLAR};
+
+		for(int i = 0; i < 2; i++)
+		{
+			set_var(channels[i] + CH_LAST, 0);
+			set_var(channels[i] + CH_MIN, 0xFFFF);
+			set_var(channels[i] + CH_MAX, 0);
+			set_var(channels[i] + CH_SUM_LO, 0);
+			set_var(channels[i] + CH_SUM_HI, 0);
+		}
+
+		set_var(VAR_COUNT, 0);
+	}
+
+	/******************************************************************************
+	 * ULP variable access
+	 *****************************************************************************/
+	uint32_t get_var(int var)
+	{
+		return RTC_SLOW_MEM[ENERGY_MONITOR_ULP_DATA_OFFSET + var] & 0xFFFF;
+	}
+
+	void set_var(int var, uint32_t val)
+	{
+		RTC_SLOW_MEM[ENERGY_MONITOR_ULP_DATA_OFFSET + var] = val;
+	}
+}
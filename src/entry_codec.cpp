@@ -0,0 +1,446 @@
+#include <math.h>
+#include <string.h>
+#include "entry_codec.h"
+#include "const.h"
+#include "common.h"
+
+namespace EntryCodec
+{
+	//
+	// Private functions
+	//
+	int64_t quantize(const Field *field, const uint8_t *entry);
+	void dequantize(const Field *field, int64_t value, uint8_t *entry);
+	bool is_timestamp(const Field *field);
+	int64_t read_timestamp(const Field *field, const uint8_t *entry);
+	void write_timestamp(const Field *field, int64_t timestamp, uint8_t *entry);
+	int64_t timestamp_unit(const Format *format);
+	int write_varint(uint8_t *out, int out_size, int64_t value);
+	int read_varint(const uint8_t *in, int in_size, int64_t *value);
+	uint32_t read_uint(const uint8_t *in, int size);
+	int32_t read_int(const uint8_t *in, int size);
+	int32_t int_min(int size);
+	int32_t int_max(int size);
+	uint32_t uint_max(int size);
+
+	/******************************************************************************
+	 * Base timestamp (seconds) of a block starting with entry, 0 if format has
+	 * no timestamp field
+	 *****************************************************************************/
+	uint32_t get_base_timestamp(const Format *format, const void *entry)
+	{
+		for(int i = 0; i < format->field_count; i++)
+		{
+			if(is_timestamp(&format->fields[i]))
+				return read_timestamp(&format->fields[i], (const uint8_t*)entry) / timestamp_unit(format);
+		}
+
+		return 0;
+	}
+
+	/******************************************************************************
+	 * Reset state for the first entry of a block
+	 *****************************************************************************/
+	void block_begin(const Format *format, uint32_t base_timestamp, BlockState *state)
+	{
+		memset(state, 0, sizeof(BlockState));
+
+		state->timestamp = (int64_t)base_timestamp * timestamp_unit(format);
+	}
+
+	/******************************************************************************
+	 * Encode entry as varints, delta-of-delta of timestamp and delta of values
+	 * from the previous entry of the block
+	 * Values out of range of their field size are saturated
+	 * @param format	Entry format
+	 * @param state		Block state, updated only when entry is encoded
+	 * @param entry		Entry struct
+	 * @param out		Output buffer
+	 * @param out_size	Space left in output buffer
+	 * @return Bytes written, -1 if entry does not fit
+	 *****************************************************************************/
+	int block_encode(const Format *format, BlockState *state, const void *entry, uint8_t *out, int out_size)
+	{
+		const uint8_t *src = (const uint8_t*)entry;
+		BlockState next = *state;
+		int size = 0;
+
+		if(format->field_count > ENTRY_CODEC_MAX_FIELDS)
+			return -1;
+
+		for(int i = 0; i < format->field_count; i++)
+		{
+			const Field *field = &format->fields[i];
+			int64_t delta = 0;
+
+			if(is_timestamp(field))
+			{
+				// Entries logged at a fixed interval encode to 0
+				int64_t timestamp = read_timestamp(field, src);
+				int64_t timestamp_delta = timestamp - next.timestamp;
+
+				delta = timestamp_delta - next.timestamp_delta;
+
+				next.timestamp = timestamp;
+				next.timestamp_delta = timestamp_delta;
+			}
+			else
+			{
+				int64_t value = quantize(field, src);
+
+				delta = value - next.values[i];
+				next.values[i] = value;
+			}
+
+			int written = write_varint(out + size, out_size - size, delta);
+			if(written < 0)
+				return -1;
+
+			size += written;
+		}
+
+		*state = next;
+
+		return size;
+	}
+
+	/******************************************************************************
+	 * Decode next entry of a block
+	 * @param format	Entry format
+	 * @param state		Block state
+	 * @param in		Encoded entry
+	 * @param in_size	Bytes left in block
+	 * @param entry		Output entry struct, fields not in format are left as is
+	 * @return Bytes read, -1 if block data is truncated
+	 *****************************************************************************/
+	int block_decode(const Format *format, BlockState *state, const uint8_t *in, int in_size, void *entry)
+	{
+		uint8_t *dst = (uint8_t*)entry;
+		int size = 0;
+
+		if(format->field_count > ENTRY_CODEC_MAX_FIELDS)
+			return -1;
+
+		for(int i = 0; i < format->field_count; i++)
+		{
+			const Field *field = &format->fields[i];
+			int64_t delta = 0;
+
+			int read = read_varint(in + size, in_size - size, &delta);
+			if(read < 0)
+				return -1;
+
+			size += read;
+
+			if(is_timestamp(field))
+			{
+				state->timestamp_delta += delta;
+				state->timestamp += state->timestamp_delta;
+
+				write_timestamp(field, state->timestamp, dst);
+			}
+			else
+			{
+				state->values[i] += delta;
+
+				dequantize(field, state->values[i], dst);
+			}
+		}
+
+		return size;
+	}
+
+	/******************************************************************************
+	 * Size of an entry in a record file
+	 *****************************************************************************/
+	int record_size(const Format *format)
+	{
+		int size = 0;
+
+		for(int i = 0; i < format->field_count; i++)
+			size += format->fields[i].size;
+
+		return size;
+	}
+
+	/******************************************************************************
+	 * Decode entry of a record file
+	 * @param format			Entry format
+	 * @param in				Encoded entry
+	 * @param base_timestamp	Base timestamp of the file entry was read from
+	 * @param entry				Output entry struct, fields not in format are left as is
+	 *****************************************************************************/
+	void record_decode(const Format *format, const uint8_t *in, uint32_t base_timestamp, void *entry)
+	{
+		uint8_t *dst = (uint8_t*)entry;
+
+		for(int i = 0; i < format->field_count; i++)
+		{
+			const Field *field = &format->fields[i];
+
+			switch(field->type)
+			{
+				case FIELD_TIMESTAMP:
+					write_timestamp(field, base_timestamp + (uint32_t)read_int(in, field->size), dst);
+					break;
+				case FIELD_FLOAT:
+					dequantize(field, read_int(in, field->size), dst);
+					break;
+				case FIELD_UINT8:
+				case FIELD_UINT16:
+				case FIELD_UINT32:
+					dequantize(field, read_uint(in, field->size), dst);
+					break;
+				default:
+					break;
+			}
+
+			in += field->size;
+		}
+	}
+
+	/******************************************************************************
+	 * Read file header from the start of a file
+	 * @return RET_ERROR if file has no header (eg. written before formats were
+	 * used)
+	 *****************************************************************************/
+	RetResult read_header(File &f, FileHeader *header)
+	{
+		if(!f.seek(0) || f.read((uint8_t*)header, sizeof(FileHeader)) != sizeof(FileHeader))
+			return RET_ERROR;
+
+		if(header->magic != ENTRY_CODEC_BLOCK_FILE_MAGIC && header->magic != ENTRY_CODEC_RECORD_FILE_MAGIC)
+			return RET_ERROR;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Write block file header, must be the first thing written to a file
+	 *****************************************************************************/
+	RetResult write_header(File &f, const Format *format)
+	{
+		FileHeader header = {0};
+		header.magic = ENTRY_CODEC_BLOCK_FILE_MAGIC;
+		header.version = format->version;
+
+		if(f.write((uint8_t*)&header, sizeof(header)) != sizeof(header))
+			return RET_ERROR;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Field value to integer
+	 *****************************************************************************/
+	int64_t quantize(const Field *field, const uint8_t *entry)
+	{
+		const uint8_t *src = entry + field->offset;
+
+		if(field->type == FIELD_FLOAT)
+		{
+			float value = 0;
+			memcpy(&value, src, sizeof(value));
+
+			// Lowest value is reserved for NAN
+			if(isnan(value))
+				return int_min(field->size);
+
+			float scaled = roundf(value * field->scale);
+
+			if(scaled <= (float)int_min(field->size))
+				return int_min(field->size) + 1;
+			else if(scaled >= (float)int_max(field->size))
+				return int_max(field->size);
+
+			return (int32_t)scaled;
+		}
+
+		uint32_t value = 0;
+
+		if(field->type == FIELD_UINT8)
+			value = src[0];
+		else if(field->type == FIELD_UINT16)
+			value = read_uint(src, 2);
+		else
+			value = read_uint(src, 4);
+
+		if(value > uint_max(field->size))
+			value = uint_max(field->size);
+
+		return value;
+	}
+
+	/******************************************************************************
+	 * Integer back to field value
+	 *****************************************************************************/
+	void dequantize(const Field *field, int64_t value, uint8_t *entry)
+	{
+		uint8_t *dst = entry + field->offset;
+
+		switch(field->type)
+		{
+			case FIELD_FLOAT:
+			{
+				float decoded = value == int_min(field->size) ? NAN : value / field->scale;
+				memcpy(dst, &decoded, sizeof(decoded));
+				break;
+			}
+			case FIELD_UINT8:
+				dst[0] = (uint8_t)value;
+				break;
+			case FIELD_UINT16:
+			{
+				uint16_t decoded = (uint16_t)value;
+				memcpy(dst, &decoded, sizeof(decoded));
+				break;
+			}
+			case FIELD_UINT32:
+			{
+				uint32_t decoded = (uint32_t)value;
+				memcpy(dst, &decoded, sizeof(decoded));
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	/******************************************************************************
+	 * Timestamp fields, in the unit of the field
+	 *****************************************************************************/
+	bool is_timestamp(const Field *field)
+	{
+		return field->type == FIELD_TIMESTAMP || field->type == FIELD_TIMESTAMP_MS;
+	}
+
+	int64_t read_timestamp(const Field *field, const uint8_t *entry)
+	{
+		if(field->type == FIELD_TIMESTAMP_MS)
+		{
+			uint64_t timestamp = 0;
+			memcpy(&timestamp, entry + field->offset, sizeof(timestamp));
+			return (int64_t)timestamp;
+		}
+
+		uint32_t timestamp = 0;
+		memcpy(&timestamp, entry + field->offset, sizeof(timestamp));
+		return timestamp;
+	}
+
+	void write_timestamp(const Field *field, int64_t timestamp, uint8_t *entry)
+	{
+		if(field->type == FIELD_TIMESTAMP_MS)
+		{
+			uint64_t value = (uint64_t)timestamp;
+			memcpy(entry + field->offset, &value, sizeof(value));
+		}
+		else
+		{
+			uint32_t value = (uint32_t)timestamp;
+			memcpy(entry + field->offset, &value, sizeof(value));
+		}
+	}
+
+	/******************************************************************************
+	 * Timestamp units per second
+	 *****************************************************************************/
+	int64_t timestamp_unit(const Format *format)
+	{
+		for(int i = 0; i < format->field_count; i++)
+		{
+			if(format->fields[i].type == FIELD_TIMESTAMP_MS)
+				return 1000;
+		}
+
+		return 1;
+	}
+
+	/******************************************************************************
+	 * Zigzag LEB128 varint, values close to 0 of either sign take a single byte
+	 * @return Bytes written, -1 if out of space
+	 *****************************************************************************/
+	int write_varint(uint8_t *out, int out_size, int64_t value)
+	{
+		uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+		int size = 0;
+
+		do
+		{
+			if(size >= out_size)
+				return -1;
+
+			uint8_t byte = zigzag & 0x7F;
+			zigzag >>= 7;
+
+			out[size++] = zigzag ? (byte | 0x80) : byte;
+		}while(zigzag);
+
+		return size;
+	}
+
+	/******************************************************************************
+	 * @return Bytes read, -1 if varint is truncated or too long
+	 *****************************************************************************/
+	int read_varint(const uint8_t *in, int in_size, int64_t *value)
+	{
+		uint64_t zigzag = 0;
+		int size = 0;
+
+		while(true)
+		{
+			if(size >= in_size || size >= 10)
+				return -1;
+
+			uint8_t byte = in[size];
+			zigzag |= (uint64_t)(byte & 0x7F) << (7 * size);
+			size++;
+
+			if(!(byte & 0x80))
+				break;
+		}
+
+		*value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+
+		return size;
+	}
+
+	/******************************************************************************
+	 * Little endian integer of 1-4 bytes
+	 *****************************************************************************/
+	uint32_t read_uint(const uint8_t *in, int size)
+	{
+		uint32_t value = 0;
+
+		for(int i = 0; i < size; i++)
+			value |= (uint32_t)in[i] << (8 * i);
+
+		return value;
+	}
+
+	int32_t read_int(const uint8_t *in, int size)
+	{
+		uint32_t value = read_uint(in, size);
+
+		// Sign extend
+		if(size < 4 && (value & (1UL << (8 * size - 1))))
+			value |= 0xFFFFFFFF << (8 * size);
+
+		return (int32_t)value;
+	}
+
+	int32_t int_min(int size)
+	{
+		return size >= 4 ? INT32_MIN : -(1L << (8 * size - 1));
+	}
+
+	int32_t int_max(int size)
+	{
+		return size >= 4 ? INT32_MAX : (1L << (8 * size - 1)) - 1;
+	}
+
+	uint32_t uint_max(int size)
+	{
+		return size >= 4 ? UINT32_MAX : (1UL << (8 * size)) - 1;
+	}
+}
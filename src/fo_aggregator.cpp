@@ -0,0 +1,194 @@
+#include <math.h>
+#include "fo_aggregator.h"
+#include "utils.h"
+
+/******************************************************************************
+* Add value to running statistics
+* @param val    New value
+* @param count  Number of values including the new one
+******************************************************************************/
+void FoAggregator::Stat::add(float val, int count)
+{
+    total += val;
+
+    float delta = val - mean;
+    mean += delta / count;
+    m2 += delta * (val - mean);
+
+    if(count == 1 || val < min)
+        min = val;
+    if(count == 1 || val > max)
+        max = val;
+}
+
+/******************************************************************************
+* Population variance of added values
+******************************************************************************/
+float FoAggregator::Stat::variance(int count) const
+{
+    if(count < 1)
+        return 0;
+
+    return m2 / count;
+}
+
+/******************************************************************************
+* Reset aggregator
+******************************************************************************/
+void FoAggregator::clear()
+{
+    *this = FoAggregator();
+}
+
+/******************************************************************************
+* Add packet to aggregates
+* @param packet Decoded packet
+* @param tstamp Time packet was received
+******************************************************************************/
+void FoAggregator::add(const FoDecodedPacket *packet, uint32_t tstamp)
+{
+    _count++;
+
+    _temp.add(packet->temp, _count);
+    _wind_speed.add(packet->wind_speed, _count);
+    _wind_gust.add(packet->wind_gust, _count);
+
+    _hum_total += packet->hum;
+    _uv_total += packet->uv;
+    _uv_index_total += packet->uv_index;
+    _light_total += packet->light;
+    _solar_radiation_total += packet->solar_radiation;
+
+    _wind_dir_sin_total += sin(Utils::deg_to_rad(packet->wind_dir));
+    _wind_dir_cos_total += cos(Utils::deg_to_rad(packet->wind_dir));
+
+    if(_count == 1)
+    {
+        _first_rain = packet->rain;
+        _first_tstamp = tstamp;
+    }
+    _last_rain = packet->rain;
+
+    // Rain counter slope
+    float t = (float)(tstamp - _first_tstamp) / 60;
+    float r = packet->rain - _first_rain;
+
+    _rain_t_total += t;
+    _rain_r_total += r;
+    _rain_tt_total += t * t;
+    _rain_tr_total += t * r;
+}
+
+/******************************************************************************
+* Fill store entry with aggregated values. Timestamp and rain rate depend on
+* packet times and are left to the caller.
+******************************************************************************/
+RetResult FoAggregator::fill_entry(FoData::StoreEntry *entry) const
+{
+    if(_count < 1)
+        return RET_ERROR;
+
+    // Calc wind dir avg
+    float wind_dir_avg = atan2(_wind_dir_sin_total / _count, _wind_dir_cos_total / _count);
+
+    wind_dir_avg = Utils::rad_to_deg(wind_dir_avg);
+    if(wind_dir_avg < 0)
+        wind_dir_avg += 360;
+
+    entry->packets = _count;
+
+    entry->temp = (float)_temp.total / _count;
+    entry->hum = (float)_hum_total / _count;
+    entry->wind_dir = (uint16_t)wind_dir_avg;
+    entry->wind_speed = (float)_wind_speed.total / _count;
+    entry->wind_gust = (float)_wind_gust.total / _count;
+    entry->uv = _uv_total / _count;
+    entry->uv_index = _uv_index_total / _count;
+    entry->light = _light_total / _count;
+    entry->solar_radiation = _solar_radiation_total / _count;
+    entry->rain = _last_rain;
+
+    entry->temp_min = _temp.min;
+    entry->temp_max = _temp.max;
+    entry->wind_gust_max = _wind_gust.max;
+    entry->wind_speed_std_dev = sqrt(_wind_speed.variance(_count));
+    entry->wind_dir_std_dev = (uint16_t)(get_wind_dir_std_dev() + 0.5);
+    entry->rain_intensity = get_rain_intensity();
+
+    return RET_OK;
+}
+
+/******************************************************************************
+* Rain intensity (mm/h), calculated from the least squares slope of the rain
+* counter over time. 0 when not enough data or counter was reset.
+******************************************************************************/
+float FoAggregator::get_rain_intensity() const
+{
+    if(_count < 2)
+        return 0;
+
+    float denom = _count * _rain_tt_total - _rain_t_total * _rain_t_total;
+    if(denom <= 0)
+        return 0;
+
+    float slope_min = (_count * _rain_tr_total - _rain_t_total * _rain_r_total) / denom;
+
+    // Counter reset (eg. battery change) results in negative slope
+    if(slope_min < 0)
+        return 0;
+
+    return slope_min * 60;
+}
+
+/******************************************************************************
+* Wind direction standard deviation (deg), Yamartino method
+******************************************************************************/
+float FoAggregator::get_wind_dir_std_dev() const
+{
+    if(_count < 1)
+        return 0;
+
+    float s = _wind_dir_sin_total / _count;
+    float c = _wind_dir_cos_total / _count;
+
+    float e2 = 1 - (s * s + c * c);
+    if(e2 <= 0)
+        return 0;
+
+    float e = sqrt(e2);
+
+    return Utils::rad_to_deg(asin(e) * (1 + 0.1547 * e * e * e));
+}
+
+/******************************************************************************
+* Getters
+******************************************************************************/
+int FoAggregator::get_count() const
+{
+    return _count;
+}
+
+float FoAggregator::get_first_rain() const
+{
+    return _first_rain;
+}
+
+float FoAggregator::get_last_rain() const
+{
+    return _last_rain;
+}
+
+const FoAggregator::Stat* FoAggregator::get_temp() const
+{
+    return &_temp;
+}
+
+const FoAggregator::Stat* FoAggregator::get_wind_speed() const
+{
+    return &_wind_speed;
+}
+
+const FoAggregator::Stat* FoAggregator::get_wind_gust() const
+{
+    return &_wind_gust;
+}
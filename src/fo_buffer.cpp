@@ -3,119 +3,112 @@
 #include "rtc.h"
 #include "fo_data.h"
 
+/** Length of each aggregation window */
+const int FO_BUFFER_WINDOW_SEC[FoData::WINDOW_COUNT] = {
+    [FoData::WINDOW_DEFAULT] = FO_AGGREGATE_INTERVAL_SEC,
+    [FoData::WINDOW_HOURLY] = FO_AGGREGATE_HOURLY_INTERVAL_SEC
+};
+
 /******************************************************************************
-* Add packet to buffer
+* Add packet received now to all aggregation windows
 ******************************************************************************/
 RetResult FoBuffer::add_packet(FoDecodedPacket *packet)
 {
-    // Buffer full, ignore
-    if(_packet_count >= FO_BUFFER_SIZE)
-        return RET_ERROR;
-
-    // If first packet, store current time. Aggregate packet timestamp is tstamp
-    // of the first packet
-    if(_packet_count == 0)
-        _first_packet_tstamp = RTC::get_timestamp();
-    _last_packet_tstamp = RTC::get_timestamp();
+    return add_packet(packet, RTC::get_timestamp());
+}
 
-    memcpy(&_buffer[_packet_count], packet, sizeof(FoDecodedPacket));
+/******************************************************************************
+* Add packet to all aggregation windows
+* Windows are aligned to clock time. When a packet belongs to a different window
+* than the packets already aggregated, aggregated packets are commited first.
+* @param packet Decoded packet
+* @param tstamp Time packet was received
+******************************************************************************/
+RetResult FoBuffer::add_packet(FoDecodedPacket *packet, uint32_t tstamp)
+{
+    for(int i = 0; i < FoData::WINDOW_COUNT; i++)
+    {
+        Window *window = &_windows[i];
+        int window_sec = FO_BUFFER_WINDOW_SEC[i];
+
+        if(window->aggregator.get_count() > 0 && tstamp / window_sec != window->first_packet_tstamp / window_sec)
+        {
+            debug_print(tstamp - window->first_packet_tstamp, DEC);
+            debug_println(" seconds passed since first packet, window ended, commiting FoSniffer buffer.");
+            commit_window((FoData::Window)i);
+        }
+
+        // If first packet, store current time. Aggregate packet timestamp is tstamp
+        // of the first packet
+        if(window->aggregator.get_count() == 0)
+            window->first_packet_tstamp = tstamp;
+        window->last_packet_tstamp = tstamp;
+
+        window->aggregator.add(packet, tstamp);
+    }
 
-    _packet_count++;
+    return RET_OK;
+}
 
-    // Commit automatically if X seconds passed from last packet
-    int sec_since_last_commit = RTC::get_timestamp() - _first_packet_tstamp;
-    if(sec_since_last_commit >= FO_AGGREGATE_INTERVAL_SEC)
+/******************************************************************************
+* Clear all windows
+******************************************************************************/
+void FoBuffer::clear()
+{
+    for(int i = 0; i < FoData::WINDOW_COUNT; i++)
     {
-        debug_print(sec_since_last_commit, DEC);
-        debug_println(" seconds passed since last commit, commiting FoSniffer buffer.");
-        commit_buffer();
+        _windows[i].first_packet_tstamp = 0;
+        _windows[i].aggregator.clear();
     }
 }
 
 /******************************************************************************
-* Clear buffer
+* Set station packets come from
+* @param station    Index of station in sniffer's station table
+* @param station_id Weather station address
 ******************************************************************************/
-void FoBuffer::clear()
+void FoBuffer::set_station(uint8_t station, uint8_t station_id)
 {
-    _first_packet_tstamp = 0;
-    _packet_count = 0;
+    _station = station;
+    _station_id = station_id;
 }
 
 /******************************************************************************
-* Save buffer to the file system
-* After aggregate calcs whole buffer results in a single entry in the filesystem
+* Save default window to the file system (eg. before submitting data)
+* Longer windows are left to complete so they always cover their whole period
 ******************************************************************************/
 RetResult FoBuffer::commit_buffer()
 {
-    // Nothing to commit
-    if(_packet_count < 1)
-        return RET_OK;
-
-    //
-    // Aggregate data
-    //
-
-    // Totals of params to calc averages
-    float hum_total = 0, temp_total = 0;
-    float wind_speed_total = 0, wind_gust_total = 0;
-    float solar_radiation_total = 0;
-    uint32_t uv_total = 0, uv_index_total = 0, light_total = 0;
-
-    // Total of sin/cos of wind dir, used to calculate mean angle
-    float wind_dir_sin_total = 0, wind_dir_cos_total = 0;
-
-    for(int i = 0; i < _packet_count; i++)
-    {
-        FoDecodedPacket *cur_packet = &_buffer[i];
-
-        temp_total += cur_packet->temp;
-        hum_total += cur_packet->hum;
-        wind_speed_total += cur_packet->wind_speed;
-        wind_gust_total += cur_packet->wind_gust;
-        uv_total += cur_packet->uv;
-        uv_index_total += cur_packet->uv_index;
-        light_total += cur_packet->light;
-        solar_radiation_total += cur_packet->solar_radiation;
-
-        wind_dir_sin_total += sin(Utils::deg_to_rad(cur_packet->wind_dir));
-        wind_dir_cos_total += cos(Utils::deg_to_rad(cur_packet->wind_dir));
-    }
-
-    // Calc wind dir avg
-    float wind_dir_avg = atan2(wind_dir_sin_total / _packet_count, wind_dir_cos_total / _packet_count);
+    return commit_window(FoData::WINDOW_DEFAULT);
+}
 
-    wind_dir_avg = Utils::rad_to_deg(wind_dir_avg);
-    if(wind_dir_avg < 0)
-        wind_dir_avg += 360;
+/******************************************************************************
+* Save window to the file system
+* Aggregated packets result in a single entry in the window's store
+******************************************************************************/
+RetResult FoBuffer::commit_window(FoData::Window window_id)
+{
+    Window *window = &_windows[window_id];
 
-    //
-    // Calc hourly rate from previous commit
-    //
+    // Nothing to commit
+    if(window->aggregator.get_count() < 1)
+        return RET_OK;
 
     //
     // Build data store entry
     //
     FoData::StoreEntry entry = {0};
     
-    entry.timestamp = _first_packet_tstamp;
-    entry.packets = _packet_count;
-
-    entry.temp = (float)temp_total / _packet_count;
-    entry.hum = (float)hum_total / _packet_count;
-    entry.wind_dir = (uint16_t)wind_dir_avg;
-    entry.wind_speed = (float)wind_speed_total / _packet_count;
-    entry.wind_gust = (float)wind_gust_total / _packet_count;
-    entry.uv = uv_total / _packet_count;
-    entry.uv_index = uv_index_total / _packet_count;
-    entry.light = light_total / _packet_count;
-    entry.solar_radiation = solar_radiation_total / _packet_count;
-    entry.rain = _buffer[_packet_count - 1].rain;
+    entry.timestamp = window->first_packet_tstamp;
+    entry.station = _station;
+    entry.station_id = _station_id;
+    window->aggregator.fill_entry(&entry);
 
     // Calc hourly rate from previous commit
-    if(_last_packet_tstamp > _first_packet_tstamp)
+    if(window->last_packet_tstamp > window->first_packet_tstamp)
     {
-        uint32_t time_diff_sec = _last_packet_tstamp - _first_packet_tstamp;
-        float rain_diff = entry.rain - _buffer[0].rain;
+        uint32_t time_diff_sec = window->last_packet_tstamp - window->first_packet_tstamp;
+        float rain_diff = entry.rain - window->aggregator.get_first_rain();
         float rate_hr = (60 * 60 / time_diff_sec) * rain_diff;
         rate_hr = (int)(rate_hr * 100 + 0.5) / 100.0;
 
@@ -123,17 +116,21 @@ RetResult FoBuffer::commit_buffer()
     }
 
     // Update previous rain count
-    _prev_rain = entry.rain;
+    if(window_id == FoData::WINDOW_DEFAULT)
+        _prev_rain = entry.rain;
 
-    debug_println_i(F("Commiting FO Buffer,"));
+    debug_print_i(F("Commiting FO Buffer, window: "));
+    debug_println(window_id, DEC);
     debug_print(F("Total time (sec): "));
-    debug_println(_last_packet_tstamp - _first_packet_tstamp, DEC);
+    debug_println(window->last_packet_tstamp - window->first_packet_tstamp, DEC);
     debug_print(F("Rain rate (hr): "));
     debug_println(entry.rain_hourly, DEC);
 
-    FoData::add(&entry);
+    FoData::add(&entry, window_id);
+
+    window->first_packet_tstamp = 0;
+    window->aggregator.clear();
 
-    clear();
     return RET_OK;
 }
 
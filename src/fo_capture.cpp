@@ -0,0 +1,109 @@
+#include "fo_capture.h"
+#include "fo_sniffer.h"
+#include "data_store_reader.h"
+#include "common.h"
+
+namespace FoCapture
+{
+    /**
+     * Store of captured frames
+     */
+    DataStore<FoCapture::Entry> store(FO_CAPTURE_STORE_PATH, FO_CAPTURE_ENTRIES_PER_FILE);
+
+    /******************************************************************************
+    * Add frame to store. Not commited on every add to spare flash writes, store
+    * is commited when full or with commit_buffer()
+    * @param tstamp Time frame was received
+    * @param buff   Rx buffer, at least FO_CAPTURE_FRAME_LEN long
+    ******************************************************************************/
+    RetResult add(uint32_t tstamp, uint8_t const buff[])
+    {
+        Entry entry = {0};
+
+        entry.timestamp = tstamp;
+        memcpy(entry.frame, buff, sizeof(entry.frame));
+
+        return store.add(&entry);
+    }
+
+    /******************************************************************************
+    * Commit captured frames to flash
+    ******************************************************************************/
+    RetResult commit_buffer()
+    {
+        return store.commit();
+    }
+
+    /******************************************************************************
+    * Get pointer to store (for use with reader)
+    ******************************************************************************/
+    DataStore<FoCapture::Entry>* get_store()
+    {
+        return &store;
+    }
+
+    /******************************************************************************
+    * Replay captured frames through the same path as received ones (pre-filter,
+    * decode, buffer) as fast as possible. Frames are added to buffer with their
+    * capture time, buffer commits its windows to FoData as they end.
+    * @param store  Store with captured frames
+    * @param buffer Buffer to add decoded packets to
+    * @param stats  Replay results
+    ******************************************************************************/
+    RetResult replay(const DataStore<Entry> *store, FoBuffer *buffer, ReplayStats *stats)
+    {
+        DataStoreReader<Entry> reader(store);
+        const Entry *entry = NULL;
+        FoDecodedPacket packet = {0};
+
+        memset(stats, 0, sizeof(ReplayStats));
+
+        while(reader.next_file())
+        {
+            while((entry = reader.next_entry()))
+            {
+                if(!reader.entry_crc_valid())
+                {
+                    debug_println_e(F("Invalid CRC, skipping captured frame."));
+                    continue;
+                }
+
+                stats->frames++;
+
+                uint32_t start_us = micros();
+
+                if(!FoSniffer::prefilter_frame(entry->frame))
+                {
+                    stats->filtered++;
+                }
+                else if(FoSniffer::decode_packet(entry->frame, &packet) != RET_OK)
+                {
+                    stats->corrupt++;
+                }
+                else
+                {
+                    buffer->add_packet(&packet, entry->timestamp);
+                    stats->decoded++;
+                }
+
+                stats->elapsed_us += micros() - start_us;
+            }
+        }
+
+        debug_printf("Replayed %d frames, filtered: %d corrupt: %d decoded: %d (%u us)\n",
+            stats->frames, stats->filtered, stats->corrupt, stats->decoded, stats->elapsed_us);
+
+        return stats->frames > 0 ? RET_OK : RET_ERROR;
+    }
+
+    /******************************************************************************
+    * Print captured frame
+    ******************************************************************************/
+    void print(const Entry *data)
+    {
+        debug_print(F("Timestamp: "));
+        debug_println(data->timestamp);
+
+        Utils::print_buff_hex((uint8_t*)data->frame, sizeof(data->frame));
+    }
+} // namespace FoCapture
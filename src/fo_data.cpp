@@ -1,27 +1,81 @@
 #include "fo_data.h"
 #include "log.h"
+#include "common.h"
 
 namespace FoData
 {
+	/**
+	 * Compact on-flash encoding of store entries. Version MUST be increased when
+	 * fields change.
+	 */
+	const EntryCodec::Field FORMAT_FIELDS[] = {
+		ENTRY_FIELD_TIMESTAMP(StoreEntry, timestamp, 3),
+		ENTRY_FIELD_UINT(StoreEntry, packets, 2),
+		ENTRY_FIELD_UINT(StoreEntry, wakeups, 2),
+		ENTRY_FIELD_FLOAT(StoreEntry, temp, 2, 10),
+		ENTRY_FIELD_UINT(StoreEntry, hum, 1),
+		ENTRY_FIELD_FLOAT(StoreEntry, rain, 3, 100),
+		ENTRY_FIELD_FLOAT(StoreEntry, rain_hourly, 2, 100),
+		ENTRY_FIELD_UINT(StoreEntry, wind_dir, 2),
+		ENTRY_FIELD_FLOAT(StoreEntry, wind_speed, 2, 100),
+		ENTRY_FIELD_FLOAT(StoreEntry, wind_gust, 2, 100),
+		ENTRY_FIELD_UINT(StoreEntry, uv, 2),
+		ENTRY_FIELD_UINT(StoreEntry, uv_index, 1),
+		ENTRY_FIELD_UINT(StoreEntry, light, 3),
+		ENTRY_FIELD_UINT(StoreEntry, solar_radiation, 3),
+		ENTRY_FIELD_FLOAT(StoreEntry, temp_min, 2, 10),
+		ENTRY_FIELD_FLOAT(StoreEntry, temp_max, 2, 10),
+		ENTRY_FIELD_FLOAT(StoreEntry, wind_gust_max, 2, 100),
+		ENTRY_FIELD_FLOAT(StoreEntry, wind_speed_std_dev, 2, 100),
+		ENTRY_FIELD_UINT(StoreEntry, wind_dir_std_dev, 2),
+		ENTRY_FIELD_FLOAT(StoreEntry, rain_intensity, 2, 100),
+		ENTRY_FIELD_UINT(StoreEntry, station, 1),
+		ENTRY_FIELD_UINT(StoreEntry, station_id, 1)
+	};
+
+	const EntryCodec::Format FORMAT = {1, FORMAT_FIELDS, sizeof(FORMAT_FIELDS) / sizeof(FORMAT_FIELDS[0])};
+
 	/**
 	 * Private vars
 	 */
-	DataStore<StoreEntry> store(FO_DATA_STORE_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ);
+	DataStore<StoreEntry> store(FO_DATA_STORE_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, &FORMAT);
+
+	/** Store of hourly aggregates */
+	DataStore<StoreEntry> store_hourly(FO_DATA_HOURLY_STORE_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ, &FORMAT);
+
+    /** Stores entries of each window are added to. Can be redirected (eg. when
+     * replaying captures) */
+    DataStore<StoreEntry> *_stores[WINDOW_COUNT] = {
+        [WINDOW_DEFAULT] = &store,
+        [WINDOW_HOURLY] = &store_hourly
+    };
 
     /** FO wakeup count */
     int _wakeup_count = 0;
 
     /******************************************************************************
     * Add entry to store
+    * @param data   Entry
+    * @param window Aggregation window entry belongs to
     ******************************************************************************/
-    RetResult add(FoData::StoreEntry *data)
+    RetResult add(FoData::StoreEntry *data, Window window)
     {
+        // Hourly entries only roll up default window data, wake up count belongs
+        // to default window entries
+        if(window == WINDOW_HOURLY)
+        {
+            RetResult ret = _stores[WINDOW_HOURLY]->add(data);
+            _stores[WINDOW_HOURLY]->commit();
+
+            return ret;
+        }
+
         data->wakeups = _wakeup_count;
 
-		RetResult ret = store.add(data);
+		RetResult ret = _stores[WINDOW_DEFAULT]->add(data);
 
 		// Commit on every add
-		store.commit();
+		_stores[WINDOW_DEFAULT]->commit();
 
         Log::log(Log::FO_WAKEUPS, _wakeup_count);
 
@@ -31,11 +85,26 @@ namespace FoData
     }   
 
     /******************************************************************************
-    * Get pointer to store (for use with reader)
+    * Get pointer to store of window (for use with reader), follows set_store()
     ******************************************************************************/
-    DataStore<StoreEntry>* get_store()
+    DataStore<StoreEntry>* get_store(Window window)
     {
-        return &store;
+        if(window < 0 || window >= WINDOW_COUNT)
+            return NULL;
+
+        return _stores[window];
+    }
+
+    /******************************************************************************
+    * Redirect entries of window to another store
+    * @param target Store to add entries to, NULL to restore default store
+    ******************************************************************************/
+    void set_store(Window window, DataStore<StoreEntry> *target)
+    {
+        if(target == NULL)
+            target = (window == WINDOW_HOURLY) ? &store_hourly : &store;
+
+        _stores[window] = target;
     }
 
     /******************************************************************************
@@ -54,7 +123,16 @@ namespace FoData
 	{
 		Utils::print_separator(F("FO Data"));
 
-        Serial.println(F("FO data print not implemented"));
+        debug_printf("Timestamp: %u - Packets: %d\n", data->timestamp, data->packets);
+        debug_printf("Station: %d (ID: %02x)\n", data->station, data->station_id);
+        debug_printf("Temperature: %.1f (min: %.1f max: %.1f)\n", data->temp, data->temp_min, data->temp_max);
+        debug_printf("Humidity: %d\n", data->hum);
+        debug_printf("Rain: %.2f - Hourly: %.2f - Intensity: %.2f\n", data->rain, data->rain_hourly, data->rain_intensity);
+        debug_printf("Wind dir: %d (std dev: %d)\n", data->wind_dir, data->wind_dir_std_dev);
+        debug_printf("Wind speed: %.2f (std dev: %.2f)\n", data->wind_speed, data->wind_speed_std_dev);
+        debug_printf("Wind gust: %.2f (max: %.2f)\n", data->wind_gust, data->wind_gust_max);
+        debug_printf("UV: %u - UV index: %u\n", data->uv, data->uv_index);
+        debug_printf("Light: %u - Solar radiation: %u\n", data->light, data->solar_radiation);
 
 		Utils::print_separator(NULL);
 	}
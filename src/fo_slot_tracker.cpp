@@ -0,0 +1,151 @@
+#include <math.h>
+#include "fo_slot_tracker.h"
+#include "common.h"
+
+/******************************************************************************
+* Reset tracker, next packet becomes the new anchor
+******************************************************************************/
+void FoSlotTracker::reset()
+{
+    *this = FoSlotTracker();
+}
+
+/******************************************************************************
+* Add packet arrival time
+* Error between arrival and predicted arrival corrects the period estimate
+* (spread over the slots elapsed since the anchor) and the jitter estimate.
+* Window shrinks towards the jitter estimate, at most by half per packet.
+* @param rx_ms Time packet was received (millis)
+******************************************************************************/
+void FoSlotTracker::add(uint32_t rx_ms)
+{
+    uint32_t elapsed_ms = rx_ms - _anchor_ms;
+    int slots = (int)((float)elapsed_ms / _period_ms + 0.5);
+
+    // First packet or anchor too old for the period estimate to be of any use
+    if(!_anchored || slots > FO_SNIFFER_SLOT_MAX_TRACK_SLOTS)
+    {
+        _anchor_ms = rx_ms;
+        _anchored = true;
+        _misses = 0;
+        return;
+    }
+
+    // Same slot as the anchor (duplicate), nothing to learn
+    if(slots < 1)
+        return;
+
+    float err_ms = (float)elapsed_ms - slots * _period_ms;
+
+    // Correct period, clamped to the max crystal drift of the station
+    float nominal_ms = FO_SNIFFER_PACKET_INTERVAL_SEC * 1000;
+    float max_dev_ms = nominal_ms * FO_SNIFFER_SLOT_MAX_DRIFT_PPM / 1000000;
+
+    _period_ms += FO_SNIFFER_SLOT_PERIOD_GAIN * err_ms / slots;
+
+    if(_period_ms > nominal_ms + max_dev_ms)
+        _period_ms = nominal_ms + max_dev_ms;
+    else if(_period_ms < nominal_ms - max_dev_ms)
+        _period_ms = nominal_ms - max_dev_ms;
+
+    _jitter_ms += FO_SNIFFER_SLOT_JITTER_GAIN * (fabs(err_ms) - _jitter_ms);
+
+    // Narrow window
+    uint32_t window_ms = FO_SNIFFER_SLOT_WINDOW_MIN_MS + FO_SNIFFER_SLOT_JITTER_MULT * _jitter_ms;
+
+    if(window_ms < _window_ms / 2)
+        window_ms = _window_ms / 2;
+
+    if(window_ms < FO_SNIFFER_SLOT_WINDOW_MIN_MS)
+        window_ms = FO_SNIFFER_SLOT_WINDOW_MIN_MS;
+    else if(window_ms > FO_SNIFFER_SLOT_WINDOW_MAX_MS)
+        window_ms = FO_SNIFFER_SLOT_WINDOW_MAX_MS;
+
+    _window_ms = window_ms;
+
+    // Move anchor towards arrival time instead of onto it, so jitter of single
+    // packets is smoothed out of the phase
+    _anchor_ms += (uint32_t)(slots * _period_ms + FO_SNIFFER_SLOT_PHASE_GAIN * err_ms + 0.5);
+    _misses = 0;
+}
+
+/******************************************************************************
+* Packet not received within its window, widen window
+******************************************************************************/
+void FoSlotTracker::miss()
+{
+    _window_ms *= 2;
+
+    if(_window_ms > FO_SNIFFER_SLOT_WINDOW_MAX_MS)
+        _window_ms = FO_SNIFFER_SLOT_WINDOW_MAX_MS;
+
+    if(_misses < 0xFF)
+        _misses++;
+}
+
+/******************************************************************************
+* Listen window of the next packet that can still be received
+* Window is centered on the predicted arrival time and grows with every slot
+* skipped since the anchor, to allow for the error of the period estimate.
+* @param now_ms     Current time (millis)
+* @param open_ms    Time window opens (millis), may be in the past
+* @param len_ms     Window length
+******************************************************************************/
+void FoSlotTracker::get_next_window(uint32_t now_ms, uint32_t *open_ms, uint32_t *len_ms) const
+{
+    uint32_t elapsed_ms = now_ms - _anchor_ms;
+    int slot = (int)((float)elapsed_ms / _period_ms);
+
+    if(slot < 1)
+        slot = 1;
+
+    for(;; slot++)
+    {
+        uint32_t half_ms = _window_ms / 2 + (slot - 1) * FO_SNIFFER_SLOT_DRIFT_MS;
+
+        // Windows of successive slots never overlap
+        if(half_ms > _period_ms / 2)
+            half_ms = _period_ms / 2;
+        uint32_t pred_ms = (uint32_t)(slot * _period_ms + 0.5);
+
+        // Still open (time relative to anchor so wraparound is not an issue)
+        if(pred_ms + half_ms > elapsed_ms)
+        {
+            *open_ms = _anchor_ms + pred_ms - half_ms;
+            *len_ms = half_ms * 2;
+            return;
+        }
+    }
+}
+
+/******************************************************************************
+* Getters
+******************************************************************************/
+bool FoSlotTracker::is_anchored() const
+{
+    return _anchored;
+}
+
+float FoSlotTracker::get_period_ms() const
+{
+    return _period_ms;
+}
+
+uint32_t FoSlotTracker::get_window_ms() const
+{
+    return _window_ms;
+}
+
+uint8_t FoSlotTracker::get_misses() const
+{
+    return _misses;
+}
+
+/******************************************************************************
+* Print tracker state
+******************************************************************************/
+void FoSlotTracker::print() const
+{
+    debug_printf("Slot tracker - Period: %.1fms, Jitter: %.1fms, Window: %ums, Misses: %d\n",
+        _period_ms, _jitter_ms, _window_ms, _misses);
+}
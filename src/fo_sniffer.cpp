@@ -9,19 +9,61 @@
 #include "fo_data.h"
 #include "log.h"
 #include "fo_buffer.h"
+#include "fo_capture.h"
+#include "fo_slot_tracker.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 
 namespace FoSniffer
 {
 	/**
 	 * Private functions
 	 */
-	RetResult decode_packet(uint8_t *buff, FoDecodedPacket *decoded);
-	uint8_t calc_crc(uint8_t const buff[], int len, uint8_t polynomial, uint8_t init);
-	uint8_t calc_checksum(uint8_t const buff[]);	
 	uint8_t uv_to_index(int uv);
 
-	/** Time of last valid packet */
-	uint32_t _last_packet_tstamp = 0;
+	struct Station;
+	void update_stations();
+	bool station_active(const Station *station);
+	int get_active_station_count();
+	Station* find_station(uint8_t id);
+	int calc_secs_to_packet(const Station *station, uint32_t now);
+	int listen(bool pending[], int wait_for, uint32_t timeout_ms);
+	void sleep_radio_off(uint32_t until_ms);
+	RetResult read_packet();
+	Station* store_packet(uint32_t rx_ms);
+	bool station_radio_tracked(const Station *station, uint32_t now);
+	void task(void *params);
+	void task_sniff();
+	bool task_wait_for_int(uint32_t timeout_ms);
+	void task_delay_until(uint32_t until_ms);
+	void drain_task_queue();
+	void set_address_filter();
+
+	/**
+	 * CRC8 lookup table, polynomial 0x31
+	 * Entry n is the CRC of the single byte n, so CRC is one lookup per byte
+	 * instead of 8 shift/xor steps
+	 */
+	const uint8_t CRC8_TABLE[256] = {
+		0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
+		0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4, 0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
+		0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11, 0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
+		0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
+		0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA, 0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
+		0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9, 0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
+		0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C, 0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
+		0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F, 0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
+		0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED, 0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
+		0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE, 0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
+		0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B, 0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
+		0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
+		0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0, 0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
+		0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93, 0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
+		0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
+		0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15, 0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC
+	};
 
 	/** Last received packet */
 	// TODO: Useless along with get_packet??? Never needed externall
@@ -38,24 +80,97 @@ namespace FoSniffer
 	RFM95 _rf = new Module(PIN_RF_SS, PIN_RF_DI0, 444, _spi);
 
 	/**
-	 * Sniffer currently in sync with the tx interval of the weather statopm
-	 * Considered in sync when packet received succesfully at expected time (ie. after
-	 * waiting known number of seconds from last packet)
-	*/
-	bool _in_sync = false;
+	 * State of a sniffed weather station
+	 */
+	struct Station
+	{
+		/** Weather station address, 0 when station slot is not used */
+		uint8_t id;
+
+		/**
+		 * Sniffer currently in sync with the tx interval of the station
+		 * Considered in sync when packet received succesfully at expected time (ie. after
+		 * waiting known number of seconds from last packet)
+		 */
+		bool in_sync;
+
+		/** Number of successive failures to sniff station */
+		uint8_t rx_failures;
 
-	/** 
-	 * Number of successive failures to sniff weather station
-	 */ 
-	uint8_t _rx_failures = 0;
+		/** Station not sniffed anymore because of rx failures. Cleared when all
+		 * stations failed (FO is disabled) or station id changes */
+		bool disabled;
+
+		/** Time of last valid packet. Station tx phase is derived from it */
+		uint32_t last_packet_tstamp;
+
+		/** Tracks tx slot of the station, listen windows are predicted from it */
+		FoSlotTracker tracker;
+
+		/** Aggregates packets of the station */
+		FoBuffer buffer;
+	};
+
+	/** Sniffed stations, indexes match station ids in device config */
+	Station _stations[FO_SNIFFER_MAX_STATIONS];
+
+	/** Address the RF module filters packets by, 0 when filtering is disabled
+	 * (multiple stations) */
+	uint8_t _filter_address = 0;
 
 	/**
 	 * Tstamp of last sync attempt. 
 	 */
 	uint32_t _last_sync_tstamp = 0;
 
-	/** Holds last X decoded packets */
-	FoBuffer _packet_buff;
+	/** Time last packet was received (millis), taken as soon as RX INT fires */
+	uint32_t _last_packet_rx_ms = 0;
+
+	/** Time the RF module was receiving since duty cycle start (ms) */
+	uint32_t _radio_on_ms = 0;
+
+	/** Start of current duty cycle measurement (millis) */
+	uint32_t _duty_cycle_start_ms = 0;
+
+	/** RF module left receiving while sleeping, device wakes up on its INT */
+	bool _radio_wakeup_armed = false;
+
+	/** Time radio wake up was armed (millis) */
+	uint32_t _radio_wakeup_armed_ms = 0;
+
+	/** Device woke up on radio INT, packet waits in RF module to be read */
+	bool _radio_packet_pending = false;
+
+	/**
+	 * Packet received by the background task, queued for the main task
+	 */
+	struct TaskPacket
+	{
+		uint8_t station;
+		uint32_t tstamp;
+		FoDecodedPacket packet;
+	};
+
+	/** Background sniffing task, NULL when not running. While it runs, the
+	 * task owns the RF module and station sync state, station buffers are only
+	 * touched by the main task */
+	volatile TaskHandle_t _task_handle = NULL;
+
+	/** Received packets handed off to the main task */
+	QueueHandle_t _task_queue = NULL;
+
+	/** Set to stop the task */
+	volatile bool _task_stop = false;
+
+	/** Given by the task when it has stopped and no longer uses the RF module */
+	SemaphoreHandle_t _task_done = NULL;
+
+	/** Packets received/dropped by the task */
+	volatile uint32_t _task_received = 0;
+	volatile uint32_t _task_dropped = 0;
+
+	/** Stations the task could not sync, not retried until task is restarted */
+	bool _task_sync_failed[FO_SNIFFER_MAX_STATIONS] = {false};
 
 	/******************************************************************************
 	 * Init
@@ -125,123 +240,506 @@ namespace FoSniffer
 	/******************************************************************************
 	 * Calculate time left to when sniffer needs to start sniffing
 	 * Takes into account tolerance (starts a little earlier to account for time drift)
+	 * Earliest packet of all stations is returned, stations transmitting shortly
+	 * after it are received in the same wakeup.
 	 * @return Seconds to next sniff event. -1 when time unknown
 	 *****************************************************************************/
 	int calc_secs_to_next_sniff()
 	{
+		update_stations();
+
 		uint32_t now = RTC::get_timestamp();
+		uint32_t now_ms = millis();
+		int min_secs_to_next = -1;
 
-		// First run
-		if(_last_packet_tstamp == 0)
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
 		{
-			// ASAP so we can sync
-			return 1;
-		}
+			const Station *station = &_stations[i];
 
-		uint32_t secs_since_last_packet = now - _last_packet_tstamp;
+			if(!station_active(station) || station_radio_tracked(station, now))
+				continue;
 
-		Serial.print(F("Seconds since last packet: "));
-		Serial.println(secs_since_last_packet, DEC);
+			// First run
+			if(station->last_packet_tstamp == 0)
+			{
+				// ASAP so we can sync
+				return 1;
+			}
 
-		// Divide by packet interval and count from there
-		int secs_to_next = secs_since_last_packet - ( (secs_since_last_packet / FO_SNIFFER_PACKET_INTERVAL_SEC) * FO_SNIFFER_PACKET_INTERVAL_SEC);
-		secs_to_next = FO_SNIFFER_PACKET_INTERVAL_SEC - secs_to_next - FO_SNIFFER_WAIT_PACKET_EARLY_WAKEUP_SEC;
+			debug_printf("Station %02x, seconds since last packet: %u\n", station->id, now - station->last_packet_tstamp);
 
-		if(secs_to_next <= 0)
-		{
-			// We're late by X seconds becase early wake up tolerance is larger than time left to next sniff
-			// Skip to next sniff wakeup event
-			return (secs_to_next * -1) + (FO_SNIFFER_PACKET_INTERVAL_SEC - FO_SNIFFER_WAIT_PACKET_EARLY_WAKEUP_SEC);
-		}
-		else
-		{
-			return secs_to_next;
+			int secs_to_next = 0;
+
+			if(station->in_sync)
+			{
+				// Wake up just before the listen window, radio is kept off until it opens
+				uint32_t open_ms = 0, len_ms = 0;
+				station->tracker.get_next_window(now_ms, &open_ms, &len_ms);
+
+				secs_to_next = (int32_t)(open_ms - now_ms) / 1000 - FO_SNIFFER_SLOT_EARLY_WAKEUP_SEC;
+
+				if(secs_to_next < 1)
+				{
+					station->tracker.get_next_window(open_ms + len_ms, &open_ms, &len_ms);
+					secs_to_next = (int32_t)(open_ms - now_ms) / 1000 - FO_SNIFFER_SLOT_EARLY_WAKEUP_SEC;
+				}
+			}
+			else
+			{
+				secs_to_next = calc_secs_to_packet(station, now) - FO_SNIFFER_WAIT_PACKET_EARLY_WAKEUP_SEC;
+
+				// We're late becase early wake up tolerance is larger than time left to next packet
+				// Skip to next packet
+				if(secs_to_next <= 0)
+					secs_to_next += FO_SNIFFER_PACKET_INTERVAL_SEC;
+			}
+
+			if(min_secs_to_next < 0 || secs_to_next < min_secs_to_next)
+				min_secs_to_next = secs_to_next;
 		}
+
+		return min_secs_to_next;
 	}
 
 	/******************************************************************************
 	 * Handle sniff event
+	 * Stations in sync are listened only within the window of their expected packet,
+	 * radio is off in between. Stations not in sync (or that lost sync by missing
+	 * too many windows) are listened for a whole tx interval.
+	 * When woken up by radio INT the received packet is read first, stations heard
+	 * recently are not listened for.
 	 *****************************************************************************/
 	RetResult handle_sniff_event()
 	{
-		RetResult ret = RET_ERROR;
+		update_stations();
 
-		if(_in_sync)
+		// Woke up on radio INT, packet is already in the RF module
+		if(_radio_packet_pending)
 		{
-			Serial.println("In sync, waiting for packet");
-			ret = sleep_to_packet(FO_SNIFFER_PACKET_WAIT_TIME_MS);
+			_radio_packet_pending = false;
 
-			if(ret == RET_ERROR)
-			{
-				Log::log(Log::FO_SNIFFER_SNIFF_FAILED);
-				_in_sync = false;
-			}
-			else
+			if(read_packet() == RET_OK)
+				store_packet(_last_packet_rx_ms);
+
+			_rf.sleep();
+		}
+
+		uint32_t now = RTC::get_timestamp();
+		uint32_t now_ms = millis();
+
+		// Stations expected in this wakeup, cleared as packets are received
+		bool pending[FO_SNIFFER_MAX_STATIONS] = {false};
+		uint32_t open_ms[FO_SNIFFER_MAX_STATIONS] = {0};
+		uint32_t len_ms[FO_SNIFFER_MAX_STATIONS] = {0};
+
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+		{
+			Station *station = &_stations[i];
+
+			if(!station_active(station) || !station->in_sync || station_radio_tracked(station, now))
+				continue;
+
+			station->tracker.get_next_window(now_ms, &open_ms[i], &len_ms[i]);
+
+			// Window too far from this wakeup, will be received in another one
+			if((int32_t)(open_ms[i] - now_ms) > (FO_SNIFFER_SLOT_EARLY_WAKEUP_SEC + FO_SNIFFER_STATION_GROUP_SEC + 1) * 1000)
+				continue;
+
+			pending[i] = true;
+		}
+
+		//
+		// Listen to windows in the order they open
+		//
+		while(true)
+		{
+			int next = -1;
+
+			for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
 			{
-				// Success, store packet
-				_packet_buff.add_packet(&_last_decoded_packet);
-				_in_sync = true;
+				if(pending[i] && (next < 0 || (int32_t)(open_ms[i] - open_ms[next]) < 0))
+					next = i;
 			}
+
+			if(next < 0)
+				break;
+
+			Station *station = &_stations[next];
+
+			sleep_radio_off(open_ms[next]);
+
+			int32_t left_ms = open_ms[next] + len_ms[next] - millis();
+
+			debug_printf("Listening for station %02x, window: %ums\n", station->id, len_ms[next]);
+
+			if(left_ms > 0)
+				listen(pending, next, left_ms);
+
+			if(!pending[next])
+				continue;
+
+			pending[next] = false;
+
+			debug_printf("Station %02x packet not received within window\n", station->id);
+			Log::log(Log::FO_SNIFFER_SNIFF_FAILED, station->id);
+
+			station->tracker.miss();
+
+			// Lost sync, try to sync again right away
+			if(station->tracker.get_misses() >= FO_SNIFFER_SLOT_MAX_MISSES)
+				station->in_sync = false;
 		}
 
-		if(!_in_sync)
+		//
+		// Sync
+		//
+		int sync_count = 0;
+
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
 		{
-			debug_println(F("Not in sync, trying to sync."));
+			const Station *station = &_stations[i];
+
+			if(!station_active(station) || station->in_sync || station_radio_tracked(station, now))
+				continue;
+
+			debug_printf("Station %02x not in sync, trying to sync.\n", station->id);
+			Log::log(Log::FO_SNIFFER_NOT_IN_SYNC, station->id);
+
+			pending[i] = true;
+			sync_count++;
+		}
+
+		if(sync_count > 0)
+		{
+			Serial.printf("Waiting for packets of %d station(s)\n", sync_count);
+
+			listen(pending, -1, FO_SNIFFER_SYNC_WAIT_TIME_MS);
+		}
+
+		_rf.sleep();
 
-			Log::log(Log::FO_SNIFFER_NOT_IN_SYNC);
+		//
+		// Failures
+		//
+		RetResult ret = RET_OK;
 
-			ret = sleep_to_packet(FO_SNIFFER_SYNC_WAIT_TIME_MS);
-			if(ret == RET_ERROR)
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+		{
+			Station *station = &_stations[i];
+
+			if(!pending[i])
+				continue;
+
+			ret = RET_ERROR;
+
+			debug_printf("Could not sync station %02x\n", station->id);
+			Log::log(Log::FO_SNIFFER_SYNC_FAILED, station->id);
+
+			station->rx_failures++;
+
+			debug_print_e(F("FO rx failed, failures: "));
+			debug_println_e(station->rx_failures, DEC);
+
+			// Stop sniffing station after X successive failures
+			if(station->rx_failures >= FO_FAILED_RX_THRESHOLD)
 			{
-				debug_println(F("Could not sync, aborting"));
+				Log::log(Log::FO_DISABLED_RX_FAILED, station->rx_failures, station->id);
 
-				Log::log(Log::FO_SNIFFER_SYNC_FAILED);
+				station->disabled = true;
 			}
-			else
-			{
-				_packet_buff.add_packet(&_last_decoded_packet);
-				_in_sync = true;
-				
-				Log::log(Log::FO_SNIFFER_SCAN_RESULT, _last_decoded_packet.node_address);
+		}
+
+		// Disable FO weather station when all stations failed
+		// Admin must reactivate it again via remote control
+		if(get_active_station_count() == 0)
+		{
+			debug_println_e(F("FineOffset RX failures reached threshold, disabling FO weather station."));
+
+			DeviceConfig::set_fo_enabled(false);
+			DeviceConfig::commit();
 
+			for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+			{
+				_stations[i].disabled = false;
+				_stations[i].rx_failures = 0;
 			}
 		}
 
-		if(ret == RET_ERROR)
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Receive packets until pending stations are received or timeout. Packets
+	 * of stations not pending are stored as well.
+	 * @param pending		Stations to wait for, cleared when received
+	 * @param wait_for		Return as soon as this station is received, -1 to wait
+	 * 						for all pending stations
+	 * @param timeout_ms	Max time to listen
+	 * @return Number of stations still pending
+	 *****************************************************************************/
+	int listen(bool pending[], int wait_for, uint32_t timeout_ms)
+	{
+		uint32_t start_ms = millis();
+		int pending_count = 0;
+
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+		{
+			if(pending[i])
+				pending_count++;
+		}
+
+		while(pending_count > 0 && millis() - start_ms < timeout_ms)
 		{
-			_rx_failures++;
+			if(wait_for >= 0 && !pending[wait_for])
+				break;
 
-			debug_print_e(F("FO rx failed, failures: "));
-			debug_println_e(_rx_failures, DEC);
+			if(_task_handle != NULL && _task_stop)
+				break;
 
-			// Disable FO weather station after X successive failures
-			// Admin must reactivate it again via remote control
-			if(_rx_failures >= FO_FAILED_RX_THRESHOLD)
+			if(sleep_to_packet(timeout_ms - (millis() - start_ms)) != RET_OK)
 			{
-				debug_println_e(F("FineOffset RX failures reached threshold, disabling FO weather station."));
+				// Don't hog the core the task runs on if RX keeps failing
+				if(_task_handle != NULL)
+					vTaskDelay(pdMS_TO_TICKS(FO_SNIFFER_TASK_POLL_MS));
+
+				continue;
+			}
 
-				DeviceConfig::set_fo_enabled(false);
-				DeviceConfig::commit();
+			Station *station = store_packet(_last_packet_rx_ms);
+			if(station == NULL)
+				continue;
 
-				Log::log(Log::FO_DISABLED_RX_FAILED, _rx_failures);
+			int index = station - _stations;
 
-				_rx_failures = 0;
+			if(pending[index])
+			{
+				pending[index] = false;
+				pending_count--;
 			}
 		}
+
+		return pending_count;
+	}
+
+	/******************************************************************************
+	 * Store last decoded packet to the station it came from
+	 * @param rx_ms	Time packet was received (millis)
+	 * @return Station, NULL when packet is from an unknown station
+	 *****************************************************************************/
+	Station* store_packet(uint32_t rx_ms)
+	{
+		Station *station = find_station(_last_decoded_packet.node_address);
+		if(station == NULL)
+		{
+			debug_printf("Packet from unknown station %02x ignored.\n", _last_decoded_packet.node_address);
+			return NULL;
+		}
+
+		station->last_packet_tstamp = RTC::get_timestamp();
+		station->rx_failures = 0;
+
+		station->tracker.add(rx_ms);
+		station->tracker.print();
+
+		if(_task_handle != NULL)
+		{
+			// Received by the task, hand off to the main task
+			TaskPacket item = {0};
+			item.station = station - _stations;
+			item.tstamp = station->last_packet_tstamp;
+			item.packet = _last_decoded_packet;
+
+			if(xQueueSend(_task_queue, &item, 0) == pdTRUE)
+				_task_received++;
+			else
+				_task_dropped++;
+		}
 		else
 		{
-			// Reset failure counter
-			_rx_failures = 0;
+			station->buffer.add_packet(&_last_decoded_packet);
+
+			if(!station->in_sync)
+				Log::log(Log::FO_SNIFFER_SCAN_RESULT, station->id);
 		}
 
-		return ret;
+		station->in_sync = true;
+
+		return station;
+	}
+
+	/******************************************************************************
+	 * Light sleep with the RF module off until given time
+	 * @param until_ms	Time to wake up (millis)
+	 *****************************************************************************/
+	void sleep_radio_off(uint32_t until_ms)
+	{
+		int32_t sleep_ms = until_ms - millis();
+
+		if(sleep_ms <= 0)
+			return;
+
+		_rf.sleep();
+
+		if(_task_handle != NULL)
+		{
+			task_delay_until(until_ms);
+			return;
+		}
+
+		Serial.flush();
+		esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_EXT0);
+		esp_sleep_enable_timer_wakeup((uint64_t)sleep_ms * 1000);
+		esp_light_sleep_start();
+	}
+
+	/******************************************************************************
+	 * Seconds until the next expected packet of a station, from its tx phase
+	 * (time of last packet modulo tx interval)
+	 *****************************************************************************/
+	int calc_secs_to_packet(const Station *station, uint32_t now)
+	{
+		uint32_t secs_since_last_packet = now - station->last_packet_tstamp;
+
+		return (FO_SNIFFER_PACKET_INTERVAL_SEC - secs_since_last_packet % FO_SNIFFER_PACKET_INTERVAL_SEC) % FO_SNIFFER_PACKET_INTERVAL_SEC;
+	}
+
+	/******************************************************************************
+	 * Update station table from device config. Stations whose id changed start
+	 * over, data aggregated for the previous station is commited.
+	 *****************************************************************************/
+	void update_stations()
+	{
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+		{
+			Station *station = &_stations[i];
+			uint8_t id = DeviceConfig::get_fo_sniffer_id(i);
+
+			if(station->id == id)
+				continue;
+
+			station->buffer.commit_buffer();
+			station->buffer.clear();
+			station->buffer.set_station(i, id);
+
+			station->id = id;
+			station->in_sync = false;
+			station->rx_failures = 0;
+			station->disabled = false;
+			station->last_packet_tstamp = 0;
+			station->tracker.reset();
+		}
+	}
+
+	/******************************************************************************
+	 * Station is set and not disabled
+	 *****************************************************************************/
+	bool station_active(const Station *station)
+	{
+		return station->id != 0 && !station->disabled;
+	}
+
+	/******************************************************************************
+	 * Number of active stations
+	 *****************************************************************************/
+	int get_active_station_count()
+	{
+		int count = 0;
+
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+		{
+			if(station_active(&_stations[i]))
+				count++;
+		}
+
+		return count;
+	}
+
+	/******************************************************************************
+	 * Find active station by id
+	 * @return Station, NULL when not found
+	 *****************************************************************************/
+	Station* find_station(uint8_t id)
+	{
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+		{
+			if(station_active(&_stations[i]) && _stations[i].id == id)
+				return &_stations[i];
+		}
+
+		return NULL;
+	}
+
+	/******************************************************************************
+	 * Set RF module address filtering. With a single station the module filters
+	 * by its address, with multiple stations filtering is done in software.
+	 *****************************************************************************/
+	void set_address_filter()
+	{
+		_filter_address = 0;
+
+		if(get_active_station_count() == 1)
+		{
+			for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+			{
+				if(station_active(&_stations[i]))
+					_filter_address = _stations[i].id;
+			}
+		}
+
+		if(_filter_address != 0)
+			_rf.setNodeAddress(_filter_address);
+		else
+			_rf.disableAddressFiltering();
+	}
+
+	/******************************************************************************
+	 * Check whether a received frame can be a weather station packet, before
+	 * spending time on integrity checks and decoding. Rejects noise received
+	 * while listening (wrong family code, no address, out of range fields).
+	 * Invalid markers sent by the station for missing readings are accepted.
+	 *****************************************************************************/
+	bool prefilter_frame(uint8_t const buff[])
+	{
+		if(buff[0] != FO_SNIFFER_FAMILY_CODE)
+			return false;
+
+		if(buff[1] == 0x00 || buff[1] == 0xFF)
+			return false;
+
+		uint16_t wind_dir = ((buff[3] & 0x80) << 1) | buff[2];
+		if(wind_dir > FO_SNIFFER_WIND_DIR_MAX && wind_dir != FO_SNIFFER_WIND_DIR_INVALID)
+			return false;
+
+		uint16_t temp_raw = ((buff[3] & 0b111) << 8) | buff[4];
+		if(temp_raw > FO_SNIFFER_TEMP_RAW_MAX && temp_raw != FO_SNIFFER_TEMP_RAW_INVALID)
+			return false;
+
+		if(buff[5] > FO_SNIFFER_HUM_MAX && buff[5] != FO_SNIFFER_HUM_INVALID)
+			return false;
+
+		return true;
 	}
 
 	/******************************************************************************
 	 * Decode a buffer into a FoDecodedPacket struct
+	 * Integrity is checked first, decoded is left untouched on failure.
 	 *****************************************************************************/
-	RetResult decode_packet(uint8_t *buff, FoDecodedPacket *decoded)
+	RetResult decode_packet(uint8_t const buff[], FoDecodedPacket *decoded)
 	{
+		uint8_t calced_crc = calc_crc(buff, FO_SNIFFER_CRC_LEN),
+			calced_checksum = calc_checksum(buff);
+
+		// Return false if integrity tests failed
+		if(buff[15] != calced_crc || buff[16] != calced_checksum)
+		{
+			Serial.println(F("Packet integrity check failed."));
+
+			Serial.printf("Packet CRC is %02x, should be %02x\n", buff[15], calced_crc);
+			Serial.printf("Packet checksum is %02x, should be %02x\n", buff[16], calced_checksum);
+
+			return RET_ERROR;
+		}
+
 		decoded->node_address = buff[1];
 
 		// Wind direction
@@ -262,13 +760,11 @@ namespace FoSniffer
 		if(buff[3] & 0b1000000)
 		{
 			// Wind speed is 9bit
-			Serial.println(F("WSP flag SET!!"));
 			extra_wind_speed_bits =  (buff[3] & 0b10000) >> 4;
 		}
 		else
 		{
 			// Wind speed is 10bit
-			Serial.println(F("WSP flag NOT SET!!"));
 			extra_wind_speed_bits =  (buff[3] & 0b110000) >> 4;
 		}
 
@@ -299,26 +795,6 @@ namespace FoSniffer
 		decoded->crc = buff[15];
 		decoded->checksum = buff[16];
 
-		uint8_t calced_crc = calc_crc((uint8_t*)decoded, 15, 0x31, 0),
-		calced_checksum = calc_checksum((uint8_t*)decoded);
-
-		// Return false if integrity tests failed
-		if(decoded->crc != calc_crc(buff, 15, 0x31, 0) && decoded->checksum != calc_checksum(buff))
-		{
-			Serial.println(F("Packet integrity check failed."));
-
-			Serial.printf("Packet CRC is %02x, should be %02x\n", decoded->crc, calced_crc);
-			Serial.printf("Packet checksum is %02x, should be %02x\n", decoded->checksum, calced_checksum);
-
-			return RET_ERROR;
-		}
-		else
-		{
-			Serial.println(F("Packet integrity OK"));
-			return RET_OK;
-		}
-
-		// Success
 		return RET_OK;
 	}
 
@@ -329,11 +805,14 @@ namespace FoSniffer
 	******************************************************************************/
 	RetResult sleep_to_packet(uint32_t max_sleep_ms)
 	{
-		// Receive packet
-		static uint8_t buff[256] = "";
-
 		int16_t state = 0;
 
+		// Task is stopping, leave the RF module alone
+		if(_task_handle != NULL && _task_stop)
+			return RET_ERROR;
+
+		set_address_filter();
+
 		// Start receive mode
 		state = _rf.startReceive(5, SX127X_RX);
 		if(state != ERR_NONE)
@@ -342,16 +821,33 @@ namespace FoSniffer
 			return RET_ERROR;
 		}
 
+		// Other core keeps running, wait without sleeping
+		if(_task_handle != NULL)
+		{
+			uint32_t wait_start_ms = millis();
+			bool int_fired = task_wait_for_int(max_sleep_ms);
+
+			_last_packet_rx_ms = millis();
+			_radio_on_ms += _last_packet_rx_ms - wait_start_ms;
+
+			return int_fired ? read_packet() : RET_ERROR;
+		}
+
 		Serial.println(F("Going to sleep until packet receive INT fires..."));
 		Serial.flush();
 		
 		// Set up external INT on DI0 pin and a timer at the same time
 		// If no INT is received within max_sleep_ms, timeout
 		Serial.flush();
+		uint32_t rx_start_ms = millis();
+
 		esp_sleep_enable_timer_wakeup((uint64_t)max_sleep_ms * 1000);
 		esp_sleep_enable_ext0_wakeup(PIN_RF_DI0, 1);
 		esp_light_sleep_start();
 		
+		_last_packet_rx_ms = millis();
+		_radio_on_ms += _last_packet_rx_ms - rx_start_ms;
+
 		esp_sleep_wakeup_cause_t wakeup_cause = esp_sleep_get_wakeup_cause();
 
 		if(wakeup_cause == esp_sleep_wakeup_cause_t::ESP_SLEEP_WAKEUP_TIMER)
@@ -364,36 +860,133 @@ namespace FoSniffer
 		{
 			Serial.println(F("INT wakeup."));
 
-			_rf.setNodeAddress(DeviceConfig::get_fo_sniffer_id());
-			state = _rf.readData((uint8_t*)&buff[2], sizeof(buff)-2);
+			return read_packet();
+		}
+		else
+		{
+			Serial.println(F("Invalid wakeup"));
+			return RET_ERROR;
+		}
 
-			buff[0] = FO_SNIFFER_FAMILY_CODE;
-			buff[1] = DeviceConfig::get_fo_sniffer_id();
+		return RET_ERROR;
+	}
 
-			Serial.printf("\n\n########################## RAW PACKET ###############################\n");
-			Utils::print_buff_hex(buff, 30);
-			Serial.printf("\n\n#####################################################################\n");
-			Serial.println();
+	/******************************************************************************
+	* Read and decode packet received by the RF module (after its INT fired)
+	* Decoded packet is stored in _last_decoded_packet
+	******************************************************************************/
+	RetResult read_packet()
+	{
+		static uint8_t buff[256] = "";
 
-			RetResult decode_ret = decode_packet(buff, &_last_decoded_packet);
+		// RF ic strips everything up to the node address when filtering
+		if(_filter_address != 0)
+		{
+			_rf.readData((uint8_t*)&buff[2], sizeof(buff)-2);
+			buff[1] = _filter_address;
+		}
+		else
+		{
+			_rf.readData((uint8_t*)&buff[1], sizeof(buff)-1);
+		}
 
-			if(decode_ret != RET_ERROR)
-			{
-				FoBuffer::print_packet(&_last_decoded_packet);
+		buff[0] = FO_SNIFFER_FAMILY_CODE;
 
-				// Update time of last received packet
-				_last_packet_tstamp = RTC::get_timestamp();
-			}
+		// Capture store is not thread safe, frames received by the task are not captured
+		if(FLAGS.FO_SNIFFER_CAPTURE_ENABLED && _task_handle == NULL)
+			FoCapture::add(RTC::get_timestamp(), buff);
+
+		Serial.printf("\n\n########################## RAW PACKET ###############################\n");
+		Utils::print_buff_hex(buff, 30);
+		Serial.printf("\n\n#####################################################################\n");
+		Serial.println();
 
-			return decode_ret;
+		if(!prefilter_frame(buff))
+		{
+			debug_println(F("Not a FO packet, ignoring."));
+			return RET_ERROR;
 		}
-		else
+
+		RetResult decode_ret = decode_packet(buff, &_last_decoded_packet);
+
+		if(decode_ret != RET_ERROR)
 		{
-			Serial.println(F("Invalid wakeup"));
+			debug_println(F("Packet integrity OK"));
+			FoBuffer::print_packet(&_last_decoded_packet);
+		}
+
+		return decode_ret;
+	}
+
+	/******************************************************************************
+	* Radio wake up can be used: enabled in flags, FO enabled and sniffed, and
+	* INT wake up source not used by lightning sensor
+	******************************************************************************/
+	bool radio_wakeup_enabled()
+	{
+		return FLAGS.FO_SNIFFER_RADIO_WAKEUP_ENABLED && !FLAGS.LIGHTNING_SENSOR_ENABLED &&
+			FO_SOURCE == FO_SOURCE_SNIFFER && DeviceConfig::get_fo_enabled();
+	}
+
+	/******************************************************************************
+	* Leave RF module receiving and set its packet INT as wake up source, so the
+	* device sleeps until a packet actually arrives. Called before going to sleep.
+	******************************************************************************/
+	RetResult arm_radio_wakeup()
+	{
+		if(!radio_wakeup_enabled() || get_active_station_count() == 0)
+			return RET_ERROR;
+
+		set_address_filter();
+
+		if(_rf.startReceive(5, SX127X_RX) != ERR_NONE)
+		{
+			debug_println_e(F("Could not start RX for radio wake up."));
 			return RET_ERROR;
 		}
 
-		return RET_ERROR;
+		esp_sleep_enable_ext0_wakeup(PIN_RF_DI0, 1);
+
+		_radio_wakeup_armed = true;
+		_radio_wakeup_armed_ms = millis();
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	* Check if device woke up from RF module INT. Called right after waking up.
+	* Packet is left in the RF module to be read when sniff event is handled,
+	* otherwise RF module is turned off.
+	* @return True when woke up on packet
+	******************************************************************************/
+	bool check_radio_wakeup()
+	{
+		if(!_radio_wakeup_armed)
+			return false;
+
+		_radio_wakeup_armed = false;
+		_last_packet_rx_ms = millis();
+		_radio_on_ms += _last_packet_rx_ms - _radio_wakeup_armed_ms;
+
+		if(esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0)
+		{
+			_radio_packet_pending = true;
+			return true;
+		}
+
+		_rf.sleep();
+
+		return false;
+	}
+
+	/******************************************************************************
+	* Station is received through radio wake up and needs no scheduled sniffing
+	* (heard recently)
+	******************************************************************************/
+	bool station_radio_tracked(const Station *station, uint32_t now)
+	{
+		return radio_wakeup_enabled() && station->last_packet_tstamp != 0 &&
+			now - station->last_packet_tstamp < FO_SNIFFER_RADIO_WAKEUP_TIMEOUT_SEC;
 	}
 
 	/******************************************************************************
@@ -415,27 +1008,44 @@ namespace FoSniffer
 			// Start writing to buffer leaving space to add family code and node address manually
 			// to calculate CRC and checksum
 			int state = 0;
+			uint32_t rx_start_ms = millis();
 
 			if(ignore_address)
 			{
 				_rf.disableAddressFiltering();
-
-				state = _rf.receive((uint8_t*)&buff[1], sizeof(buff) - 1);
+				_filter_address = 0;
 			}
 			else
 			{
-				// Re enable address filtering in case it was disabled, by setting address
-				_rf.setNodeAddress(DeviceConfig::get_fo_sniffer_id());
+				// Re enable address filtering in case it was disabled
+				set_address_filter();
+			}
 
+			if(_filter_address != 0)
+			{
 				state = _rf.receive((uint8_t*)&buff[2], sizeof(buff) - 2);
 
-				buff[1] = DeviceConfig::get_fo_sniffer_id();
+				buff[1] = _filter_address;
+			}
+			else
+			{
+				state = _rf.receive((uint8_t*)&buff[1], sizeof(buff) - 1);
 			}
 
+			_radio_on_ms += millis() - rx_start_ms;
+
 			buff[0] = FO_SNIFFER_FAMILY_CODE;
 			
 			if (state == ERR_NONE)
 			{
+				if(FLAGS.FO_SNIFFER_CAPTURE_ENABLED)
+					FoCapture::add(RTC::get_timestamp(), buff);
+
+				// Noise is common while listening, keep waiting without decoding
+				// or printing it
+				if(!prefilter_frame(buff))
+					continue;
+
 				Serial.println(F("Packet received!"));
 				Serial.flush();
 
@@ -450,9 +1060,6 @@ namespace FoSniffer
 					debug_print(F("Node: "))
 					debug_println_i(_last_decoded_packet.node_address, HEX);
 					FoBuffer::print_packet(&_last_decoded_packet);
-
-					// Update time of last received packet
-					_last_packet_tstamp = RTC::get_timestamp();
 				}
 
 				Serial.printf("\n\n########################## RAW PACKET ###############################\n");
@@ -488,11 +1095,14 @@ namespace FoSniffer
 	}
 
 	/******************************************************************************
-	* Wait for a valid RF packet from any FO station in range, and (optionally)
-	* update config with sniffer id
-	* @param timeout_ms Scan time in (ms)
-	* @param update_config Update fo node address in device config
-	* @return 0 when no FO station found, id otherwise
+	* Wait for valid RF packets from all FO stations in range (up to
+	* FO_SNIFFER_MAX_STATIONS), and (optionally) update config with their ids
+	* Stations transmit every tx interval, so scanning ends one sync window after
+	* the first station is found.
+	* If the background task is running it is stopped during the scan and
+	* restarted afterwards.
+	* @param update_config Update fo node addresses in device config
+	* @return 0 when no FO station found, id of first station found otherwise
 	******************************************************************************/
 	uint8_t scan_fo_id(bool update_config)
 	{
@@ -502,13 +1112,20 @@ namespace FoSniffer
 			return 0;
 		}
 
+		// Task owns the radio and decode state
+		bool task_was_running = _task_handle != NULL;
+		if(task_was_running)
+			stop_task();
+
 		debug_println(F("Scanning for new FO id..."));
 
 		Log::log(Log::FO_SNIFFER_SCANNING);
 
-		int ret = 0;
+		uint8_t found_ids[FO_SNIFFER_MAX_STATIONS] = {0};
+		int found_count = 0;
 
 		uint32_t start_ms = millis();
+		uint32_t scan_time_ms = FO_SNIFFER_SCAN_TIME_MS;
 
 		// Try scanning for devices for FO_SNIFFER_SCAN_TIME_MS
 		// If invalid packet is received (wait for packet returns error), calculate
@@ -518,40 +1135,295 @@ namespace FoSniffer
 
 		do
 		{
-			uint32_t timeout = FO_SNIFFER_SCAN_TIME_MS - (millis() - start_ms);
+			uint32_t timeout = scan_time_ms - (millis() - start_ms);
 
 			debug_print(F("Scanning for (mS): "));
 			debug_println(timeout, DEC);
 
-			if(wait_for_packet(timeout, true) == RET_OK)
+			if(wait_for_packet(timeout, true) != RET_OK)
+				continue;
+
+			uint8_t id = _last_decoded_packet.node_address;
+
+			bool known = false;
+			for(int i = 0; i < found_count; i++)
 			{
-				debug_print_i(F("Found FO station ID: 0x"));
-				debug_println_i(_last_decoded_packet.node_address, HEX);
+				if(found_ids[i] == id)
+					known = true;
+			}
 
-				ret = _last_decoded_packet.node_address;
+			if(known)
+				continue;
 
-				Log::log(Log::FO_SNIFFER_SCAN_RESULT, ret);
+			debug_print_i(F("Found FO station ID: 0x"));
+			debug_println_i(id, HEX);
 
-				if(update_config)
-				{
-					debug_println(F("Saving new FO address"));
-					DeviceConfig::set_fo_sniffer_id(ret);
-					DeviceConfig::commit();
-				}
+			Log::log(Log::FO_SNIFFER_SCAN_RESULT, id);
 
-				break;
+			found_ids[found_count++] = id;
+
+			// All stations in range are heard within a tx interval of the first one
+			if(found_count == 1 && millis() - start_ms + FO_SNIFFER_SYNC_WAIT_TIME_MS < scan_time_ms)
+				scan_time_ms = millis() - start_ms + FO_SNIFFER_SYNC_WAIT_TIME_MS;
+		}while(found_count < FO_SNIFFER_MAX_STATIONS && millis() - start_ms < scan_time_ms);
+
+		if(found_count == 0)
+		{
+			Serial.println(F("No FO weather station found."));
+		}
+		else if(update_config)
+		{
+			debug_println(F("Saving new FO addresses"));
+
+			for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+				DeviceConfig::set_fo_sniffer_id(found_ids[i], i);
+
+			DeviceConfig::commit();
+		}
+
+		Log::log(Log::FO_SNIFFER_SCAN_FINISHED, found_count);
+
+		if(task_was_running)
+			start_task();
+		
+		return found_ids[0];
+	}
+
+	/******************************************************************************
+	 * Start sniffing in a background task, pinned to the core not used by the
+	 * main task (eg. while calling home). Sniffer must not be used by the main task
+	 * until stop_task() is called, except for commit_buffer().
+	 *****************************************************************************/
+	RetResult start_task()
+	{
+		if(!FLAGS.FO_SNIFFER_CALL_HOME_TASK_ENABLED || FO_SOURCE != FO_SOURCE_SNIFFER || !DeviceConfig::get_fo_enabled())
+			return RET_ERROR;
+
+		if(_task_handle != NULL)
+			return RET_OK;
+
+		update_stations();
+
+		if(get_active_station_count() == 0)
+			return RET_ERROR;
+
+		if(_task_queue == NULL)
+		{
+			_task_queue = xQueueCreate(FO_SNIFFER_TASK_QUEUE_LEN, sizeof(TaskPacket));
+
+			if(_task_queue == NULL)
+			{
+				debug_println_e(F("Could not create FO sniffer task queue."));
+				return RET_ERROR;
 			}
-			else
+		}
+
+		if(_task_done == NULL)
+		{
+			_task_done = xSemaphoreCreateBinary();
+
+			if(_task_done == NULL)
 			{
-				Serial.println(F("No FO weather station found."));
+				debug_println_e(F("Could not create FO sniffer task semaphore."));
+				return RET_ERROR;
+			}
+		}
+
+		_task_stop = false;
+		_task_received = 0;
+		_task_dropped = 0;
+
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+			_task_sync_failed[i] = false;
+
+		TaskHandle_t handle = NULL;
+
+		if(xTaskCreatePinnedToCore(task, "fo_sniffer", FO_SNIFFER_TASK_STACK_SIZE, NULL,
+			FO_SNIFFER_TASK_PRIORITY, &handle, FO_SNIFFER_TASK_CORE) != pdPASS)
+		{
+			debug_println_e(F("Could not start FO sniffer task."));
+			return RET_ERROR;
+		}
+
+		_task_handle = handle;
+
+		debug_println_i(F("FO sniffer task started."));
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Stop background task and hand off packets it received
+	 * Task is never deleted from here, it may be in the middle of an SPI
+	 * transaction. It exits on its own once it sees _task_stop.
+	 *****************************************************************************/
+	void stop_task()
+	{
+		if(_task_handle == NULL)
+			return;
+
+		_task_stop = true;
+
+		if(xSemaphoreTake(_task_done, pdMS_TO_TICKS(FO_SNIFFER_TASK_STOP_TIMEOUT_MS)) != pdTRUE)
+		{
+			debug_println_w(F("FO sniffer task slow to stop, waiting."));
+
+			xSemaphoreTake(_task_done, portMAX_DELAY);
+		}
+
+		_rf.sleep();
 
-				ret = 0;
+		drain_task_queue();
+
+		debug_printf("FO sniffer task stopped, received: %u, dropped: %u\n", _task_received, _task_dropped);
+		Log::log(Log::FO_SNIFFER_TASK_STATS, _task_received, _task_dropped);
+	}
+
+	/******************************************************************************
+	 * Background task body
+	 *****************************************************************************/
+	void task(void *params)
+	{
+		_task_handle = xTaskGetCurrentTaskHandle();
+
+		while(!_task_stop)
+			task_sniff();
+
+		_task_handle = NULL;
+		xSemaphoreGive(_task_done);
+
+		vTaskDelete(NULL);
+	}
+
+	/******************************************************************************
+	 * Single sniff from the background task. Like handle_sniff_event(), but
+	 * waits instead of sleeping and does not log or touch device config (not
+	 * thread safe). Stations that fail to sync are not retried by the task and
+	 * failures are not counted.
+	 *****************************************************************************/
+	void task_sniff()
+	{
+		bool pending[FO_SNIFFER_MAX_STATIONS] = {false};
+		int sync_count = 0;
+
+		//
+		// Sync first
+		//
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+		{
+			if(station_active(&_stations[i]) && !_stations[i].in_sync && !_task_sync_failed[i])
+			{
+				pending[i] = true;
+				sync_count++;
 			}
-		}while(millis() - start_ms < FO_SNIFFER_SCAN_TIME_MS);
+		}
 
-		Log::log(Log::FO_SNIFFER_SCAN_FINISHED);
-		
-		return ret;
+		if(sync_count > 0)
+		{
+			listen(pending, -1, FO_SNIFFER_SYNC_WAIT_TIME_MS);
+			_rf.sleep();
+
+			for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+			{
+				if(pending[i] && !_task_stop)
+					_task_sync_failed[i] = true;
+			}
+
+			return;
+		}
+
+		//
+		// Earliest window of stations in sync
+		//
+		uint32_t now_ms = millis();
+		uint32_t open_ms = 0, len_ms = 0;
+		int next = -1;
+
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+		{
+			uint32_t station_open_ms = 0, station_len_ms = 0;
+
+			if(!station_active(&_stations[i]) || !_stations[i].in_sync)
+				continue;
+
+			_stations[i].tracker.get_next_window(now_ms, &station_open_ms, &station_len_ms);
+
+			if(next < 0 || (int32_t)(station_open_ms - open_ms) < 0)
+			{
+				next = i;
+				open_ms = station_open_ms;
+				len_ms = station_len_ms;
+			}
+		}
+
+		if(next < 0)
+		{
+			task_delay_until(now_ms + FO_SNIFFER_PACKET_INTERVAL_SEC * 1000);
+			return;
+		}
+
+		sleep_radio_off(open_ms);
+
+		int32_t left_ms = open_ms + len_ms - millis();
+
+		pending[next] = true;
+
+		if(left_ms > 0 && !_task_stop)
+			listen(pending, next, left_ms);
+
+		_rf.sleep();
+
+		if(!pending[next] || _task_stop)
+			return;
+
+		Station *station = &_stations[next];
+
+		station->tracker.miss();
+
+		if(station->tracker.get_misses() >= FO_SNIFFER_SLOT_MAX_MISSES)
+			station->in_sync = false;
+	}
+
+	/******************************************************************************
+	 * Wait for RF module packet INT from the background task
+	 * @return True when INT fired, false on timeout or when task is stopping
+	 *****************************************************************************/
+	bool task_wait_for_int(uint32_t timeout_ms)
+	{
+		uint32_t start_ms = millis();
+
+		while(millis() - start_ms < timeout_ms && !_task_stop)
+		{
+			if(digitalRead(PIN_RF_DI0))
+				return true;
+
+			vTaskDelay(pdMS_TO_TICKS(FO_SNIFFER_TASK_POLL_MS));
+		}
+
+		return false;
+	}
+
+	/******************************************************************************
+	 * Delay background task until given time (millis) or until task is stopping
+	 *****************************************************************************/
+	void task_delay_until(uint32_t until_ms)
+	{
+		while((int32_t)(until_ms - millis()) > 0 && !_task_stop)
+			vTaskDelay(pdMS_TO_TICKS(FO_SNIFFER_TASK_POLL_MS));
+	}
+
+	/******************************************************************************
+	 * Add packets received by the background task to their station buffers
+	 *****************************************************************************/
+	void drain_task_queue()
+	{
+		if(_task_queue == NULL)
+			return;
+
+		TaskPacket item;
+
+		while(xQueueReceive(_task_queue, &item, 0) == pdTRUE)
+			_stations[item.station].buffer.add_packet(&item.packet, item.tstamp);
 	}
 
 	/******************************************************************************
@@ -564,40 +1436,65 @@ namespace FoSniffer
 
 	/******************************************************************************
 	* Commit buffer
+	* Radio duty cycle since last commit is logged as well
 	******************************************************************************/
 	RetResult commit_buffer()
 	{
-		return _packet_buff.commit_buffer();
+		if(FLAGS.FO_SNIFFER_CAPTURE_ENABLED)
+			FoCapture::commit_buffer();
+
+		drain_task_queue();
+
+		uint32_t elapsed_ms = millis() - _duty_cycle_start_ms;
+
+		if(elapsed_ms > 0)
+		{
+			uint32_t duty_permille = (uint64_t)_radio_on_ms * 1000 / elapsed_ms;
+
+			debug_printf("FO radio on for %ums of %ums (%u per mille)\n", _radio_on_ms, elapsed_ms, duty_permille);
+			Log::log(Log::FO_SNIFFER_RADIO_DUTY_CYCLE, _radio_on_ms, duty_permille);
+		}
+
+		_radio_on_ms = 0;
+		_duty_cycle_start_ms = millis();
+
+		RetResult ret = RET_OK;
+
+		for(int i = 0; i < FO_SNIFFER_MAX_STATIONS; i++)
+		{
+			if(_stations[i].buffer.commit_buffer() != RET_OK)
+				ret = RET_ERROR;
+		}
+
+		return ret;
 	}
 
 	/******************************************************************************
-	 * Calculate CRC
+	 * Calculate CRC8 (polynomial 0x31) using lookup table
+	 * @param buff	Data
+	 * @param len	Bytes of data
+	 * @param init	Initial CRC value
 	 *****************************************************************************/
-	uint8_t calc_crc(uint8_t const buff[], int len, uint8_t polynomial, uint8_t init)
+	uint8_t calc_crc(uint8_t const buff[], int len, uint8_t init)
 	{
-		uint8_t remainder = init;
+		uint8_t crc = init;
 
 		for (int i = 0; i < len; ++i)
 		{
-			remainder ^= buff[i];
-			for (int j = 0; j < 8; ++j)
-			{
-				if (remainder & 0x80)
-					remainder = (remainder << 1) ^ polynomial;
-				else
-					remainder = (remainder << 1);
-			}
+			crc = CRC8_TABLE[crc ^ buff[i]];
 		}
-		return remainder;
+
+		return crc;
 	}
 
 	/******************************************************************************
-	 * Calculate checksum
+	 * Calculate checksum (sum of all bytes of the frame before the checksum)
 	 *****************************************************************************/
 	uint8_t calc_checksum(uint8_t const buff[])
 	{
 		uint8_t checksum = 0;
-		for (int i = 0; i < 16; i++)
+
+		for (int i = 0; i < FO_SNIFFER_CHECKSUM_LEN; i++)
 		{
 			checksum += buff[i];
 		}
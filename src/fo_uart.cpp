@@ -4,6 +4,7 @@
 #include "fo_data.h"
 #include "fo_buffer.h"
 #include "device_config.h"
+#include "fo_uart_parser.h"
 
 namespace FoUart
 {
@@ -84,159 +85,53 @@ namespace FoUart
 		HardwareSerial uart(FO_UART_PORT);
 		uart.begin(9600, SERIAL_8N1, PIN_FO_UART_RX, 999, false, FO_UART_RX_TIMEOUT_MS);
 
-		// Rx buffer, must fit 1 line of response
-		char buff[128] = "";
+		// Response is parsed as bytes arrive, without buffering lines
+		FoUartParser parser;
+		FoUartParser::Result result = FoUartParser::PARSE_INCOMPLETE;
 
-		// Index of current parsed field in param array
-		// int cur_field_index = 0;
-
-		// Number of recognized params found so far
-		int found_param_count = 0;
-
-		// Return result
 		RetResult ret = RET_ERROR;
 
-		// Break reading loops
-		bool break_read = false;
-
-		// Receive data until done or timeout
+		// Receive data until all params parsed or timeout
 		uint32_t start_ms = millis();
-		while(millis() - start_ms < FO_UART_RX_TIMEOUT_MS)
+		while(result == FoUartParser::PARSE_INCOMPLETE && millis() - start_ms < FO_UART_RX_TIMEOUT_MS)
 		{
-			if(break_read)
-			{
-				break;
-			}
+			int c = 0;
 
-			if(!uart.available())
-				continue;
-			int len = 0;
-			
-			// while(len = uart.readBytes(buff, sizeof(buff)-1))
-			uart.setTimeout(FO_UART_RX_TIMEOUT_MS);
-			while((len = uart.readBytesUntil('\n', buff, sizeof(buff)-1)))
-			{
-				buff[len] = '\0';
-
-				// Print received line
-				// debug_println(buff);
-
-				// Skip until first field is found
-				char param_name[25] = "";
-				// const char *param_name = FO_UART_RESPONSE_PARAM_NAMES[cur_field_index];
-				float param_val = 0;
-
-				// Build format string eg. "WindDir = %f"
-				// snprintf(format, sizeof(format), "%s = %%f", param_name);
-
-				// Parse from current response line
-				// At first, skip lines until first field found. After that fields are expected
-				// to be returned one by one in the order specified by param array, otherwise fail
-				int found = sscanf(buff, "%s = %f", param_name, &param_val);
-
-				if(found == 0)
-				{
-					if(found_param_count == 0)
-					{
-						// Still looking for start, keep looking
-						memset(buff, 0, sizeof(buff));
-						continue;
-					}
-					else
-					{
-						// Next value is not what was expected, fail
-						ret = RET_ERROR;
-						break_read = true;
-
-						debug_println_e(F("No param returned or invalid format."));
-						Log::log(Log::FO_ERROR_UNEXPECTED_VALUE, found_param_count);
-
-						debug_println(F("Found params: "));
-						debug_println(found_param_count, DEC);
-
-						memset(buff, 0, sizeof(buff));
-
-						break;
-					}
-				}
-				// Parsed both param & value
-				else if(found == 2)
-				{
-					found_param_count++;
-
-					if(strcmp(param_name, FO_UART_RESPONSE_PARAM_NAMES[FO_UART_FIELD_WIND_DIR]) == 0)
-					{
-						_last_decoded_packet.wind_dir = param_val;
-					}
-					else if(strcmp(param_name, FO_UART_RESPONSE_PARAM_NAMES[FO_UART_FIELD_WIND_SPEED]) == 0)
-					{
-						_last_decoded_packet.wind_speed = param_val * FO_WIND_SPEED_COEFF;
-					}
-					else if(strcmp(param_name, FO_UART_RESPONSE_PARAM_NAMES[FO_UART_FIELD_WIND_GUST]) == 0)
-					{
-						_last_decoded_packet.wind_gust = param_val * FO_WIND_GUST_COEFF;
-					}
-					else if(strcmp(param_name, FO_UART_RESPONSE_PARAM_NAMES[FO_UART_FIELD_TEMP]) == 0)
-					{
-						_last_decoded_packet.temp = (float)param_val/10;
-					}
-					else if(strcmp(param_name, FO_UART_RESPONSE_PARAM_NAMES[FO_UART_FIELD_HUMIDITY]) == 0)
-					{
-						_last_decoded_packet.hum = param_val;
-					}
-					else if(strcmp(param_name, FO_UART_RESPONSE_PARAM_NAMES[FO_UART_FIELD_LIGHT]) == 0)
-					{
-						_last_decoded_packet.light = param_val * 10;
-					}
-					else if(strcmp(param_name, FO_UART_RESPONSE_PARAM_NAMES[FO_UART_FIELD_UV_INDEX]) == 0)
-					{
-						_last_decoded_packet.uv_index = param_val;
-					}
-					else if(strcmp(param_name, FO_UART_RESPONSE_PARAM_NAMES[FO_UART_FIELD_RAIN_COUNTER]) == 0)
-					{
-						_last_decoded_packet.rain = param_val * FO_RAIN_MM_PER_CLICK;
-					}
-					else
-					{
-						// Unknown param, decrease count
-						found_param_count--;
-					}
-
-					if(found_param_count == FO_UART_PARAM_COUNT)
-					{
-						// All params read, break
-						Serial.println(F("All FO params read, stopping."));
-						break_read = true;
-						break;
-					}
-				}
-			}
+			while(result == FoUartParser::PARSE_INCOMPLETE && (c = uart.read()) >= 0)
+				result = parser.feed((char)c);
 		}
 
-		// Calculate derived values
-		_last_decoded_packet.solar_radiation = _last_decoded_packet.light * FO_SNIFFER_LUX_TO_SOLAR_RADIATION_COEFF;
-
-		// Not all params read
-		if(FO_UART_PARAM_COUNT != found_param_count)
+		if(result == FoUartParser::PARSE_DONE)
 		{
-			debug_print_e(F("Invalid FO param count: "));
-			debug_println_e(found_param_count, DEC);
-			Log::log(Log::FO_ERROR_INVALID_PARAM_COUNT, found_param_count);
+			Serial.printf("All FO params read in %ums.\n", millis() - start_ms);
+
+			parser.fill_packet(&_last_decoded_packet);
 
-			ret = RET_ERROR;
-		}
-		else
-		{
 			ret = RET_OK;
 
 			// Update time of last received packet
 			_last_packet_tstamp = RTC::get_timestamp();
 		}
+		else if(result == FoUartParser::PARSE_ERROR)
+		{
+			debug_println_e(F("No param returned or invalid format."));
+			Log::log(Log::FO_ERROR_UNEXPECTED_VALUE, parser.get_found_param_count());
+		}
+		else
+		{
+			// Not all params read
+			debug_print_e(F("Invalid FO param count: "));
+			debug_println_e(parser.get_found_param_count(), DEC);
+			Log::log(Log::FO_ERROR_INVALID_PARAM_COUNT, parser.get_found_param_count());
+		}
 
 		// Reset request pin back to 0 otherwise weather station will output data immediately when
 		// available
 		digitalWrite(PIN_FO_UART_REQ_DATA, 0);
 
+		// UART is shared with SDI12, free its interrupt
+		uart.end();
+
 		return ret;
 	}
 
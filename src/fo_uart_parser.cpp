@@ -0,0 +1,217 @@
+#include "fo_uart_parser.h"
+
+/******************************************************************************
+* All param bits set
+******************************************************************************/
+static const uint16_t ALL_PARAMS = (1 << FO_UART_PARAM_COUNT) - 1;
+
+/******************************************************************************
+* Reset parser to start of response
+******************************************************************************/
+void FoUartParser::reset()
+{
+    *this = FoUartParser();
+}
+
+/******************************************************************************
+* Feed a single received byte
+* Lines with unknown names or without a value are skipped. A known param with a
+* malformed value after the first param has been found fails parsing.
+******************************************************************************/
+FoUartParser::Result FoUartParser::feed(char c)
+{
+    if(_result != PARSE_INCOMPLETE)
+        return _result;
+
+    if(c == '\n' || c == '\r')
+    {
+        if(_state == STATE_VALUE)
+            end_value();
+        else if(_state == STATE_SEPARATOR && _found != 0)
+            _result = PARSE_ERROR;
+
+        _state = STATE_NAME;
+        _name_index = 0;
+
+        return _result;
+    }
+
+    switch(_state)
+    {
+        case STATE_NAME:
+            // Leading whitespace
+            if(_name_index == 0 && (c == ' ' || c == '\t'))
+                break;
+
+            if(c == ' ' || c == '\t' || c == '=')
+            {
+                end_name();
+                break;
+            }
+
+            if(_name_index == 0)
+                _candidates = ALL_PARAMS;
+
+            for(int i = 0; i < FO_UART_PARAM_COUNT; i++)
+            {
+                if((_candidates & (1 << i)) && FO_UART_RESPONSE_PARAM_NAMES[i][_name_index] != c)
+                    _candidates &= ~(1 << i);
+            }
+
+            _name_index++;
+
+            if(_candidates == 0 || _name_index >= sizeof(FO_UART_RESPONSE_PARAM_NAMES[0]))
+                _state = STATE_SKIP_LINE;
+            break;
+
+        case STATE_SEPARATOR:
+            if(c == ' ' || c == '\t' || c == '=')
+                break;
+
+            _state = STATE_VALUE;
+            _negative = false;
+            _fraction = false;
+            _has_digits = false;
+            _value = 0;
+            _fraction_div = 1;
+
+            if(c == '-')
+            {
+                _negative = true;
+                break;
+            }
+            // Fall through, first char of value
+
+        case STATE_VALUE:
+            if(c >= '0' && c <= '9')
+            {
+                _has_digits = true;
+
+                if(_fraction)
+                {
+                    _fraction_div *= 10;
+                    _value += (c - '0') / _fraction_div;
+                }
+                else
+                {
+                    _value = _value * 10 + (c - '0');
+                }
+            }
+            else if(c == '.' && !_fraction)
+            {
+                _fraction = true;
+            }
+            else if(c == ' ' || c == '\t')
+            {
+                // Trailing whitespace (or unit), value ends here
+                end_value();
+                if(_result == PARSE_INCOMPLETE)
+                    _state = STATE_SKIP_LINE;
+            }
+            else
+            {
+                // Malformed value
+                _has_digits = false;
+                end_value();
+                if(_result == PARSE_INCOMPLETE)
+                    _state = STATE_SKIP_LINE;
+            }
+            break;
+
+        case STATE_SKIP_LINE:
+            break;
+    }
+
+    return _result;
+}
+
+/******************************************************************************
+* Feed a chunk of received data
+******************************************************************************/
+FoUartParser::Result FoUartParser::feed(const char *data, int len)
+{
+    for(int i = 0; i < len && _result == PARSE_INCOMPLETE; i++)
+        feed(data[i]);
+
+    return _result;
+}
+
+/******************************************************************************
+* Name ended, keep the param whose name matched entirely
+******************************************************************************/
+void FoUartParser::end_name()
+{
+    _param = -1;
+
+    for(int i = 0; i < FO_UART_PARAM_COUNT; i++)
+    {
+        if((_candidates & (1 << i)) && FO_UART_RESPONSE_PARAM_NAMES[i][_name_index] == '\0')
+            _param = i;
+    }
+
+    _state = _param < 0 ? STATE_SKIP_LINE : STATE_SEPARATOR;
+}
+
+/******************************************************************************
+* Value ended, store it
+******************************************************************************/
+void FoUartParser::end_value()
+{
+    if(!_has_digits)
+    {
+        // Garbage before response starts is ignored
+        if(_found != 0)
+            _result = PARSE_ERROR;
+
+        return;
+    }
+
+    _values[_param] = _negative ? -_value : _value;
+    _found |= 1 << _param;
+
+    if(_found == ALL_PARAMS)
+        _result = PARSE_DONE;
+}
+
+/******************************************************************************
+* Fill packet with received values, converted to packet units
+******************************************************************************/
+void FoUartParser::fill_packet(FoDecodedPacket *packet) const
+{
+    packet->wind_dir = _values[FO_UART_FIELD_WIND_DIR];
+    packet->wind_speed = _values[FO_UART_FIELD_WIND_SPEED] * FO_WIND_SPEED_COEFF;
+    packet->wind_gust = _values[FO_UART_FIELD_WIND_GUST] * FO_WIND_GUST_COEFF;
+    packet->temp = _values[FO_UART_FIELD_TEMP] / 10;
+    packet->hum = _values[FO_UART_FIELD_HUMIDITY];
+    packet->light = _values[FO_UART_FIELD_LIGHT] * 10;
+    packet->uv_index = _values[FO_UART_FIELD_UV_INDEX];
+    packet->rain = _values[FO_UART_FIELD_RAIN_COUNTER] * FO_RAIN_MM_PER_CLICK;
+
+    packet->solar_radiation = packet->light * FO_SNIFFER_LUX_TO_SOLAR_RADIATION_COEFF;
+}
+
+/******************************************************************************
+* Getters
+******************************************************************************/
+FoUartParser::Result FoUartParser::get_result() const
+{
+    return _result;
+}
+
+int FoUartParser::get_found_param_count() const
+{
+    int count = 0;
+
+    for(int i = 0; i < FO_UART_PARAM_COUNT; i++)
+    {
+        if(_found & (1 << i))
+            count++;
+    }
+
+    return count;
+}
+
+float FoUartParser::get_value(FoUartParam param) const
+{
+    return _values[param];
+}
@@ -7,6 +7,7 @@
 #include "rtc.h"
 #include "struct.h"
 #include "utils.h"
+#include "power_control.h"
 #include "log.h"
 #include <Wire.h>
 #include "common.h"
@@ -108,8 +109,7 @@ RetResult on()
 	delay(GSM_WAIT_AFTER_PWR_ON_MS);
 
 	#ifdef TCALL_H
-		// Turn IP5306 power boost OFF to reduce idle current
-		Utils::ip5306_set_power_boost_state(true);
+		PowerControl::acquire(PowerControl::RAIL_BOOST);
 	#endif
 
 	// If end not called before calling begin again, it results in a guru meditation error sometimes
@@ -168,8 +168,8 @@ RetResult off()
 	_power_toggle_ms = millis();
 
 	#ifdef TCALL_H
-		// Turn IP5306 power boost OFF to reduce idle current
-		Utils::ip5306_set_power_boost_state(false);
+		// Turn IP5306 power boost OFF to reduce idle current, unless sensors use it
+		PowerControl::release(PowerControl::RAIL_BOOST);
 	#endif
 
 	return RET_OK;
@@ -1,4 +1,6 @@
 #include "SPIFFS.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include "log.h"
 #include "const.h"
 #include "rtc.h"
@@ -7,8 +9,20 @@
 
 namespace Log
 {
+	/**
+	 * Compact on-flash encoding. Version MUST be increased when fields change.
+	 */
+	const EntryCodec::Field FORMAT_FIELDS[] = {
+		ENTRY_FIELD_TIMESTAMP_MS(Entry, timestamp),
+		ENTRY_FIELD_UINT(Entry, code, 2),
+		ENTRY_FIELD_UINT(Entry, meta1, 4),
+		ENTRY_FIELD_UINT(Entry, meta2, 4)
+	};
+
+	const EntryCodec::Format FORMAT = {1, FORMAT_FIELDS, sizeof(FORMAT_FIELDS) / sizeof(FORMAT_FIELDS[0])};
+
 	/** Log data store */
-	DataStore<Log::Entry> store(LOG_DATA_PATH, LOG_ENTRIES_PER_SUBMIT_REQ);
+	DataStore<Log::Entry> store(LOG_DATA_PATH, LOG_ENTRIES_PER_SUBMIT_REQ, &FORMAT);
 
 	/**
 	 * Timestamp of the last time a log has been recorded (log() called)
@@ -27,6 +41,11 @@ namespace Log
 	 */
 	bool _enabled = true;
 
+	/**
+	 * Logs are added from sensor tasks as well as the main task
+	 */
+	SemaphoreHandle_t _mutex = xSemaphoreCreateMutex();
+
 	/******************************************************************************
 	* Create log entry with current timestamp.
 	* @param code Error code
@@ -49,6 +68,8 @@ namespace Log
 		// debug_print(meta2);
 		// debug_println(F(" )"));
 
+		xSemaphoreTake(_mutex, portMAX_DELAY);
+
 		uint32_t cur_tstamp = RTC::get_timestamp();
 
 		entry.timestamp = cur_tstamp * 1000LL;
@@ -74,12 +95,15 @@ namespace Log
 			debug_print(F("Logging disabled, ignoring log: "));
 			print(&entry);
 			Utils::serial_style(STYLE_RESET);
+			xSemaphoreGive(_mutex);
 			return RET_ERROR;
 		}
 
 		store.add(&entry);
 		store.commit();
 
+		xSemaphoreGive(_mutex);
+
 		return RET_OK;
 	}
 
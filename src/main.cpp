@@ -34,6 +34,7 @@
 #include "lightning.h"
 #include "battery_gauge.h"
 #include "solar_monitor.h"
+#include "energy_monitor.h"
 #include "ipfs_client.h"
 
 // For testing
@@ -45,10 +46,13 @@
 #include "wifi_modem.h"
 #include "sdi12.h"
 #include "sdi12_sensor.h"
+#include "sensor_registry.h"
+#include "power_control.h"
 #include "dfrobot_liquid.h"
 #include "teros12.h"
 #include "soil_moisture_data.h"
 #include "water_level.h"
+#include "water_level_trend.h"
 #include "water_presence.h"
 #include "aquatroll.h"
 
@@ -179,24 +183,20 @@ void setup()
 	RTC::sync_time_from_ext_rtc();
 	RTC::enable_timechange_safety(true);
 
-	#ifdef TCALL_H
-		// Turn IP5306 power boost OFF to reduce idle current
-		Utils::ip5306_set_power_boost_state(false);
-	#endif
+	// Turn all power rails OFF (IP5306 power boost on TCall) to reduce idle current
+	PowerControl::init();
 
 	delay(100);
 	IntEnvSensor::init();
 	Battery::init();
+	EnergyMonitor::init();
 	BatteryGauge::init();
 	SolarMonitor::init();
 	delay(100);
 	Flash::mount();
 	Flash::ls();
 	GSM::init();
-	WaterSensors::init();
-	WaterLevel::init();
-	WaterPresence::init();
-	Atmos41::init();
+	SensorRegistry::init();
 
 	if(FO_SOURCE == FO_SOURCE_SNIFFER)
 	{
@@ -329,27 +329,10 @@ void setup()
 	//////////////////////////////////////////////////////////////////////////////////////////
 
 	// TODO: Make all tasks run on boot and remove this
-	if(FLAGS.WATER_QUALITY_SENSOR_ENABLED || FLAGS.WATER_LEVEL_SENSOR_ENABLED)
-	{
-		Utils::serial_style(STYLE_MAGENTA);
-		debug_println(F("Reading: Read water sensors"));
-		Utils::serial_style(STYLE_RESET);
-		WaterSensors::log();
-	}
-	if(FLAGS.ATMOS41_ENABLED)
-	{
-		Utils::serial_style(STYLE_CYAN);
-		debug_println(F("Reading: Read weather station"));
-		Utils::serial_style(STYLE_RESET);
-		Atmos41::measure_log();
-	}
-	if(FLAGS.SOIL_MOISTURE_SENSOR_ENABLED)
-	{
-		Utils::serial_style(STYLE_CYAN);
-		debug_println(F("Reading: Read soil moisture sensor"));
-		Utils::serial_style(STYLE_RESET);
-		Teros12::log();
-	}
+	Utils::serial_style(STYLE_MAGENTA);
+	debug_println(F("Reading: All enabled sensors"));
+	Utils::serial_style(STYLE_RESET);
+	SensorRegistry::log_all();
 
 	Utils::serial_style(STYLE_BLUE);
 	debug_println(F("Reason: Call home"));
@@ -480,62 +463,28 @@ void loop()
 		}
 
 		//
-		// Measure water quality
-		//
-		if(SleepScheduler::wakeup_reason_is(SleepScheduler::REASON_READ_WATER_SENSORS))
-		{
-			debug_println_i(F("Reason: Read water sensors"));
-
-			if(!FLAGS.WATER_QUALITY_SENSOR_ENABLED &&  !FLAGS.WATER_LEVEL_SENSOR_ENABLED)
-			{
-				debug_println_e(F("Water sensors disabled, measurement aborted."));
-			}
-			else
-			{
-				WaterSensors::log();
-			}
-		}
-
-		//
-		// Measure soil moisture
+		// Read sensors due
 		//
-		if(SleepScheduler::wakeup_reason_is(SleepScheduler::REASON_READ_SOIL_MOISTURE_SENSOR))
-		{
-			debug_println_i(F("Reason: Read soil moisture"));
-
-			if(!FLAGS.SOIL_MOISTURE_SENSOR_ENABLED)
-			{
-				debug_println_e(F("Soil moisture sensor disabled, measurement aborted."));
-			}
-			else
-			{
-				Teros12::log();
-			}
-		}
-
-		//
-		// Measure weather data
-		//
-		if(SleepScheduler::wakeup_reason_is(SleepScheduler::REASON_READ_WEATHER_STATION))
-		{
-			debug_println_i(F("Reason: Read weather station"));
+		SensorRegistry::log_due();
 
-			if(!FLAGS.ATMOS41_ENABLED)
-			{
-				debug_println_e(F("Weather station disabled, measurement aborted."));
-			}
-			else
-			{
-				Atmos41::measure_log();
-			}
-		}
+		Sdi12::print_latency_histograms();
+		SensorRegistry::print_stats();
 	}
 	
+	// Early call home requested by water level burst sampling. Consumed on every
+	// wake up so it is not repeated after a scheduled call home.
+	bool burst_call_home = WaterLevelTrend::take_call_home_request();
+
 	if(SleepScheduler::wakeup_reason_is(SleepScheduler::REASON_CALL_HOME))
 	{
 		debug_println_i(F("Reason: Call home"));
 		CallHome::start();
 	}
+	else if(burst_call_home)
+	{
+		debug_println_i(F("Reason: Call home (water level burst)"));
+		CallHome::start();
+	}
 
 	debug_println(F("------------------------------------------------"));
 }
\ No newline at end of file
@@ -1,20 +1,261 @@
 #include "Arduino.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "driver/rtc_io.h"
+#include "esp_sleep.h"
 #include "power_control.h"
+#include "app_config.h"
+#include "const.h"
+#include "utils.h"
+#include "common.h"
 
 /******************************************************************************
 * Controls various power sources
 ******************************************************************************/
 namespace PowerControl
 {
-    RetResult switch_12v(bool on)
+    /**
+     * Rail configuration
+     */
+    struct RailConfig
     {
+        const char *name;
+
+        // Switch pin (active high), -1 if switched otherwise
+        int pin;
+
+        // Time for powered peripherals to boot
+        uint32_t warm_up_ms;
+
+        // Rail this one is powered from, acquired along with it
+        Rail parent;
+    };
+
+    /**
+     * Rail state
+     */
+    struct RailState
+    {
+        int refs;
+        uint32_t on_ms;
+
+        // Times rail was power cycled
+        uint32_t cycles;
+    };
+
+    const RailConfig RAILS[RAIL_COUNT] = {
+        [RAIL_BOOST] = {"boost", -1, POWER_RAIL_BOOST_WARM_UP_MS, RAIL_NONE},
+#ifdef TCALL_H
+        [RAIL_SENSORS] = {"sensors", PIN_WATER_SENSORS_PWR, POWER_RAIL_SENSORS_WARM_UP_MS, RAIL_BOOST}
+#else
+        [RAIL_SENSORS] = {"sensors", PIN_WATER_SENSORS_PWR, POWER_RAIL_SENSORS_WARM_UP_MS, RAIL_NONE}
+#endif
+    };
+
+    //
+    // Private functions
+    //
+    void switch_rail(Rail rail, bool on);
+
+    //
+    // Private members
+    //
+    RailState _rails[RAIL_COUNT] = {0};
+
+    /** Rails are acquired from sensor tasks as well as the main task */
+    SemaphoreHandle_t _mutex = xSemaphoreCreateMutex();
+
+    /******************************************************************************
+     * Setup rail pins and make sure all rails are off
+     *****************************************************************************/
+    RetResult init()
+    {
+        for(int i = 0; i < RAIL_COUNT; i++)
+        {
+            _rails[i].refs = 0;
+            switch_rail((Rail)i, false);
+        }
+
+        // Sensors rail pin is held through light sleep, keep RTC peripherals powered
+        esp_sleep_pd_config(esp_sleep_pd_domain_t::ESP_PD_DOMAIN_RTC_PERIPH, esp_sleep_pd_option_t::ESP_PD_OPTION_ON);
+        rtc_gpio_pulldown_en(PIN_WATER_SENSORS_PWR);
+        rtc_gpio_set_direction(PIN_WATER_SENSORS_PWR, rtc_gpio_mode_t::RTC_GPIO_MODE_OUTPUT_ONLY);
+
+        return RET_OK;
+    }
+
+    /******************************************************************************
+     * Switch rail on if not already on and wait until it has warmed up
+     * Must be matched by a release()
+     *****************************************************************************/
+    RetResult acquire(Rail rail)
+    {
+        if(rail <= RAIL_NONE || rail >= RAIL_COUNT)
+            return RET_ERROR;
+
+        const RailConfig *config = &RAILS[rail];
+
+        if(config->parent != RAIL_NONE && acquire(config->parent) != RET_OK)
+            return RET_ERROR;
+
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+
+        if(_rails[rail].refs++ == 0)
+        {
+            switch_rail(rail, true);
+            _rails[rail].on_ms = millis();
+        }
+
+        uint32_t on_ms = _rails[rail].on_ms;
+
+        xSemaphoreGive(_mutex);
+
+        // Only the remaining warm-up when rail is already on
+        uint32_t elapsed_ms = millis() - on_ms;
+        if(elapsed_ms < config->warm_up_ms)
+            delay(config->warm_up_ms - elapsed_ms);
+
+        return RET_OK;
+    }
+
+    /******************************************************************************
+     * Release rail, switched off when it has no other users
+     *****************************************************************************/
+    RetResult release(Rail rail)
+    {
+        if(rail <= RAIL_NONE || rail >= RAIL_COUNT)
+            return RET_ERROR;
+
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+
+        if(_rails[rail].refs == 0)
+        {
+            xSemaphoreGive(_mutex);
+
+            debug_print_w(F("Power rail not acquired: "));
+            debug_println(RAILS[rail].name);
+            return RET_ERROR;
+        }
+
+        if(--_rails[rail].refs == 0)
+            switch_rail(rail, false);
+
+        xSemaphoreGive(_mutex);
+
+        if(RAILS[rail].parent != RAIL_NONE)
+            release(RAILS[rail].parent);
+
+        return RET_OK;
+    }
+
+    /******************************************************************************
+     * Switch rail off and on again (eg. to reset a stuck sensor) and wait until
+     * it has warmed up. Rail must be acquired by the caller and not shared, a
+     * shared rail is not cycled so other users don't lose power mid-measurement.
+     * @return RET_ERROR if rail is not held by the caller alone
+     *****************************************************************************/
+    RetResult cycle(Rail rail)
+    {
+        if(rail <= RAIL_NONE || rail >= RAIL_COUNT)
+            return RET_ERROR;
+
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+
+        if(_rails[rail].refs != 1)
+        {
+            xSemaphoreGive(_mutex);
+
+            debug_print_w(F("Power rail shared, not cycled: "));
+            debug_println(RAILS[rail].name);
+            return RET_ERROR;
+        }
+
+        switch_rail(rail, false);
+        switch_rail(rail, true);
+        _rails[rail].on_ms = millis();
+        _rails[rail].cycles++;
+
+        xSemaphoreGive(_mutex);
+
+        delay(RAILS[rail].warm_up_ms);
+
+        return RET_OK;
+    }
+
+    /******************************************************************************
+     * Rail is on (may still be warming up)
+     *****************************************************************************/
+    bool is_on(Rail rail)
+    {
+        if(rail <= RAIL_NONE || rail >= RAIL_COUNT)
+            return false;
+
+        return _rails[rail].refs > 0;
+    }
+
+    /******************************************************************************
+     * Rail is on and warmed up
+     *****************************************************************************/
+    bool is_ready(Rail rail)
+    {
+        return is_on(rail) && millis() - _rails[rail].on_ms >= RAILS[rail].warm_up_ms;
+    }
+
+    /******************************************************************************
+     * Number of times rail was power cycled since boot
+     *****************************************************************************/
+    uint32_t get_cycle_count(Rail rail)
+    {
+        if(rail <= RAIL_NONE || rail >= RAIL_COUNT)
+            return 0;
+
+        return _rails[rail].cycles;
+    }
+
+    /******************************************************************************
+     * Hold rail pin level through light sleep
+     *****************************************************************************/
+    void hold(Rail rail, bool enable)
+    {
+        if(rail <= RAIL_NONE || rail >= RAIL_COUNT || RAILS[rail].pin < 0)
+            return;
+
+        if(enable)
+            rtc_gpio_hold_en((gpio_num_t)RAILS[rail].pin);
+        else
+            rtc_gpio_hold_dis((gpio_num_t)RAILS[rail].pin);
+    }
+
+    /******************************************************************************
+     * Switch rail power
+     *****************************************************************************/
+    void switch_rail(Rail rail, bool on)
+    {
+        const RailConfig *config = &RAILS[rail];
+
+        debug_printf("Power rail %s %s.\n", config->name, on ? "ON" : "OFF");
+
+        if(rail == RAIL_BOOST)
+        {
+            #ifdef TCALL_H
+                Utils::ip5306_set_power_boost_state(on);
+            #endif
+            return;
+        }
+
+        pinMode(config->pin, OUTPUT);
+
         if(on)
         {
-            digitalWrite(PIN_WATER_SENSORS_PWR, 0);
+            digitalWrite(config->pin, 1);
         }
         else
         {
-            digitalWrite(PIN_WATER_SENSORS_PWR, 1);
+            // Set to input instead of driving low to prevent LED on TSIM from turning ON
+            // pinMode(config->pin, INPUT);
+            digitalWrite(config->pin, 0);
+            rtc_gpio_set_level((gpio_num_t)config->pin, 0);
+            delay(POWER_RAIL_OFF_DELAY_MS);
         }
     }
-}
\ No newline at end of file
+}
@@ -1,98 +1,341 @@
 #include "sdi12.h"
+#include <driver/gpio.h>
+#include <rom/gpio.h>
+#include <soc/gpio_sig_map.h>
 #include "common.h"
 
+QueueHandle_t Sdi12::_uart_queues[UART_NUM_MAX] = {NULL};
+int Sdi12::_instances[UART_NUM_MAX] = {0};
+esp_timer_handle_t Sdi12::_break_timer = NULL;
+SemaphoreHandle_t Sdi12::_break_done = NULL;
+volatile int Sdi12::_break_stage = 0;
+gpio_num_t Sdi12::_break_pin;
+uint32_t Sdi12::_last_activity_ms = 0;
+char Sdi12::_last_address = 0;
+Sdi12::LatencyHistogram Sdi12::_latency[CMD_TYPES_COUNT];
+Sdi12::Transport Sdi12::_transport = nullptr;
+
+/** GPIO matrix signals of each UART */
+static const uint32_t UART_TX_SIGNALS[UART_NUM_MAX] = {U0TXD_OUT_IDX, U1TXD_OUT_IDX, U2TXD_OUT_IDX};
+static const uint32_t UART_RX_SIGNALS[UART_NUM_MAX] = {U0RXD_IN_IDX, U1RXD_IN_IDX, U2RXD_IN_IDX};
+
+/** Break timer stages */
+enum BreakStage
+{
+	BREAK_STAGE_SPACING,
+	BREAK_STAGE_MARKING
+};
+
 /******************************************************************************
 * Constructor
-* Set hw serial and rx/tx pin on construct
-* @param serial HW serial instance to use. Must be initiated externally
-*               and provided by user
+* Installs UART driver on first use, later instances share it
+* @param uart_num UART to use
 * @param data_pin Pin to use for data comm pin
 ******************************************************************************/
-Sdi12::Sdi12(int uart_num, gpio_num_t data_pin) : _serial(uart_num)
+Sdi12::Sdi12(int uart_num, gpio_num_t data_pin)
 {
+	_uart_num = uart_num;
 	_data_pin = data_pin;
 
+	_instances[_uart_num]++;
+
+	// Bus is simulated, leave hardware alone
+	if(_transport != nullptr)
+		return;
+
+	if(_uart_queues[_uart_num] == NULL)
+	{
+		uart_config_t config = {};
+		config.baud_rate = BAUD_RATE;
+		config.data_bits = UART_DATA_7_BITS;
+		config.parity = UART_PARITY_EVEN;
+		config.stop_bits = UART_STOP_BITS_1;
+		config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+		config.rx_flow_ctrl_thresh = 0;
+
+		uart_param_config(_uart_num, &config);
+
+		// SDI12 logic is inverted (marking is low)
+		uart_set_line_inverse(_uart_num, UART_INVERSE_RXD | UART_INVERSE_TXD);
+
+		if(uart_driver_install(_uart_num, UART_RX_BUFF_SIZE, 0, UART_QUEUE_LEN, &_uart_queues[_uart_num], 0) != ESP_OK)
+		{
+			debug_println_e(F("Could not install SDI12 UART driver."));
+		}
+	}
+
+	if(_break_timer == NULL)
+	{
+		_break_done = xSemaphoreCreateBinary();
+
+		esp_timer_create_args_t timer_args;
+		timer_args.callback = break_timer_cb;
+		timer_args.arg = NULL;
+		timer_args.dispatch_method = ESP_TIMER_TASK;
+		timer_args.name = "sdi12_break";
+
+		esp_timer_create(&timer_args, &_break_timer);
+	}
+
 	switch_to_rx();
 }
 
 /******************************************************************************
-* Switch serial to TX mode
+* Destructor
+* Deletes UART driver with the last instance
+******************************************************************************/
+Sdi12::~Sdi12()
+{
+	if(--_instances[_uart_num] > 0 || _uart_queues[_uart_num] == NULL)
+		return;
+
+	uart_driver_delete(_uart_num);
+	_uart_queues[_uart_num] = NULL;
+
+	// Release line
+	gpio_matrix_out(_data_pin, SIG_GPIO_OUT_IDX, false, false);
+	gpio_set_direction(_data_pin, GPIO_MODE_INPUT);
+}
+
+/******************************************************************************
+* Switch data pin to UART TX
 ******************************************************************************/
 void Sdi12::switch_to_tx()
 {
     _state = STATE_TX;
 
-    // Restart UART with data pin set to TX and a dummy pin for RX
-    gpio_set_direction(_data_pin, gpio_mode_t::GPIO_MODE_DISABLE);
-    _serial.begin(BAUD_RATE, SERIAL_7E1, 999, _data_pin, true, UART_TIMEOUT_MS);
+	gpio_set_direction(_data_pin, GPIO_MODE_INPUT_OUTPUT);
+	gpio_matrix_out(_data_pin, UART_TX_SIGNALS[_uart_num], false, false);
 }
 
 /******************************************************************************
-* Switch serial to RX mode
+* Switch data pin to UART RX and release the line
 ******************************************************************************/
 void Sdi12::switch_to_rx()
 {
     _state = STATE_LISTENING;
 
-    // Restart UART with data pin set to RX and a dummy pin for TX
-    gpio_set_direction(_data_pin, gpio_mode_t::GPIO_MODE_DISABLE);
-    _serial.begin(BAUD_RATE, SERIAL_7E1, _data_pin, 999, true, UART_TIMEOUT_MS);
+	gpio_matrix_out(_data_pin, SIG_GPIO_OUT_IDX, false, false);
+	gpio_set_direction(_data_pin, GPIO_MODE_INPUT);
+	gpio_matrix_in(_data_pin, UART_RX_SIGNALS[_uart_num], false);
 }
 
 /******************************************************************************
-* Check for available bytes in buffer
-* @returns Number of available bytes
+* Send a command and wait for its response. Returns as soon as the response
+* terminator (<CR><LF>) is received.
+* @param cmd		Command
+* @param response	Output, response without terminator, null terminated
+* @param length		Response buffer size
+* @returns Number of bytes received, 0 on timeout or failure
 ******************************************************************************/
-int Sdi12::available(void)
+size_t Sdi12::transaction(const char *cmd, char *response, size_t length)
 {
-	return _serial.available();
+	if(_transport != nullptr)
+		return _transport(cmd, response, length);
+
+	if(_uart_queues[_uart_num] == NULL || length < 1)
+		return 0;
+
+	response[0] = '\0';
+
+	// Break can be skipped when addressing the same, still awake sensor
+	bool full_break = cmd[0] != _last_address || millis() - _last_activity_ms > BREAK_SKIP_MS;
+
+	if(send_break(full_break) != RET_OK)
+	{
+		switch_to_rx();
+		return 0;
+	}
+
+	switch_to_tx();
+	uart_write_bytes(_uart_num, cmd, strlen(cmd));
+	uart_wait_tx_done(_uart_num, pdMS_TO_TICKS(UART_TIMEOUT_MS));
+	switch_to_rx();
+
+	// Drop own command echoed back on the shared pin
+	uart_flush_input(_uart_num);
+	xQueueReset(_uart_queues[_uart_num]);
+
+	int64_t start_us = esp_timer_get_time();
+
+	size_t bytes = receive(response, length);
+
+	LatencyHistogram *histogram = &_latency[command_type(cmd)];
+	if(bytes == 0)
+	{
+		histogram->timeouts++;
+	}
+	else
+	{
+		int bucket = (esp_timer_get_time() - start_us) / 1000 / SDI12_LATENCY_BUCKET_MS;
+		if(bucket >= SDI12_LATENCY_BUCKETS)
+			bucket = SDI12_LATENCY_BUCKETS - 1;
+
+		histogram->buckets[bucket]++;
+	}
+
+	_last_address = cmd[0];
+	_last_activity_ms = millis();
+
+	return bytes;
 }
 
 /******************************************************************************
-* Read a byte from the rx buffer
-* @returns Number of bytes read, -1 if no data available
+* Receive response from the UART event queue until <LF>
+* @returns Number of bytes received, without <CR><LF>
 ******************************************************************************/
-int Sdi12::read()
+size_t Sdi12::receive(char *response, size_t length)
 {
-	if(_state != STATE_LISTENING)
-		switch_to_rx();
+	QueueHandle_t queue = _uart_queues[_uart_num];
+	uint32_t start_ms = millis();
+	size_t bytes = 0;
+
+	while(true)
+	{
+		uint32_t elapsed_ms = millis() - start_ms;
+		if(elapsed_ms >= UART_TIMEOUT_MS)
+			return 0;
+
+		uart_event_t event;
+		if(xQueueReceive(queue, &event, pdMS_TO_TICKS(UART_TIMEOUT_MS - elapsed_ms)) != pdTRUE)
+			return 0;
+
+		if(event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL)
+		{
+			uart_flush_input(_uart_num);
+			xQueueReset(queue);
+			return 0;
+		}
+
+		if(event.type != UART_DATA)
+			continue;
+
+		size_t remaining = event.size;
+		while(remaining > 0)
+		{
+			uint8_t data[SDI12_RECV_BUFF_SIZE];
+			int read = uart_read_bytes(_uart_num, data, remaining < sizeof(data) ? remaining : sizeof(data), 0);
+			if(read <= 0)
+				break;
+
+			remaining -= read;
 
-	return _serial.read();
+			for(int i = 0; i < read; i++)
+			{
+				if(data[i] == '\n')
+				{
+					// Strip <CR>
+					if(bytes > 0 && response[bytes - 1] == '\r')
+						bytes--;
+
+					response[bytes] = '\0';
+					return bytes;
+				}
+
+				// Keep room for string termination
+				if(bytes < length - 1)
+					response[bytes++] = data[i];
+			}
+		}
+	}
 }
 
 /******************************************************************************
-* Read bytes from the rx buffer until a delimiter is found
-* @returns Number of bytes read
+* Send break (12ms spacing) followed by marking (8.33ms), timed by esp_timer
+* @param full_break	False to only send marking
 ******************************************************************************/
-size_t Sdi12::readBytesUntil(char terminator, char *buffer, size_t length)
+RetResult Sdi12::send_break(bool full_break)
 {
-	if(_state != STATE_LISTENING)
-		switch_to_rx();
+	_break_pin = _data_pin;
+	_break_stage = full_break ? BREAK_STAGE_SPACING : BREAK_STAGE_MARKING;
+
+	gpio_matrix_out(_data_pin, SIG_GPIO_OUT_IDX, false, false);
+	gpio_set_direction(_data_pin, GPIO_MODE_INPUT_OUTPUT);
+	gpio_set_level(_data_pin, full_break ? 1 : 0);
 
-	return _serial.readBytesUntil(terminator, buffer, length);
+	xSemaphoreTake(_break_done, 0);
+	esp_timer_start_once(_break_timer, full_break ? BREAK_US : MARKING_US);
+
+	if(xSemaphoreTake(_break_done, pdMS_TO_TICKS(UART_TIMEOUT_MS)) != pdTRUE)
+	{
+		debug_println_e(F("SDI12 break timeout."));
+		return RET_ERROR;
+	}
+
+	return RET_OK;
 }
 
 /******************************************************************************
-* Write an SDI12 command
-* @returns Number of bytes written
+* Break timer callback. Ends spacing, then marking.
 ******************************************************************************/
-size_t Sdi12::write_command(char *cmd)
+void Sdi12::break_timer_cb(void *arg)
 {
-	pinMode(_data_pin, OUTPUT);
-	digitalWrite(_data_pin, 1);
-	delay(20);
-	digitalWrite(_data_pin, 0);
-	delay(15);
+	if(_break_stage == BREAK_STAGE_SPACING)
+	{
+		gpio_set_level(_break_pin, 0);
+		_break_stage = BREAK_STAGE_MARKING;
+		esp_timer_start_once(_break_timer, MARKING_US);
+		return;
+	}
 
-	switch_to_tx();
+	xSemaphoreGive(_break_done);
+}
 
-	size_t ret = _serial.write(cmd);
-	_serial.flush();
-	_serial.end();
+/******************************************************************************
+* Command type from command string (aM!, aMC!, aC!, aCC!, aDx! ...)
+******************************************************************************/
+Sdi12::CommandType Sdi12::command_type(const char *cmd)
+{
+	if(cmd[0] == '\0')
+		return CMD_OTHER;
 
-	switch_to_rx();
+	switch(cmd[1])
+	{
+		case 'M':
+		case 'C':
+			return CMD_MEASURE;
+		case 'D':
+			return CMD_DATA;
+		default:
+			return CMD_OTHER;
+	}
+}
+
+/******************************************************************************
+* Get response latency histogram of a command type
+******************************************************************************/
+const Sdi12::LatencyHistogram* Sdi12::get_latency_histogram(CommandType type)
+{
+	return &_latency[type];
+}
+
+/******************************************************************************
+* Clear response latency histograms
+******************************************************************************/
+void Sdi12::clear_latency_histograms()
+{
+	memset(_latency, 0, sizeof(_latency));
+}
+
+/******************************************************************************
+* Print response latency histograms
+******************************************************************************/
+void Sdi12::print_latency_histograms()
+{
+	const char *names[CMD_TYPES_COUNT] = {"Measure", "Data", "Other"};
 
-	return ret;
+	for(int type = 0; type < CMD_TYPES_COUNT; type++)
+	{
+		debug_printf("SDI12 %s latency (ms):", names[type]);
+
+		for(int i = 0; i < SDI12_LATENCY_BUCKETS; i++)
+		{
+			if(_latency[type].buckets[i] > 0)
+				debug_printf(" <%d: %u", (i + 1) * SDI12_LATENCY_BUCKET_MS, _latency[type].buckets[i]);
+		}
+
+		debug_printf(" timeouts: %u\n", _latency[type].timeouts);
+	}
 }
 
 /******************************************************************************
@@ -123,12 +366,25 @@ bool Sdi12::check_crc(const char *buff)
     debug_print(F("CRC: "));
     debug_println(input_crc);
 
-	// Calculate
+	char calced_crc_str[4] = "";
+	calc_crc(buff, data_length - 3, calced_crc_str);
+
+	return strcmp(input_crc, calced_crc_str) == 0;
+}
+
+/******************************************************************************
+* Calculate SDI12 CRC (CRC-16 encoded as 3 ASCII chars)
+* @param data		Data
+* @param length		Data length
+* @param crc_out	Output, 3 CRC chars and string termination
+******************************************************************************/
+void Sdi12::calc_crc(const char *data, size_t length, char crc_out[4])
+{
 	uint16_t calced_crc = 0;
 
-	for (int i = 0; i < data_length - 3; i++)
+	for (size_t i = 0; i < length; i++)
 	{
-		calced_crc = buff[i] ^ calced_crc;
+		calced_crc = data[i] ^ calced_crc;
 
 		for (int j = 1; j <= 8; j++)
 		{
@@ -144,10 +400,17 @@ bool Sdi12::check_crc(const char *buff)
 		}
 	}
 
-	char calced_crc_str[4] = "";
-	calced_crc_str[0] = 0x40 | (calced_crc >> 12);
-	calced_crc_str[1] = 0x40 | ((calced_crc >> 6) & 0x3F);
-	calced_crc_str[2] = 0x40 | (calced_crc & 0x3F);
+	crc_out[0] = 0x40 | (calced_crc >> 12);
+	crc_out[1] = 0x40 | ((calced_crc >> 6) & 0x3F);
+	crc_out[2] = 0x40 | (calced_crc & 0x3F);
+	crc_out[3] = '\0';
+}
 
-	return strcmp(input_crc, calced_crc_str) == 0;
-}
\ No newline at end of file
+/******************************************************************************
+* Route transactions to a transport instead of the UART
+* @param transport	Transport, nullptr to use the UART again
+******************************************************************************/
+void Sdi12::set_transport(Transport transport)
+{
+	_transport = transport;
+}
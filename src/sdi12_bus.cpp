@@ -0,0 +1,178 @@
+#include <Arduino.h>
+#include "sdi12_bus.h"
+#include "sdi12_sensor.h"
+#include "water_sensors.h"
+#include "app_config.h"
+#include "const.h"
+#include "log.h"
+#include "common.h"
+
+namespace Sdi12Bus
+{
+	/**
+	 * Concurrent measurement waiting to be collected by a driver
+	 */
+	struct Measurement
+	{
+		char address;
+		uint8_t vals;
+	};
+
+	//
+	// Private functions
+	//
+	int unique_addresses(const char addresses[], int count, char unique_out[]);
+
+	//
+	// Private members
+	//
+	Measurement _pending[SDI12_BUS_MAX_SENSORS];
+	int _pending_count = 0;
+	bool _active = false;
+
+	/******************************************************************************
+	 * Power sensors and start a concurrent measurement on each address. Returns
+	 * when the slowest sensor is ready. Sensors stay powered until end().
+	 * Sensors that fail to start are measured on their own by their driver.
+	 * @param addresses	SDI12 addresses of the sensors to measure
+	 * @param count		Number of addresses
+	 * @return RET_ERROR if no measurement was started
+	 *****************************************************************************/
+	RetResult start(const char addresses[], int count)
+	{
+		end();
+
+		char unique[SDI12_BUS_MAX_SENSORS];
+		count = unique_addresses(addresses, count, unique);
+
+		// Sensors sharing an address cannot be measured concurrently
+		if(count < 2)
+		{
+			debug_println(F("Less than 2 unique SDI12 addresses, sensors measured one by one."));
+			return RET_ERROR;
+		}
+
+		// All SDI12 sensors are on the same power rail, held until end()
+		WaterSensors::on();
+		_active = true;
+
+		uint16_t max_secs = 0;
+		uint32_t start_ms = millis();
+
+		for(int i = 0; i < count; i++)
+		{
+			Sdi12Sensor sensor(PIN_SDI12_DATA, unique[i]);
+
+			uint16_t secs_to_wait = 0;
+			uint8_t measurement_vals = 0;
+
+			if(sensor.start_concurrent(&secs_to_wait, &measurement_vals) != RET_OK ||
+				secs_to_wait > SDI12_BUS_MEASURE_WAIT_SEC_MAX)
+			{
+				debug_printf("Could not start concurrent measurement on sensor %c.\n", unique[i]);
+				continue;
+			}
+
+			_pending[_pending_count].address = unique[i];
+			_pending[_pending_count].vals = measurement_vals;
+			_pending_count++;
+
+			if(secs_to_wait > max_secs)
+				max_secs = secs_to_wait;
+		}
+
+		if(_pending_count == 0)
+			return RET_ERROR;
+
+		// Sensors were started one after the other, slowest one is ready at most
+		// max_secs after the first command
+		uint32_t wait_ms = (uint32_t)(max_secs + SDI12_MEASURE_EXTRA_WAIT_SECS) * 1000;
+		uint32_t elapsed_ms = millis() - start_ms;
+
+		debug_printf("Waiting for %d concurrent measurements (sec): %d\n", _pending_count, max_secs + SDI12_MEASURE_EXTRA_WAIT_SECS);
+
+		// Concurrent measurements send no service request
+		if(elapsed_ms < wait_ms)
+			WaterSensors::sleep(wait_ms - elapsed_ms);
+
+		Log::log(Log::SDI12_CONCURRENT_MEASUREMENT, _pending_count, max_secs);
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Drop uncollected measurements and power sensors off
+	 *****************************************************************************/
+	void end()
+	{
+		_pending_count = 0;
+
+		if(!_active)
+			return;
+
+		_active = false;
+		WaterSensors::off();
+	}
+
+	/******************************************************************************
+	 * Sensors are powered by the bus, drivers must not turn them off
+	 *****************************************************************************/
+	bool is_active()
+	{
+		return _active;
+	}
+
+	/******************************************************************************
+	 * Collect a completed concurrent measurement. Each measurement can only be
+	 * collected once.
+	 * @param address			SDI12 address of the sensor
+	 * @param measurement_vals	Output, number of values measured
+	 * @return True if a measurement was found
+	 *****************************************************************************/
+	bool take_measurement(char address, uint8_t *measurement_vals)
+	{
+		for(int i = 0; i < _pending_count; i++)
+		{
+			if(_pending[i].address != address)
+				continue;
+
+			*measurement_vals = _pending[i].vals;
+
+			_pending[i] = _pending[--_pending_count];
+
+			return true;
+		}
+
+		return false;
+	}
+
+	/******************************************************************************
+	 * Copy addresses without duplicates
+	 * @param addresses		SDI12 addresses
+	 * @param count			Number of addresses
+	 * @param unique_out	Output, max SDI12_BUS_MAX_SENSORS addresses
+	 * @return Number of unique addresses
+	 *****************************************************************************/
+	int unique_addresses(const char addresses[], int count, char unique_out[])
+	{
+		int unique = 0;
+
+		for(int i = 0; i < count && unique < SDI12_BUS_MAX_SENSORS; i++)
+		{
+			bool found = false;
+			for(int j = 0; j < unique; j++)
+			{
+				if(unique_out[j] == addresses[i])
+				{
+					found = true;
+					break;
+				}
+			}
+
+			if(!found)
+				unique_out[unique++] = addresses[i];
+		}
+
+		return unique;
+	}
+}
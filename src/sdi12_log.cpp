@@ -13,7 +13,7 @@ namespace SDI12Log
 	/******************************************************************************
 	 * Add entry
 	 *****************************************************************************/
-	RetResult add(char *response)
+	RetResult add(const char *response)
 	{
 		// To prevent duplicate timestamps (as in Log)
 		static uint32_t _last_log_tstamp = 0;
@@ -0,0 +1,192 @@
+#include "sdi12_profile.h"
+#include "sdi12_sensor.h"
+#include "app_config.h"
+#include "const.h"
+#include "log.h"
+#include "utils.h"
+#include "common.h"
+
+namespace Sdi12Profile
+{
+	//
+	// Private functions
+	//
+	RetResult read_batch(Sdi12Sensor *sensor, const Profile *profile, uint8_t batch, float vals[], int first, int *count);
+	void store_field(const Field *field, float val, void *out);
+
+	/******************************************************************************
+	 * Measure a sensor and fill its output structure
+	 * Data is requested batch after batch (aD0!, aD1! ...) without delays, until
+	 * all values are received. Each batch is retried on CRC, parse or range
+	 * failure.
+	 * @param profile	Sensor profile
+	 * @param out		Output structure, profile->out_size bytes
+	 *****************************************************************************/
+	RetResult measure(const Profile *profile, void *out)
+	{
+		memset(out, 0, profile->out_size);
+
+		if(profile->values > SDI12_PROFILE_MAX_VALUES)
+			return RET_ERROR;
+
+		Sdi12Sensor sensor(PIN_SDI12_DATA, profile->address);
+
+		// Output variables
+		// Seconds to wait
+		uint16_t secs_to_wait = 0;
+		// Vals to be measured
+		uint8_t measured_values = 0;
+
+		if(sensor.measure(&secs_to_wait, &measured_values) != RET_OK)
+		{
+			if(sensor.get_last_error() == Sdi12Sensor::ERROR_INVALID_RESPONSE)
+			{
+				debug_println(F("Invalid response returned."));
+
+				Log::log(profile->invalid_response_code, strlen(sensor.get_buffer()));
+			}
+
+			return RET_ERROR;
+		}
+
+		// Check if seconds within range. If not, something is wrong with the response
+		// or with the configuration of the sensor
+		if(secs_to_wait > profile->wait_sec_max)
+		{
+			debug_print(F("Invalid number of seconds to wait for measurements: "));
+			debug_println(secs_to_wait, DEC);
+			return RET_ERROR;
+		}
+		// The exact number of measured values is known and configured into the sensor
+		if(measured_values != profile->values)
+		{
+			debug_printf("Invalid number of measured values. Expected: %d, returned: %d\n", profile->values, measured_values);
+			return RET_ERROR;
+		}
+
+		sensor.wait_measurement(secs_to_wait);
+
+		//
+		// Request measurement data
+		// Data will be copied to output structure only after successfull measurement
+		//
+		float vals[SDI12_PROFILE_MAX_VALUES];
+		int received = 0;
+
+		for(uint8_t batch = 0; received < profile->values; batch++)
+		{
+			if(batch >= SDI12_MAX_DATA_BATCHES)
+			{
+				debug_println(F("Sensor did not return all values, aborting."));
+				return RET_ERROR;
+			}
+
+			int count = 0;
+			if(read_batch(&sensor, profile, batch, vals, received, &count) != RET_OK)
+			{
+				debug_println(F("Aborting"));
+				return RET_ERROR;
+			}
+
+			received += count;
+		}
+
+		//
+		// All data received successfully, fill structure
+		//
+		bool all_zero = true;
+		for(int i = 0; i < profile->values; i++)
+		{
+			if(profile->fields[i].type == FIELD_NONE)
+				continue;
+
+			store_field(&profile->fields[i], vals[i], out);
+
+			if(vals[i] != 0)
+				all_zero = false;
+		}
+
+		if(profile->reject_zero_vals && all_zero)
+		{
+			debug_println(F("All measured vals are 0, aborting."));
+			Log::log(profile->zero_vals_code);
+			return RET_ERROR;
+		}
+
+		if(profile->post_process != nullptr)
+			profile->post_process(out);
+
+		Utils::serial_style(STYLE_GREEN);
+		debug_printf("All %s data is received successfully.\n", profile->name);
+		Utils::serial_style(STYLE_RESET);
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Request a data batch, retrying on failure
+	 * @param sensor	Sensor
+	 * @param profile	Sensor profile
+	 * @param batch		Batch number (x in aDx!)
+	 * @param vals		Output, all values of the measurement
+	 * @param first		Index of the batch's first value
+	 * @param count		Output, number of values in batch
+	 *****************************************************************************/
+	RetResult read_batch(Sdi12Sensor *sensor, const Profile *profile, uint8_t batch, float vals[], int first, int *count)
+	{
+		int tries = profile->tries;
+
+		while(tries--)
+		{
+			bool valid = sensor->read_data(batch, &vals[first], profile->values - first, count) == RET_OK && *count > 0;
+
+			// Check ranges
+			for(int i = first; valid && i < first + *count; i++)
+			{
+				const Field *field = &profile->fields[i];
+
+				if(field->min < field->max && (vals[i] < field->min || vals[i] > field->max))
+				{
+					debug_printf("Value %d out of range: %f\n", i, vals[i]);
+					valid = false;
+				}
+			}
+
+			if(valid)
+				return RET_OK;
+
+			debug_print(F("Could not get measurement results for batch: "));
+			debug_println(batch, DEC);
+
+			Log::log(profile->data_req_failed_code, batch);
+
+			if(tries > 0)
+			{
+				debug_println(F("Retrying"));
+				delay(profile->retry_delay_ms);
+			}
+		}
+
+		return RET_ERROR;
+	}
+
+	/******************************************************************************
+	 * Store a value in the output structure (may be unaligned, structures are
+	 * packed)
+	 *****************************************************************************/
+	void store_field(const Field *field, float val, void *out)
+	{
+		uint8_t *dest = (uint8_t*)out + field->offset;
+		val *= field->scale;
+
+		if(field->type == FIELD_FLOAT)
+		{
+			memcpy(dest, &val, sizeof(val));
+		}
+		else if(field->type == FIELD_INT16)
+		{
+			int16_t int_val = val;
+			memcpy(dest, &int_val, sizeof(int_val));
+		}
+	}
+}
@@ -1,6 +1,8 @@
 #include "sdi12_sensor.h"
 #include "app_config.h"
 #include "sdi12_log.h"
+#include "sdi12_bus.h"
+#include "water_sensors.h"
 
 /******************************************************************************
  * Default constructor (private)
@@ -9,29 +11,29 @@
 /******************************************************************************
  * Constructor
  *****************************************************************************/
-Sdi12Sensor::Sdi12Sensor(gpio_num_t data_pin) : _sdi12(SDI12_UART_NUM, data_pin)
+Sdi12Sensor::Sdi12Sensor(gpio_num_t data_pin, char address) : _sdi12(SDI12_UART_NUM, data_pin), _data_pin(data_pin), _address(address)
 {
 
 }
 
 /******************************************************************************
-* Read whole response (until \r) into buffer. Times out if no response.
-* Removes \r charcater and replaces with \0
+* Send command and read whole response into buffer. Times out if no response.
 * @return Number of bytes read or 0 on timeout or failure
 ******************************************************************************/
-size_t Sdi12Sensor::read_response()
+size_t Sdi12Sensor::transaction(const char *cmd)
 {
-    size_t bytes = _sdi12.readBytesUntil('\r', _buff, sizeof(_buff));
+    #ifdef DEBUG
+        debug_print(F("SDI12 writing command: "));
+        debug_println(cmd);
+    #endif
 
-    // Put string termination at the end of the response
-    if(bytes > sizeof(_buff) - 1)
-    {
-        _buff[sizeof(_buff) - 1] = '\0';
-    }
-    else
-    {
-        _buff[bytes] = '\0';
-    }
+	// Log comms if enabled in config
+	if(FLAGS.LOG_RAW_SDI12_COMMS)
+	{
+		SDI12Log::add(cmd);
+	}	
+
+    size_t bytes = _sdi12.transaction(cmd, _buff, sizeof(_buff));
 
     #ifdef DEBUG
         debug_print(F("SDI12 response: "));
@@ -51,60 +53,107 @@ size_t Sdi12Sensor::read_response()
 		SDI12Log::add(_buff);
 	}	
 
-
     return bytes;
 }
 
 /******************************************************************************
-* Write command
-******************************************************************************/
-size_t Sdi12Sensor::write_command(char *cmd)
+ * Send measure command with CRC (aMC!)
+ * Sensor responds with time to wait until measurement results are ready.
+ * If a concurrent measurement was already started and waited for by Sdi12Bus,
+ * it is used instead and secs_to_wait is 0.
+ *****************************************************************************/
+RetResult Sdi12Sensor::measure(uint16_t *secs_to_wait, uint8_t *measurement_vals)
 {
-    #ifdef DEBUG
-        debug_print(F("SDI12 writing command: "));
-        debug_println(cmd);
-    #endif
+    set_last_error(ERROR_NONE);
 
-	// Log comms if enabled in config
-	if(FLAGS.LOG_RAW_SDI12_COMMS)
+	_prestarted = Sdi12Bus::take_measurement(_address, measurement_vals);
+	if(_prestarted)
 	{
-		SDI12Log::add(cmd);
-	}	
+		debug_println(F("Using concurrent measurement."));
+
+		*secs_to_wait = 0;
+		return RET_OK;
+	}
+
+	char cmd[6] = "";
+	snprintf(cmd, sizeof(cmd), "%cMC!", _address);
 
-    return _sdi12.write_command(cmd);
+	return start_measurement(cmd, secs_to_wait, measurement_vals);
 }
 
 /******************************************************************************
- * Send measure command with CRC (aMC!)
- * Sensor responds with time to wait until measurement results are ready
+ * Send concurrent measure command with CRC (aCC!)
+ * Sensor responds with time to wait until measurement results are ready but,
+ * unlike aMC!, other sensors on the bus can be addressed while waiting.
  *****************************************************************************/
-RetResult Sdi12Sensor::measure(uint16_t *secs_to_wait, uint8_t *measurement_vals)
+RetResult Sdi12Sensor::start_concurrent(uint16_t *secs_to_wait, uint8_t *measurement_vals)
 {
     set_last_error(ERROR_NONE);
 
+	char cmd[6] = "";
+	snprintf(cmd, sizeof(cmd), "%cCC!", _address);
+
+	return start_measurement(cmd, secs_to_wait, measurement_vals);
+}
+
+/******************************************************************************
+ * Wait for measurement results to be ready. Device light sleeps with sensors
+ * powered and wakes up early on the sensor's service request (a<CR><LF>).
+ * @param secs_to_wait	As returned by measure()
+ *****************************************************************************/
+void Sdi12Sensor::wait_measurement(uint16_t secs_to_wait)
+{
+	// Bus already waited for all concurrent measurements
+	if(_prestarted)
+		return;
+
+	debug_print(F("Waiting (sec): "));
+	debug_println(secs_to_wait + SDI12_MEASURE_EXTRA_WAIT_SECS);
+
+	// Sensors with 0 secs to wait have data ready and send no service request
+	if(secs_to_wait == 0)
+	{
+		delay(SDI12_MEASURE_EXTRA_WAIT_SECS * 1000);
+		return;
+	}
+
+	if(WaterSensors::sleep((secs_to_wait + SDI12_MEASURE_EXTRA_WAIT_SECS) * 1000, _data_pin))
+	{
+		debug_println(F("Service request received."));
+
+		// Let the rest of the service request through before next command
+		delay(SDI12_SERVICE_REQUEST_TIME_MS);
+	}
+}
+
+/******************************************************************************
+ * Send a measure command and parse response
+ * @param cmd				Measure command (aMC! or aCC!)
+ * @param secs_to_wait		Output, seconds until results are ready
+ * @param measurement_vals	Output, number of values measured
+ *****************************************************************************/
+RetResult Sdi12Sensor::start_measurement(const char *cmd, uint16_t *secs_to_wait, uint8_t *measurement_vals)
+{
 	// Address parsed from response
 	// // All responses contain the SDI12 device address as the first char
-	int addr = 0;
+	char addr = 0;
 	// // Number of vals parsed from response
 	int vals = 0;
 
 	// // Request measurement start
-    write_command("0MC!");
-	delay(SDI12_COMMAND_WAIT_TIME_MS);
-	
-    if(read_response() == 0)
+    if(transaction(cmd) == 0)
     {
         set_last_error(ERROR_NO_RESPONSE);
         return RET_ERROR;
     }
 
 	// // Parse response.
-	// Response format must be ABBBC
+	// Response format must be ABBBC (aMC!) or ABBBCC (aCC!)
 	// BBB: seconds to wait
 	// C: number of measurements to be returned
 	int response_secs = 0, response_vals = 0;
 
-	vals = sscanf(_buff, "%1d%3d%1d", &addr, &response_secs, &response_vals);
+	vals = sscanf(_buff, "%c%3d%2d", &addr, &response_secs, &response_vals);
 
 	// // Must be exactly 3 vals
 	if(vals != 3)
@@ -118,10 +167,10 @@ RetResult Sdi12Sensor::measure(uint16_t *secs_to_wait, uint8_t *measurement_vals
 
 	// // Validate vals
 	// // Check address
-	if(addr != 0)
+	if(addr != _address)
 	{
 		debug_print("Invalid address value, expected: ");
-		debug_println(addr);
+		debug_println(_address);
 
 		set_last_error(ERROR_INVALID_RESPONSE);
 
@@ -135,48 +184,30 @@ RetResult Sdi12Sensor::measure(uint16_t *secs_to_wait, uint8_t *measurement_vals
 }
 
 /******************************************************************************
- * Request measurement results from sensor (aDx!), check CRC and parse into variables
- * @param adapter       SDI12Adapter to use
- * @param batch         Sensor returns measurement data in batches of 3. 0 indexed
- *                      batch number (0-9)
- * @param r1, r2, r3    Vars to receive the results. Unused should be set to nullptr
+ * Request measurement results from sensor (aDx!), check CRC and parse values
+ * @param batch         0 indexed batch number (0-9). Sensor returns as many
+ *                      values per batch as fit in a response
+ * @param vals          Output, parsed values
+ * @param max_vals      Max number of values expected
+ * @param count         Output, number of values parsed
  * @return RET_ERROR if no data received, could not parse or crc failure
  *****************************************************************************/
-RetResult Sdi12Sensor::read_measurement_data(uint8_t batch, float *o1, float *o2, float *o3)
+RetResult Sdi12Sensor::read_data(uint8_t batch, float vals[], int max_vals, int *count)
 {
 	set_last_error(ERROR_NONE);
 
-	// Expected response format
-	// aadr+val1+val2+val3
-	const char *parse_format = "%1d%f%f%f";
-	// Parsed device address
-	uint8_t addr = 0;
-	// Parsed vals
-	float d1 = 0, d2 = 0, d3 = 0;
-
-	// Number of vars to expect
-	// If less than this count parsed, abort
-	uint8_t var_count = 0;
-	if(o1 != nullptr) var_count++;
-	if(o2 != nullptr) var_count++;
-	if(o3 != nullptr) var_count++;
-
-	// At least one output var must be provided
-	if(var_count < 1)
-		return RET_ERROR;
+	*count = 0;
 
-	debug_printf("Getting batch %d - Vars: %d\n", batch, var_count);
+	debug_printf("Getting batch %d\n", batch);
 
 	//
 	// Request data
 	//
 	char cmd[10] = "";
 
-	snprintf(cmd, sizeof(cmd), "0D%d!", batch);
+	snprintf(cmd, sizeof(cmd), "%cD%d!", _address, batch);
 
-	write_command(cmd);
-	delay(SDI12_COMMAND_WAIT_TIME_MS);
-	read_response();
+	transaction(cmd);
 
 	if(!_sdi12.check_crc(_buff))
 	{
@@ -187,34 +218,44 @@ RetResult Sdi12Sensor::read_measurement_data(uint8_t batch, float *o1, float *o2
 		return RET_ERROR;
 	}
 
-	// Parse data
-	uint8_t vals = sscanf(_buff, parse_format, &addr, &d1, &d2, &d3);
+	// Expected response format: address, values with sign (+/-), 3 chars CRC
+	_buff[strlen(_buff) - 3] = '\0';
 
-	// // Check response dev address and var count. If not expected amount of vars, abort
-	if(addr != 0 || vals != (var_count + 1))
+	if(_buff[0] != _address)
 	{
 		debug_println("Could not parse response.");
 
 		set_last_error(ERROR_INVALID_RESPONSE);
-		
+
 		return RET_ERROR;
 	}
 
+	const char *p = &_buff[1];
+	while(*p != '\0')
+	{
+		char *end = nullptr;
 
-	// debug_print(F("Parsed: "));
-	// if(o1 != nullptr)
-	// 	debug_printf("%f - ", d1);
-	// if(o2 != nullptr)
-	// 	debug_printf("%f - ", d2);
-	// if(o3 != nullptr)
-	// 	debug_printf("%f", d3);
+		if(*count >= max_vals || (*p != '+' && *p != '-'))
+			break;
 
-	// debug_println();
+		vals[*count] = strtof(p, &end);
+		if(end == p)
+			break;
+
+		(*count)++;
+		p = end;
+	}
 
-	// All ok
-	if(o1 != nullptr) *o1 = d1;
-	if(o2 != nullptr) *o2 = d2;
-	if(o3 != nullptr) *o3 = d3;
+	// Must have parsed the whole response
+	if(*p != '\0')
+	{
+		debug_println("Could not parse response.");
+
+		set_last_error(ERROR_INVALID_RESPONSE);
+		*count = 0;
+
+		return RET_ERROR;
+	}
 
 	return RET_OK;
 }
@@ -228,6 +269,14 @@ const char* Sdi12Sensor::get_buffer()
     return _buff;
 }
 
+/******************************************************************************
+ * Get SDI12 address of the sensor
+ *****************************************************************************/
+char Sdi12Sensor::get_address()
+{
+	return _address;
+}
+
 /******************************************************************************
  * Get last error
  *****************************************************************************/
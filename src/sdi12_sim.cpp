@@ -0,0 +1,216 @@
+#include <Arduino.h>
+#include "sdi12_sim.h"
+#include "sdi12.h"
+#include "const.h"
+#include "common.h"
+
+namespace Sdi12Sim
+{
+	/**
+	 * Measurement state of a sensor
+	 */
+	struct SensorState
+	{
+		// Last measure command requested CRC (aMC!/aCC!)
+		bool crc;
+
+		// Measurement was requested, data available
+		bool measured;
+	};
+
+	//
+	// Private functions
+	//
+	Sensor* find_sensor(char address, SensorState **state);
+	size_t respond(Sensor *sensor, SensorState *state, const char *cmd, char *response, size_t length);
+	size_t data_response(Sensor *sensor, SensorState *state, int batch, char *response, size_t length);
+
+	//
+	// Private members
+	//
+	Sensor *_sensors = nullptr;
+	SensorState _states[SDI12_SIM_MAX_SENSORS];
+	int _sensors_count = 0;
+
+	uint32_t _bus_time_us = 0;
+	uint32_t _transactions = 0;
+	char _last_address = 0;
+
+	/******************************************************************************
+	 * Replace the UART with the virtual bus
+	 * @param sensors	Sensors on the bus, modified while running (error counters)
+	 * @param count		Number of sensors, max SDI12_SIM_MAX_SENSORS
+	 *****************************************************************************/
+	void attach(Sensor sensors[], int count)
+	{
+		_sensors = sensors;
+		_sensors_count = count < SDI12_SIM_MAX_SENSORS ? count : SDI12_SIM_MAX_SENSORS;
+		memset(_states, 0, sizeof(_states));
+		_last_address = 0;
+
+		reset_stats();
+
+		Sdi12::set_transport(transaction);
+	}
+
+	/******************************************************************************
+	 * Give the bus back to the UART
+	 *****************************************************************************/
+	void detach()
+	{
+		Sdi12::set_transport(nullptr);
+
+		_sensors = nullptr;
+		_sensors_count = 0;
+	}
+
+	/******************************************************************************
+	 * Handle a command (Sdi12 transport)
+	 * @return Response length, 0 if no sensor responded
+	 *****************************************************************************/
+	size_t transaction(const char *cmd, char *response, size_t length)
+	{
+		response[0] = '\0';
+		_transactions++;
+
+		// Break and marking, skipped by driver when addressing the same sensor
+		if(cmd[0] != _last_address)
+			_bus_time_us += SDI12_SIM_BREAK_US;
+		_last_address = cmd[0];
+
+		_bus_time_us += strlen(cmd) * SDI12_SIM_CHAR_US;
+
+		SensorState *state = nullptr;
+		Sensor *sensor = find_sensor(cmd[0], &state);
+
+		if(sensor == nullptr)
+		{
+			_bus_time_us += SDI12_SIM_NO_RESPONSE_US;
+			return 0;
+		}
+
+		size_t bytes = respond(sensor, state, cmd, response, length);
+
+		// Response and <CR><LF>
+		_bus_time_us += sensor->response_delay_ms * 1000 + (bytes + 2) * SDI12_SIM_CHAR_US;
+
+		return bytes;
+	}
+
+	/******************************************************************************
+	 * Build response of a sensor
+	 *****************************************************************************/
+	size_t respond(Sensor *sensor, SensorState *state, const char *cmd, char *response, size_t length)
+	{
+		if(sensor->garbage > 0)
+		{
+			sensor->garbage--;
+			return snprintf(response, length, "%c#?x7", sensor->address);
+		}
+
+		const char *body = &cmd[1];
+		int batch = 0;
+
+		// Acknowledge (a!)
+		if(strcmp(body, "!") == 0)
+			return snprintf(response, length, "%c", sensor->address);
+
+		// Measure (aM!, aMC!) and concurrent measure (aC!, aCC!)
+		if(body[0] == 'M' || body[0] == 'C')
+		{
+			bool concurrent = body[0] == 'C';
+
+			state->crc = body[1] == 'C';
+			state->measured = true;
+
+			// Concurrent responses have 2 digits for the number of values
+			return snprintf(response, length, concurrent ? "%c%03d%02d" : "%c%03d%d",
+				sensor->address, sensor->measure_secs, sensor->values_count);
+		}
+
+		// Send data (aDn!)
+		if(sscanf(body, "D%d!", &batch) == 1)
+			return data_response(sensor, state, batch, response, length);
+
+		// Unknown command, sensors do not respond
+		return 0;
+	}
+
+	/******************************************************************************
+	 * Build response of a data command. Appends CRC if the measurement was
+	 * requested with CRC.
+	 *****************************************************************************/
+	size_t data_response(Sensor *sensor, SensorState *state, int batch, char *response, size_t length)
+	{
+		size_t bytes = snprintf(response, length, "%c", sensor->address);
+
+		int first = batch * sensor->values_per_batch;
+		for(int i = first; state->measured && i < first + sensor->values_per_batch && i < sensor->values_count; i++)
+		{
+			// Truncated like on a real UART when response does not fit
+			if(bytes >= length)
+				return length - 1;
+
+			bytes += snprintf(&response[bytes], length - bytes, "%+.3f", sensor->values[i]);
+		}
+
+		if(bytes >= length)
+			return length - 1;
+
+		if(!state->crc || bytes + 4 > length)
+			return bytes;
+
+		char crc[4];
+		Sdi12::calc_crc(response, bytes, crc);
+
+		if(sensor->crc_errors > 0)
+		{
+			sensor->crc_errors--;
+			crc[2] ^= 0x01;
+		}
+
+		strcpy(&response[bytes], crc);
+
+		return bytes + 3;
+	}
+
+	/******************************************************************************
+	 * Find sensor by address
+	 * @param state	Output, measurement state of the sensor
+	 *****************************************************************************/
+	Sensor* find_sensor(char address, SensorState **state)
+	{
+		for(int i = 0; i < _sensors_count; i++)
+		{
+			if(_sensors[i].address == address)
+			{
+				*state = &_states[i];
+				return &_sensors[i];
+			}
+		}
+
+		return nullptr;
+	}
+
+	/******************************************************************************
+	 * Bus time accumulated since last reset (ms)
+	 *****************************************************************************/
+	uint32_t get_bus_time_ms()
+	{
+		return _bus_time_us / 1000;
+	}
+
+	/******************************************************************************
+	 * Transactions since last reset
+	 *****************************************************************************/
+	uint32_t get_transactions()
+	{
+		return _transactions;
+	}
+
+	void reset_stats()
+	{
+		_bus_time_us = 0;
+		_transactions = 0;
+	}
+}
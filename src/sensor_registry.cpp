@@ -0,0 +1,314 @@
+#include <Arduino.h>
+#include "sensor_registry.h"
+#include "sdi12_bus.h"
+#include "water_sensors.h"
+#include "teros12.h"
+#include "atmos41.h"
+#include "app_config.h"
+#include "const.h"
+#include "utils.h"
+#include "log.h"
+#include "common.h"
+
+namespace SensorRegistry
+{
+	/**
+	 * Acquisition job queued to the sensor task runner
+	 */
+	struct JobRef
+	{
+		int driver;
+		int job;
+		uint32_t duration_ms;
+	};
+
+	//
+	// Private functions
+	//
+	RetResult log_drivers(const bool due[]);
+	RetResult acquire_job(void *arg);
+	RetResult sdi12_start_job(void *arg);
+	RetResult sdi12_end_job(void *arg);
+
+	//
+	// Private members
+	//
+	/** Drivers built in, in reading order. Drivers of disabled features are left
+	 * out so their code is not linked. Terminated with a null sentinel so the
+	 * array is not empty when all sensor features are disabled. */
+	const SensorDriver *DRIVERS[] = {
+#if FEATURE_WATER_QUALITY_SENSOR || FEATURE_WATER_LEVEL_SENSOR
+		&WaterSensors::DRIVER,
+#endif
+#if FEATURE_SOIL_MOISTURE_SENSOR
+		&Teros12::DRIVER,
+#endif
+#if FEATURE_ATMOS41
+		&Atmos41::DRIVER,
+#endif
+		nullptr
+	};
+
+	/** Arrays indexed by driver are sized with the sentinel, never empty */
+	const int DRIVERS_SIZE = sizeof(DRIVERS) / sizeof(DRIVERS[0]);
+	const int DRIVERS_COUNT = DRIVERS_SIZE - 1;
+
+	Stats _stats[DRIVERS_SIZE];
+
+	JobRef _job_refs[SENSOR_TASKS_MAX_JOBS];
+
+	char _sdi12_addresses[SDI12_BUS_MAX_SENSORS];
+	int _sdi12_count = 0;
+
+	/******************************************************************************
+	 * Number of drivers
+	 *****************************************************************************/
+	int count()
+	{
+		return DRIVERS_COUNT;
+	}
+
+	/******************************************************************************
+	 * Get driver
+	 *****************************************************************************/
+	const SensorDriver* get(int index)
+	{
+		if(index < 0 || index >= DRIVERS_COUNT)
+			return nullptr;
+
+		return DRIVERS[index];
+	}
+
+	/******************************************************************************
+	 * Get driver counters
+	 *****************************************************************************/
+	const Stats* get_stats(int index)
+	{
+		if(index < 0 || index >= DRIVERS_COUNT)
+			return nullptr;
+
+		return &_stats[index];
+	}
+
+	/******************************************************************************
+	 * Init all drivers, enabled or not
+	 *****************************************************************************/
+	RetResult init()
+	{
+		RetResult ret = RET_OK;
+
+		for(int i = 0; i < DRIVERS_COUNT; i++)
+		{
+			if(DRIVERS[i]->init != nullptr && DRIVERS[i]->init() != RET_OK)
+			{
+				debug_print_e(F("Could not init sensor: "));
+				debug_println(DRIVERS[i]->name);
+				ret = RET_ERROR;
+			}
+		}
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Read and store all sensors due on this wake up
+	 *****************************************************************************/
+	RetResult log_due()
+	{
+		bool due[DRIVERS_SIZE] = {};
+
+		for(int i = 0; i < DRIVERS_COUNT; i++)
+		{
+			if(!SleepScheduler::wakeup_reason_is(DRIVERS[i]->reason))
+				continue;
+
+			debug_printf("Reason: Read %s\n", DRIVERS[i]->name);
+
+			if(!DRIVERS[i]->is_enabled())
+			{
+				debug_print_e(F("Sensor disabled, measurement aborted: "));
+				debug_println(DRIVERS[i]->name);
+				continue;
+			}
+
+			due[i] = true;
+		}
+
+		return log_drivers(due);
+	}
+
+	/******************************************************************************
+	 * Read and store all enabled sensors
+	 *****************************************************************************/
+	RetResult log_all()
+	{
+		bool due[DRIVERS_SIZE] = {};
+
+		for(int i = 0; i < DRIVERS_COUNT; i++)
+		{
+			due[i] = DRIVERS[i]->is_enabled();
+
+			if(due[i])
+				debug_printf("Reading: %s\n", DRIVERS[i]->name);
+		}
+
+		return log_drivers(due);
+	}
+
+	/******************************************************************************
+	 * Power rails of the sensors once, read them with the sensor task runner
+	 * (concurrent measurement started on SDI12 sensors first) and store their
+	 * data.
+	 * @param due Drivers to read
+	 * @return RET_ERROR if any sensor failed
+	 *****************************************************************************/
+	RetResult log_drivers(const bool due[])
+	{
+		bool rails[PowerControl::RAIL_COUNT] = {false};
+		bool any_due = false;
+
+		_sdi12_count = 0;
+
+		for(int i = 0; i < DRIVERS_COUNT; i++)
+		{
+			if(!due[i])
+				continue;
+
+			any_due = true;
+
+			if(DRIVERS[i]->rail != PowerControl::RAIL_NONE)
+				rails[DRIVERS[i]->rail] = true;
+
+			char address = DRIVERS[i]->sdi12_address != nullptr ? DRIVERS[i]->sdi12_address() : 0;
+			if(address != 0 && _sdi12_count < SDI12_BUS_MAX_SENSORS)
+				_sdi12_addresses[_sdi12_count++] = address;
+		}
+
+		if(!any_due)
+			return RET_OK;
+
+		// Single power up for all sensors
+		for(int rail = 0; rail < PowerControl::RAIL_COUNT; rail++)
+		{
+			if(rails[rail])
+				PowerControl::acquire((PowerControl::Rail)rail);
+		}
+
+		// Jobs on the same bus run in the order added
+		if(_sdi12_count > 1)
+			SensorTasks::add(SensorTasks::BUS_SDI12, "SDI12 start", sdi12_start_job);
+
+		int refs_count = 0;
+
+		for(int i = 0; i < DRIVERS_COUNT; i++)
+		{
+			if(!due[i])
+				continue;
+
+			for(int j = 0; j < SENSOR_DRIVER_MAX_JOBS && refs_count < SENSOR_TASKS_MAX_JOBS; j++)
+			{
+				const SensorDriver::AcquireJob *job = &DRIVERS[i]->jobs[j];
+				if(job->acquire == nullptr)
+					continue;
+
+				JobRef *ref = &_job_refs[refs_count++];
+				ref->driver = i;
+				ref->job = j;
+				ref->duration_ms = 0;
+
+				SensorTasks::add(job->bus, DRIVERS[i]->name, acquire_job, ref);
+			}
+		}
+
+		if(_sdi12_count > 1)
+			SensorTasks::add(SensorTasks::BUS_SDI12, "SDI12 end", sdi12_end_job);
+
+		SensorTasks::run();
+
+		//
+		// Store data and update counters
+		//
+		RetResult ret = RET_OK;
+
+		for(int i = 0; i < DRIVERS_COUNT; i++)
+		{
+			if(!due[i])
+				continue;
+
+			uint32_t duration_ms = 0;
+			for(int r = 0; r < refs_count; r++)
+			{
+				if(_job_refs[r].driver == i)
+					duration_ms += _job_refs[r].duration_ms;
+			}
+
+			Stats *stats = &_stats[i];
+			stats->runs++;
+			stats->last_ms = duration_ms;
+			stats->total_ms += duration_ms;
+			if(duration_ms > stats->max_ms)
+				stats->max_ms = duration_ms;
+
+			if(DRIVERS[i]->store() != RET_OK)
+			{
+				stats->failures++;
+				ret = RET_ERROR;
+			}
+		}
+
+		// Store may still read sensors (eg. water presence), power off last
+		for(int rail = 0; rail < PowerControl::RAIL_COUNT; rail++)
+		{
+			if(rails[rail])
+				PowerControl::release((PowerControl::Rail)rail);
+		}
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Print counters of all drivers
+	 *****************************************************************************/
+	void print_stats()
+	{
+		for(int i = 0; i < DRIVERS_COUNT; i++)
+		{
+			const Stats *stats = &_stats[i];
+
+			if(stats->runs == 0)
+				continue;
+
+			debug_printf("%s: %u runs, %u failed, last %ums, max %ums, avg %ums\n", DRIVERS[i]->name,
+				stats->runs, stats->failures, stats->last_ms, stats->max_ms, stats->total_ms / stats->runs);
+		}
+	}
+
+	/******************************************************************************
+	 * Sensor task runner jobs
+	 *****************************************************************************/
+	RetResult acquire_job(void *arg)
+	{
+		JobRef *ref = (JobRef*)arg;
+
+		uint32_t start_ms = millis();
+		RetResult ret = DRIVERS[ref->driver]->jobs[ref->job].acquire();
+		ref->duration_ms = millis() - start_ms;
+
+		return ret;
+	}
+
+	RetResult sdi12_start_job(void *arg)
+	{
+		// Sensors not started are measured one by one by their driver
+		Sdi12Bus::start(_sdi12_addresses, _sdi12_count);
+
+		return RET_OK;
+	}
+
+	RetResult sdi12_end_job(void *arg)
+	{
+		Sdi12Bus::end();
+
+		return RET_OK;
+	}
+}
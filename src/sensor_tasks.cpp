@@ -0,0 +1,185 @@
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "sensor_tasks.h"
+#include "app_config.h"
+#include "const.h"
+#include "log.h"
+#include "common.h"
+
+namespace SensorTasks
+{
+	/**
+	 * Queued job
+	 */
+	struct JobEntry
+	{
+		const char *name;
+		Bus bus;
+		Job job;
+		void *arg;
+		RetResult ret;
+		uint32_t duration_ms;
+	};
+
+	//
+	// Private functions
+	//
+	void task(void *params);
+	void run_bus(Bus bus);
+
+	//
+	// Private members
+	//
+	JobEntry _jobs[SENSOR_TASKS_MAX_JOBS];
+	int _jobs_count = 0;
+
+	bool _running = false;
+
+	/** Bus tasks not finished yet */
+	volatile int _active_buses = 0;
+	portMUX_TYPE _active_buses_mux = portMUX_INITIALIZER_UNLOCKED;
+
+	/******************************************************************************
+	 * Queue a job for the next run
+	 * @param bus	Bus used by the job
+	 * @param name	Name, for debugging
+	 * @param job	Function reading the sensor(s)
+	 * @param arg	Passed to job
+	 *****************************************************************************/
+	RetResult add(Bus bus, const char *name, Job job, void *arg)
+	{
+		if(_running || bus >= BUS_COUNT || _jobs_count >= SENSOR_TASKS_MAX_JOBS)
+		{
+			debug_println_e(F("Could not add sensor job."));
+			return RET_ERROR;
+		}
+
+		JobEntry *entry = &_jobs[_jobs_count++];
+		entry->name = name;
+		entry->bus = bus;
+		entry->job = job;
+		entry->arg = arg;
+		entry->ret = RET_ERROR;
+		entry->duration_ms = 0;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Run queued jobs (one task per bus) and wait for all of them to finish.
+	 * Queue is cleared.
+	 * @return RET_ERROR if any job failed
+	 *****************************************************************************/
+	RetResult run()
+	{
+		if(_jobs_count == 0)
+			return RET_OK;
+
+		bool bus_used[BUS_COUNT] = {false};
+
+		for(int i = 0; i < _jobs_count; i++)
+			bus_used[_jobs[i].bus] = true;
+
+		uint32_t start_ms = millis();
+
+		_running = true;
+
+		for(int bus = 0; bus < BUS_COUNT; bus++)
+		{
+			if(!bus_used[bus])
+				continue;
+
+			if(!FLAGS.SENSOR_TASKS_ENABLED)
+			{
+				run_bus((Bus)bus);
+				continue;
+			}
+
+			portENTER_CRITICAL(&_active_buses_mux);
+			_active_buses++;
+			portEXIT_CRITICAL(&_active_buses_mux);
+
+			if(xTaskCreatePinnedToCore(task, "sensor_task", SENSOR_TASKS_STACK_SIZE, (void*)(intptr_t)bus,
+				SENSOR_TASKS_PRIORITY, NULL, SENSOR_TASKS_CORE) != pdPASS)
+			{
+				debug_println_e(F("Could not start sensor task, running jobs in main task."));
+
+				portENTER_CRITICAL(&_active_buses_mux);
+				_active_buses--;
+				portEXIT_CRITICAL(&_active_buses_mux);
+
+				run_bus((Bus)bus);
+			}
+		}
+
+		// Drivers have their own timeouts, tasks always finish
+		while(_active_buses > 0)
+			delay(SENSOR_TASKS_POLL_MS);
+
+		_running = false;
+
+		uint32_t elapsed_ms = millis() - start_ms;
+		uint32_t jobs_ms = 0;
+		RetResult ret = RET_OK;
+
+		for(int i = 0; i < _jobs_count; i++)
+		{
+			debug_printf("Sensor job %s: %s, %ums\n", _jobs[i].name, _jobs[i].ret == RET_OK ? "OK" : "failed",
+				_jobs[i].duration_ms);
+
+			jobs_ms += _jobs[i].duration_ms;
+
+			if(_jobs[i].ret != RET_OK)
+				ret = RET_ERROR;
+		}
+
+		debug_printf("Sensor tasks done in %ums, jobs %ums.\n", elapsed_ms, jobs_ms);
+		Log::log(Log::SENSOR_TASKS_DONE, elapsed_ms, jobs_ms);
+
+		_jobs_count = 0;
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Bus task
+	 * @param params Bus
+	 *****************************************************************************/
+	void task(void *params)
+	{
+		run_bus((Bus)(intptr_t)params);
+
+		portENTER_CRITICAL(&_active_buses_mux);
+		_active_buses--;
+		portEXIT_CRITICAL(&_active_buses_mux);
+
+		vTaskDelete(NULL);
+	}
+
+	/******************************************************************************
+	 * Run a bus' jobs in order
+	 *****************************************************************************/
+	void run_bus(Bus bus)
+	{
+		for(int i = 0; i < _jobs_count; i++)
+		{
+			JobEntry *entry = &_jobs[i];
+
+			if(entry->bus != bus)
+				continue;
+
+			uint32_t start_ms = millis();
+			entry->ret = entry->job(entry->arg);
+			entry->duration_ms = millis() - start_ms;
+		}
+	}
+
+	/******************************************************************************
+	 * More than one bus is being read, device must not light sleep
+	 *****************************************************************************/
+	bool is_concurrent()
+	{
+		return _active_buses > 1;
+	}
+}
@@ -12,6 +12,8 @@
 #include "fo_sniffer.h"
 #include "fo_uart.h"
 #include "fo_data.h"
+#include "water_level_trend.h"
+#include "energy_monitor.h"
 
 namespace SleepScheduler
 {
@@ -145,6 +147,14 @@ namespace SleepScheduler
 
 		Serial.flush();
 		
+		// FO packets wake device up through RF module INT instead of timer
+		if(FoSniffer::radio_wakeup_enabled())
+			FoSniffer::arm_radio_wakeup();
+
+		// Sample battery/solar while sleeping, wake up if battery gets critical
+		if(FLAGS.ENERGY_MONITOR_ENABLED)
+			EnergyMonitor::arm(EnergyMonitor::WAKE_BATTERY_LOW);
+
 		esp_sleep_enable_timer_wakeup((uint64_t)next_event_seconds_left * 1000000);
 		esp_light_sleep_start();
 
@@ -152,6 +162,24 @@ namespace SleepScheduler
 		// Wake up
 		//
 
+		// Woke up early on FO packet, handle it only. Scheduled events are
+		// calculated again on next sleep.
+		bool fo_radio_wakeup = FoSniffer::check_radio_wakeup();
+		if(fo_radio_wakeup)
+		{
+			debug_println(F("Woke up on FO packet."));
+			_last_wakeup_reasons = SleepScheduler::REASON_FO;
+		}
+
+		// Woke up early on critical battery, no scheduled events are handled and
+		// sleep charge is entered
+		bool energy_wakeup = EnergyMonitor::check_wakeup();
+		if(energy_wakeup)
+		{
+			debug_println(F("Woke up on battery threshold."));
+			_last_wakeup_reasons = SleepScheduler::REASON_NONE;
+		}
+
 		//
 		// ESP32 internal clock drifts, calculate how much time left for actual wakeup time and sleep again
 		//
@@ -159,7 +187,7 @@ namespace SleepScheduler
 		// How much time were we supposed to sleep?
 		// supposed - slept = more sleep time
 		// Calculated using timestamp from external RTC
-		if(FLAGS.EXTERNAL_RTC_ENABLED)
+		if(FLAGS.EXTERNAL_RTC_ENABLED && !fo_radio_wakeup && !energy_wakeup)
 		{
 			int t_wakeup = RTC::get_external_rtc_timestamp();
 
@@ -452,6 +480,22 @@ namespace SleepScheduler
 			memcpy(schedule_out, WAKEUP_SCHEDULE_DEFAULT, sizeof(WAKEUP_SCHEDULE_DEFAULT));
 		}
 
+		// Water level changing fast, sample water sensors more often
+		if(WaterLevelTrend::burst_active())
+		{
+			for(int i = 0; i < WAKEUP_SCHEDULE_LEN; i++)
+			{
+				if(schedule_out[i].reason == REASON_READ_WATER_SENSORS && schedule_out[i].wakeup_int > WATER_LEVEL_BURST_WAKEUP_INT)
+				{
+					schedule_out[i].wakeup_int = WATER_LEVEL_BURST_WAKEUP_INT;
+				}
+			}
+
+			Utils::serial_style(STYLE_YELLOW);
+			debug_println(F("Water level burst sampling active."));
+			Utils::serial_style(STYLE_RESET);
+		}
+
 		return RET_OK;
 	}
 		
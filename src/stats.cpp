@@ -0,0 +1,191 @@
+#include "stats.h"
+
+namespace Stats
+{
+	//
+	// Private functions
+	//
+	int div_round(int64_t sum, int count);
+
+	/******************************************************************************
+	 * Find k-th smallest value (quickselect, Wirth's partitioning)
+	 * Array is partitioned around it: vals[0..k-1] <= vals[k] <= vals[k+1..]
+	 * @param vals	Values, reordered
+	 * @param count	Number of values
+	 * @param k		Zero-based rank of value to find
+	 * @return		k-th smallest value
+	 *****************************************************************************/
+	int select(int vals[], int count, int k)
+	{
+		int left = 0;
+		int right = count - 1;
+
+		while(left < right)
+		{
+			int pivot = vals[k];
+			int i = left;
+			int j = right;
+
+			do
+			{
+				while(vals[i] < pivot)
+					i++;
+				while(pivot < vals[j])
+					j--;
+
+				if(i <= j)
+				{
+					int tmp = vals[i];
+					vals[i] = vals[j];
+					vals[j] = tmp;
+					i++;
+					j--;
+				}
+			} while(i <= j);
+
+			if(j < k)
+				left = i;
+			if(k < i)
+				right = j;
+		}
+
+		return vals[k];
+	}
+
+	/******************************************************************************
+	 * Median. Mean of the two middle values when count is even.
+	 * @param vals	Values, reordered
+	 * @param count	Number of values
+	 *****************************************************************************/
+	int median(int vals[], int count)
+	{
+		if(count < 1)
+			return 0;
+
+		int mid = count / 2;
+		int upper = select(vals, count, mid);
+
+		if(count % 2)
+			return upper;
+
+		// Lower middle value is the largest of the lower partition
+		int lower = vals[0];
+		for(int i = 1; i < mid; i++)
+		{
+			if(vals[i] > lower)
+				lower = vals[i];
+		}
+
+		return div_round((int64_t)lower + upper, 2);
+	}
+
+	/******************************************************************************
+	 * Median absolute deviation
+	 * @param vals		Values
+	 * @param count		Number of values
+	 * @param med		Median of values
+	 * @param scratch	Work array, at least count long
+	 *****************************************************************************/
+	int mad(const int vals[], int count, int med, int scratch[])
+	{
+		for(int i = 0; i < count; i++)
+		{
+			int dev = vals[i] - med;
+			scratch[i] = dev < 0 ? -dev : dev;
+		}
+
+		return median(scratch, count);
+	}
+
+	/******************************************************************************
+	 * Mean (rounded)
+	 *****************************************************************************/
+	int mean(const int vals[], int count)
+	{
+		if(count < 1)
+			return 0;
+
+		int64_t sum = 0;
+		for(int i = 0; i < count; i++)
+			sum += vals[i];
+
+		return div_round(sum, count);
+	}
+
+	/******************************************************************************
+	 * Mean after dropping the lowest and highest trim_pct% of values
+	 * @param vals		Values, reordered
+	 * @param count		Number of values
+	 * @param trim_pct	Percentage of values dropped from each end
+	 *****************************************************************************/
+	int trimmed_mean(int vals[], int count, int trim_pct)
+	{
+		int trim = count * trim_pct / 100;
+		int kept = count - 2 * trim;
+
+		if(kept < 1)
+			return median(vals, count);
+
+		// Lowest values end up before vals[trim], highest after vals[count - trim - 1]
+		if(trim > 0)
+		{
+			select(vals, count, trim);
+			select(vals + trim, count - trim, kept - 1);
+		}
+
+		return mean(vals + trim, kept);
+	}
+
+	/******************************************************************************
+	 * Hampel filter. Values further than k * 1.4826 * MAD from the median are
+	 * outliers. Unlike a mean +/-1 std dev filter, good samples of a normal
+	 * distribution are kept and a few large spikes do not widen the threshold.
+	 * Inliers are moved to the front of the array, in their original order.
+	 * @param vals	Values, reordered
+	 * @param count	Number of values, max STATS_MAX_SAMPLES
+	 * @param k_q8	Threshold in MAD std devs (Q8 fixed point)
+	 * @return		Number of inliers, -1 on error
+	 *****************************************************************************/
+	int hampel_filter(int vals[], int count, int k_q8)
+	{
+		if(count < 1 || count > STATS_MAX_SAMPLES)
+			return -1;
+
+		int scratch[STATS_MAX_SAMPLES];
+		for(int i = 0; i < count; i++)
+			scratch[i] = vals[i];
+
+		int med = median(scratch, count);
+		int dev = mad(vals, count, med, scratch);
+
+		// Quantized samples often have more than half values equal to the median
+		if(dev < STATS_MAD_MIN)
+			dev = STATS_MAD_MIN;
+
+		int64_t threshold = ((int64_t)dev * STATS_MAD_SCALE_Q8 * k_q8) >> 16;
+
+		int valid = 0;
+		for(int i = 0; i < count; i++)
+		{
+			int64_t diff = (int64_t)vals[i] - med;
+			if(diff < 0)
+				diff = -diff;
+
+			if(diff <= threshold)
+				vals[valid++] = vals[i];
+		}
+
+		return valid;
+	}
+
+	/******************************************************************************
+	 * Integer division rounded half away from zero
+	 *****************************************************************************/
+	int div_round(int64_t sum, int count)
+	{
+		if(sum < 0)
+			return (sum - count / 2) / count;
+
+		return (sum + count / 2) / count;
+	}
+}
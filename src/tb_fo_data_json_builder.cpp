@@ -3,35 +3,115 @@
 #include "common.h"
 #include "fo_data.h"
 
+/** Keys of default window entries */
+const TbFoDataJsonBuilder::Keys TB_FO_DATA_KEYS = {
+	FO_DATA_KEY_PACKETS,
+	FO_DATA_KEY_TEMP,
+	FO_DATA_KEY_HUMIDITY,
+	FO_DATA_KEY_RAIN,
+	FO_DATA_KEY_RAIN_RATE_HR,
+	FO_DATA_KEY_WIND_DIR,
+	FO_DATA_KEY_WIND_SPEED,
+	FO_DATA_KEY_WIND_GUST,
+	FO_DATA_KEY_UV,
+	FO_DATA_KEY_UV_INDEX,
+	FO_DATA_KEY_LIGHT,
+	FO_DATA_KEY_SOLAR_RADIATION,
+	FO_DATA_KEY_TEMP_MIN,
+	FO_DATA_KEY_TEMP_MAX,
+	FO_DATA_KEY_WIND_GUST_MAX,
+	FO_DATA_KEY_WIND_SPEED_STD_DEV,
+	FO_DATA_KEY_WIND_DIR_STD_DEV,
+	FO_DATA_KEY_RAIN_INTENSITY,
+	FO_DATA_KEY_STATION_ID
+};
+
+/** Keys of hourly window entries */
+const TbFoDataJsonBuilder::Keys TB_FO_DATA_HOURLY_KEYS = {
+	FO_DATA_HOURLY_KEY_PACKETS,
+	FO_DATA_HOURLY_KEY_TEMP,
+	FO_DATA_HOURLY_KEY_HUMIDITY,
+	FO_DATA_HOURLY_KEY_RAIN,
+	FO_DATA_HOURLY_KEY_RAIN_RATE_HR,
+	FO_DATA_HOURLY_KEY_WIND_DIR,
+	FO_DATA_HOURLY_KEY_WIND_SPEED,
+	FO_DATA_HOURLY_KEY_WIND_GUST,
+	FO_DATA_HOURLY_KEY_UV,
+	FO_DATA_HOURLY_KEY_UV_INDEX,
+	FO_DATA_HOURLY_KEY_LIGHT,
+	FO_DATA_HOURLY_KEY_SOLAR_RADIATION,
+	FO_DATA_HOURLY_KEY_TEMP_MIN,
+	FO_DATA_HOURLY_KEY_TEMP_MAX,
+	FO_DATA_HOURLY_KEY_WIND_GUST_MAX,
+	FO_DATA_HOURLY_KEY_WIND_SPEED_STD_DEV,
+	FO_DATA_HOURLY_KEY_WIND_DIR_STD_DEV,
+	FO_DATA_HOURLY_KEY_RAIN_INTENSITY,
+	FO_DATA_HOURLY_KEY_STATION_ID
+};
+
 /******************************************************************************
  * Add packet to request
  *****************************************************************************/
 RetResult TbFoDataJsonBuilder::add(const FoData::StoreEntry *entry)
+{
+	return add(entry, &TB_FO_DATA_KEYS);
+}
+
+/******************************************************************************
+ * Add packet to request using given key names
+ * Optional outputs are added depending on FO_AGGREGATE_OUTPUTS
+ *****************************************************************************/
+RetResult TbFoDataJsonBuilder::add(const FoData::StoreEntry *entry, const Keys *keys)
 {
 	JsonObject json_entry = _root_array.createNestedObject();
 
-	json_entry[FO_DATA_KEY_TIMESTAMP] = (long long)entry->timestamp * 1000;
+	// Entries of different stations may start at the same second, offset by station
+	// index (ms) so TB doesn't overwrite them
+	json_entry[FO_DATA_KEY_TIMESTAMP] = (long long)entry->timestamp * 1000 + entry->station;
 	JsonObject values = json_entry.createNestedObject("values");
 
-	values[FO_DATA_KEY_PACKETS] = entry->packets;
-	values[FO_DATA_KEY_TEMP] = entry->temp;
-	values[FO_DATA_KEY_HUMIDITY] = entry->hum;	
-	values[FO_DATA_KEY_RAIN] = entry->rain;
-	values[FO_DATA_KEY_RAIN_RATE_HR] = entry->rain_hourly;
-	values[FO_DATA_KEY_WIND_DIR] = entry->wind_dir;
-	values[FO_DATA_KEY_WIND_SPEED] = entry->wind_speed;
-	values[FO_DATA_KEY_WIND_GUST] = entry->wind_gust;
-	values[FO_DATA_KEY_UV] = entry->uv;
-	values[FO_DATA_KEY_UV_INDEX] = entry->uv_index;
-	values[FO_DATA_KEY_SOLAR_RADIATION] = entry->solar_radiation;
+	values[keys->station_id] = entry->station_id;
+	values[keys->packets] = entry->packets;
+	values[keys->temp] = entry->temp;
+	values[keys->hum] = entry->hum;	
+	values[keys->rain] = entry->rain;
+	values[keys->rain_hourly] = entry->rain_hourly;
+	values[keys->wind_dir] = entry->wind_dir;
+	values[keys->wind_speed] = entry->wind_speed;
+	values[keys->wind_gust] = entry->wind_gust;
+	values[keys->uv] = entry->uv;
+	values[keys->uv_index] = entry->uv_index;
+	values[keys->solar_radiation] = entry->solar_radiation;
+
+	if(FO_AGGREGATE_OUTPUTS & FO_OUTPUT_TEMP_MIN_MAX)
+	{
+		values[keys->temp_min] = entry->temp_min;
+		values[keys->temp_max] = entry->temp_max;
+	}
+	if(FO_AGGREGATE_OUTPUTS & FO_OUTPUT_WIND_GUST_MAX)
+		values[keys->wind_gust_max] = entry->wind_gust_max;
+	if(FO_AGGREGATE_OUTPUTS & FO_OUTPUT_WIND_SPEED_STD_DEV)
+		values[keys->wind_speed_std_dev] = entry->wind_speed_std_dev;
+	if(FO_AGGREGATE_OUTPUTS & FO_OUTPUT_WIND_DIR_STD_DEV)
+		values[keys->wind_dir_std_dev] = entry->wind_dir_std_dev;
+	if(FO_AGGREGATE_OUTPUTS & FO_OUTPUT_RAIN_INTENSITY)
+		values[keys->rain_intensity] = entry->rain_intensity;
 
 	// Check the last one, no need to check all, if last doesnt fit into
 	// the json doc, doc is full already
-	if(((values[FO_DATA_KEY_LIGHT] = entry->light)) == false)
+	if(((values[keys->light] = entry->light)) == false)
 	{
 		debug_println(F("Could not add FO data to JSON."));
 		return RET_ERROR;
 	}
 
 	return RET_OK;
-} 
\ No newline at end of file
+}
+
+/******************************************************************************
+ * Add hourly aggregate packet to request
+ *****************************************************************************/
+RetResult TbFoHourlyDataJsonBuilder::add(const FoData::StoreEntry *entry)
+{
+	return TbFoDataJsonBuilder::add(entry, &TB_FO_DATA_HOURLY_KEYS);
+}
@@ -1,11 +1,14 @@
+#include <stddef.h>
 #include "utils.h"
 #include "rtc.h"
 #include "log.h"
-#include "sdi12_sensor.h"
+#include "sdi12_profile.h"
 #include "common.h"
 #include "teros12.h"
 #include "power_control.h"
 #include "water_sensors.h"
+#include "call_home.h"
+#include "tb_soil_moisture_data_json_builder.h"
 
 namespace Teros12
 {
@@ -13,6 +16,52 @@ namespace Teros12
     * Private functions
     ******************************************************************************/
    RetResult measure_data(SoilMoistureData::Entry *data);
+   RetResult acquire();
+   RetResult store();
+   RetResult submit(DataStoreSubmitStats *stats);
+   bool is_enabled();
+   char sdi12_address();
+
+    /******************************************************************************
+    * Private members
+    ******************************************************************************/
+    /** Last acquired data, until stored */
+    SoilMoistureData::Entry _data;
+    RetResult _data_ret = RET_ERROR;
+
+    const Sdi12Profile::Field TEROS12_FIELDS[TEROS12_NUMBER_OF_MEASUREMENTS] = {
+        {Sdi12Profile::FIELD_FLOAT, offsetof(SoilMoistureData::Entry, vwc), 1, 0, 0},
+        {Sdi12Profile::FIELD_FLOAT, offsetof(SoilMoistureData::Entry, temperature), 1, -40, 60},
+        {Sdi12Profile::FIELD_FLOAT, offsetof(SoilMoistureData::Entry, conductivity), 1, 0, 20000}
+    };
+
+    const Sdi12Profile::Profile TEROS12_PROFILE = {
+        "Teros12",
+        TEROS12_SDI12_ADDRESS,
+        TEROS12_NUMBER_OF_MEASUREMENTS,
+        TEROS12_FIELDS,
+        sizeof(SoilMoistureData::Entry),
+        TEROS12_MEASURE_WAIT_SEC_MAX,
+        3,
+        0,
+        true,
+        Log::SOIL_MOISTURE_INVALID_RESPONSE,
+        Log::SOIL_MOISTURE_MEASUREMENT_DATA_REQ_FAILED,
+        Log::SOIL_MOISTURE_ZERO_VALS,
+        nullptr
+    };
+
+    const SensorDriver DRIVER = {
+        "soil moisture",
+        SleepScheduler::REASON_READ_SOIL_MOISTURE_SENSOR,
+        PowerControl::RAIL_SENSORS,
+        is_enabled,
+        sdi12_address,
+        init,
+        {{SensorTasks::BUS_SDI12, acquire}},
+        store,
+        submit
+    };
 
     /******************************************************************************
      * Initialization
@@ -41,127 +90,15 @@ namespace Teros12
     
     /******************************************************************************
      * Send measure command to the sensor and fill data structure
-     * Aquatroll is configured to return 5 measurements (in this order):
-     * RDO - Dissolved oxygen (concentration) - mg/L
-     * RDO - Dissolved oxygen (%saturation) - %Sat
-     * RDO - Temperature - C
-     * Cond - Specific Conductivity - uS/cm
-     * pH/ORP
+     * Teros12 returns 3 measurements (in this order):
+     * Volumetric water content (raw)
+     * Temperature - C
+     * Bulk electrical conductivity - uS/cm
      * @param data Output structure
      ******************************************************************************/
     RetResult measure_data(SoilMoistureData::Entry *data)
     {
-               // Zero structure
-        memset(data, 0, sizeof(SoilMoistureData::Entry));
-
-        // I2C slave SDI12 adapter
-        Sdi12Sensor sensor(PIN_SDI12_DATA);
-
-        // Output variables
-        // Seconds to wait
-        uint16_t secs_to_wait = 0;
-        // Vals to be measured
-        uint8_t measured_values = 0;
-
-        if(sensor.measure(&secs_to_wait, &measured_values) != RET_OK)
-        {
-            Sdi12Sensor::ErrorCode error = sensor.get_last_error();
-            if(error == Sdi12Sensor::ERROR_INVALID_RESPONSE)
-            {
-                debug_println(F("Invalid response returned."));
-
-                Log::log(Log::SOIL_MOISTURE_INVALID_RESPONSE);
-
-                return RET_ERROR;
-            }
-
-            return RET_ERROR;
-        }
-
-        // Check if seconds within range. Range values are chosen empirically.
-        // If values not within range, something is wrong with the response or with the
-        // configuration of Aquatroll
-        if(secs_to_wait > TEROS12_MEASURE_WAIT_SEC_MAX)
-        {
-            debug_println(F("Invalid number of seconds to wait for measurements."));
-            return RET_ERROR;
-        }
-        // The exact number of measured values is known and configured into Teros12
-        if(measured_values != TEROS12_NUMBER_OF_MEASUREMENTS)
-        {
-            debug_print(F("Invalid number of measured values. Expected: "));
-            debug_println(TEROS12_NUMBER_OF_MEASUREMENTS, DEC);
-            return RET_ERROR;
-        }
-
-        debug_print(F("Waiting (sec): "));
-        debug_println(secs_to_wait + SDI12_MEASURE_EXTRA_WAIT_SECS);
-        delay((secs_to_wait + SDI12_MEASURE_EXTRA_WAIT_SECS) * 1000);
-
-        //
-        // Request measurement data
-        //
-        SoilMoistureData::Entry sensor_data = {0};
-
-        // Vars to receive all the measurement data
-        // Data will be copied to output structure only after successfull measurement
-        float d1 = 0, d2 = 0, d3 = 0, d4 = 0, d5 = 0;
-
-        //
-        // Get measurements
-        //
-        int tries = 3;
-        RetResult ret = RET_ERROR;
-        while(tries--)
-        {
-            if(sensor.read_measurement_data(0, &sensor_data.vwc, &sensor_data.temperature, &sensor_data.conductivity) != RET_OK)
-            {
-                debug_println(F("Could not get measurement results."));
-
-                Log::log(Log::SOIL_MOISTURE_MEASUREMENT_DATA_REQ_FAILED, 0);
-
-                if(tries > 0)
-                {
-                    debug_println(F("Retrying"));
-                }
-                else
-                {
-                    ret = RET_ERROR;
-                }
-            }
-            else
-            {
-                ret = RET_OK;
-                break;
-            }
-        }
-
-        if(ret != RET_OK)
-        {
-
-            debug_println(F("Aborting"));
-            return RET_ERROR;
-        }
-
-        //
-        // All data received successfully, fill strcture
-        //
-        memcpy(data, &sensor_data, sizeof(sensor_data));
-
-        // If all fields 0 return error even if CRC is OK
-        if(data->conductivity == 0 && data->temperature == 0 && data->vwc == 0)
-        {
-            debug_println(F("All measured vals are 0, aborting."));
-
-            Log::log(Log::SOIL_MOISTURE_ZERO_VALS);
-            return RET_ERROR;
-        }
-
-        Utils::serial_style(STYLE_GREEN);
-        debug_println(F("All Teros12 data is received successfully."));
-        Utils::serial_style(STYLE_RESET);
-
-        return RET_OK;
+        return Sdi12Profile::measure(&TEROS12_PROFILE, data);
     }
 
     /******************************************************************************
@@ -170,31 +107,74 @@ namespace Teros12
 	******************************************************************************/
 	RetResult log()
 	{
-		SoilMoistureData::Entry data = {0};
+        acquire();
+
+        return store();
+    }
+
+    /******************************************************************************
+	* Read soil moisture sensor, data kept until store()
+	******************************************************************************/
+	RetResult acquire()
+	{
+		memset(&_data, 0, sizeof(_data));
 
         Log::log(Log::SOIL_MOISTURE_SENSOR_MEASUREMENT_LOG);
 
 		//
 		// Read soil moisture sensor
         // 
-        if(Teros12::measure(&data) != RET_OK)
+        _data_ret = Teros12::measure(&_data);
+
+        if(_data_ret != RET_OK)
         {
             Serial.println(F("Failed reading soil moisture"));
             Log::log(Log::SOIL_MOISTURE_MEASUREMENT_FAILED);
-            return RET_ERROR;
         }
 
-		//
-		// Set timestamp and save
-		//
-		data.timestamp = RTC::get_timestamp();
+        return _data_ret;
+    }
+
+    /******************************************************************************
+	* Set timestamp and save acquired data
+	* @return RET_ERROR Failed to read
+	******************************************************************************/
+	RetResult store()
+	{
+        if(_data_ret != RET_OK)
+            return RET_ERROR;
+
+		_data.timestamp = RTC::get_timestamp();
 
 		debug_println(F("Soil moisture data"));
-		SoilMoistureData::print(&data);
+		SoilMoistureData::print(&_data);
 
-		SoilMoistureData::add(&data);
+		SoilMoistureData::add(&_data);
 		SoilMoistureData::get_store()->commit();
 
+        _data_ret = RET_ERROR;
+
 		return RET_OK;
 	}
+
+    /******************************************************************************
+     * Submit stored data when calling home
+     ******************************************************************************/
+    RetResult submit(DataStoreSubmitStats *stats)
+    {
+        return CallHome::submit_stored_telemetry<DataStore<SoilMoistureData::Entry>, TbSoilMoistureDataJsonBuilder, SoilMoistureData::Entry>(SoilMoistureData::get_store(), stats);
+    }
+
+    /******************************************************************************
+     * Driver config
+     ******************************************************************************/
+    bool is_enabled()
+    {
+        return FLAGS.SOIL_MOISTURE_SENSOR_ENABLED;
+    }
+
+    char sdi12_address()
+    {
+        return TEROS12_SDI12_ADDRESS;
+    }
 }
\ No newline at end of file
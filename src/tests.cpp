@@ -16,6 +16,23 @@
 #include "limits.h"
 #include "remote_control.h"
 #include "device_config.h"
+#include "water_level_trend.h"
+#include "fo_aggregator.h"
+#include "fo_data.h"
+#include "fo_buffer.h"
+#include "fo_sniffer.h"
+#include "fo_capture.h"
+#include "fo_slot_tracker.h"
+#include "fo_uart_parser.h"
+#include "water_level.h"
+#include "water_sensors.h"
+#include "stats.h"
+#include "adc.h"
+#include "sdi12_sim.h"
+#include "aquatroll.h"
+#include "teros12.h"
+#include "atmos41.h"
+#include "power_control.h"
 #include "common.h"
 
 namespace Tests
@@ -32,12 +49,27 @@ namespace Tests
 		IGNORED = -1
 	};
 
+	int compare_int(const void *a, const void *b);
+	RetResult sdi12_sim_measure(int sensor_type, Sdi12Sim::Sensor *sensor);
+
 	/** Pointers to test functions mapped to their type */
 	RetResult (*test_funcs[])() = {
 		[RTC_FROM_GSM] = rtc_from_gsm,
 		[DATA_STORE] = data_store,
 		[WAKEUP_TIMES] = wakeup_times,
-		[DEVICE_CONFIG] = device_config
+		[DEVICE_CONFIG] = device_config,
+		[WATER_LEVEL_BURST] = water_level_burst,
+		[FO_AGGREGATOR] = fo_aggregator,
+		[FO_SNIFFER_FRAMES] = fo_sniffer_frames,
+		[FO_CAPTURE_REPLAY] = fo_capture_replay,
+		[FO_SLOT_TRACKER] = fo_slot_tracker,
+		[FO_UART_PARSER] = fo_uart_parser,
+		[WATER_LEVEL_PWM_CAPTURE] = water_level_pwm_capture,
+		[STATS] = stats,
+		[ADC_BURST] = adc_burst,
+		[SDI12_SIM] = sdi12_sim,
+		[ENTRY_CODEC] = entry_codec,
+		[SENSOR_POWER_CYCLE] = sensor_power_cycle
 	};
 
 	/** Test names mapped to their type */
@@ -45,7 +77,19 @@ namespace Tests
 		[RTC_FROM_GSM] = "RTC from GSM",
 		[DATA_STORE] = "Buffered data store",
 		[WAKEUP_TIMES] = "Wake-up times",
-		[DEVICE_CONFIG] = "Device configuration store"
+		[DEVICE_CONFIG] = "Device configuration store",
+		[WATER_LEVEL_BURST] = "Water level burst sampling",
+		[FO_AGGREGATOR] = "FO streaming aggregator",
+		[FO_SNIFFER_FRAMES] = "FO sniffer frame integrity",
+		[FO_CAPTURE_REPLAY] = "FO capture replay",
+		[FO_SLOT_TRACKER] = "FO tx slot tracker",
+		[FO_UART_PARSER] = "FO UART response parser",
+		[WATER_LEVEL_PWM_CAPTURE] = "Water level PWM capture (RMT vs pulseIn)",
+		[STATS] = "Statistics (quickselect, Hampel filter)",
+		[ADC_BURST] = "ADC burst (DMA vs analogRead)",
+		[SDI12_SIM] = "SDI12 drivers on virtual bus",
+		[ENTRY_CODEC] = "Compact entry format",
+		[SENSOR_POWER_CYCLE] = "Sensor power cycle on retry"
 	};
 
 	/******************************************************************************
@@ -76,6 +120,316 @@ namespace Tests
 	// How many wake up "times" to calculate starting from now
 	const int WAKEUP_TIMES_SERIES_LEN = 100;
 
+	//
+	// Water level burst
+	//
+	struct WaterLevelSeriesEntry
+	{
+		// Seconds from series start
+		uint32_t t_offset;
+		// Level in cm
+		float level;
+		// Transition expected after adding this entry
+		WaterLevelTrend::Transition expected;
+	};
+
+	// Recorded series (ultrasonic, distance shrinks as water rises): stable level
+	// sampled every 10 min, fast rise, burst sampling every 2 min until stable again
+	const WaterLevelSeriesEntry WATER_LEVEL_SERIES[] = {
+		{0, 150.2, WaterLevelTrend::TRANSITION_NONE},
+		{600, 150.0, WaterLevelTrend::TRANSITION_NONE},
+		{1200, 150.3, WaterLevelTrend::TRANSITION_NONE},
+		{1800, 150.1, WaterLevelTrend::TRANSITION_NONE},
+		{2400, 150.2, WaterLevelTrend::TRANSITION_NONE},
+		{3000, 145.0, WaterLevelTrend::TRANSITION_NONE},
+		{3600, 138.0, WaterLevelTrend::TRANSITION_BURST_START},
+		{3720, 136.8, WaterLevelTrend::TRANSITION_NONE},
+		{3840, 135.5, WaterLevelTrend::TRANSITION_NONE},
+		{3960, 134.6, WaterLevelTrend::TRANSITION_NONE},
+		{4080, 134.2, WaterLevelTrend::TRANSITION_NONE},
+		{4200, 134.1, WaterLevelTrend::TRANSITION_NONE},
+		{4320, 134.2, WaterLevelTrend::TRANSITION_NONE},
+		{4440, 134.1, WaterLevelTrend::TRANSITION_NONE},
+		{4560, 134.2, WaterLevelTrend::TRANSITION_NONE},
+		{4680, 134.1, WaterLevelTrend::TRANSITION_NONE},
+		{4800, 134.2, WaterLevelTrend::TRANSITION_NONE},
+		{4920, 134.1, WaterLevelTrend::TRANSITION_NONE},
+		{5040, 134.2, WaterLevelTrend::TRANSITION_BURST_END},
+		{5160, 134.1, WaterLevelTrend::TRANSITION_NONE}
+	};
+
+	// Timestamp series starts from
+	const uint32_t WATER_LEVEL_SERIES_START = 1577836800;
+
+	//
+	// FO aggregator
+	//
+	// Recorded packet streams (low_bat, address, temp, hum, rain, wind dir, wind speed,
+	// wind gust, uv, uv index, light, solar radiation, crc, checksum)
+	const FoDecodedPacket FO_STREAM_CALM[] = {
+		{false, 0x5A, 18.3, 64, 112.5, 45, 1.1, 2.2, 1020, 2, 41230, 326, 0, 0},
+		{false, 0x5A, 18.4, 64, 112.5, 52, 1.4, 2.2, 1034, 2, 41870, 331, 0, 0},
+		{false, 0x5A, 18.4, 63, 112.5, 38, 0.7, 1.5, 1041, 2, 42310, 334, 0, 0},
+		{false, 0x5A, 18.5, 63, 112.5, 61, 1.8, 3.1, 1052, 2, 42950, 339, 0, 0},
+		{false, 0x5A, 18.5, 63, 112.5, 49, 1.1, 2.2, 1049, 2, 42810, 338, 0, 0},
+		{false, 0x5A, 18.6, 62, 112.5, 44, 0.4, 1.5, 1063, 2, 43520, 344, 0, 0},
+		{false, 0x5A, 18.7, 62, 112.5, 57, 1.4, 2.2, 1070, 2, 43980, 347, 0, 0},
+		{false, 0x5A, 18.7, 62, 112.5, 50, 1.1, 2.2, 1078, 2, 44200, 349, 0, 0}
+	};
+
+	// Time between packets of recorded streams
+	const int FO_STREAM_PACKET_INTERVAL_SEC = 16;
+
+	// Timestamp of first packet of recorded streams
+	const uint32_t FO_STREAM_START = 1577836800;
+
+	// Northerly wind (directions wrap around 0) with rain
+	const FoDecodedPacket FO_STREAM_STORM[] = {
+		{false, 0x5A, 12.1, 91, 240.3, 350, 6.3, 9.9, 12, 0, 1520, 12, 0, 0},
+		{false, 0x5A, 12.0, 92, 240.6, 5, 7.1, 11.3, 10, 0, 1410, 11, 0, 0},
+		{false, 0x5A, 11.8, 93, 241.2, 355, 8.2, 12.6, 9, 0, 1320, 10, 0, 0},
+		{false, 0x5A, 11.7, 94, 241.8, 12, 9.7, 14.2, 9, 0, 1250, 10, 0, 0},
+		{false, 0x5A, 11.7, 95, 242.7, 340, 7.8, 12.6, 8, 0, 1190, 9, 0, 0},
+		{false, 0x5A, 11.6, 95, 243.3, 2, 6.6, 9.9, 8, 0, 1130, 9, 0, 0},
+		{false, 0x5A, 11.5, 96, 244.2, 358, 5.9, 8.6, 7, 0, 1080, 8, 0, 0},
+		{false, 0x5A, 11.5, 96, 244.8, 8, 6.1, 9.9, 7, 0, 1040, 8, 0, 0},
+		{false, 0x5A, 11.4, 97, 245.4, 351, 7.4, 11.3, 6, 0, 990, 7, 0, 0},
+		{false, 0x5A, 11.4, 97, 246.0, 3, 8.0, 12.6, 6, 0, 950, 7, 0, 0}
+	};
+
+	//
+	// FO sniffer frames
+	//
+	enum FoFrameResult
+	{
+		FO_FRAME_OK,
+		// Rejected by pre-filter, never decoded
+		FO_FRAME_FILTERED,
+		// Passed pre-filter, failed CRC or checksum
+		FO_FRAME_CORRUPT
+	};
+
+	struct FoFrameCorpusEntry
+	{
+		uint8_t frame[FO_SNIFFER_FRAME_LEN];
+		FoFrameResult expected;
+
+		// Decoded values expected for valid frames
+		uint8_t node_address;
+		uint16_t wind_dir;
+		float temp;
+		uint8_t hum;
+		float wind_speed;
+		float rain;
+	};
+
+	// Frames as stored in the rx buffer (family code, address, payload, CRC, checksum)
+	const FoFrameCorpusEntry FO_FRAME_CORPUS[] = {
+		{{0x24, 0x5A, 0x2D, 0x02, 0x47, 0x40, 0x11, 0x04, 0x01, 0xBB, 0x03, 0xFC, 0x06, 0x4A, 0x8C, 0x53, 0x33},
+			FO_FRAME_OK, 0x5A, 45, 18.3, 64, 1.095, 112.522},
+		// Wind dir > 255, negative temp
+		{{0x24, 0x5A, 0x5E, 0x81, 0x45, 0x5B, 0x62, 0x13, 0x03, 0xB2, 0x00, 0x0C, 0x00, 0x3B, 0x60, 0x74, 0x42},
+			FO_FRAME_OK, 0x5A, 350, -7.5, 91, 6.311, 240.284},
+		// WSP flag set, 9bit wind speed
+		{{0x24, 0xC3, 0x02, 0xD2, 0xC8, 0x23, 0x2C, 0x28, 0x00, 0x00, 0x10, 0x72, 0x0E, 0xF8, 0x08, 0xDB, 0x65},
+			FO_FRAME_OK, 0xC3, 258, 31.2, 35, 19.32, 0},
+		// WSP flag not set, 10bit wind speed
+		{{0x24, 0xC3, 0x0C, 0x21, 0x90, 0x63, 0x62, 0x3A, 0x00, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD0, 0x7F},
+			FO_FRAME_OK, 0xC3, 12, 0, 99, 39.284, 3.048},
+		// WSP flag set, 10bit extra bit ignored
+		{{0x24, 0xC3, 0x02, 0xF2, 0xC8, 0x23, 0x2C, 0x28, 0x00, 0x00, 0x10, 0x72, 0x0E, 0xF8, 0x08, 0x46, 0xF0},
+			FO_FRAME_OK, 0xC3, 258, 31.2, 35, 19.32, 0},
+		// WSP flag set, 9bit extra bit clear
+		{{0x24, 0xC3, 0x02, 0xE2, 0xC8, 0x23, 0x2C, 0x28, 0x00, 0x00, 0x10, 0x72, 0x0E, 0xF8, 0x08, 0x90, 0x2A},
+			FO_FRAME_OK, 0xC3, 258, 31.2, 35, 2.834, 0},
+		// WSP flag not set, both extra bits set
+		{{0x24, 0x5A, 0x5A, 0x31, 0xC2, 0x50, 0x10, 0x46, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x56, 0xDB},
+			FO_FRAME_OK, 0x5A, 90, 5.0, 80, 50.49, 5.08},
+		// First frame with a flipped wind speed bit
+		{{0x24, 0x5A, 0x2D, 0x02, 0x47, 0x40, 0x15, 0x04, 0x01, 0xBB, 0x03, 0xFC, 0x06, 0x4A, 0x8C, 0x53, 0x33},
+			FO_FRAME_CORRUPT},
+		// First frame with rain bytes swapped, checksum still matches but CRC does not
+		{{0x24, 0x5A, 0x2D, 0x02, 0x47, 0x40, 0x11, 0x01, 0x04, 0xBB, 0x03, 0xFC, 0x06, 0x4A, 0x8C, 0x53, 0x33},
+			FO_FRAME_CORRUPT},
+		// Noise
+		{{0x24, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+			FO_FRAME_FILTERED},
+		// Humidity out of range
+		{{0x24, 0x5A, 0x2D, 0x02, 0x47, 0xC8, 0x11, 0x04, 0x01, 0xBB, 0x03, 0xFC, 0x06, 0x4A, 0x8C, 0x53, 0x33},
+			FO_FRAME_FILTERED},
+		// Wrong family code
+		{{0x41, 0x5A, 0x2D, 0x02, 0x47, 0x40, 0x11, 0x04, 0x01, 0xBB, 0x03, 0xFC, 0x06, 0x4A, 0x8C, 0x53, 0x33},
+			FO_FRAME_FILTERED}
+	};
+
+	// Times to run through the corpus when benchmarking
+	const int FO_FRAME_BENCH_ITERATIONS = 1000;
+
+	//
+	// FO capture replay
+	//
+	// Paths of test capture store and FO data stores replay commits to
+	const char *FO_CAPTURE_TEST_PATH = "/tfoc";
+	const char *FO_CAPTURE_TEST_DATA_PATH = "/tfo";
+	const char *FO_CAPTURE_TEST_DATA_HOURLY_PATH = "/tfoh";
+
+	// Frames to capture, frame corpus is repeated FO_STREAM_PACKET_INTERVAL_SEC apart
+	const int FO_CAPTURE_REPLAY_FRAMES = 100;
+
+	//
+	// FO slot tracker
+	//
+	// Simulated station tx period (ms), nominal interval plus crystal drift
+	const uint32_t FO_SLOT_TEST_PERIOD_MS = 16004;
+
+	// Arrival time jitter pattern applied to simulated packets (ms)
+	const int FO_SLOT_TEST_JITTER_MS[] = {0, 12, -8, 20, -20, 5, -15, 9};
+
+	// Packets to simulate, every FO_SLOT_TEST_LOST_EVERY-th one is lost
+	const int FO_SLOT_TEST_PACKETS = 200;
+	const int FO_SLOT_TEST_LOST_EVERY = 37;
+
+	// Max error of the period estimate and max window after converging (ms)
+	const float FO_SLOT_TEST_PERIOD_TOLERANCE_MS = 2;
+	const uint32_t FO_SLOT_TEST_MAX_WINDOW_MS = 500;
+
+	//
+	// FO UART parser
+	//
+	// Recorded weather station UART responses and expected parse result
+	struct FoUartTranscript
+	{
+		const char *data;
+		FoUartParser::Result expected;
+	};
+
+	const FoUartTranscript FO_UART_TRANSCRIPTS[] = {
+		// Complete response
+		{"WindDir = 123\r\nWindSpeed = 15\r\nWindGust = 20\r\nTemp = 245\r\nHumi = 67\r\n"
+			"Light = 12345\r\nUV_Index = 3\r\nRainCnt = 1024\r\n", FoUartParser::PARSE_DONE},
+		// Banner before response, unknown param, LF only, negative and fractional values
+		{"\r\n== FO ==\r\nID: 0x5A\r\n  WindDir=90\nWindSpeed = 0\nPressure = 1013\nWindGust = 2.5\n"
+			"Temp = -105\nHumi = 99\nLight = 0\nUV_Index = 0\nRainCnt = 7\n", FoUartParser::PARSE_DONE},
+		// Response cut off
+		{"WindDir = 123\r\nWindSpeed = 15\r\nWindGust = 20\r\nTemp = 245\r\n", FoUartParser::PARSE_INCOMPLETE},
+		// Malformed value
+		{"WindDir = 123\r\nWindSpeed = 15\r\nHumi = ab\r\nTemp = 245\r\n", FoUartParser::PARSE_ERROR}
+	};
+
+	// Transcripts are fed in chunks of these sizes, as if read from the UART
+	const int FO_UART_TRANSCRIPT_CHUNK_SIZES[] = {1, 3, 7, 64};
+
+	//
+	// Water level PWM capture
+	//
+	// Times to capture with each method (alternating)
+	const int WATER_LEVEL_PWM_TEST_ROUNDS = 5;
+
+	// Max difference of mean pulse width between methods (mm)
+	const float WATER_LEVEL_PWM_TEST_TOLERANCE_MM = 5;
+
+	//
+	// Statistics
+	//
+	// Recorded sensor samples. Good samples first, known outliers (spikes) last
+	struct StatsRecording
+	{
+		const char *name;
+		int vals[20];
+		int spikes;
+	};
+
+	const StatsRecording STATS_RECORDINGS[] = {
+		// MaxBotix PWM (mm), max range and multipath echoes
+		{"Water level PWM", {1523, 1521, 1524, 1522, 1526, 1523, 1520, 1522, 1525, 1523,
+			1519, 1524, 1522, 1527, 1523, 1521, 1524, 762, 9998, 1611}, 3},
+		// Battery ADC (raw), GSM tx current spikes
+		{"Battery ADC", {2381, 2374, 2390, 2379, 2368, 2385, 2377, 2396, 2372, 2383,
+			2380, 2362, 2388, 2376, 2384, 2371, 2393, 2379, 2105, 2590}, 2}
+	};
+
+	// Max difference of filtered mean from mean of good samples (sample units)
+	const int STATS_TEST_MEAN_TOLERANCE = 2;
+
+	// Random arrays checked against sorting
+	const int STATS_TEST_RANDOM_ARRAYS = 200;
+
+	// Times to run median of STATS_MAX_SAMPLES values when benchmarking
+	const int STATS_TEST_BENCH_ROUNDS = 100;
+
+	//
+	// ADC burst
+	//
+	// Delay between analogRead samples, as used before burst sampling
+	const int ADC_TEST_SAMPLING_DELAY_MS = 5;
+
+	// Max difference between burst and analogRead values
+	const int ADC_TEST_TOLERANCE_MV = 50;
+
+	//
+	// SDI12 virtual bus
+	//
+	enum Sdi12SimSensorType
+	{
+		SDI12_SIM_AQUATROLL,
+		SDI12_SIM_TEROS12,
+		SDI12_SIM_ATMOS41
+	};
+
+	// Values returned by the simulated sensors, in response order
+	const float SDI12_SIM_AQUATROLL_VALUES[] = {8.12, 95.1, 21.5, 523.4, 7.21, 210.5, 1013.2, 152.4};
+	const float SDI12_SIM_TEROS12_VALUES[] = {2005.1, 22.3, 123};
+	const float SDI12_SIM_ATMOS41_VALUES[] = {512, 0.017, 0, 3.2, 270, 5.1, 18.5, 1.2, 101.3};
+	// All in a single 75 char aD0! response, max for concurrent measurements
+	const float SDI12_SIM_ATMOS41_LONG_VALUES[] = {1234.125, 1234.125, 0, 12.5, 12345.125, 12345.125, -12.5, 1234.125, 101.325};
+
+	/**
+	 * Simulated measurement and expected outcome
+	 */
+	struct Sdi12SimCase
+	{
+		const char *name;
+		int sensor_type;
+		Sdi12Sim::Sensor sensor;
+		bool expect_ok;
+	};
+
+	const Sdi12SimCase SDI12_SIM_CASES[] = {
+		{"Aquatroll", SDI12_SIM_AQUATROLL, {'0', 1, SDI12_SIM_AQUATROLL_VALUES,
+			AQUATROLL_MODEL == AQUATROLL_MODEL_600 ? AQUATROLL600_NUMBER_OF_MEASUREMENTS : AQUATROLL400_NUMBER_OF_MEASUREMENTS,
+			3, 10, 0, 0}, true},
+		{"Aquatroll, 2 CRC errors", SDI12_SIM_AQUATROLL, {'0', 1, SDI12_SIM_AQUATROLL_VALUES,
+			AQUATROLL_MODEL == AQUATROLL_MODEL_600 ? AQUATROLL600_NUMBER_OF_MEASUREMENTS : AQUATROLL400_NUMBER_OF_MEASUREMENTS,
+			3, 10, 2, 0}, true},
+		{"Aquatroll, 3 CRC errors", SDI12_SIM_AQUATROLL, {'0', 1, SDI12_SIM_AQUATROLL_VALUES,
+			AQUATROLL_MODEL == AQUATROLL_MODEL_600 ? AQUATROLL600_NUMBER_OF_MEASUREMENTS : AQUATROLL400_NUMBER_OF_MEASUREMENTS,
+			3, 10, 3, 0}, false},
+		{"Aquatroll, garbage", SDI12_SIM_AQUATROLL, {'0', 1, SDI12_SIM_AQUATROLL_VALUES,
+			AQUATROLL_MODEL == AQUATROLL_MODEL_600 ? AQUATROLL600_NUMBER_OF_MEASUREMENTS : AQUATROLL400_NUMBER_OF_MEASUREMENTS,
+			3, 10, 0, 1}, false},
+		{"Teros12", SDI12_SIM_TEROS12, {'0', 0, SDI12_SIM_TEROS12_VALUES, TEROS12_NUMBER_OF_MEASUREMENTS, 3, 10, 0, 0}, true},
+		{"Atmos41, 4 values per batch", SDI12_SIM_ATMOS41, {'0', 1, SDI12_SIM_ATMOS41_VALUES, WEATHER_STATION_NUMBER_OF_MEASUREMENTS, 4, 10, 0, 0}, true},
+		{"Atmos41, slow sensor", SDI12_SIM_ATMOS41, {'0', 1, SDI12_SIM_ATMOS41_VALUES, WEATHER_STATION_NUMBER_OF_MEASUREMENTS, 3, 200, 0, 0}, true},
+		{"Atmos41, full length response", SDI12_SIM_ATMOS41, {'0', 1, SDI12_SIM_ATMOS41_LONG_VALUES, WEATHER_STATION_NUMBER_OF_MEASUREMENTS, 9, 10, 0, 0}, true}
+	};
+
+	// Max difference of measured from simulated values (values are sent with 3 decimals)
+	const float SDI12_SIM_TOLERANCE = 0.01;
+
+	//
+	// Compact entry format
+	//
+	// Path of test store
+	const char *ENTRY_CODEC_TEST_PATH = "/tenc";
+
+	// Entries to write, ENTRY_CODEC_TEST_INTERVAL_SEC apart, committed one by one
+	// so blocks are extended in place. Last one is far from the rest to check
+	// large timestamp deltas.
+	const int ENTRY_CODEC_TEST_ENTRIES = 40;
+	const uint32_t ENTRY_CODEC_TEST_START = 1600000000;
+	const uint32_t ENTRY_CODEC_TEST_INTERVAL_SEC = 600;
+	const uint32_t ENTRY_CODEC_TEST_GAP_SEC = 200 * 24 * 3600;
+
 
 	/******************************************************************************
 	 * Set dummy date in RTC, ask GSM module to update time from NTP and see if
@@ -427,6 +781,1331 @@ namespace Tests
 		return RET_OK;
 	}
 
+	/******************************************************************************
+	 * Water level burst sampling
+	 * Feed recorded level series to rate estimator/state machine and check
+	 * transitions happen at expected samples
+	 ******************************************************************************/
+	RetResult water_level_burst()
+	{
+		WaterLevelTrend::State state;
+		WaterLevelTrend::reset(&state);
+
+		const int series_len = sizeof(WATER_LEVEL_SERIES) / sizeof(WATER_LEVEL_SERIES[0]);
+
+		for(int i = 0; i < series_len; i++)
+		{
+			const WaterLevelSeriesEntry *entry = &WATER_LEVEL_SERIES[i];
+
+			WaterLevelTrend::Transition transition = WaterLevelTrend::update(&state, WATER_LEVEL_SERIES_START + entry->t_offset, entry->level);
+
+			debug_printf("%d - %.1f cm - ", i, entry->level);
+			WaterLevelTrend::print(&state);
+
+			if(transition != entry->expected)
+			{
+				debug_printf("Unexpected transition at sample %d. Expected: %d Found: %d\n", i, entry->expected, transition);
+				return RET_ERROR;
+			}
+		}
+
+		if(state.mode != WaterLevelTrend::MODE_NORMAL)
+		{
+			debug_println(F("Not in normal mode at end of series."));
+			return RET_ERROR;
+		}
+
+		//
+		// Time going backwards must discard history
+		//
+		WaterLevelTrend::update(&state, WATER_LEVEL_SERIES_START, 100);
+		if(state.count != 1 || state.rate != 0)
+		{
+			debug_println(F("History not reset when time went backwards."));
+			return RET_ERROR;
+		}
+
+		debug_println(F("Done!"));
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Reference FO aggregation, calculated from a buffer of packets as FoBuffer
+	 * did before the streaming aggregator was introduced. Packets are assumed
+	 * FO_STREAM_PACKET_INTERVAL_SEC apart.
+	 ******************************************************************************/
+	void fo_aggregate_buffered(const FoDecodedPacket packets[], int count, FoData::StoreEntry *entry)
+	{
+		//
+		// Min/max, wind speed standard deviation and rain counter slope (two pass)
+		//
+		float temp_min = packets[0].temp, temp_max = packets[0].temp, wind_gust_max = packets[0].wind_gust;
+		float wind_speed_mean = 0;
+		float t_mean = 0, r_mean = 0;
+
+		for(int i = 0; i < count; i++)
+		{
+			temp_min = packets[i].temp < temp_min ? packets[i].temp : temp_min;
+			temp_max = packets[i].temp > temp_max ? packets[i].temp : temp_max;
+			wind_gust_max = packets[i].wind_gust > wind_gust_max ? packets[i].wind_gust : wind_gust_max;
+			wind_speed_mean += packets[i].wind_speed / count;
+			t_mean += (float)(i * FO_STREAM_PACKET_INTERVAL_SEC) / 60 / count;
+			r_mean += (packets[i].rain - packets[0].rain) / count;
+		}
+
+		float wind_speed_var = 0, t_var = 0, tr_cov = 0;
+		for(int i = 0; i < count; i++)
+		{
+			float t = (float)(i * FO_STREAM_PACKET_INTERVAL_SEC) / 60 - t_mean;
+			float r = packets[i].rain - packets[0].rain - r_mean;
+
+			wind_speed_var += pow(packets[i].wind_speed - wind_speed_mean, 2) / count;
+			t_var += t * t;
+			tr_cov += t * r;
+		}
+
+		entry->temp_min = temp_min;
+		entry->temp_max = temp_max;
+		entry->wind_gust_max = wind_gust_max;
+		entry->wind_speed_std_dev = sqrt(wind_speed_var);
+		entry->rain_intensity = (t_var > 0 && tr_cov > 0) ? tr_cov / t_var * 60 : 0;
+
+		//
+		// Averages
+		//
+		float hum_total = 0, temp_total = 0;
+		float wind_speed_total = 0, wind_gust_total = 0;
+		float solar_radiation_total = 0;
+		uint32_t uv_total = 0, uv_index_total = 0, light_total = 0;
+		float wind_dir_sin_total = 0, wind_dir_cos_total = 0;
+
+		for(int i = 0; i < count; i++)
+		{
+			const FoDecodedPacket *cur_packet = &packets[i];
+
+			temp_total += cur_packet->temp;
+			hum_total += cur_packet->hum;
+			wind_speed_total += cur_packet->wind_speed;
+			wind_gust_total += cur_packet->wind_gust;
+			uv_total += cur_packet->uv;
+			uv_index_total += cur_packet->uv_index;
+			light_total += cur_packet->light;
+			solar_radiation_total += cur_packet->solar_radiation;
+
+			wind_dir_sin_total += sin(Utils::deg_to_rad(cur_packet->wind_dir));
+			wind_dir_cos_total += cos(Utils::deg_to_rad(cur_packet->wind_dir));
+		}
+
+		float wind_dir_avg = atan2(wind_dir_sin_total / count, wind_dir_cos_total / count);
+
+		wind_dir_avg = Utils::rad_to_deg(wind_dir_avg);
+		if(wind_dir_avg < 0)
+			wind_dir_avg += 360;
+
+		entry->packets = count;
+		entry->temp = (float)temp_total / count;
+		entry->hum = (float)hum_total / count;
+		entry->wind_dir = (uint16_t)wind_dir_avg;
+		entry->wind_speed = (float)wind_speed_total / count;
+		entry->wind_gust = (float)wind_gust_total / count;
+		entry->uv = uv_total / count;
+		entry->uv_index = uv_index_total / count;
+		entry->light = light_total / count;
+		entry->solar_radiation = solar_radiation_total / count;
+		entry->rain = packets[count - 1].rain;
+	}
+
+	/******************************************************************************
+	 * FO streaming aggregator
+	 * Replay recorded packet streams through the streaming aggregator and the
+	 * buffered reference calculation. Averages and min/max must be identical,
+	 * standard deviation and rain intensity within tolerance.
+	 ******************************************************************************/
+	RetResult fo_aggregator()
+	{
+		struct PacketStream
+		{
+			const FoDecodedPacket *packets;
+			int count;
+		};
+
+		const PacketStream streams[] = {
+			{FO_STREAM_CALM, sizeof(FO_STREAM_CALM) / sizeof(FO_STREAM_CALM[0])},
+			{FO_STREAM_STORM, sizeof(FO_STREAM_STORM) / sizeof(FO_STREAM_STORM[0])}
+		};
+		const int stream_count = sizeof(streams) / sizeof(streams[0]);
+
+		FoAggregator aggregator;
+
+		for(int i = 0; i < stream_count; i++)
+		{
+			FoData::StoreEntry expected = {0}, found = {0};
+
+			aggregator.clear();
+
+			// Aggregate every prefix of the stream so commits at any point are covered
+			for(int j = 0; j < streams[i].count; j++)
+			{
+				aggregator.add(&streams[i].packets[j], FO_STREAM_START + j * FO_STREAM_PACKET_INTERVAL_SEC);
+
+				fo_aggregate_buffered(streams[i].packets, j + 1, &expected);
+				aggregator.fill_entry(&found);
+
+				// Values calculated differently (streaming/two pass) must be close
+				if(fabs(expected.wind_speed_std_dev - found.wind_speed_std_dev) > 0.001 ||
+					fabs(expected.rain_intensity - found.rain_intensity) > 0.01)
+				{
+					debug_printf("Stream %d, packet %d: wind speed std dev or rain intensity differ.\n", i, j);
+					debug_println(F("Expected: "));
+					FoData::print(&expected);
+					debug_println(F("Found: "));
+					FoData::print(&found);
+
+					return RET_ERROR;
+				}
+				expected.wind_speed_std_dev = found.wind_speed_std_dev;
+				expected.rain_intensity = found.rain_intensity;
+
+				// Wind direction std dev is calculated from the same sin/cos totals
+				expected.wind_dir_std_dev = found.wind_dir_std_dev;
+
+				if(memcmp(&expected, &found, sizeof(expected)) != 0)
+				{
+					debug_printf("Stream %d, packet %d: aggregates differ.\n", i, j);
+					debug_println(F("Expected: "));
+					FoData::print(&expected);
+					debug_println(F("Found: "));
+					FoData::print(&found);
+
+					return RET_ERROR;
+				}
+			}
+
+			if(aggregator.get_first_rain() != streams[i].packets[0].rain)
+			{
+				debug_printf("Stream %d: first rain count invalid.\n", i);
+				return RET_ERROR;
+			}
+
+			debug_printf("Stream %d: %d packets OK\n", i, streams[i].count);
+		}
+
+		debug_println(F("Done!"));
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Reference CRC8, calculated bit by bit as FoSniffer did before the lookup
+	 * table was introduced
+	 ******************************************************************************/
+	uint8_t fo_crc_bitwise(uint8_t const buff[], int len, uint8_t polynomial, uint8_t init)
+	{
+		uint8_t remainder = init;
+
+		for (int i = 0; i < len; ++i)
+		{
+			remainder ^= buff[i];
+			for (int j = 0; j < 8; ++j)
+			{
+				if (remainder & 0x80)
+					remainder = (remainder << 1) ^ polynomial;
+				else
+					remainder = (remainder << 1);
+			}
+		}
+		return remainder;
+	}
+
+	/******************************************************************************
+	 * FO sniffer frame integrity
+	 * Table CRC must match the bitwise reference for all byte values and init
+	 * values. Frame corpus must be filtered/decoded as expected. Prints timings
+	 * of bitwise vs table CRC and of decoding vs pre-filtering noise.
+	 ******************************************************************************/
+	RetResult fo_sniffer_frames()
+	{
+		const int corpus_len = sizeof(FO_FRAME_CORPUS) / sizeof(FO_FRAME_CORPUS[0]);
+
+		//
+		// Table against reference
+		//
+		for(int init = 0; init < 256; init++)
+		{
+			for(int val = 0; val < 256; val++)
+			{
+				uint8_t byte = val;
+
+				if(FoSniffer::calc_crc(&byte, 1, init) != fo_crc_bitwise(&byte, 1, 0x31, init))
+				{
+					debug_printf("CRC mismatch, init: %02x byte: %02x\n", init, val);
+					return RET_ERROR;
+				}
+			}
+		}
+
+		//
+		// Corpus
+		//
+		for(int i = 0; i < corpus_len; i++)
+		{
+			const FoFrameCorpusEntry *entry = &FO_FRAME_CORPUS[i];
+			FoDecodedPacket packet = {0};
+
+			FoFrameResult result = FO_FRAME_OK;
+
+			if(!FoSniffer::prefilter_frame(entry->frame))
+				result = FO_FRAME_FILTERED;
+			else if(FoSniffer::decode_packet(entry->frame, &packet) != RET_OK)
+				result = FO_FRAME_CORRUPT;
+
+			if(result != entry->expected)
+			{
+				debug_printf("Frame %d: expected result %d, found %d\n", i, entry->expected, result);
+				return RET_ERROR;
+			}
+
+			if(result != FO_FRAME_OK)
+				continue;
+
+			if(fo_crc_bitwise(entry->frame, FO_SNIFFER_CRC_LEN, 0x31, 0) != entry->frame[15])
+			{
+				debug_printf("Frame %d: corpus CRC invalid\n", i);
+				return RET_ERROR;
+			}
+
+			if(packet.node_address != entry->node_address || packet.wind_dir != entry->wind_dir ||
+				packet.hum != entry->hum || fabs(packet.temp - entry->temp) > 0.01 ||
+				fabs(packet.wind_speed - entry->wind_speed) > 0.01 || fabs(packet.rain - entry->rain) > 0.01)
+			{
+				debug_printf("Frame %d: decoded values invalid\n", i);
+				FoBuffer::print_packet(&packet);
+				return RET_ERROR;
+			}
+		}
+
+		//
+		// Benchmark
+		//
+		volatile uint8_t sink = 0;
+		uint32_t start_us = 0, bitwise_us = 0, table_us = 0, decode_us = 0, filter_us = 0;
+
+		start_us = micros();
+		for(int i = 0; i < FO_FRAME_BENCH_ITERATIONS; i++)
+			for(int j = 0; j < corpus_len; j++)
+				sink += fo_crc_bitwise(FO_FRAME_CORPUS[j].frame, FO_SNIFFER_CRC_LEN, 0x31, 0);
+		bitwise_us = micros() - start_us;
+
+		start_us = micros();
+		for(int i = 0; i < FO_FRAME_BENCH_ITERATIONS; i++)
+			for(int j = 0; j < corpus_len; j++)
+				sink += FoSniffer::calc_crc(FO_FRAME_CORPUS[j].frame, FO_SNIFFER_CRC_LEN);
+		table_us = micros() - start_us;
+
+		// Valid frame, full decode
+		FoDecodedPacket packet = {0};
+		start_us = micros();
+		for(int i = 0; i < FO_FRAME_BENCH_ITERATIONS; i++)
+			sink += FoSniffer::decode_packet(FO_FRAME_CORPUS[0].frame, &packet);
+		decode_us = micros() - start_us;
+
+		// Noise, rejected by pre-filter
+		int noise_index = 0;
+		while(FO_FRAME_CORPUS[noise_index].expected != FO_FRAME_FILTERED)
+			noise_index++;
+
+		start_us = micros();
+		for(int i = 0; i < FO_FRAME_BENCH_ITERATIONS; i++)
+			sink += FoSniffer::prefilter_frame(FO_FRAME_CORPUS[noise_index].frame);
+		filter_us = micros() - start_us;
+
+		debug_printf("CRC of %d frames, bitwise: %u us, table: %u us\n", FO_FRAME_BENCH_ITERATIONS * corpus_len, bitwise_us, table_us);
+		debug_printf("%d frames, decode: %u us, pre-filter: %u us\n", FO_FRAME_BENCH_ITERATIONS, decode_us, filter_us);
+
+		debug_println(F("Done!"));
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * FO capture replay
+	 * Capture frame corpus into a test capture store, replay it through the
+	 * decoder and FoBuffer into test FO data stores. Checks replay stats and
+	 * committed entries, prints pipeline throughput.
+	 ******************************************************************************/
+	RetResult fo_capture_replay()
+	{
+		const int corpus_len = sizeof(FO_FRAME_CORPUS) / sizeof(FO_FRAME_CORPUS[0]);
+
+		DataStore<FoCapture::Entry> capture_store(FO_CAPTURE_TEST_PATH, FO_CAPTURE_ENTRIES_PER_FILE);
+		DataStore<FoData::StoreEntry> data_store(FO_CAPTURE_TEST_DATA_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ);
+		DataStore<FoData::StoreEntry> data_store_hourly(FO_CAPTURE_TEST_DATA_HOURLY_PATH, FO_DATA_STORE_ENTRIES_PER_SUBMIT_REQ);
+
+		capture_store.clear_all();
+		data_store.clear_all();
+		data_store_hourly.clear_all();
+
+		//
+		// Capture
+		//
+		int expected_decoded = 0, expected_filtered = 0, expected_corrupt = 0;
+		int expected_entries = 0;
+		uint32_t last_window = 0;
+
+		for(int i = 0; i < FO_CAPTURE_REPLAY_FRAMES; i++)
+		{
+			const FoFrameCorpusEntry *corpus_entry = &FO_FRAME_CORPUS[i % corpus_len];
+			FoCapture::Entry capture = {0};
+
+			capture.timestamp = FO_STREAM_START + i * FO_STREAM_PACKET_INTERVAL_SEC;
+			memcpy(capture.frame, corpus_entry->frame, sizeof(corpus_entry->frame));
+
+			capture_store.add(&capture);
+
+			if(corpus_entry->expected == FO_FRAME_FILTERED)
+			{
+				expected_filtered++;
+			}
+			else if(corpus_entry->expected == FO_FRAME_CORRUPT)
+			{
+				expected_corrupt++;
+			}
+			else
+			{
+				expected_decoded++;
+
+				// Every window with decoded packets results in an entry
+				uint32_t window = capture.timestamp / FO_AGGREGATE_INTERVAL_SEC;
+				if(expected_entries == 0 || window != last_window)
+					expected_entries++;
+				last_window = window;
+			}
+		}
+
+		capture_store.commit();
+
+		//
+		// Replay
+		//
+		FoData::set_store(FoData::WINDOW_DEFAULT, &data_store);
+		FoData::set_store(FoData::WINDOW_HOURLY, &data_store_hourly);
+
+		FoBuffer buffer;
+		FoCapture::ReplayStats stats = {0};
+
+		RetResult replay_ret = FoCapture::replay(&capture_store, &buffer, &stats);
+		buffer.commit_buffer();
+
+		FoData::set_store(FoData::WINDOW_DEFAULT, NULL);
+		FoData::set_store(FoData::WINDOW_HOURLY, NULL);
+
+		RetResult ret = RET_OK;
+
+		if(replay_ret != RET_OK || stats.frames != FO_CAPTURE_REPLAY_FRAMES || stats.decoded != expected_decoded ||
+			stats.filtered != expected_filtered || stats.corrupt != expected_corrupt)
+		{
+			debug_println(F("Replay stats invalid."));
+			ret = RET_ERROR;
+		}
+
+		//
+		// Committed entries must cover all decoded packets
+		//
+		DataStoreReader<FoData::StoreEntry> reader(&data_store);
+		FoData::StoreEntry *entry = NULL;
+		int entries = 0, packets = 0;
+
+		while(reader.next_file())
+		{
+			while((entry = reader.next_entry()))
+			{
+				FoData::print(entry);
+
+				entries++;
+				packets += entry->packets;
+			}
+		}
+
+		if(entries != expected_entries || packets != expected_decoded)
+		{
+			debug_printf("Expected %d entries of %d packets, found %d of %d.\n", expected_entries, expected_decoded, entries, packets);
+			ret = RET_ERROR;
+		}
+
+		if(stats.elapsed_us > 0)
+			debug_printf("Throughput: %u frames/s\n", (uint32_t)((uint64_t)stats.frames * 1000000 / stats.elapsed_us));
+
+		capture_store.clear_all();
+		data_store.clear_all();
+		data_store_hourly.clear_all();
+
+		if(ret == RET_OK)
+			debug_println(F("Done!"));
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Feed slot tracker with simulated packet arrivals (drifting period, jitter,
+	 * lost packets) and check every packet arrives within its predicted window,
+	 * period is estimated and window converges/widens as expected
+	******************************************************************************/
+	RetResult fo_slot_tracker()
+	{
+		const int jitter_len = sizeof(FO_SLOT_TEST_JITTER_MS) / sizeof(FO_SLOT_TEST_JITTER_MS[0]);
+
+		FoSlotTracker tracker;
+		RetResult ret = RET_OK;
+
+		// Start close to millis() wraparound
+		uint32_t start_ms = UINT32_MAX - FO_SLOT_TEST_PERIOD_MS * 10;
+		uint64_t listen_ms = 0;
+		int outside_window = 0;
+
+		tracker.add(start_ms + FO_SLOT_TEST_JITTER_MS[0]);
+
+		for(int i = 1; i < FO_SLOT_TEST_PACKETS; i++)
+		{
+			uint32_t rx_ms = start_ms + i * FO_SLOT_TEST_PERIOD_MS + FO_SLOT_TEST_JITTER_MS[i % jitter_len];
+			uint32_t open_ms = 0, len_ms = 0;
+
+			// Window is requested shortly after previous slot, as when waking up for it
+			tracker.get_next_window(start_ms + (i - 1) * FO_SLOT_TEST_PERIOD_MS + 1000, &open_ms, &len_ms);
+			listen_ms += len_ms;
+
+			if(i % FO_SLOT_TEST_LOST_EVERY == 0)
+			{
+				tracker.miss();
+				continue;
+			}
+
+			if((int32_t)(rx_ms - open_ms) < 0 || rx_ms - open_ms > len_ms)
+			{
+				debug_printf("Packet %d at %u outside window %u - %u\n", i, rx_ms, open_ms, open_ms + len_ms);
+				outside_window++;
+
+				tracker.miss();
+				continue;
+			}
+
+			tracker.add(rx_ms);
+		}
+
+		tracker.print();
+
+		if(outside_window > 0)
+		{
+			debug_printf("%d packets outside their window.\n", outside_window);
+			ret = RET_ERROR;
+		}
+
+		if(fabs(tracker.get_period_ms() - FO_SLOT_TEST_PERIOD_MS) > FO_SLOT_TEST_PERIOD_TOLERANCE_MS)
+		{
+			debug_printf("Period estimate %.2fms, should be %ums\n", tracker.get_period_ms(), FO_SLOT_TEST_PERIOD_MS);
+			ret = RET_ERROR;
+		}
+
+		uint32_t window_ms = tracker.get_window_ms();
+		if(window_ms > FO_SLOT_TEST_MAX_WINDOW_MS)
+		{
+			debug_printf("Window did not converge: %ums\n", window_ms);
+			ret = RET_ERROR;
+		}
+
+		tracker.miss();
+		if(tracker.get_window_ms() <= window_ms)
+		{
+			debug_println(F("Window not widened after miss."));
+			ret = RET_ERROR;
+		}
+
+		debug_printf("Radio duty cycle: %u per mille\n",
+			(uint32_t)(listen_ms * 1000 / ((uint64_t)(FO_SLOT_TEST_PACKETS - 1) * FO_SLOT_TEST_PERIOD_MS)));
+
+		if(ret == RET_OK)
+			debug_println(F("Done!"));
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Feed FO UART parser with recorded responses, split in chunks of various
+	 * sizes, and check parse result and decoded values
+	******************************************************************************/
+	RetResult fo_uart_parser()
+	{
+		const int transcripts_len = sizeof(FO_UART_TRANSCRIPTS) / sizeof(FO_UART_TRANSCRIPTS[0]);
+		const int chunk_sizes_len = sizeof(FO_UART_TRANSCRIPT_CHUNK_SIZES) / sizeof(FO_UART_TRANSCRIPT_CHUNK_SIZES[0]);
+
+		RetResult ret = RET_OK;
+
+		for(int i = 0; i < transcripts_len; i++)
+		{
+			const FoUartTranscript *transcript = &FO_UART_TRANSCRIPTS[i];
+			int len = strlen(transcript->data);
+
+			for(int j = 0; j < chunk_sizes_len; j++)
+			{
+				int chunk_size = FO_UART_TRANSCRIPT_CHUNK_SIZES[j];
+
+				FoUartParser parser;
+				FoUartParser::Result result = FoUartParser::PARSE_INCOMPLETE;
+
+				for(int pos = 0; pos < len; pos += chunk_size)
+				{
+					int chunk_len = len - pos < chunk_size ? len - pos : chunk_size;
+					result = parser.feed(transcript->data + pos, chunk_len);
+				}
+
+				if(result != transcript->expected)
+				{
+					debug_printf("Transcript %d, chunk %d: result %d, should be %d\n", i, chunk_size, result, transcript->expected);
+					ret = RET_ERROR;
+				}
+			}
+		}
+
+		//
+		// Decoded values
+		//
+		FoUartParser parser;
+		FoDecodedPacket packet = {0};
+
+		parser.feed(FO_UART_TRANSCRIPTS[0].data, strlen(FO_UART_TRANSCRIPTS[0].data));
+		parser.fill_packet(&packet);
+
+		if(packet.wind_dir != 123 || fabs(packet.temp - 24.5) > 0.01 || packet.hum != 67 ||
+			packet.light != 123450 || packet.uv_index != 3 || fabs(packet.rain - 1024 * FO_RAIN_MM_PER_CLICK) > 0.01)
+		{
+			debug_println(F("Decoded values invalid."));
+			FoBuffer::print_packet(&packet);
+			ret = RET_ERROR;
+		}
+
+		parser.reset();
+		parser.feed(FO_UART_TRANSCRIPTS[1].data, strlen(FO_UART_TRANSCRIPTS[1].data));
+
+		if(parser.get_value(FO_UART_FIELD_TEMP) != -105 || fabs(parser.get_value(FO_UART_FIELD_WIND_GUST) - 2.5) > 0.001)
+		{
+			debug_println(F("Negative/fractional values invalid."));
+			ret = RET_ERROR;
+		}
+
+		if(ret == RET_OK)
+			debug_println(F("Done!"));
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Capture water level sensor PWM with RMT and pulseIn alternately and compare
+	 * mean, spread and capture time of both. Requires a sensor with a static
+	 * target.
+	******************************************************************************/
+	RetResult water_level_pwm_capture()
+	{
+		const WaterLevelPwmCapture methods[] = {WATER_LEVEL_PWM_CAPTURE_PULSEIN, WATER_LEVEL_PWM_CAPTURE_RMT};
+		const char *method_names[] = {"pulseIn", "RMT"};
+		const int methods_len = sizeof(methods) / sizeof(methods[0]);
+
+		float mean_total[methods_len] = {0};
+		float std_dev_total[methods_len] = {0};
+		uint32_t elapsed_total_ms[methods_len] = {0};
+
+		RetResult ret = RET_OK;
+
+		WaterSensors::on();
+
+		for(int round = 0; round < WATER_LEVEL_PWM_TEST_ROUNDS && ret == RET_OK; round++)
+		{
+			for(int m = 0; m < methods_len; m++)
+			{
+				int samples[WATER_LEVEL_MEASUREMENTS_COUNT] = {0};
+				uint32_t start_ms = millis();
+
+				if(WaterLevel::capture_pwm(methods[m], samples, WATER_LEVEL_MEASUREMENTS_COUNT) != RET_OK)
+				{
+					debug_printf("%s capture failed, error: %d\n", method_names[m], WaterLevel::get_last_error());
+					ret = RET_ERROR;
+					break;
+				}
+
+				elapsed_total_ms[m] += millis() - start_ms;
+
+				float mean = 0, var = 0;
+				for(int i = 0; i < WATER_LEVEL_MEASUREMENTS_COUNT; i++)
+					mean += samples[i];
+				mean /= WATER_LEVEL_MEASUREMENTS_COUNT;
+
+				for(int i = 0; i < WATER_LEVEL_MEASUREMENTS_COUNT; i++)
+					var += (samples[i] - mean) * (samples[i] - mean);
+				var /= WATER_LEVEL_MEASUREMENTS_COUNT;
+
+				mean_total[m] += mean;
+				std_dev_total[m] += sqrt(var);
+
+				debug_printf("Round %d, %s: mean %.1fmm, std dev %.2fmm, %ums\n", round, method_names[m], mean, sqrt(var), millis() - start_ms);
+			}
+		}
+
+		WaterSensors::off();
+
+		if(ret != RET_OK)
+			return ret;
+
+		for(int m = 0; m < methods_len; m++)
+		{
+			debug_printf("%s: mean %.1fmm, std dev %.2fmm, capture time %ums\n", method_names[m],
+				mean_total[m] / WATER_LEVEL_PWM_TEST_ROUNDS, std_dev_total[m] / WATER_LEVEL_PWM_TEST_ROUNDS,
+				elapsed_total_ms[m] / WATER_LEVEL_PWM_TEST_ROUNDS);
+		}
+
+		float diff = fabs(mean_total[0] - mean_total[1]) / WATER_LEVEL_PWM_TEST_ROUNDS;
+
+		if(diff > WATER_LEVEL_PWM_TEST_TOLERANCE_MM)
+		{
+			debug_printf("Methods differ by %.1fmm.\n", diff);
+			ret = RET_ERROR;
+		}
+
+		if(ret == RET_OK)
+			debug_println(F("Done!"));
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Check quickselect, median and trimmed mean against sorting, Hampel filter
+	 * against recorded sensor samples (compared to a mean +/-1 std dev filter)
+	 * and benchmark median with quickselect vs sorting
+	******************************************************************************/
+	RetResult stats()
+	{
+		RetResult ret = RET_OK;
+
+		//
+		// Random arrays, results must match sorted array
+		//
+		for(int i = 0; i < STATS_TEST_RANDOM_ARRAYS; i++)
+		{
+			int count = random(1, STATS_MAX_SAMPLES + 1);
+			int vals[STATS_MAX_SAMPLES], sorted[STATS_MAX_SAMPLES], work[STATS_MAX_SAMPLES];
+
+			for(int j = 0; j < count; j++)
+			{
+				// Narrow range so arrays contain duplicates
+				vals[j] = sorted[j] = random(-50, 50);
+			}
+
+			qsort(sorted, count, sizeof(int), compare_int);
+
+			int k = random(count);
+			memcpy(work, vals, count * sizeof(int));
+			if(Stats::select(work, count, k) != sorted[k])
+			{
+				debug_printf("Array %d: select(%d) invalid.\n", i, k);
+				ret = RET_ERROR;
+			}
+
+			int median = count % 2 ? sorted[count / 2] : sorted[count / 2 - 1] + sorted[count / 2];
+			memcpy(work, vals, count * sizeof(int));
+			int stats_median = Stats::median(work, count);
+
+			if((count % 2 && stats_median != median) || (count % 2 == 0 && abs(2 * stats_median - median) > 1))
+			{
+				debug_printf("Array %d: median %d invalid.\n", i, stats_median);
+				ret = RET_ERROR;
+			}
+
+			int trim = count * STATS_TRIM_PCT / 100;
+			if(count - 2 * trim >= 1)
+			{
+				float trimmed_mean = 0;
+				for(int j = trim; j < count - trim; j++)
+					trimmed_mean += sorted[j];
+				trimmed_mean /= count - 2 * trim;
+
+				memcpy(work, vals, count * sizeof(int));
+				int stats_trimmed_mean = Stats::trimmed_mean(work, count);
+
+				if(fabs(stats_trimmed_mean - trimmed_mean) > 0.5)
+				{
+					debug_printf("Array %d: trimmed mean %d, should be %.2f\n", i, stats_trimmed_mean, trimmed_mean);
+					ret = RET_ERROR;
+				}
+			}
+		}
+
+		//
+		// Window keeps last values only
+		//
+		Stats::Window<5> window;
+		for(int i = 0; i < 12; i++)
+			window.push(i < 7 ? 1000 : i);
+
+		if(window.get_count() != 5 || window.median() != 9 || window.mean() != 9)
+		{
+			debug_println(F("Window invalid."));
+			ret = RET_ERROR;
+		}
+
+		//
+		// Recorded samples
+		//
+		const int recordings_len = sizeof(STATS_RECORDINGS) / sizeof(STATS_RECORDINGS[0]);
+
+		for(int i = 0; i < recordings_len; i++)
+		{
+			const StatsRecording *rec = &STATS_RECORDINGS[i];
+			const int count = sizeof(rec->vals) / sizeof(rec->vals[0]);
+			const int good_count = count - rec->spikes;
+
+			float good_mean = 0;
+			for(int j = 0; j < good_count; j++)
+				good_mean += rec->vals[j];
+			good_mean /= good_count;
+
+			// Mean +/-1 std dev, as used before
+			float mean = 0, std_dev = 0;
+			for(int j = 0; j < count; j++)
+				mean += rec->vals[j];
+			mean /= count;
+
+			for(int j = 0; j < count; j++)
+				std_dev += (rec->vals[j] - mean) * (rec->vals[j] - mean);
+			std_dev = sqrt(std_dev / count);
+
+			int std_dev_good_kept = 0, std_dev_spikes_kept = 0;
+			for(int j = 0; j < count; j++)
+			{
+				if(fabs(rec->vals[j] - mean) > std_dev)
+					continue;
+
+				if(j < good_count)
+					std_dev_good_kept++;
+				else
+					std_dev_spikes_kept++;
+			}
+
+			// Hampel
+			int vals[count];
+			memcpy(vals, rec->vals, sizeof(vals));
+
+			int valid = Stats::hampel_filter(vals, count);
+			int filtered_mean = Stats::mean(vals, valid);
+
+			int hampel_good_kept = 0, hampel_spikes_kept = 0;
+			for(int j = 0; j < valid; j++)
+			{
+				bool spike = false;
+				for(int s = good_count; s < count; s++)
+				{
+					if(vals[j] == rec->vals[s])
+						spike = true;
+				}
+
+				if(spike)
+					hampel_spikes_kept++;
+				else
+					hampel_good_kept++;
+			}
+
+			debug_printf("%s: good samples kept (std dev/Hampel): %d/%d of %d, spikes kept: %d/%d of %d\n", rec->name,
+				std_dev_good_kept, hampel_good_kept, good_count, std_dev_spikes_kept, hampel_spikes_kept, rec->spikes);
+			debug_printf("%s: mean of good samples %.2f, filtered mean %d\n", rec->name, good_mean, filtered_mean);
+
+			if(hampel_good_kept != good_count || hampel_spikes_kept > 0 || fabs(filtered_mean - good_mean) > STATS_TEST_MEAN_TOLERANCE)
+			{
+				debug_printf("%s: Hampel filter invalid.\n", rec->name);
+				ret = RET_ERROR;
+			}
+		}
+
+		//
+		// Benchmark
+		//
+		int bench_vals[STATS_MAX_SAMPLES], work[STATS_MAX_SAMPLES];
+		for(int i = 0; i < STATS_MAX_SAMPLES; i++)
+			bench_vals[i] = random(4096);
+
+		uint32_t select_us = 0, sort_us = 0;
+		for(int i = 0; i < STATS_TEST_BENCH_ROUNDS; i++)
+		{
+			memcpy(work, bench_vals, sizeof(work));
+			uint32_t start_us = micros();
+			Stats::median(work, STATS_MAX_SAMPLES);
+			select_us += micros() - start_us;
+
+			memcpy(work, bench_vals, sizeof(work));
+			start_us = micros();
+			qsort(work, STATS_MAX_SAMPLES, sizeof(int), compare_int);
+			sort_us += micros() - start_us;
+		}
+
+		debug_printf("Median of %d values: quickselect %uus, qsort %uus\n", STATS_MAX_SAMPLES,
+			select_us / STATS_TEST_BENCH_ROUNDS, sort_us / STATS_TEST_BENCH_ROUNDS);
+
+		if(ret == RET_OK)
+			debug_println(F("Done!"));
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Sample battery and solar pins with a DMA burst and with analogRead and
+	 * compare values and sampling time
+	******************************************************************************/
+	RetResult adc_burst()
+	{
+		const uint8_t pins[] = {PIN_ADC_BAT, PIN_ADC_SOLAR};
+		const char *pin_names[] = {"Battery", "Solar"};
+		const int pins_len = sizeof(pins) / sizeof(pins[0]);
+
+		RetResult ret = RET_OK;
+
+		int burst_mv[pins_len] = {0};
+		uint32_t start_ms = millis();
+
+		if(Adc::read_burst(pins, pins_len, burst_mv) != RET_OK)
+		{
+			debug_println(F("Burst failed."));
+			return RET_ERROR;
+		}
+
+		uint32_t burst_ms = millis() - start_ms;
+
+		int analog_read_mv[pins_len] = {0};
+		start_ms = millis();
+
+		for(int i = 0; i < pins_len; i++)
+			analog_read_mv[i] = Utils::read_adc_mv(pins[i], ADC_BURST_SAMPLES, ADC_TEST_SAMPLING_DELAY_MS);
+
+		uint32_t analog_read_ms = millis() - start_ms;
+
+		for(int i = 0; i < pins_len; i++)
+		{
+			debug_printf("%s: burst %dmV, analogRead %dmV\n", pin_names[i], burst_mv[i], analog_read_mv[i]);
+
+			if(abs(burst_mv[i] - analog_read_mv[i]) > ADC_TEST_TOLERANCE_MV)
+			{
+				debug_printf("%s: values differ.\n", pin_names[i]);
+				ret = RET_ERROR;
+			}
+		}
+
+		debug_printf("Sampling time: burst %ums, analogRead %ums\n", burst_ms, analog_read_ms);
+
+		if(ret == RET_OK)
+			debug_println(F("Done!"));
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Run the sensor drivers against scripted sensors on the virtual SDI12 bus
+	 * (CRC errors, garbage, slow responses) and report bus time of each
+	 * measurement
+	******************************************************************************/
+	RetResult sdi12_sim()
+	{
+		if(FLAGS.MEASURE_DUMMY_WATER_QUALITY || FLAGS.MEASURE_DUMMY_WEATHER)
+		{
+			debug_println(F("Dummy measurements enabled, drivers would not use the bus."));
+			return RET_ERROR;
+		}
+
+		RetResult ret = RET_OK;
+		const int cases_len = sizeof(SDI12_SIM_CASES) / sizeof(SDI12_SIM_CASES[0]);
+
+		for(int i = 0; i < cases_len; i++)
+		{
+			const Sdi12SimCase *test_case = &SDI12_SIM_CASES[i];
+
+			// Sensor is modified by the bus (error counters)
+			Sdi12Sim::Sensor sensor = test_case->sensor;
+			Sdi12Sim::attach(&sensor, 1);
+
+			uint32_t start_ms = millis();
+			bool ok = sdi12_sim_measure(test_case->sensor_type, &sensor) == RET_OK;
+			uint32_t elapsed_ms = millis() - start_ms;
+
+			Sdi12Sim::detach();
+
+			debug_printf("%s: %s, bus time %ums, %u transactions, total %ums\n", test_case->name,
+				ok ? "OK" : "failed", Sdi12Sim::get_bus_time_ms(), Sdi12Sim::get_transactions(), elapsed_ms);
+
+			if(ok != test_case->expect_ok)
+			{
+				debug_printf("%s: unexpected result.\n", test_case->name);
+				ret = RET_ERROR;
+			}
+		}
+
+		if(ret == RET_OK)
+			debug_println(F("Done!"));
+
+		return ret;
+	}
+
+	/******************************************************************************
+	 * Measure a simulated sensor with its driver and check values
+	 * @return RET_ERROR if measurement failed or values differ
+	******************************************************************************/
+	RetResult sdi12_sim_measure(int sensor_type, Sdi12Sim::Sensor *sensor)
+	{
+		const float *vals = sensor->values;
+		float measured[3] = {0};
+		float expected[3] = {0};
+
+		if(sensor_type == SDI12_SIM_AQUATROLL)
+		{
+			WaterSensorData::Entry data;
+			if(Aquatroll::measure(&data) != RET_OK)
+				return RET_ERROR;
+
+			// Common to all models
+			measured[0] = data.dissolved_oxygen;	expected[0] = vals[0];
+			measured[1] = data.temperature;			expected[1] = vals[2];
+			measured[2] = data.conductivity;		expected[2] = vals[3];
+		}
+		else if(sensor_type == SDI12_SIM_TEROS12)
+		{
+			SoilMoistureData::Entry data;
+			if(Teros12::measure(&data) != RET_OK)
+				return RET_ERROR;
+
+			measured[0] = data.vwc;					expected[0] = vals[0];
+			measured[1] = data.temperature;			expected[1] = vals[1];
+			measured[2] = data.conductivity;		expected[2] = vals[2];
+		}
+		else
+		{
+			Atmos41Data::Entry data;
+			if(Atmos41::measure(&data) != RET_OK)
+				return RET_ERROR;
+
+			// Pressure converted to hPa
+			measured[0] = data.solar;				expected[0] = vals[0];
+			measured[1] = data.air_temp;			expected[1] = vals[6];
+			measured[2] = data.atm_pressure;		expected[2] = vals[8] * 10;
+		}
+
+		for(int i = 0; i < 3; i++)
+		{
+			if(fabs(measured[i] - expected[i]) > SDI12_SIM_TOLERANCE)
+			{
+				debug_printf("Value %d: expected %f, measured %f\n", i, expected[i], measured[i]);
+				return RET_ERROR;
+			}
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Write water sensor entries to a store with the compact format, read them back
+	 * and compare with written values, within the resolution of each field
+	******************************************************************************/
+	RetResult entry_codec()
+	{
+		const EntryCodec::Format *format = &WaterSensorData::FORMAT;
+
+		DataStore<WaterSensorData::Entry> store(ENTRY_CODEC_TEST_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, format);
+		store.clear_all();
+
+		WaterSensorData::Entry written[ENTRY_CODEC_TEST_ENTRIES] = {0};
+
+		for(int i = 0; i < ENTRY_CODEC_TEST_ENTRIES; i++)
+		{
+			WaterSensorData::Entry *entry = &written[i];
+
+			entry->timestamp = ENTRY_CODEC_TEST_START + i * ENTRY_CODEC_TEST_INTERVAL_SEC;
+			if(i == ENTRY_CODEC_TEST_ENTRIES - 1)
+				entry->timestamp += ENTRY_CODEC_TEST_GAP_SEC;
+
+			entry->temperature = random(-500, 5000) / 100.0;
+			entry->dissolved_oxygen = random(0, 6000) / 100.0;
+			entry->conductivity = random(0, 1000000) / 10.0;
+			entry->ph = random(0, 1400) / 100.0;
+			// Failed measurement
+			entry->orp = i == 0 ? NAN : random(-14000, 14000) / 10.0;
+			entry->pressure = random(0, 10000) / 100.0;
+			entry->depth_cm = random(0, 100000) / 100.0;
+			entry->depth_ft = entry->depth_cm / 30.48;
+			entry->tss = random(0, 100000) / 100.0;
+			entry->presence = i % 2;
+			// cm, or mV of analog pressure sensors
+			entry->water_level = i % 2 ? random(500, 9990) / 10.0 : random(0, 3400);
+
+			store.add(entry);
+			if(store.commit() != RET_OK)
+			{
+				debug_println(F("Could not commit data."));
+				return RET_ERROR;
+			}
+		}
+
+		//
+		// Read back, entries are matched by timestamp
+		//
+		DataStoreReader<WaterSensorData::Entry> reader(&store);
+		WaterSensorData::Entry *read_back = NULL;
+		bool found[ENTRY_CODEC_TEST_ENTRIES] = {false};
+		int files = 0;
+		int bytes = 0;
+
+		reader.begin();
+
+		while(reader.next_file())
+		{
+			files++;
+
+			while((read_back = reader.next_entry()))
+			{
+				if(!reader.entry_crc_valid())
+				{
+					debug_println(F("Entry CRC invalid."));
+					return RET_ERROR;
+				}
+
+				int index = -1;
+				for(int i = 0; i < ENTRY_CODEC_TEST_ENTRIES; i++)
+				{
+					if(written[i].timestamp == read_back->timestamp)
+						index = i;
+				}
+
+				if(index < 0 || found[index])
+				{
+					debug_print(F("Unexpected entry, timestamp: "));
+					debug_println(read_back->timestamp);
+					return RET_ERROR;
+				}
+
+				found[index] = true;
+
+				for(int f = 0; f < format->field_count; f++)
+				{
+					const EntryCodec::Field *field = &format->fields[f];
+					const uint8_t *expected = (const uint8_t*)&written[index] + field->offset;
+					const uint8_t *actual = (const uint8_t*)read_back + field->offset;
+
+					if(field->type != EntryCodec::FIELD_FLOAT)
+					{
+						if(memcmp(expected, actual, field->type == EntryCodec::FIELD_UINT8 ? 1 : field->type == EntryCodec::FIELD_UINT16 ? 2 : 4) != 0)
+						{
+							debug_printf("Entry %d, field %d differs.\n", index, f);
+							return RET_ERROR;
+						}
+						continue;
+					}
+
+					float expected_val = 0, actual_val = 0;
+					memcpy(&expected_val, expected, sizeof(float));
+					memcpy(&actual_val, actual, sizeof(float));
+
+					bool ok = isnan(expected_val) ? isnan(actual_val) :
+						fabs(expected_val - actual_val) <= 0.5 / field->scale + 0.001;
+
+					if(!ok)
+					{
+						debug_printf("Entry %d, field %d: expected %f, read %f\n", index, f, expected_val, actual_val);
+						return RET_ERROR;
+					}
+				}
+			}
+		}
+
+		for(int i = 0; i < ENTRY_CODEC_TEST_ENTRIES; i++)
+		{
+			if(!found[i])
+			{
+				debug_printf("Entry %d not read back.\n", i);
+				return RET_ERROR;
+			}
+		}
+
+		//
+		// Compare size with entries stored as they are
+		//
+		File dir = SPIFFS.open(ENTRY_CODEC_TEST_PATH);
+		File f;
+		while(f = dir.openNextFile())
+			bytes += f.size();
+		dir.close();
+
+		int raw_bytes = ENTRY_CODEC_TEST_ENTRIES * sizeof(DataStore<WaterSensorData::Entry>::Entry);
+
+		debug_printf("%d files, %d bytes (%d bytes unencoded)\n", files, bytes, raw_bytes);
+
+		store.clear_all();
+
+		if(bytes >= raw_bytes)
+		{
+			debug_println(F("Encoded entries not smaller."));
+			return RET_ERROR;
+		}
+
+		//
+		// Log entries (ms timestamps, integer fields) must read back unchanged
+		//
+		DataStore<Log::Entry> log_store(ENTRY_CODEC_TEST_PATH, LOG_ENTRIES_PER_SUBMIT_REQ, &Log::FORMAT);
+		Log::Entry log_written[ENTRY_CODEC_TEST_ENTRIES] = {};
+
+		for(int i = 0; i < ENTRY_CODEC_TEST_ENTRIES; i++)
+		{
+			log_written[i].timestamp = ENTRY_CODEC_TEST_START * 1000ULL + i * 1500 + random(0, 1000);
+			log_written[i].code = (Log::Code)random(0, 100);
+			log_written[i].meta1 = random(-100000, 100000);
+			log_written[i].meta2 = i;
+
+			log_store.add(&log_written[i]);
+			if(log_store.commit() != RET_OK)
+			{
+				debug_println(F("Could not commit log."));
+				return RET_ERROR;
+			}
+		}
+
+		DataStoreReader<Log::Entry> log_reader(&log_store);
+		Log::Entry *log_read_back = NULL;
+		int log_count = 0;
+
+		log_reader.begin();
+
+		while(log_reader.next_file())
+		{
+			while((log_read_back = log_reader.next_entry()))
+			{
+				int i = log_read_back->meta2;
+
+				if(!log_reader.entry_crc_valid() || i < 0 || i >= ENTRY_CODEC_TEST_ENTRIES ||
+					memcmp(log_read_back, &log_written[i], sizeof(Log::Entry)) != 0)
+				{
+					debug_printf("Log entry %d differs.\n", i);
+					return RET_ERROR;
+				}
+
+				log_count++;
+			}
+		}
+
+		if(log_count != ENTRY_CODEC_TEST_ENTRIES)
+		{
+			debug_printf("%d log entries read back.\n", log_count);
+			log_store.clear_all();
+			return RET_ERROR;
+		}
+
+		//
+		// Current file deleted between commits (eg. submitted on call home),
+		// next commit must continue in a new file
+		//
+		DataStoreReader<Log::Entry> delete_reader(&log_store);
+		delete_reader.begin();
+
+		while(delete_reader.next_file())
+			delete_reader.delete_file();
+
+		log_store.add(&log_written[0]);
+		if(log_store.commit() != RET_OK)
+		{
+			debug_println(F("Could not commit after current file was deleted."));
+			log_store.clear_all();
+			return RET_ERROR;
+		}
+
+		DataStoreReader<Log::Entry> after_delete_reader(&log_store);
+		log_count = 0;
+		after_delete_reader.begin();
+
+		while(after_delete_reader.next_file())
+		{
+			while(after_delete_reader.next_entry())
+				log_count++;
+		}
+
+		log_store.clear_all();
+
+		if(log_count != 1)
+		{
+			debug_printf("%d log entries read back after delete, expected 1.\n", log_count);
+			return RET_ERROR;
+		}
+
+		debug_println(F("Done!"));
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Read a water quality sensor that only answers garbage, like the registry
+	 * does (rail held once by the caller). Sensors rail must be power cycled
+	 * before the last try, but not when another user shares the rail.
+	******************************************************************************/
+	RetResult sensor_power_cycle()
+	{
+		if(!FLAGS.WATER_QUALITY_SENSOR_ENABLED || FLAGS.MEASURE_DUMMY_WATER_QUALITY)
+		{
+			debug_println(F("Water quality sensor disabled or dummy, retries would not use the bus."));
+			return RET_ERROR;
+		}
+
+		const PowerControl::Rail rail = PowerControl::RAIL_SENSORS;
+
+		Sdi12Sim::Sensor sensor = {AQUATROLL_SDI12_ADDRESS, 1, SDI12_SIM_AQUATROLL_VALUES,
+			AQUATROLL_MODEL == AQUATROLL_MODEL_600 ? AQUATROLL600_NUMBER_OF_MEASUREMENTS : AQUATROLL400_NUMBER_OF_MEASUREMENTS,
+			3, 10, 0, UINT8_MAX};
+		Sdi12Sim::attach(&sensor, 1);
+
+		PowerControl::acquire(rail);
+
+		// Rail held by the caller alone
+		uint32_t cycles = PowerControl::get_cycle_count(rail);
+		WaterSensors::DRIVER.jobs[0].acquire();
+		uint32_t sole_cycles = PowerControl::get_cycle_count(rail) - cycles;
+		bool sole_on = PowerControl::is_on(rail);
+
+		// Rail shared with another sensor
+		PowerControl::acquire(rail);
+
+		cycles = PowerControl::get_cycle_count(rail);
+		WaterSensors::DRIVER.jobs[0].acquire();
+		uint32_t shared_cycles = PowerControl::get_cycle_count(rail) - cycles;
+
+		PowerControl::release(rail);
+		PowerControl::release(rail);
+
+		Sdi12Sim::detach();
+
+		debug_printf("Power cycles, rail not shared: %u, shared: %u\n", sole_cycles, shared_cycles);
+
+		if(sole_cycles != 1 || !sole_on)
+		{
+			debug_println(F("Rail not cycled when held by the caller alone."));
+			return RET_ERROR;
+		}
+
+		if(shared_cycles != 0)
+		{
+			debug_println(F("Shared rail was cycled."));
+			return RET_ERROR;
+		}
+
+		debug_println(F("Done!"));
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * qsort int comparator
+	******************************************************************************/
+	int compare_int(const void *a, const void *b)
+	{
+		return *(const int*)a - *(const int*)b;
+	}
+
 	/******************************************************************************
 	* Configuration store
 	******************************************************************************/
@@ -14,6 +14,8 @@
 #include "water_sensor_data.h"
 #include "soil_moisture_data.h"
 #include "atmos41_data.h"
+#include "stats.h"
+#include "adc.h"
 
 namespace Utils
 {
@@ -334,7 +336,7 @@ namespace Utils
 	* @param pin ADC pin
 	* @param samples Number of samples to read
 	* @param sampling_delay_ms mS to wait between samples
-	* @return Value in mV
+	* @return Trimmed mean of samples in mV
 	******************************************************************************/
 	int read_adc_mv(uint8_t pin, int samples, int sampling_delay_ms)
 	{
@@ -348,18 +350,16 @@ namespace Utils
 			return -1;
 		}
 
-		int level_raw = 0;
+		// Only the last STATS_MAX_SAMPLES samples are kept
+		Stats::Window<STATS_MAX_SAMPLES> window;
 		for(int i = 0; i < samples; i++)
 		{
-			level_raw += analogRead(pin);
+			window.push(analogRead(pin));
 			delay(sampling_delay_ms);
 		}
-		level_raw /= samples;
+		int level_raw = window.trimmed_mean();
 
-		// Convert to mV
-		int mv = ((float)3600 / 4096) * level_raw;
-
-		return mv;
+		return Adc::raw_to_mv(pin, level_raw);
 	}
 
 	/******************************************************************************
@@ -744,62 +744,6 @@ namespace Utils
 		serializeJson(_json_doc, buff, buff_size);
 	}
 
-	/**
-	 * Filter outliers in an array (std dev).
-	 * Outliers are marked as -1.
-	 * @param vals  Value array
-	 * @param count Size of array
-	 * @param avg   Outputs avg of filtered array
-	 * @return      Outlier count
-	 */
-	int filter_outliers(int vals[], int count, float *avg_out)
-	{
-		float avg = 0;
-
-		// Calc avg
-		for (int i = 0; i < count; ++i)
-		{
-			avg += vals[i];
-		}
-		avg /= count;
-		printf("Avg: %3.3f\n", avg);
-
-		// Calc std dev
-		float std_dev = 0;
-		for (int i = 0; i < count; ++i)
-		{
-			std_dev += pow(vals[i] - avg, 2);
-		}
-		std_dev /= count;
-		std_dev = sqrt(std_dev);
-		printf("Std dev: %f\n", std_dev);
-
-		// Mark outliers as -1
-		// Also calc avg of clean values
-		int outlier_count = 0;
-		float valid_avg = 0;
-		for(int i=0; i<count; i++)
-		{
-			if(vals[i] < (avg - std_dev) || vals[i] > (avg + std_dev))
-			{
-				// Mark outlier
-				vals[i] = -1;
-				outlier_count++;
-			}
-			else
-			{
-				valid_avg += vals[i];
-			}
-		}
-
-		valid_avg /= (count - outlier_count);
-
-		if(avg_out != nullptr)
-			*avg_out = valid_avg;
-
-		return outlier_count;
-	}
-
 	/******************************************************************************
     * Print array
     ******************************************************************************/
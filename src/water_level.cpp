@@ -2,10 +2,14 @@
 #include "app_config.h"
 #include "water_level.h"
 #include "water_sensor_data.h"
+#include "water_level_trend.h"
+#include "rtc.h"
 #include "utils.h"
 #include "common.h"
 #include "log.h"
 #include "log_codes.h"
+#include "stats.h"
+#include <driver/rmt.h>
 
 namespace WaterLevel
 {
@@ -19,6 +23,9 @@ namespace WaterLevel
 	RetResult measure_dfrobot_ultrasonic_serial(WaterSensorData::Entry *data);
 	uint8_t calc_dfrobot_checksum(char *data);
 	void set_last_error(ErrorCode error);
+	bool pwm_value_valid(int level);
+	RetResult capture_pwm_pulsein(int samples[], int count);
+	RetResult capture_pwm_rmt(int samples[], int count);
 
 	// Private members
 	ErrorCode _last_error = ERROR_NONE;
@@ -52,22 +59,24 @@ namespace WaterLevel
 	 *****************************************************************************/
 	RetResult measure(WaterSensorData::Entry *data)
 	{
+		RetResult ret = RET_ERROR;
+
 		switch(WATER_LEVEL_INPUT_CHANNEL)
 		{
 		case WATER_LEVEL_CHANNEL_MAXBOTIX_PWM:
-			return measure_maxbotix_pwm(data);
+			ret = measure_maxbotix_pwm(data);
 			break;
 		case WATER_LEVEL_CHANNEL_MAXBOTIX_ANALOG:
-			return measure_maxbotix_analog(data);
+			ret = measure_maxbotix_analog(data);
 			break;
 		case WATER_LEVEL_CHANNEL_MAXBOTIX_SERIAL:
-			return measure_maxbotix_serial(data);
+			ret = measure_maxbotix_serial(data);
 			break;
 		case WATER_LEVEL_CHANNEL_DFROBOT_PRESSURE_ANALOG:
-			return measure_dfrobot_pressure_analog(data);
+			ret = measure_dfrobot_pressure_analog(data);
 			break;
 		case WATER_LEVEL_CHANNEL_DFROBOT_ULTRASONIC_SERIAL:
-			return measure_dfrobot_ultrasonic_serial(data);
+			ret = measure_dfrobot_ultrasonic_serial(data);
 			break;
 		default:
 			Utils::serial_style(STYLE_RED);
@@ -76,6 +85,15 @@ namespace WaterLevel
 
 			return RET_ERROR;
 		}
+
+		// Feed rate of change estimation (decides burst sampling). Dummy values are random
+		// and would trigger bursts, ignore them.
+		if(ret == RET_OK && !FLAGS.MEASURE_DUMMY_WATER_LEVEL)
+		{
+			WaterLevelTrend::add(RTC::get_timestamp(), data->water_level);
+		}
+
+		return ret;
 	}
 
 	/******************************************************************************
@@ -93,25 +111,86 @@ namespace WaterLevel
             return measure_dummy(data);
         }
 
+		int samples[WATER_LEVEL_MEASUREMENTS_COUNT] = {0};
+
+		if(capture_pwm(WATER_LEVEL_PWM_CAPTURE, samples, WATER_LEVEL_MEASUREMENTS_COUNT) != RET_OK)
+			return RET_ERROR;
+
+		// Print samples
+		// for (size_t i = 0; i < WATER_LEVEL_MEASUREMENTS_COUNT; i++)
+		// {
+			// TODO: Temp
+			// Log::log(Log::WATER_LEVEL_RAW_READING, samples[i]);
+
+			// debug_print(samples[i]);
+			// debug_print(", ");
+		// }
+		debug_println();
+
+		// Drop outliers
+		int valid_val_count = Stats::hampel_filter(samples, WATER_LEVEL_MEASUREMENTS_COUNT);
+
+		debug_print(F("Valid values after filtering: "));
+		debug_println(valid_val_count, DEC);
+
+		if(valid_val_count < WATER_LEVEL_MIN_VALID_MEASUREMENTS)
+		{
+			set_last_error(ErrorCode::ERROR_HIGH_VAL_FLUCTUATION);
+			debug_println_e(F("Too few valid values after filtering."));
+			return RET_ERROR;
+		}
+
+		int level = Stats::mean(samples, valid_val_count);
+
+		// Convert mm to cm
+		data->water_level = (float)level / 10;
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Capture valid pulse widths (mm) from the sensor's PWM channel
+	 * @param method	Capture method
+	 * @param samples	Output, valid pulse widths
+	 * @param count		Pulses to capture
+	 *****************************************************************************/
+	RetResult capture_pwm(WaterLevelPwmCapture method, int samples[], int count)
+	{
+		if(method == WATER_LEVEL_PWM_CAPTURE_RMT)
+			return capture_pwm_rmt(samples, count);
+		else
+			return capture_pwm_pulsein(samples, count);
+	}
+
+	/******************************************************************************
+	 * Ignore invalid values
+	 * 0 returned when no pulse before timeout
+	 * Sensor returns max range when no target detected within rage
+	 * Since PWM has an offset take into account a small tolerance
+	 *****************************************************************************/
+	bool pwm_value_valid(int level)
+	{
+		return level != 0 && level < (WATER_LEVEL_MAX_RANGE_MM - WATER_LEVEL_PWM_MAX_VAL_TOL);
+	}
+
+	/******************************************************************************
+	 * Capture pulses one by one with pulseIn (busy waits)
+	 *****************************************************************************/
+	RetResult capture_pwm_pulsein(int samples[], int count)
+	{
 		// Number of valid measurements
 		int cur_sample = 0;
 		int failures = 0;
 
-		int samples[WATER_LEVEL_MEASUREMENTS_COUNT] = {0};
-		float avg = 0;
 		uint32_t start_ms = millis();
 
-		while(millis() - start_ms < WATER_LEVEL_US_TIMEOUT_MS && cur_sample < WATER_LEVEL_MEASUREMENTS_COUNT)
+		while(millis() - start_ms < WATER_LEVEL_US_TIMEOUT_MS && cur_sample < count)
 		{
 			int level = pulseIn(PIN_WATER_LEVEL_PWM, 1, WATER_LEVEL_PWM_TIMEOUT_MS * 1000);
 			Serial.print(F("Level: "));
 			Serial.println(level, DEC);
 
-			// Ignore invalid values
-			// 0 returned when no pulse before timeout
-			// Sensor returns max range when no target detected within rage
-			// Since PWM has an offset take into account a small tolerance
-			if(level == 0 || level >= (WATER_LEVEL_MAX_RANGE_MM - WATER_LEVEL_PWM_MAX_VAL_TOL))
+			if(!pwm_value_valid(level))
 			{
 				if(++failures >= WATER_LEVEL_PWM_FAILED_MEAS_LIMIT)
 				{
@@ -126,13 +205,11 @@ namespace WaterLevel
 				}
 			}
 
-			avg += level;
 			samples[cur_sample++] = level;
 
 			delay(WATER_LEVEL_DELAY_BETWEEN_MEAS_MS);
 		}
 
-		
 		if(millis() - start_ms >= WATER_LEVEL_US_TIMEOUT_MS)
 		{
 			set_last_error(ErrorCode::ERROR_TIMEOUT);
@@ -140,73 +217,114 @@ namespace WaterLevel
 			return RET_ERROR;
 		}
 
-		// Print samples
-		// for (size_t i = 0; i < WATER_LEVEL_MEASUREMENTS_COUNT; i++)
-		// {
-			// TODO: Temp
-			// Log::log(Log::WATER_LEVEL_RAW_READING, samples[i]);
+		return RET_OK;
+	}
 
-			// debug_print(samples[i]);
-			// debug_print(", ");
-		// }
-		debug_println();
+	/******************************************************************************
+	 * Capture pulses with the RMT receiver
+	 * Pulse widths are timed in hardware (1uS resolution) and queued by the RMT
+	 * driver, the CPU is blocked (not busy waiting) until pulses arrive. Every pulse
+	 * is captured, no pulses are lost while processing previous ones.
+	 *****************************************************************************/
+	RetResult capture_pwm_rmt(int samples[], int count)
+	{
+		rmt_channel_t channel = (rmt_channel_t)WATER_LEVEL_PWM_RMT_CHANNEL;
 
-		// Pre-filtered values avg
-		avg /= WATER_LEVEL_MEASUREMENTS_COUNT;
+		rmt_config_t config = {};
+		config.rmt_mode = RMT_MODE_RX;
+		config.channel = channel;
+		config.gpio_num = (gpio_num_t)PIN_WATER_LEVEL_PWM;
+		config.clk_div = WATER_LEVEL_PWM_RMT_CLK_DIV;
+		config.mem_block_num = 1;
+		config.rx_config.filter_en = true;
+		config.rx_config.filter_ticks_thresh = WATER_LEVEL_PWM_RMT_FILTER_TICKS;
+		config.rx_config.idle_threshold = WATER_LEVEL_PWM_RMT_IDLE_US;
 
-		// Calc standard deviation
-		float std_dev = 0;
-		for(int i=0; i<WATER_LEVEL_MEASUREMENTS_COUNT; i++)
+		RingbufHandle_t ringbuf = NULL;
+
+		if(rmt_config(&config) != ESP_OK || rmt_driver_install(channel, WATER_LEVEL_PWM_RMT_BUFF_SIZE, 0) != ESP_OK)
 		{
-			std_dev += pow((float)samples[i] - avg, 2);
+			set_last_error(ErrorCode::ERROR_OTHER);
+			debug_println_e(F("Could not init RMT."));
+			return RET_ERROR;
 		}
-		std_dev /= WATER_LEVEL_MEASUREMENTS_COUNT;
-		std_dev = sqrt(std_dev);
 
-		// Mark outliers by setting them to -1
-		debug_print(F("Std dev: "));
-		debug_println(std_dev, DEC);
+		rmt_get_ringbuf_handle(channel, &ringbuf);
+		rmt_rx_start(channel, true);
 
-		debug_print(F("Filtering outliers: "));
-		for(int i=0; i<WATER_LEVEL_MEASUREMENTS_COUNT; i++)
+		int cur_sample = 0;
+		int failures = 0;
+		bool first_pulse = true;
+		RetResult ret = RET_OK;
+
+		uint32_t start_ms = millis();
+
+		while(cur_sample < count)
 		{
-			if(samples[i] < (avg - std_dev) || samples[i] > (avg + std_dev))
+			if(millis() - start_ms >= WATER_LEVEL_US_TIMEOUT_MS)
 			{
-				debug_print_i(samples[i], DEC);
-				debug_print(F(" "));
+				set_last_error(ErrorCode::ERROR_TIMEOUT);
+				debug_println_e(F("Timeout, aborting."));
+				ret = RET_ERROR;
+				break;
+			}
+
+			size_t size = 0;
+			rmt_item32_t *items = (rmt_item32_t*)xRingbufferReceive(ringbuf, &size, pdMS_TO_TICKS(WATER_LEVEL_PWM_TIMEOUT_MS));
 
-				// Filter outlier
-				samples[i] = -1;
+			// No pulse before timeout
+			int level = 0;
+
+			if(items != NULL)
+			{
+				int items_len = size / sizeof(rmt_item32_t);
+
+				// Each capture holds a single pulse, ended by the idle line
+				for(int i = 0; i < items_len; i++)
+				{
+					if(items[i].level0 == 1 && items[i].duration0 > 0)
+						level = items[i].duration0;
+					else if(items[i].level1 == 1 && items[i].duration1 > 0)
+						level = items[i].duration1;
+				}
+
+				vRingbufferReturnItem(ringbuf, items);
+
+				// Capture may have started in the middle of a pulse
+				if(first_pulse)
+				{
+					first_pulse = false;
+					continue;
+				}
 			}
-		}
-		debug_print(F(" "));
 
-		// Calculate avg for valid values
-		float level = 0;
-		int valid_val_count = 0;
-		for(int i=0; i<WATER_LEVEL_MEASUREMENTS_COUNT; i++)
-		{
-			if(samples[i] != -1)
+			Serial.print(F("Level: "));
+			Serial.println(level, DEC);
+
+			if(!pwm_value_valid(level))
 			{
-				valid_val_count++;
-				level += samples[i];
+				if(++failures >= WATER_LEVEL_PWM_FAILED_MEAS_LIMIT)
+				{
+					set_last_error(ErrorCode::ERROR_TOO_MANY_INVALID_VALUES);
+					debug_println_e("Too many invalid values, aborting.");
+					ret = RET_ERROR;
+					break;
+				}
+
+				debug_println_e("Invalid value, ignoring.");
+				continue;
 			}
-		}
 
-		if(valid_val_count < WATER_LEVEL_MIN_VALID_MEASUREMENTS)
-		{
-			set_last_error(ErrorCode::ERROR_HIGH_VAL_FLUCTUATION);
-			debug_println_e(F("Too few valid values after filtering."));
-			return RET_ERROR;
+			samples[cur_sample++] = level;
 		}
 
-		// Calc average
-		level /= valid_val_count;
+		rmt_rx_stop(channel);
+		rmt_driver_uninstall(channel);
 
-		// Convert mm to cm
-		data->water_level = (float)level / 10;
+		// Give pin back to GPIO
+		pinMode(PIN_WATER_LEVEL_PWM, INPUT);
 
-		return RET_OK;
+		return ret;
 	}
 
 	/******************************************************************************
@@ -223,19 +341,7 @@ namespace WaterLevel
             return measure_dummy(data);
         }
 
-		// TODO: Refactor to use Utils::read_adc_mv
-
-		// X measurements, calc average
-		int level_raw = 0;
-		for(int i = 0; i < WATER_LEVEL_MEASUREMENTS_COUNT; i++)
-		{
-			level_raw += analogRead(PIN_WATER_LEVEL_ANALOG);
-			delay(WATER_LEVEL_DELAY_BETWEEN_MEAS_MS);
-		}
-		level_raw /= WATER_LEVEL_MEASUREMENTS_COUNT;
-
-		// Convert to mV
-		int mv = ((float)3600 / 4096) * level_raw;
+		int mv = Utils::read_adc_mv(PIN_WATER_LEVEL_ANALOG, WATER_LEVEL_MEASUREMENTS_COUNT, WATER_LEVEL_DELAY_BETWEEN_MEAS_MS);
 
 		// Convert to CM
 		int cm = (mv / WATER_LEVEL_MV_PER_MM) * 10;
@@ -258,17 +364,7 @@ namespace WaterLevel
             return measure_dummy(data);
         }
 
-		// X measurements, calc average
-		int level_raw = 0;
-		for(int i = 0; i < WATER_LEVEL_MEASUREMENTS_COUNT; i++)
-		{
-			level_raw += analogRead(PIN_WATER_LEVEL_ANALOG);
-			delay(WATER_LEVEL_DELAY_BETWEEN_MEAS_MS);
-		}
-		level_raw /= WATER_LEVEL_MEASUREMENTS_COUNT;
-
-		// Convert to mV
-		int mv = ((float)3600 / 4096) * level_raw;
+		int mv = Utils::read_adc_mv(PIN_WATER_LEVEL_ANALOG, WATER_LEVEL_MEASUREMENTS_COUNT, WATER_LEVEL_DELAY_BETWEEN_MEAS_MS);
 
 		data->water_level = mv;
 
@@ -291,7 +387,7 @@ namespace WaterLevel
             return measure_dummy(data);
         }
 
-		float level_avg = 0;
+		Stats::Window<WATER_LEVEL_MEASUREMENTS_COUNT> levels;
 
 		HardwareSerial us_serial(1);
 		us_serial.begin(9600, SERIAL_8N1, PIN_WATER_LEVEL_SERIAL_RX, 0);
@@ -346,7 +442,7 @@ namespace WaterLevel
 			}
 
 			uint16_t level = (packet[1] << 8) | packet[2];
-			level_avg += level;
+			levels.push(level);
 
 			debug_print(F("Current measurement: "));
 			debug_println(level, DEC);
@@ -365,10 +461,10 @@ namespace WaterLevel
 			return RET_ERROR;
 		}
 
-		level_avg /= valid_packets;
+		int level_avg = levels.hampel_mean();
 		
 		// Convert to cm
-		data->water_level = level_avg / 10;
+		data->water_level = (float)level_avg / 10;
 
 		Serial.print(F("Measured level: "));
 		Serial.println(level_avg, DEC);
@@ -391,7 +487,7 @@ namespace WaterLevel
             return measure_dummy(data);
         }
 
-		int level_avg = 0;
+		Stats::Window<MEASUREMENTS> levels;
 
 		HardwareSerial us_serial(1);
 		us_serial.begin(9600, SERIAL_8N1, PIN_WATER_LEVEL_SERIAL_RX, 0, true);
@@ -410,12 +506,12 @@ namespace WaterLevel
 				continue;
 			}
 
-			level_avg += level;
+			levels.push(level);
 		}
 
 		us_serial.end();
 
-		level_avg /= MEASUREMENTS;
+		int level_avg = levels.hampel_mean();
 
 		Serial.print(F("LEVEL: "));
 		Serial.println(level_avg, DEC);
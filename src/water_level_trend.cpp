@@ -0,0 +1,217 @@
+#include <math.h>
+#include "esp_attr.h"
+#include "water_level_trend.h"
+#include "app_config.h"
+#include "common.h"
+#include "utils.h"
+#include "log.h"
+#include "rtc.h"
+
+namespace WaterLevelTrend
+{
+	//
+	// Private vars
+	//
+
+	/** Estimator state. Kept in RTC memory so history survives sleep. */
+	RTC_DATA_ATTR State _state;
+
+	/** Set when burst mode starts, cleared when call home is triggered */
+	RTC_DATA_ATTR bool _call_home_requested = false;
+
+	/******************************************************************************
+	 * Add new level reading to history, update burst state and log transitions.
+	 * On burst start an early call home is requested.
+	 * @param tstamp	Timestamp of reading
+	 * @param level		Water level in cm
+	 *****************************************************************************/
+	RetResult add(uint32_t tstamp, float level)
+	{
+		if(!FLAGS.WATER_LEVEL_BURST_ENABLED)
+			return RET_OK;
+
+		if(!RTC::tstamp_valid(tstamp))
+		{
+			debug_println_e(F("Invalid timestamp, level not added to trend."));
+			return RET_ERROR;
+		}
+
+		Transition transition = update(&_state, tstamp, level);
+
+		debug_print(F("Water level rate (cm/min): "));
+		debug_println(_state.rate, 2);
+
+		if(transition == TRANSITION_BURST_START)
+		{
+			Utils::serial_style(STYLE_YELLOW);
+			debug_println(F("Water level changing fast, burst sampling started."));
+			Utils::serial_style(STYLE_RESET);
+
+			Log::log(Log::WATER_LEVEL_BURST_START, _state.rate * 100, level);
+
+			_call_home_requested = true;
+		}
+		else if(transition == TRANSITION_BURST_END)
+		{
+			debug_println(F("Water level stable, burst sampling ended."));
+
+			Log::log(Log::WATER_LEVEL_BURST_END, _state.rate * 100, level);
+		}
+
+		return RET_OK;
+	}
+
+	/******************************************************************************
+	 * Is burst sampling active
+	 *****************************************************************************/
+	bool burst_active()
+	{
+		return FLAGS.WATER_LEVEL_BURST_ENABLED && _state.mode == MODE_BURST;
+	}
+
+	/******************************************************************************
+	 * Returns true if an early call home has been requested since last call, and
+	 * clears the request
+	 *****************************************************************************/
+	bool take_call_home_request()
+	{
+		bool requested = _call_home_requested;
+		_call_home_requested = false;
+
+		return requested;
+	}
+
+	/******************************************************************************
+	 * Reset module state
+	 *****************************************************************************/
+	void reset()
+	{
+		reset(&_state);
+		_call_home_requested = false;
+	}
+
+	/******************************************************************************
+	 * Reset state to normal mode with empty history
+	 *****************************************************************************/
+	void reset(State *state)
+	{
+		memset(state, 0, sizeof(State));
+		state->mode = MODE_NORMAL;
+	}
+
+	/******************************************************************************
+	 * Add sample to history, recalculate rate and run state machine.
+	 * Rate is compared in absolute value since depending on the sensor, level is
+	 * either depth (pressure) or distance from sensor (ultrasonic).
+	 * @param state		State to update
+	 * @param tstamp	Timestamp of sample
+	 * @param level		Level in cm
+	 * @return Transition caused by this sample
+	 *****************************************************************************/
+	Transition update(State *state, uint32_t tstamp, float level)
+	{
+		// Time went backwards (eg. RTC sync), old history is useless
+		if(state->count > 0)
+		{
+			int last_index = (state->head + WATER_LEVEL_TREND_HISTORY_LEN - 1) % WATER_LEVEL_TREND_HISTORY_LEN;
+			if(tstamp <= state->history[last_index].timestamp)
+			{
+				state->count = 0;
+				state->head = 0;
+			}
+		}
+
+		state->history[state->head].timestamp = tstamp;
+		state->history[state->head].level = level;
+		state->head = (state->head + 1) % WATER_LEVEL_TREND_HISTORY_LEN;
+		if(state->count < WATER_LEVEL_TREND_HISTORY_LEN)
+			state->count++;
+
+		state->rate = calc_rate(state);
+		float abs_rate = fabs(state->rate);
+
+		if(state->mode == MODE_NORMAL)
+		{
+			if(abs_rate >= WATER_LEVEL_BURST_ENTER_RATE_CM_MIN)
+			{
+				state->mode = MODE_BURST;
+				state->stable_count = 0;
+				return TRANSITION_BURST_START;
+			}
+		}
+		else
+		{
+			if(abs_rate < WATER_LEVEL_BURST_EXIT_RATE_CM_MIN)
+			{
+				if(++state->stable_count >= WATER_LEVEL_BURST_STABLE_COUNT)
+				{
+					state->mode = MODE_NORMAL;
+					state->stable_count = 0;
+					return TRANSITION_BURST_END;
+				}
+			}
+			else
+			{
+				state->stable_count = 0;
+			}
+		}
+
+		return TRANSITION_NONE;
+	}
+
+	/******************************************************************************
+	 * Calculate rate of change (cm/min) as the least squares slope of samples
+	 * not older than WATER_LEVEL_TREND_WINDOW_SEC from the latest one.
+	 * @return Rate in cm/min, 0 if not enough samples
+	 *****************************************************************************/
+	float calc_rate(const State *state)
+	{
+		if(state->count < 2)
+			return 0;
+
+		int last_index = (state->head + WATER_LEVEL_TREND_HISTORY_LEN - 1) % WATER_LEVEL_TREND_HISTORY_LEN;
+		uint32_t t_last = state->history[last_index].timestamp;
+
+		// Times are relative to last sample (negative, in minutes) to keep float precision
+		float sum_t = 0, sum_l = 0, sum_tt = 0, sum_tl = 0;
+		int n = 0;
+		uint32_t span_sec = 0;
+
+		for(int i = 0; i < state->count; i++)
+		{
+			int index = (last_index + WATER_LEVEL_TREND_HISTORY_LEN - i) % WATER_LEVEL_TREND_HISTORY_LEN;
+			const Sample *sample = &state->history[index];
+
+			uint32_t age_sec = t_last - sample->timestamp;
+			if(age_sec > WATER_LEVEL_TREND_WINDOW_SEC)
+				break;
+
+			float t = -(float)age_sec / 60;
+
+			sum_t += t;
+			sum_l += sample->level;
+			sum_tt += t * t;
+			sum_tl += t * sample->level;
+			span_sec = age_sec;
+			n++;
+		}
+
+		if(n < 2 || span_sec < WATER_LEVEL_TREND_MIN_SPAN_SEC)
+			return 0;
+
+		float denom = n * sum_tt - sum_t * sum_t;
+		if(denom == 0)
+			return 0;
+
+		return (n * sum_tl - sum_t * sum_l) / denom;
+	}
+
+	/******************************************************************************
+	 * Print state
+	 *****************************************************************************/
+	void print(const State *state)
+	{
+		debug_printf("Mode: %s - Rate: %.2f cm/min - Samples: %d - Stable: %d\n",
+			state->mode == MODE_BURST ? "burst" : "normal", state->rate, state->count, state->stable_count);
+	}
+}
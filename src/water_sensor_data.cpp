@@ -5,13 +5,34 @@
 
 namespace WaterSensorData
 {
+	/**
+	 * Compact on-flash encoding, scaled to the resolutions documented in Entry.
+	 * Version MUST be increased when fields change.
+	 */
+	const EntryCodec::Field FORMAT_FIELDS[] = {
+		ENTRY_FIELD_TIMESTAMP(Entry, timestamp, 3),
+		ENTRY_FIELD_FLOAT(Entry, temperature, 2, 100),
+		ENTRY_FIELD_FLOAT(Entry, dissolved_oxygen, 2, 100),
+		ENTRY_FIELD_FLOAT(Entry, conductivity, 3, 10),
+		ENTRY_FIELD_FLOAT(Entry, ph, 2, 100),
+		ENTRY_FIELD_FLOAT(Entry, orp, 2, 10),
+		ENTRY_FIELD_FLOAT(Entry, pressure, 3, 100),
+		ENTRY_FIELD_FLOAT(Entry, depth_cm, 3, 100),
+		ENTRY_FIELD_FLOAT(Entry, depth_ft, 3, 100),
+		ENTRY_FIELD_FLOAT(Entry, tss, 3, 100),
+		ENTRY_FIELD_UINT(Entry, presence, 1),
+		ENTRY_FIELD_FLOAT(Entry, water_level, 3, 10)
+	};
+
+	const EntryCodec::Format FORMAT = {2, FORMAT_FIELDS, sizeof(FORMAT_FIELDS) / sizeof(FORMAT_FIELDS[0])};
+
 	/** 
 	 * Store for water sensor data
 	 * Number of entries per file is the same as the number of entries in a request packet.
 	 * This way if a request succeeds, a whole file can be deleted, if not the file remains
 	 * to be resent at a later time
 	 */
-    DataStore<WaterSensorData::Entry> store(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ);
+    DataStore<WaterSensorData::Entry> store(WATER_SENSOR_DATA_PATH, WATER_SENSOR_DATA_ENTRIES_PER_SUBMIT_REQ, &FORMAT);
 
     /******************************************************************************
     * Add water sensor data to storage
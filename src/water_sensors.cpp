@@ -6,193 +6,325 @@
 #include "utils.h"
 #include "log.h"
 #include "common.h"
+#include "sensor_tasks.h"
+#include "power_control.h"
+#include "call_home.h"
+#include "tb_water_sensor_data_json_builder.h"
 #include "driver/rtc_io.h"
+#include "driver/gpio.h"
+#include "esp_sleep.h"
 
 namespace WaterSensors
 {
+	//
+	// Private functions
+	//
+	RetResult measure_quality(WaterSensorData::Entry *data);
+	RetResult measure_level(WaterSensorData::Entry *data);
+	RetResult store_entry(WaterSensorData::Entry *data, RetResult ret_quality, RetResult ret_level);
+	RetResult acquire_quality();
+	RetResult acquire_level();
+	RetResult store();
+	RetResult submit(DataStoreSubmitStats *stats);
+	bool is_enabled();
+	char sdi12_address();
+
+	//
+	// Private members
+	//
+	/** Last acquired data, until stored */
+	WaterSensorData::Entry _quality_data;
+	WaterSensorData::Entry _level_data;
+	RetResult _quality_ret = RET_ERROR;
+	RetResult _level_ret = RET_ERROR;
+
+	const SensorDriver DRIVER = {
+		"water sensors",
+		SleepScheduler::REASON_READ_WATER_SENSORS,
+		PowerControl::RAIL_SENSORS,
+		is_enabled,
+		sdi12_address,
+		init,
+		{
+			{SensorTasks::BUS_SDI12, acquire_quality},
+			{SensorTasks::BUS_WATER_LEVEL, acquire_level}
+		},
+		store,
+		submit
+	};
+
 	/******************************************************************************
 	 * Init
 	 *****************************************************************************/
 	RetResult init()
 	{
-		// Make sure sensors are off
-		off();
-
-		// Setup RTC GPIO
-		esp_sleep_pd_config(esp_sleep_pd_domain_t::ESP_PD_DOMAIN_RTC_PERIPH, esp_sleep_pd_option_t::ESP_PD_OPTION_ON);
-		rtc_gpio_pulldown_en(PIN_WATER_SENSORS_PWR);
-		rtc_gpio_set_direction(PIN_WATER_SENSORS_PWR, rtc_gpio_mode_t::RTC_GPIO_MODE_OUTPUT_ONLY);
+		// Power pin setup and initial state handled by PowerControl
+		WaterLevel::init();
+		WaterPresence::init();
 
 		return RET_OK;
 	}
 
 	/******************************************************************************
 	 * Turn water sensors ON
-	 * Both water sensors' power is controlled from the same GPIO
+	 * Both water sensors' power is controlled from the same GPIO, shared with the
+	 * other SDI12 sensors. Must be matched by an off().
 	 *****************************************************************************/
 	RetResult on()
 	{
-		debug_println(F("Water sensors ON."));
+		return PowerControl::acquire(PowerControl::RAIL_SENSORS);
+	}
+
+	/******************************************************************************
+	 * Light sleep while sensors are measuring. Power pin is held high with RTC
+	 * GPIO hold so sensors stay powered.
+	 * @param ms		Time to sleep
+	 * @param wake_pin	Wake up early when pin goes high (SDI12 service request),
+	 *					-1 for none
+	 * @return True if woken up by wake_pin
+	 *****************************************************************************/
+	bool sleep(uint32_t ms, int wake_pin)
+	{
+		// Light sleep would also stop sensor tasks reading other buses
+		if(!FLAGS.SENSOR_WAIT_LIGHT_SLEEP_ENABLED || ms < WATER_SENSORS_MIN_SLEEP_MS || SensorTasks::is_concurrent())
+		{
+			delay(ms);
+			return false;
+		}
+
+		// Pin must be idle (low), otherwise device wakes up immediately
+		bool pin_wakeup = wake_pin >= 0 && gpio_get_level((gpio_num_t)wake_pin) == 0;
+		if(pin_wakeup)
+		{
+			gpio_wakeup_enable((gpio_num_t)wake_pin, GPIO_INTR_HIGH_LEVEL);
+			esp_sleep_enable_gpio_wakeup();
+		}
+
+		PowerControl::hold(PowerControl::RAIL_SENSORS, true);
+		Serial.flush();
+
+		bool woke_on_pin = false;
+		uint32_t start_ms = millis();
+		uint32_t elapsed_ms = 0;
+
+		// Other wake up sources (eg. lightning IRQ) can end sleep early, sleep again
+		while(elapsed_ms + WATER_SENSORS_MIN_SLEEP_MS <= ms)
+		{
+			esp_sleep_enable_timer_wakeup((uint64_t)(ms - elapsed_ms) * 1000);
+			esp_light_sleep_start();
+
+			elapsed_ms = millis() - start_ms;
+
+			if(pin_wakeup && esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO)
+			{
+				woke_on_pin = true;
+				break;
+			}
+		}
 
-		#ifdef TCALL_H
-			// Turn IP5306 power boost OFF to reduce idle current
-			Utils::ip5306_set_power_boost_state(true);
-		#endif
+		if(!woke_on_pin && elapsed_ms < ms)
+			delay(ms - elapsed_ms);
 
-		// TODO: Power on/off mgmt should be moved to Power::switch
-		pinMode(PIN_WATER_SENSORS_PWR, OUTPUT);
-		digitalWrite(PIN_WATER_SENSORS_PWR, 1);
-		delay(WATER_SENSORS_POWER_ON_DELAY_MS);
+		if(pin_wakeup)
+		{
+			esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_GPIO);
+			gpio_wakeup_disable((gpio_num_t)wake_pin);
+		}
 
-		delay(200);
+		PowerControl::hold(PowerControl::RAIL_SENSORS, false);
 
-        return RET_OK;
+		return woke_on_pin;
 	}
 
 	/******************************************************************************
-	 * Turn water sensors OFF
+	 * Turn water sensors OFF, power stays on while other sensors use it
 	 *****************************************************************************/
 	RetResult off()
 	{
-		debug_println(F("Water sensors OFF."));
+		return PowerControl::release(PowerControl::RAIL_SENSORS);
+	}
 
-		// TODO: Power on/off mgmt should be moved to Power::switch
+	/******************************************************************************
+	* Driver acquisition jobs. Quality (SDI12) and level are on different buses
+	* and may run concurrently, data is kept until store().
+	* Sensors rail is held by the caller (registry), jobs don't take a reference
+	* of their own so a stuck sensor's rail can be power cycled.
+	******************************************************************************/
+	RetResult acquire_quality()
+	{
+		memset(&_quality_data, 0, sizeof(_quality_data));
+		_quality_ret = RET_ERROR;
 
-		pinMode(PIN_WATER_SENSORS_PWR, OUTPUT);
-		digitalWrite(PIN_WATER_SENSORS_PWR, 0);
+		if(!FLAGS.WATER_QUALITY_SENSOR_ENABLED)
+			return RET_OK;
 
-		// Set to input instead of driving low to prevent LED on TSIM from turning ON
-		// pinMode(PIN_WATER_SENSORS_PWR, INPUT);
+		_quality_ret = measure_quality(&_quality_data);
 
-		rtc_gpio_set_level(PIN_WATER_SENSORS_PWR, 0);
-		delay(100);
+		return _quality_ret;
+	}
+
+	RetResult acquire_level()
+	{
+		memset(&_level_data, 0, sizeof(_level_data));
+		_level_ret = RET_ERROR;
 
-		#ifdef TCALL_H
-			// Turn IP5306 power boost OFF to reduce idle current
-			Utils::ip5306_set_power_boost_state(false);
-		#endif
+		if(!FLAGS.WATER_LEVEL_SENSOR_ENABLED)
+			return RET_OK;
 
-        return RET_OK;
+		_level_ret = measure_level(&_level_data);
+
+		return _level_ret;
 	}
 
 	/******************************************************************************
-	* Read all water sensors and log their data in memory
+	* Merge and store acquired data
 	* @return RET_ERROR only if failed to read BOTH sensors
 	******************************************************************************/
-	RetResult log()
+	RetResult store()
 	{
-		WaterSensorData::Entry data = {0};
-		int tries = 3;
-		RetResult ret_quality = RET_ERROR, ret_level;
+		_quality_data.water_level = _level_data.water_level;
 
-		if(!FLAGS.WATER_QUALITY_SENSOR_ENABLED & !FLAGS.WATER_LEVEL_SENSOR_ENABLED)
-		{
-			Serial.println(F("No water sensor is enabled."));
-			return RET_ERROR;
-		}
+		RetResult ret = store_entry(&_quality_data, _quality_ret, _level_ret);
 
-		WaterSensors::on();
+		_quality_ret = RET_ERROR;
+		_level_ret = RET_ERROR;
 
-		if(FLAGS.WATER_QUALITY_SENSOR_ENABLED)
-		{
-			Log::log(Log::WATER_SENSORS_MEASUREMENT_LOG);
+		return ret;
+	}
+
+	/******************************************************************************
+	* Submit stored data when calling home
+	******************************************************************************/
+	RetResult submit(DataStoreSubmitStats *stats)
+	{
+		return CallHome::submit_stored_telemetry<DataStore<WaterSensorData::Entry>, TbWaterSensorDataJsonBuilder, WaterSensorData::Entry>(WaterSensorData::get_store(), stats);
+	}
+
+	/******************************************************************************
+	* Driver config
+	******************************************************************************/
+	bool is_enabled()
+	{
+		return FLAGS.WATER_QUALITY_SENSOR_ENABLED || FLAGS.WATER_LEVEL_SENSOR_ENABLED;
+	}
+
+	char sdi12_address()
+	{
+		// Dummy measurements do not use the bus
+		if(!FLAGS.WATER_QUALITY_SENSOR_ENABLED || FLAGS.MEASURE_DUMMY_WATER_QUALITY)
+			return 0;
+
+		return AQUATROLL_SDI12_ADDRESS;
+	}
+
+	/******************************************************************************
+	* Read water quality sensor
+	* Try reading X times. If fails, cycle power and try once more. Power is
+	* only cycled when no other sensor uses the rail.
+	* @param data Output
+	******************************************************************************/
+	RetResult measure_quality(WaterSensorData::Entry *data)
+	{
+		int tries = 3;
+		RetResult ret_quality = RET_ERROR;
+
+		Log::log(Log::WATER_SENSORS_MEASUREMENT_LOG);
 
-			//
-			// Read water quality sensor
-			// Try reading X times. If fails, cycle power and try once more.
-			WaterSensors::on();
+		do
+		{
+			ret_quality = Aquatroll::measure(data);
 
-			do
+			if(ret_quality != RET_OK)
 			{
-				ret_quality = Aquatroll::measure(&data);
+				Utils::serial_style(STYLE_RED);
+				debug_print(F("Failed to read water quality sensor."));
+				Utils::serial_style(STYLE_RESET);
 
-				if(ret_quality != RET_OK)
+				if(tries > 1)
 				{
-					Utils::serial_style(STYLE_RED);
-					debug_print(F("Failed to read water quality sensor."));
-					Utils::serial_style(STYLE_RESET);
-
-					if(tries > 1)
-					{
-						debug_print(F("Retrying..."));
-						delay(WATER_QUALITY_RETRY_WAIT_MS);
-					}
-					debug_println();
-
-					// Next try is last, cycle power
-					if(tries == 2)
-					{
-						debug_println(F("Cycling sensor power."));	
-						WaterSensors::off();
-						WaterSensors::on();
-					}
+					debug_print(F("Retrying..."));
+					delay(WATER_QUALITY_RETRY_WAIT_MS);
 				}
-				else
-					break;
-
-			}while(--tries);
+				debug_println();
 
-			// Log possible error
-			if(ret_quality == RET_ERROR)
-			{
-				Log::log(Log::WATER_QUALITY_MEASUREMENT_FAILED);
+				// Next try is last, cycle power
+				if(tries == 2)
+				{
+					debug_println(F("Cycling sensor power."));	
+					PowerControl::cycle(PowerControl::RAIL_SENSORS);
+				}
 			}
+			else
+				break;
+
+		}while(--tries);
+
+		// Log possible error
+		if(ret_quality == RET_ERROR)
+		{
+			Log::log(Log::WATER_QUALITY_MEASUREMENT_FAILED);
 		}
 
-		//
-		// Read water level
-		//
-		tries = 3;
-		if(FLAGS.WATER_LEVEL_SENSOR_ENABLED)
+		return ret_quality;
+	}
+
+	/******************************************************************************
+	* Read water level sensor
+	* Power is only cycled when no other sensor uses the rail.
+	* @param data Output
+	******************************************************************************/
+	RetResult measure_level(WaterSensorData::Entry *data)
+	{
+		int tries = 3;
+		RetResult ret_level = RET_ERROR;
+
+		do
 		{
-			do
+			ret_level = WaterLevel::measure(data);
+
+			if(ret_level != RET_OK)
 			{
-				ret_level = WaterLevel::measure(&data);
+				debug_print_e(F("Failed to read water level sensor."));
+
+				Log::log(Log::WATER_LEVEL_MEASURE_FAILED, WaterLevel::get_last_error());
 
-				if(ret_level != RET_OK)
+				if(tries > 1)
 				{
-					debug_print_e(F("Failed to read water level sensor."));
-
-					Log::log(Log::WATER_LEVEL_MEASURE_FAILED, WaterLevel::get_last_error());
-
-					if(tries > 1)
-					{
-						debug_print(F("Retrying..."));
-						delay(WATER_LEVEL_RETRY_WAIT_MS);
-					}
-					debug_println();
-
-					// Next try is last, cycle power
-					if(tries == 2)
-					{
-						debug_println(F("Cycling sensor power."));	
-						WaterSensors::off();
-						WaterSensors::on();
-					}
+					debug_print(F("Retrying..."));
+					delay(WATER_LEVEL_RETRY_WAIT_MS);
 				}
-				else
+				debug_println();
+
+				// Next try is last, cycle power
+				if(tries == 2)
 				{
-					break;
+					debug_println(F("Cycling sensor power."));	
+					PowerControl::cycle(PowerControl::RAIL_SENSORS);
 				}
-			}while(--tries);
-		
-			// Log possible error
-			// if(ret_level != RET_OK)
-			// {
-			// 	Log::log(Log::WATER_LEVEL_MEASURE_FAILED);
-			// }
-		}
+			}
+			else
+			{
+				break;
+			}
+		}while(--tries);
 
+		return ret_level;
+	}
+
+	/******************************************************************************
+	* Read water presence sensor, set timestamp and store measured data
+	* @return RET_ERROR if both quality and level failed
+	******************************************************************************/
+	RetResult store_entry(WaterSensorData::Entry *data, RetResult ret_quality, RetResult ret_level)
+	{
 		//
 		// Read water presence sensor
 		//
 		if(FLAGS.WATER_PRESENCE_SENSOR_ENABLED)
 		{
-			WaterPresence::measure(&data);
+			WaterPresence::measure(data);
 		}
 
-		WaterSensors::off();
-
 		// If both sensors failed no reason to log error, return error
 		if(ret_level != RET_OK && ret_quality != RET_OK)
 		{
@@ -203,14 +335,14 @@ namespace WaterSensors
 		//
 		// Set timestamp and save
 		//
-		data.timestamp = RTC::get_timestamp();
+		data->timestamp = RTC::get_timestamp();
 
 		debug_println(F("Water sensor data:"));
-		WaterSensorData::print(&data);
+		WaterSensorData::print(data);
 
-		WaterSensorData::add(&data);
+		WaterSensorData::add(data);
 		WaterSensorData::get_store()->commit();
 
 		return RET_OK;
 	}
-}
\ No newline at end of file
+}